@@ -0,0 +1,251 @@
+/*******************
+ *
+ *
+ *  GRATE 9
+ *
+ *  Microbenchmarks of the model's inner routines
+ *
+ *
+ *
+*********************/
+
+#include "harness.h"
+#include "model.h"
+#include "checkpoint.h"
+#include "grateerror.h"
+#include "setup.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <ciso646>
+
+namespace {
+
+volatile double sink;                          // Keeps results of pure functions alive
+
+void printUsage()
+{
+    std::cerr << "Usage: grate_benchmarks [options]" << std::endl;
+    std::cerr << "  --input FILE           xml input the inputs are taken from (default test_out.xml)" << std::endl;
+    std::cerr << "  --spin-up N            model steps run before measuring, so the state is realistic (default 200)" << std::endl;
+    std::cerr << "  --repetitions N        timed samples per benchmark (default 30)" << std::endl;
+    std::cerr << "  --warmup SECONDS       untimed runs before sampling (default 0.1)" << std::endl;
+    std::cerr << "  --min-time SECONDS     batch cheap runs until a sample takes this long (default 0.002)" << std::endl;
+    std::cerr << "  --filter TEXT          only run benchmarks whose name contains TEXT; may be repeated" << std::endl;
+    std::cerr << "  --json FILE            also write the results as json" << std::endl;
+    std::cerr << "  --list                 list the benchmarks and exit" << std::endl;
+}
+
+bool readSetupFile(const std::string &fileName, ModelSetup &setup)
+{
+    std::ifstream in(fileName, std::ios::binary);
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    XMLDocument doc;
+    if (not in || doc.Parse(text.data(), text.size()) != XML_SUCCESS || doc.FirstChildElement() == NULL)
+    {
+        std::cerr << "Error reading xml parameters from " << fileName << std::endl;
+        return false;
+    }
+    try {
+        readSetup(doc.FirstChildElement(), setup);
+    }
+    catch (const GrateError &e) {
+        std::cerr << "Error in " << fileName << ": " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// The tridiagonal block system of hydro::fullyDynamic for n nodes (2n rows of four coefficients
+// and a right hand side), filled with well conditioned coefficients
+std::vector< std::vector<double> > matsolSystem(int n)
+{
+    std::vector< std::vector<double> > eqn(2 * n, std::vector<double>(5, 0.0));
+    eqn[0][1] = 1.0;
+    eqn[0][4] = -0.5;
+    for (int i = 0; i < n - 1; i++)
+    {
+        int k = 2 * i + 1;
+        double s = 1.0 + 0.01 * (i % 7);
+        eqn[k][0] = 2.0 * s;
+        eqn[k][1] = 0.1;
+        eqn[k][2] = -0.2;
+        eqn[k][3] = 0.5;
+        eqn[k][4] = -0.3 * s;
+        eqn[k+1][0] = 0.5;
+        eqn[k+1][1] = -0.1;
+        eqn[k+1][2] = 0.3;
+        eqn[k+1][3] = 2.0 * s;
+        eqn[k+1][4] = 0.2;
+    }
+    eqn[2 * n - 1][2] = 1.0;
+    eqn[2 * n - 1][4] = -0.1;
+    return eqn;
+}
+
+}  // namespace
+
+
+int main(int argc, char *argv[])
+{
+    std::string input_file = "test_out.xml";
+    std::string json_file;
+    int spin_up = 200;
+    bool list_only = false;
+    HarnessOptions options;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--input" && has_value)
+            input_file = argv[++i];
+        else if (arg == "--spin-up" && has_value)
+            spin_up = std::atoi(argv[++i]);
+        else if (arg == "--repetitions" && has_value)
+            options.repetitions = std::atoi(argv[++i]);
+        else if (arg == "--warmup" && has_value)
+            options.warmup = std::atof(argv[++i]);
+        else if (arg == "--min-time" && has_value)
+            options.minSample = std::atof(argv[++i]);
+        else if (arg == "--filter" && has_value)
+            options.filters.push_back(argv[++i]);
+        else if (arg == "--json" && has_value)
+            json_file = argv[++i];
+        else if (arg == "--list")
+            list_only = true;
+        else {
+            printUsage();
+            return 1;
+        }
+    }
+    if (options.repetitions < 2 || spin_up < 0) {
+        std::cerr << "Need at least 2 repetitions and a spin-up of 0 or more steps" << std::endl;
+        return 1;
+    }
+
+    ModelSetup setup;
+    if (not readSetupFile(input_file, setup))
+        return 1;
+
+    // a model spun up to a realistic state is the source of every input; the routines that change
+    // the state run on a second model that is restored from it before each sample
+    std::filesystem::path scratch = std::filesystem::temp_directory_path();
+    std::string tag = std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+    std::string ref_results = (scratch / ("grate_bench_ref_" + tag + ".txt")).string();
+    std::string work_results = (scratch / ("grate_bench_work_" + tag + ".txt")).string();
+
+    std::vector<std::string> scratch_files;
+    int status = 0;
+    try {
+        Model ref(setup, ref_results, NULL);
+        for (int s = 0; s < spin_up; s++)
+            if (not ref.iteration())
+                throw GrateError("model failed during spin-up: " + ref.status().lastError());
+        Model work(setup, work_results, NULL);
+        copyModelState(ref, work);
+        scratch_files = ref.resultsFiles();
+        std::vector<std::string> more = work.resultsFiles();
+        scratch_files.insert(scratch_files.end(), more.begin(), more.end());
+
+        RiverProfile *r = work.rn;
+        hydro *wl = work.wl;
+        sed *sd = work.sd;
+        unsigned int nodes = r->nnodes;
+        std::function<void()> restore = [&]() { copyModelState(ref, work); };
+
+        Harness harness(options);
+
+        // grain size distributions and cross-sections: copies, the routines only derive fields
+        std::vector<NodeGSDObject> gsd = ref.rn->F;
+        std::vector<NodeXSObject> xs = ref.rn->RiverXS;
+
+        harness.add(Benchmark{"gsd/norm_frac", nodes, [&]() {
+            for (unsigned int n = 0; n < nodes; n++)
+                gsd[n].norm_frac();
+        }, nullptr});
+        harness.add(Benchmark{"gsd/dg_and_std", nodes, [&]() {
+            for (unsigned int n = 0; n < nodes; n++)
+                gsd[n].dg_and_std();
+        }, nullptr});
+        harness.add(Benchmark{"xs/xsArea", nodes, [&]() {
+            for (unsigned int n = 0; n < nodes; n++)
+                xs[n].xsArea();
+        }, nullptr});
+        harness.add(Benchmark{"xs/xsPerim", nodes, [&]() {
+            for (unsigned int n = 0; n < nodes; n++)
+                xs[n].xsPerim();
+        }, nullptr});
+        harness.add(Benchmark{"xs/xsCentr", nodes, [&]() {
+            for (unsigned int n = 0; n < nodes; n++)
+                xs[n].xsCentr();
+        }, nullptr});
+        harness.add(Benchmark{"xs/xsECI", nodes, [&]() {
+            for (unsigned int n = 0; n < nodes; n++)
+                xs[n].xsECI(gsd[n]);
+        }, nullptr});
+        harness.add(Benchmark{"xs/xsWilcockTransport", nodes, [&]() {
+            for (unsigned int n = 0; n < nodes; n++)
+                xs[n].xsWilcockTransport(gsd[n]);
+        }, nullptr});
+
+        // hydraulics, on the model's own nodes in the order backWater visits them
+        harness.add(Benchmark{"hydro/xsCritDepth", nodes - 2, [&]() {
+            for (unsigned int n = nodes - 2; n > 0; n--)
+                wl->xsCritDepth(n, r, wl->QwCumul[n]);
+        }, restore});
+        harness.add(Benchmark{"hydro/energyConserve", nodes - 2, [&]() {
+            for (unsigned int n = nodes - 2; n > 0; n--)
+                wl->energyConserve(n, r);
+        }, restore});
+        harness.add(Benchmark{"hydro/regimeModel", nodes - 2, [&]() {
+            for (unsigned int n = nodes - 2; n > 0; n--)
+                wl->regimeModel(n, r);
+        }, restore});
+
+        std::vector< std::vector<double> > eqn = matsolSystem(nodes);
+        harness.add(Benchmark{"hydro/matsol", 1, [&]() {
+            sink = wl->matsol(nodes, eqn, r->diag)[0];
+        }, nullptr});
+
+        harness.add(Benchmark{"sed/exner", 1, [&]() {
+            sd->exner(r);
+        }, restore});
+
+        // a run's worth of step boundaries
+        std::vector<GrateTime> times(64, r->startTime);
+        for (unsigned int t = 1; t < times.size(); t++) {
+            times[t] = times[t-1];
+            times[t].addSecs(r->dt);
+        }
+        harness.add(Benchmark{"time/secsTo", (unsigned int)times.size() - 1, [&]() {
+            for (unsigned int t = 0; t + 1 < times.size(); t++)
+                sink = times[t].secsTo(times[t+1]);
+        }, nullptr});
+
+        if (list_only) {
+            harness.list(std::cout);
+        }
+        else {
+            std::cout << "Inputs from " << input_file << " (" << nodes << " nodes) after " << spin_up << " steps; "
+                      << options.repetitions << " samples per benchmark, times per call" << std::endl;
+            harness.run(std::cout);
+            if (not json_file.empty())
+                harness.writeJson(json_file, input_file, spin_up);
+        }
+    }
+    catch (const GrateError &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        status = 1;
+    }
+
+    scratch_files.push_back(ref_results);
+    scratch_files.push_back(work_results);
+    for (unsigned int f = 0; f < scratch_files.size(); f++)
+        std::remove(scratch_files[f].c_str());
+    return status;
+}
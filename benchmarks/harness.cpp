@@ -0,0 +1,244 @@
+/*******************
+ *
+ *
+ *  GRATE 9
+ *
+ *  Microbenchmark harness: warm-up, batching, repetitions and confidence intervals
+ *
+ *
+ *
+*********************/
+
+#include "harness.h"
+#include "grateerror.h"
+#include "jsontext.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <ciso646>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const double Z975 = 1.959964;                  // Two-sided 95% point of the normal distribution
+
+// Two-sided 95% point of Student's t with df degrees of freedom: a table for the few samples
+// where it matters, the Cornish-Fisher expansion (good to 1e-3 from df = 10) beyond
+double tQuantile975(int df)
+{
+    static const double table[] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228
+    };
+    if (df < 1)
+        return NAN;
+    if (df <= 10)
+        return table[df - 1];
+    double z = Z975, z3 = z * z * z, z5 = z3 * z * z;
+    return z + (z3 + z) / (4.0 * df) + (5 * z5 + 16 * z3 + 3 * z) / (96.0 * df * df);
+}
+
+// Linear interpolation between order statistics, as R's default quantile
+double quantile(const std::vector<double> &sorted, double p)
+{
+    double h = (sorted.size() - 1) * p;
+    size_t lo = (size_t)std::floor(h);
+    size_t hi = std::min(lo + 1, sorted.size() - 1);
+    return sorted[lo] + (h - lo) * (sorted[hi] - sorted[lo]);
+}
+
+double runBatch(const Benchmark &b, unsigned long batch)
+{
+    Clock::time_point start = Clock::now();
+    for (unsigned long i = 0; i < batch; i++)
+        b.run();
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// The same for a benchmark that changes its inputs: each run is restored first, outside the time
+double runResetBatch(const Benchmark &b, unsigned long batch)
+{
+    double seconds = 0;
+    for (unsigned long i = 0; i < batch; i++)
+    {
+        b.reset();
+        Clock::time_point start = Clock::now();
+        b.run();
+        seconds += std::chrono::duration<double>(Clock::now() - start).count();
+    }
+    return seconds;
+}
+
+double sampleBatch(const Benchmark &b, unsigned long batch)
+{
+    return b.reset ? runResetBatch(b, batch) : runBatch(b, batch);
+}
+
+}  // namespace
+
+
+HarnessOptions::HarnessOptions()
+{
+    repetitions = 30;
+    warmup = 0.1;
+    minSample = 0.002;
+}
+
+void Harness::list(std::ostream &out) const
+{
+    for (unsigned int i = 0; i < benchmarks.size(); i++)
+        out << benchmarks[i].name << "\n";
+}
+
+bool Harness::selected(const Benchmark &b) const
+{
+    if (options.filters.empty())
+        return true;
+    for (unsigned int f = 0; f < options.filters.size(); f++)
+        if (b.name.find(options.filters[f]) != std::string::npos)
+            return true;
+    return false;
+}
+
+void Harness::run(std::ostream &progress)
+{
+    printHeader(progress);
+    for (unsigned int i = 0; i < benchmarks.size(); i++)
+    {
+        if (not selected(benchmarks[i]))
+            continue;
+        measured.push_back(measure(benchmarks[i]));
+        print(progress, measured.back());
+    }
+}
+
+BenchmarkResult Harness::measure(const Benchmark &b) const
+{
+    // warm caches, branch predictors and the CPU's clock before anything is timed
+    Clock::time_point warmEnd = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.warmup));
+    int warmRuns = 0;
+    do {
+        if (b.reset)
+            b.reset();
+        b.run();
+        warmRuns++;
+    } while (warmRuns < 3 || Clock::now() < warmEnd);
+
+    // batch cheap runs so a sample is far above the clock's resolution and overhead; a benchmark
+    // with a reset changes its inputs, so its runs are timed one by one and summed into a sample
+    unsigned long batch = 1;
+    while (batch < (1ul << 30) && sampleBatch(b, batch) < options.minSample)
+        batch *= 2;
+
+    std::vector<double> samples;
+    for (int s = 0; s < options.repetitions; s++)
+        samples.push_back(sampleBatch(b, batch) * 1e9 / (double(batch) * b.calls));
+    return summarise(b.name, batch * b.calls, samples);
+}
+
+BenchmarkResult Harness::summarise(const std::string &name, unsigned long callsPerSample, std::vector<double> samples)
+{
+    BenchmarkResult r;
+    r.name = name;
+    r.callsPerSample = callsPerSample;
+    r.samples = samples.size();
+    r.mean = r.meanLow = r.meanHigh = r.median = r.medianLow = r.medianHigh = r.stdev = r.min = NAN;
+    r.outliers = 0;
+    if (samples.empty())
+        return r;
+
+    std::sort(samples.begin(), samples.end());
+    size_t n = samples.size();
+
+    double sum = 0;
+    for (size_t i = 0; i < n; i++)
+        sum += samples[i];
+    r.mean = sum / n;
+    double ss = 0;
+    for (size_t i = 0; i < n; i++)
+        ss += (samples[i] - r.mean) * (samples[i] - r.mean);
+    if (n > 1)
+    {
+        r.stdev = std::sqrt(ss / (n - 1));
+        double half = tQuantile975(n - 1) * r.stdev / std::sqrt(double(n));
+        r.meanLow = r.mean - half;
+        r.meanHigh = r.mean + half;
+    }
+
+    // timings are skewed by interruptions, so the median and its distribution-free interval
+    // (ranks from the normal approximation to the binomial) are the figures to compare
+    r.median = quantile(samples, 0.5);
+    double spread = Z975 * std::sqrt(double(n)) / 2;
+    long lo = (long)std::floor(n / 2.0 - spread);
+    long hi = (long)std::ceil(n / 2.0 + spread);
+    r.medianLow = samples[std::max(lo, 1l) - 1];
+    r.medianHigh = samples[std::min(hi, (long)n) - 1];
+    r.min = samples[0];
+
+    double q1 = quantile(samples, 0.25), q3 = quantile(samples, 0.75);
+    double fence = 1.5 * (q3 - q1);
+    for (size_t i = 0; i < n; i++)
+        if (samples[i] < q1 - fence || samples[i] > q3 + fence)
+            r.outliers++;
+    return r;
+}
+
+void Harness::printHeader(std::ostream &out)
+{
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-28s %10s %12s %10s %12s %23s %12s %8s\n", "benchmark", "calls", "mean (ns)",
+                  "+/- 95%", "median (ns)", "median 95% CI", "min (ns)", "outliers");
+    out << line;
+}
+
+void Harness::print(std::ostream &out, const BenchmarkResult &r)
+{
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-28s %10lu %12.1f %9.1f%% %12.1f [%10.1f, %10.1f] %12.1f %5d/%d\n",
+                  r.name.c_str(), r.callsPerSample, r.mean, 100 * (r.meanHigh - r.mean) / r.mean, r.median,
+                  r.medianLow, r.medianHigh, r.min, r.outliers, r.samples);
+    out << line;
+    out.flush();
+}
+
+void Harness::writeJson(const std::string &fileName, const std::string &input, int spinUp) const
+{
+    std::ofstream out(fileName);
+    if (not out)
+        throw GrateError("Error writing benchmark results: " + fileName);
+
+    out << "{\n  \"input\": ";
+    writeJsonString(out, input);
+    out << ",\n  \"spin_up_steps\": " << spinUp
+        << ",\n  \"repetitions\": " << options.repetitions << ",\n  \"unit\": \"ns\",\n  \"benchmarks\": [";
+    for (unsigned int i = 0; i < measured.size(); i++)
+    {
+        const BenchmarkResult &r = measured[i];
+        out << (i > 0 ? "," : "") << "\n    {\"name\": ";
+        writeJsonString(out, r.name);
+        out << ", \"calls\": " << r.callsPerSample
+            << ", \"samples\": " << r.samples << ", \"mean\": ";
+        writeJsonNumber(out, r.mean);
+        out << ", \"mean_ci\": [";
+        writeJsonNumber(out, r.meanLow);
+        out << ", ";
+        writeJsonNumber(out, r.meanHigh);
+        out << "], \"median\": ";
+        writeJsonNumber(out, r.median);
+        out << ", \"median_ci\": [";
+        writeJsonNumber(out, r.medianLow);
+        out << ", ";
+        writeJsonNumber(out, r.medianHigh);
+        out << "], \"stdev\": ";
+        writeJsonNumber(out, r.stdev);
+        out << ", \"min\": ";
+        writeJsonNumber(out, r.min);
+        out << ", \"outliers\": " << r.outliers << "}";
+    }
+    out << (measured.empty() ? "]\n" : "\n  ]\n") << "}\n";
+
+    if (not out)
+        throw GrateError("Error writing benchmark results: " + fileName);
+}
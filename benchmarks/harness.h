@@ -0,0 +1,76 @@
+#ifndef HARNESS_H
+#define HARNESS_H
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+// A microbenchmark: 'run' does 'calls' calls of the code being measured (e.g. one sweep over the
+// nodes), and times are reported per call. If 'reset' is given it restores the inputs, untimed,
+// before every run, and the runs of a sample are timed one at a time.
+struct Benchmark
+{
+    std::string name;                          // e.g. "hydro/xsCritDepth"
+    unsigned int calls;
+    std::function<void()> run;
+    std::function<void()> reset;
+};
+
+struct HarnessOptions
+{
+    HarnessOptions();
+
+    int repetitions;                           // Timed samples per benchmark
+    double warmup;                             // Seconds of untimed runs before sampling
+    double minSample;                          // Runs are batched until a sample takes this long (s)
+    std::vector<std::string> filters;          // Only benchmarks whose name contains one of these
+};
+
+// Summary of the per-call times of one benchmark, in nanoseconds
+struct BenchmarkResult
+{
+    std::string name;
+    unsigned long callsPerSample;
+    int samples;
+    double mean;
+    double meanLow, meanHigh;                  // 95% confidence interval of the mean (Student's t)
+    double median;
+    double medianLow, medianHigh;              // 95% confidence interval of the median (order statistics)
+    double stdev;
+    double min;
+    int outliers;                              // Samples outside the Tukey fences (1.5 IQR)
+};
+
+// Runs each benchmark in turn: a warm-up, a calibration of the batch size so that a sample is
+// long compared with the clock's resolution, then the timed samples.
+class Harness
+{
+public:
+
+    explicit Harness(const HarnessOptions &options) : options(options) {}
+
+    void add(const Benchmark &b) { benchmarks.push_back(b); }
+    void list(std::ostream &out) const;
+    bool selected(const Benchmark &b) const;
+
+    void run(std::ostream &progress);          // Prints each result as it is measured
+    const std::vector<BenchmarkResult> &results() const { return measured; }
+
+    // throws GrateError if the file can't be written
+    void writeJson(const std::string &fileName, const std::string &input, int spinUp) const;
+
+    static BenchmarkResult summarise(const std::string &name, unsigned long callsPerSample, std::vector<double> samples);
+    static void printHeader(std::ostream &out);
+    static void print(std::ostream &out, const BenchmarkResult &r);
+
+private:
+    HarnessOptions options;
+    std::vector<Benchmark> benchmarks;
+    std::vector<BenchmarkResult> measured;
+
+    BenchmarkResult measure(const Benchmark &b) const;
+};
+
+#endif // HARNESS_H
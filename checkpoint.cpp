@@ -0,0 +1,447 @@
+/*******************
+ *
+ *
+ *  GRATE 9
+ *
+ *  Binary checkpoint / restart of the model state
+ *
+ *
+ *
+*********************/
+
+#include "checkpoint.h"
+#include "model.h"
+#include "grateerror.h"
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <filesystem>
+#include <vector>
+
+namespace {
+
+const char checkpointMagic[8] = {'G', 'R', 'A', 'T', 'E', 'C', 'K', 'P'};
+const char checkpointTrailer[8] = {'E', 'N', 'D', 'C', 'K', 'P', 'T', '!'};
+const uint32_t endianMarker = 0x01020304;
+
+// The same transfer() functions are used for writing and reading, so the two can't drift apart
+template <class Archive> void transfer(Archive &ar, NodeGSDObject &g);
+template <class Archive> void transfer(Archive &ar, NodeXSObject &xs);
+template <class Archive> void transfer(Archive &ar, TS_Object &ts);
+template <class Archive> void transfer(Archive &ar, Stratigraphy &s);
+
+class CheckpointWriter
+{
+public:
+    explicit CheckpointWriter(std::ofstream &s) : out(s) {}
+
+    static const bool loading = false;
+
+    template <class T> void raw(T &v) { out.write(reinterpret_cast<const char*>(&v), sizeof(T)); }
+
+    void io(double &v) { raw(v); }
+    void io(int &v) { raw(v); }
+    void io(unsigned int &v) { raw(v); }
+    void io(uint64_t &v) { raw(v); }
+
+    void io(std::vector<double> &v) {
+        uint64_t n = v.size();
+        raw(n);
+        out.write(reinterpret_cast<const char*>(v.data()), n * sizeof(double));
+    }
+
+    void io(std::vector<unsigned int> &v) {
+        uint64_t n = v.size();
+        raw(n);
+        out.write(reinterpret_cast<const char*>(v.data()), n * sizeof(unsigned int));
+    }
+
+    template <class T> void io(std::vector<T> &v) {
+        uint64_t n = v.size();
+        raw(n);
+        for (uint64_t i = 0; i < n; i++)
+            io(v[i]);
+    }
+
+    void io(GrateTime &t) {
+        std::tm tm = t.getTm();
+        int fields[9] = {tm.tm_sec, tm.tm_min, tm.tm_hour, tm.tm_mday, tm.tm_mon,
+                         tm.tm_year, tm.tm_wday, tm.tm_yday, tm.tm_isdst};
+        out.write(reinterpret_cast<const char*>(fields), sizeof(fields));
+    }
+
+    template <class T> void io(T &obj) { transfer(*this, obj); }
+
+private:
+    std::ofstream &out;
+};
+
+class CheckpointReader
+{
+public:
+    CheckpointReader(std::ifstream &s, const std::string &name) : in(s), fileName(name) {}
+
+    static const bool loading = true;
+
+    template <class T> void raw(T &v) {
+        in.read(reinterpret_cast<char*>(&v), sizeof(T));
+        check();
+    }
+
+    void io(double &v) { raw(v); }
+    void io(int &v) { raw(v); }
+    void io(unsigned int &v) { raw(v); }
+    void io(uint64_t &v) { raw(v); }
+
+    void io(std::vector<double> &v) {
+        v.resize(length());
+        in.read(reinterpret_cast<char*>(v.data()), v.size() * sizeof(double));
+        check();
+    }
+
+    void io(std::vector<unsigned int> &v) {
+        v.resize(length());
+        in.read(reinterpret_cast<char*>(v.data()), v.size() * sizeof(unsigned int));
+        check();
+    }
+
+    template <class T> void io(std::vector<T> &v) {
+        v.resize(length());
+        for (uint64_t i = 0; i < v.size(); i++)
+            io(v[i]);
+    }
+
+    void io(GrateTime &t) {
+        int fields[9];
+        in.read(reinterpret_cast<char*>(fields), sizeof(fields));
+        check();
+        std::tm tm;
+        std::memset(&tm, 0, sizeof(tm));
+        tm.tm_sec = fields[0];
+        tm.tm_min = fields[1];
+        tm.tm_hour = fields[2];
+        tm.tm_mday = fields[3];
+        tm.tm_mon = fields[4];
+        tm.tm_year = fields[5];
+        tm.tm_wday = fields[6];
+        tm.tm_yday = fields[7];
+        tm.tm_isdst = fields[8];
+        t.setTm(tm);
+    }
+
+    template <class T> void io(T &obj) { transfer(*this, obj); }
+
+private:
+    std::ifstream &in;
+    std::string fileName;
+
+    void check() {
+        if (not in)
+            throw GrateError("Checkpoint file is truncated: " + fileName);
+    }
+
+    uint64_t length() {
+        uint64_t n;
+        raw(n);
+        if (n > (uint64_t(1) << 40))           // guard against reading garbage as a huge allocation
+            throw GrateError("Checkpoint file is corrupt: " + fileName);
+        return n;
+    }
+};
+
+template <class Archive> void transfer(Archive &ar, NodeGSDObject &g)
+{
+    ar.io(g.abrasion);
+    ar.io(g.density);
+    ar.io(g.psi);
+    ar.io(g.pct);
+    ar.io(g.dsg);
+    ar.io(g.d84);
+    ar.io(g.d90);
+    ar.io(g.stdv);
+    ar.io(g.sand_pct);
+}
+
+template <class Archive> void transfer(Archive &ar, NodeXSObject &xs)
+{
+    ar.io(xs.node);
+    ar.io(xs.noChannels);
+    ar.io(xs.depth);
+    ar.io(xs.wsl);
+    ar.io(xs.width);
+    ar.io(xs.b2b);
+    ar.io(xs.velocity);
+    ar.io(xs.ustar);
+    ar.io(xs.theta);
+    ar.io(xs.Hmax);
+    ar.io(xs.mu);
+    ar.io(xs.fpSlope);
+    ar.io(xs.valleyWallSlp);
+    ar.io(xs.fpWidth);
+    ar.io(xs.bankHeight);
+    ar.io(xs.chSinu);
+    ar.io(xs.topW);
+    for (int i = 0; i < 3; i++)
+    {
+        ar.io(xs.flow_area[i]);
+        ar.io(xs.flow_perim[i]);
+    }
+    ar.io(xs.hydRadius);
+    ar.io(xs.centr);
+    ar.io(xs.k_mean);
+    ar.io(xs.eci);
+    ar.io(xs.critdepth);
+    ar.io(xs.rough);
+    ar.io(xs.omega);
+    ar.io(xs.Tbed);
+    ar.io(xs.Tbank);
+    ar.io(xs.Qb_cap);
+    ar.io(xs.comp_D);
+    ar.io(xs.K);
+    ar.io(xs.deltaW);
+}
+
+template <class Archive> void transfer(Archive &ar, TS_Object &ts)
+{
+    ar.io(ts.date_time);
+    ar.io(ts.Q);
+    ar.io(ts.Coord);
+    ar.io(ts.GRP);
+}
+
+template <class Archive> void transfer(Archive &ar, Stratigraphy &s)
+{
+    uint64_t nodes = s.nodes();
+    uint64_t layers = s.layers();
+    ar.io(nodes);
+    ar.io(layers);
+    if (Archive::loading)
+    {
+        s.assign(nodes, layers, NodeGSDObject());
+        for (unsigned int i = 0; i < nodes; i++)
+            for (unsigned int z = 0; z < layers; z++)
+                ar.io(s.edit(i, z));
+    }
+    else
+    {
+        // writing must not unshare layers of a forked model
+        for (unsigned int i = 0; i < nodes; i++)
+            for (unsigned int z = 0; z < layers; z++)
+                ar.io(const_cast<NodeGSDObject&>(s.layer(i, z)));
+    }
+}
+
+// Run settings: constant during a run, but saved so a restart can't silently change them
+template <class Archive> void transferSettings(Archive &ar, Model &model)
+{
+    RiverProfile *rn = model.rn;
+
+    ar.io(rn->dt);
+    ar.io(rn->writeInterval);
+    ar.io(rn->regimeFlag);
+    ar.io(rn->sedUpw);
+    ar.io(rn->hydroUpw);
+
+    // randomisers
+    ar.io(rn->qsTweak);
+    ar.io(rn->qwTweak);
+    ar.io(rn->substrDial);
+    ar.io(rn->feedQw);
+    ar.io(rn->feedQs);
+    ar.io(rn->HmaxTweak);
+    ar.io(rn->randAbr);
+}
+
+// Everything that evolves during a run. The setup that is re-read from the XML file
+// (grid size, GSD library, input series) is not saved.
+template <class Archive> void transferState(Archive &ar, Model &model)
+{
+    RiverProfile *rn = model.rn;
+    hydro *wl = model.wl;
+    sed *sd = model.sd;
+
+    // time stepping
+    ar.io(rn->cTime);
+    ar.io(rn->counter);
+    ar.io(rn->yearCounter);
+
+    // profile, surface and stratigraphy
+    ar.io(rn->xx);
+    ar.io(rn->eta);
+    ar.io(rn->bedrock);
+    ar.io(rn->la);
+    ar.io(rn->toplayer);
+    ar.io(rn->ntop);
+    ar.io(rn->algrp);
+    ar.io(rn->stgrp);
+    ar.io(rn->F);
+    ar.io(rn->storedf);
+    ar.io(rn->RiverXS);
+
+    // hydraulics
+    ar.io(wl->regimeCounter);
+    ar.io(wl->Qw_Ct);
+    ar.io(wl->Fr2);
+    ar.io(wl->QwCumul);
+    ar.io(wl->bedSlope);
+
+    // sediment transport
+    ar.io(sd->Qs);
+    ar.io(sd->deta);
+    ar.io(sd->dLa_over_dt);
+    ar.io(sd->fpp);
+    ar.io(sd->p);
+    ar.io(sd->df);
+    ar.io(sd->Qs_bc);
+}
+
+// In-memory copies use the same field list: the collector records the address of each
+// field of the source, in order, and the copier assigns them to the matching fields of the target
+class StateCollector
+{
+public:
+    template <class T> void io(T &v) { fields.push_back(&v); }
+
+    std::vector<const void*> fields;
+};
+
+class StateCopier
+{
+public:
+    explicit StateCopier(const std::vector<const void*> &f) : fields(f), n(0) {}
+
+    template <class T> void io(T &v) { v = *static_cast<const T*>(fields[n++]); }
+
+private:
+    const std::vector<const void*> &fields;
+    size_t n;
+};
+
+void checkDimensions(const Model &a, const Model &b)
+{
+    if (a.rn->nnodes != b.rn->nnodes || a.rn->nlayer != b.rn->nlayer ||
+            a.rn->ngsz != b.rn->ngsz || a.rn->nlith != b.rn->nlith)
+        throw GrateError("Cannot copy model state between grids of different sizes");
+}
+
+uint64_t fileSize(const std::string &fileName)
+{
+    std::error_code ec;
+    uintmax_t size = std::filesystem::file_size(fileName, ec);
+    return ec ? 0 : size;
+}
+
+}  // namespace
+
+void writeCheckpoint(Model &model, const std::string &fileName)
+{
+    // results handed to a writer thread must be on disk before their length is recorded
+    model.flushResults();
+
+    std::string tmpName = fileName + ".tmp";
+    std::ofstream out(tmpName, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (not out)
+        throw GrateError("Error opening checkpoint file for writing: " + tmpName);
+
+    CheckpointWriter w(out);
+
+    // header
+    out.write(checkpointMagic, sizeof(checkpointMagic));
+    uint32_t version = CHECKPOINT_VERSION;
+    uint32_t endian = endianMarker;
+    w.raw(version);
+    w.raw(endian);
+    uint32_t dims[4] = {uint32_t(model.rn->nnodes), model.rn->nlayer, model.rn->ngsz, model.rn->nlith};
+    out.write(reinterpret_cast<const char*>(dims), sizeof(dims));
+
+    // length of the results file(s), so a restart can discard anything written after the checkpoint
+    std::vector<std::string> outputFiles = model.resultsFiles();
+    uint32_t nfiles = outputFiles.size();
+    w.raw(nfiles);
+    for (unsigned int f = 0; f < nfiles; f++)
+    {
+        uint64_t outputBytes = fileSize(outputFiles[f]);
+        w.raw(outputBytes);
+    }
+
+    transferSettings(w, model);
+    transferState(w, model);
+
+    out.write(checkpointTrailer, sizeof(checkpointTrailer));
+    out.close();
+    if (not out)
+        throw GrateError("Error writing checkpoint file: " + tmpName);
+
+    std::error_code ec;
+    std::filesystem::rename(tmpName, fileName, ec);
+    if (ec)
+        throw GrateError("Error renaming checkpoint file to " + fileName + ": " + ec.message());
+}
+
+void readCheckpoint(Model &model, const std::string &fileName)
+{
+    std::ifstream in(fileName, std::ios::in | std::ios::binary);
+    if (not in)
+        throw GrateError("Error opening checkpoint file: " + fileName);
+
+    CheckpointReader r(in, fileName);
+
+    // header
+    char magic[8];
+    in.read(magic, sizeof(magic));
+    if (not in || std::memcmp(magic, checkpointMagic, sizeof(magic)) != 0)
+        throw GrateError("Not a Grate checkpoint file: " + fileName);
+
+    uint32_t version, endian;
+    r.raw(version);
+    r.raw(endian);
+    if (endian != endianMarker)
+        throw GrateError("Checkpoint was written on a machine with different byte order: " + fileName);
+    if (version != CHECKPOINT_VERSION)
+        throw GrateError("Unsupported checkpoint version in " + fileName);
+
+    uint32_t dims[4];
+    in.read(reinterpret_cast<char*>(dims), sizeof(dims));
+    if (not in || dims[0] != uint32_t(model.rn->nnodes) || dims[1] != model.rn->nlayer ||
+            dims[2] != model.rn->ngsz || dims[3] != model.rn->nlith)
+        throw GrateError("Checkpoint grid dimensions do not match the input file: " + fileName);
+
+    std::vector<std::string> outputFiles = model.resultsFiles();
+    uint32_t nfiles;
+    r.raw(nfiles);
+    if (nfiles != outputFiles.size())
+        throw GrateError("Checkpoint was written for a different results format: " + fileName);
+    std::vector<uint64_t> outputBytes(nfiles);
+    for (unsigned int f = 0; f < nfiles; f++)
+        r.raw(outputBytes[f]);
+
+    transferSettings(r, model);
+    transferState(r, model);
+
+    char trailer[8];
+    in.read(trailer, sizeof(trailer));
+    if (not in || std::memcmp(trailer, checkpointTrailer, sizeof(trailer)) != 0)
+        throw GrateError("Checkpoint file is truncated: " + fileName);
+
+    // drop results written after the checkpoint, so output continues exactly where it left off
+    for (unsigned int f = 0; f < nfiles; f++)
+    {
+        uint64_t currentBytes = fileSize(outputFiles[f]);
+        if (currentBytes < outputBytes[f])
+            throw GrateError("Results file " + outputFiles[f] + " is shorter than when the checkpoint was written");
+        if (currentBytes > outputBytes[f])
+            std::filesystem::resize_file(outputFiles[f], outputBytes[f]);
+    }
+}
+
+void copyModelState(const Model &from, Model &to)
+{
+    checkDimensions(from, to);
+
+    StateCollector source;
+    transferState(source, const_cast<Model&>(from));
+
+    StateCopier copier(source.fields);
+    transferState(copier, to);
+}
@@ -0,0 +1,23 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <string>
+
+class Model;
+
+// Binary checkpoint of the complete model state (RiverProfile, hydro and sed).
+//
+// The file starts with a magic string, a format version and an endianness marker,
+// followed by the grid dimensions, which must match the model being restored.
+// Checkpoints are written to a temporary file and renamed, so an interrupted write
+// never replaces a good checkpoint.
+#define CHECKPOINT_VERSION 3
+
+void writeCheckpoint(Model &model, const std::string &fileName);
+void readCheckpoint(Model &model, const std::string &fileName);
+
+// In-memory copy of the evolving state (not the run settings or randomisers) between two
+// models built on the same grid. Storage layers are shared until either model modifies them.
+void copyModelState(const Model &from, Model &to);
+
+#endif // CHECKPOINT_H
@@ -9,74 +9,682 @@
  *
 *********************/
 #include "model.h"
+#include "ensemble.h"
+#include "grateerror.h"
+#include "setup.h"
+#include "counters.h"
+#include "footprint.h"
+#include "runsummary.h"
+#include "progress.h"
+#include "grate_version.h"
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
 #include <iostream>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <sstream>
 #include <string>
 #include <stdexcept>
+#include <thread>
+#include <ciso646>
 
 
-int main(int argc, char** argv) {
-    // number of steps can be passed as a argument, otherwise default to 800
-    int nsteps = 800;
-    if (argc == 2) {
+static void printUsage() {
+    std::cerr << "Usage: GrateCLI [NSTEPS] [options]" << std::endl;
+    std::cerr << "  NSTEPS                 total number of steps in the run (default 800)" << std::endl;
+    std::cerr << "  --input FILE           xml input file (default Conway_Template.xml)" << std::endl;
+    std::cerr << "  --output FILE          results file (default GrateResults.txt)" << std::endl;
+    std::cerr << "  --ensemble MANIFEST    run the ensemble described in the xml manifest" << std::endl;
+    std::cerr << "  --threads N            worker threads for ensembles (default: all cores)" << std::endl;
+    std::cerr << "  --checkpoint FILE      checkpoint file (default GrateCheckpoint.bin)" << std::endl;
+    std::cerr << "  --checkpoint-interval N  write a checkpoint every N steps (default: never)" << std::endl;
+    std::cerr << "  --restart FILE         continue the run from a checkpoint" << std::endl;
+    std::cerr << "  --sync-output          write results on the model thread" << std::endl;
+    std::cerr << "  --compile-setup        check the input and save it as a setup cache (FILE.setup), then exit" << std::endl;
+    std::cerr << "  --no-setup-cache       read the xml even if an up to date setup cache exists" << std::endl;
+    std::cerr << "  --timings              print the time spent in each phase of the step at the end of the run" << std::endl;
+    std::cerr << "  --timings-interval N   also print the phase times of the last N steps every N steps" << std::endl;
+    std::cerr << "  --counters             also count cycles, instructions, cache and branch misses in each phase (Linux)" << std::endl;
+    std::cerr << "  --memory               report the memory held by each structure after setup and at the end" << std::endl;
+    std::cerr << "  --memory-interval N    also report it every N steps" << std::endl;
+    std::cerr << "  --predict-memory       print the memory the input will need, without running it, then exit" << std::endl;
+    std::cerr << "  --solver-report FILE   write solver convergence counters to FILE (.json, or .csv)" << std::endl;
+    std::cerr << "  --solver-report-interval N  also report the counters of every N steps" << std::endl;
+    std::cerr << "  --summary FILE         write a JSON summary of the run: throughput, phase times, solver totals, memory" << std::endl;
+    std::cerr << "  --summary-history FILE  append the summary to FILE as one line, to follow throughput over time" << std::endl;
+    std::cerr << "  --trace FILE           record a timeline of each thread and write it as a Chrome trace" << std::endl;
+    std::cerr << "  --progress-socket PATH  serve the run's progress on a UNIX socket, for GrateStatus" << std::endl;
+}
+
+static bool saveTrace(const std::string &trace_file) {
+    try {
+        writeTrace(trace_file);
+    }
+    catch (const GrateError &e) {
+        std::cerr << e.what() << std::endl;
+        return false;
+    }
+    std::cout << "Trace written to '" << trace_file << "'" << std::endl;
+    return true;
+}
+
+static void printMemory(Model *model, const std::string &title) {
+    MemoryReport report = measureFootprint(*model);
+    std::cout << "Memory " << title << ":" << std::endl;
+    report.print(std::cout, "Measured");
+    size_t resident, peak;
+    if (residentMemory(resident, peak))
+        std::cout << "Resident set " << resident / 1000000 << " MB, peak " << peak / 1000000 << " MB" << std::endl;
+}
+
+static uint64_t fileBytes(const std::vector<std::string> &files) {
+    uint64_t bytes = 0;
+    for (unsigned int f = 0; f < files.size(); f++) {
+        std::error_code error;
+        uintmax_t size = std::filesystem::file_size(files[f], error);
+        if (not error)
+            bytes += size;
+    }
+    return bytes;
+}
+
+// what the model knows about the run so far; returns the files it writes, to be sized once they
+// are closed
+static std::vector<std::string> summariseModel(RunSummary &summary, Model *model, const SolverReport &solvers,
+                                               int steps_done) {
+    summary.nodes = model->rn->nnodes;
+    summary.dt = model->rn->dt;
+    summary.steps = steps_done;
+    summary.hasPhases = true;
+    summary.phases = model->timings();
+    summary.stepSeconds = summary.phases.seconds(PHASE_STEP);
+    summary.solvers = solvers.totals();
+    std::vector<std::string> files = model->resultsFiles();
+    if (model->checkpointInterval > 0)
+        files.push_back(model->checkpointFile);
+    return files;
+}
+
+// the summary is written however the run ended; a failure to write it is reported but doesn't
+// change the outcome of the run
+static void saveSummary(RunSummary &summary, std::chrono::steady_clock::time_point start,
+                        const std::vector<std::string> &written,
+                        const std::string &summary_file, const std::string &history_file) {
+    if (summary_file.empty() && history_file.empty())
+        return;
+    if (not written.empty())
+        summary.bytesWritten = fileBytes(written);
+    summary.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    size_t resident;
+    if (not residentMemory(resident, summary.peakResident))
+        summary.peakResident = 0;
+    try {
+        if (not summary_file.empty()) {
+            summary.write(summary_file);
+            std::cout << "Run summary written to '" << summary_file << "'" << std::endl;
+        }
+        if (not history_file.empty())
+            summary.appendTo(history_file);
+    }
+    catch (const GrateError &e) {
+        std::cerr << e.what() << std::endl;
+    }
+}
+
+static int runEnsemble(XMLDocument &xml_params, const std::string &manifest_file, int nthreads, RunSummary &run) {
+    // load the manifest
+    std::cout << "Reading ensemble manifest: '" << manifest_file << "'" << std::endl;
+    XMLDocument manifest;
+    if (manifest.LoadFile(manifest_file.c_str()) != XML_SUCCESS || manifest.FirstChildElement() == NULL) {
+        std::cerr << "Error reading ensemble manifest:" << std::endl;
+        std::cerr << manifest.ErrorStr() << std::endl;
+        return 1;
+    }
+
+    Ensemble *ensemble;
+    try {
+        ensemble = new Ensemble(&xml_params, manifest.FirstChildElement());
+    }
+    catch (const GrateError &e) {
+        std::cerr << "Error in ensemble manifest: " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    ensemble->run(nthreads, std::cout);
+    double wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // as the pool sizes itself
+    if (nthreads <= 0)
+        nthreads = std::max(1u, std::thread::hardware_concurrency());
+    run.mode = "ensemble";
+    run.output = ensemble->outputDir;
+    run.threads = nthreads;
+    run.members = ensemble->members.size();
+    run.failedMembers = ensemble->failedCount();
+    run.status = run.failedMembers > 0 ? "failed" : "finished";
+    run.stepSeconds = wall_seconds;
+    run.nodes = ensemble->nodes;
+    run.dt = ensemble->dt;
+    // the shared spin-up ran once, however many members forked from it
+    run.steps = ensemble->spinupDone;
+    std::vector<std::string> files;
+    for (unsigned int m = 0; m < ensemble->members.size(); m++) {
+        run.steps += ensemble->members[m].stepsDone;
+        files.push_back(ensemble->members[m].outputFile);
+    }
+    run.bytesWritten = fileBytes(files);
+
+    // summary table to stdout and to a file alongside the results
+    std::cout << std::endl;
+    ensemble->writeSummary(std::cout);
+    std::string summary_file = ensemble->outputDir + "/EnsembleSummary.txt";
+    std::ofstream summary(summary_file);
+    ensemble->writeSummary(summary);
+    summary.close();
+
+    int nfailed = ensemble->failedCount();
+    std::cout << std::endl << ensemble->members.size() - nfailed << " of " << ensemble->members.size()
+              << " members completed in " << std::fixed << std::setprecision(3) << wall_seconds << " s";
+    if (summary)
+        std::cout << ", summary written to '" << summary_file << "'" << std::endl;
+    else
+        std::cout << std::endl;
+
+    delete ensemble;
+
+    if (not summary) {
+        std::cerr << "Error writing ensemble summary '" << summary_file << "'" << std::endl;
+        return 1;
+    }
+
+    // failed members do not stop the ensemble, but are reported through the exit code
+    return (nfailed > 0) ? 2 : 0;
+}
+
+
+// the command line, with the defaults of whatever isn't given
+struct CliOptions
+{
+    CliOptions()
+        : nsteps(800), nstepsGiven(false), nthreads(0), checkpointInterval(0), timingsInterval(0),
+          solverInterval(0), memoryInterval(0), timings(false), counters(false), memory(false),
+          predictMemory(false), asyncOutput(true), useSetupCache(true), compileSetup(false),
+          paramFile("Conway_Template.xml"), outputFile("GrateResults.txt"),
+          checkpointFile("GrateCheckpoint.bin") {}
+
+    int nsteps;                                // Total steps in the run
+    bool nstepsGiven;
+    int nthreads;                              // Ensemble workers, 0 for all cores
+    int checkpointInterval;
+    int timingsInterval;
+    int solverInterval;
+    int memoryInterval;
+    bool timings;
+    bool counters;
+    bool memory;
+    bool predictMemory;
+    bool asyncOutput;
+    bool useSetupCache;
+    bool compileSetup;
+
+    std::string paramFile;
+    std::string outputFile;
+    std::string manifestFile;
+    std::string checkpointFile;
+    std::string restartFile;
+    std::string solverReportFile;
+    std::string traceFile;
+    std::string summaryFile;
+    std::string historyFile;
+    std::string progressSocket;
+};
+
+// returns the exit code if the run shouldn't go ahead (help, or a bad command line), -1 if it should
+static int parseOptions(int argc, char** argv, CliOptions &opts) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
         try {
-            nsteps = std::stoi(argv[1]);
+            if (arg == "--input" && i + 1 < argc) {
+                opts.paramFile = argv[++i];
+            }
+            else if (arg == "--output" && i + 1 < argc) {
+                opts.outputFile = argv[++i];
+            }
+            else if (arg == "--ensemble" && i + 1 < argc) {
+                opts.manifestFile = argv[++i];
+            }
+            else if (arg == "--threads" && i + 1 < argc) {
+                opts.nthreads = std::stoi(argv[++i]);
+            }
+            else if (arg == "--checkpoint" && i + 1 < argc) {
+                opts.checkpointFile = argv[++i];
+            }
+            else if (arg == "--checkpoint-interval" && i + 1 < argc) {
+                opts.checkpointInterval = std::stoi(argv[++i]);
+            }
+            else if (arg == "--restart" && i + 1 < argc) {
+                opts.restartFile = argv[++i];
+            }
+            else if (arg == "--sync-output") {
+                opts.asyncOutput = false;
+            }
+            else if (arg == "--compile-setup") {
+                opts.compileSetup = true;
+            }
+            else if (arg == "--no-setup-cache") {
+                opts.useSetupCache = false;
+            }
+            else if (arg == "--timings") {
+                opts.timings = true;
+            }
+            else if (arg == "--timings-interval" && i + 1 < argc) {
+                opts.timingsInterval = std::stoi(argv[++i]);
+                opts.timings = true;
+            }
+            else if (arg == "--counters") {
+                opts.counters = true;
+            }
+            else if (arg == "--memory") {
+                opts.memory = true;
+            }
+            else if (arg == "--memory-interval" && i + 1 < argc) {
+                opts.memoryInterval = std::stoi(argv[++i]);
+                opts.memory = true;
+            }
+            else if (arg == "--predict-memory") {
+                opts.predictMemory = true;
+            }
+            else if (arg == "--solver-report" && i + 1 < argc) {
+                opts.solverReportFile = argv[++i];
+            }
+            else if (arg == "--solver-report-interval" && i + 1 < argc) {
+                opts.solverInterval = std::stoi(argv[++i]);
+            }
+            else if (arg == "--summary" && i + 1 < argc) {
+                opts.summaryFile = argv[++i];
+            }
+            else if (arg == "--summary-history" && i + 1 < argc) {
+                opts.historyFile = argv[++i];
+            }
+            else if (arg == "--trace" && i + 1 < argc) {
+                opts.traceFile = argv[++i];
+            }
+            else if (arg == "--progress-socket" && i + 1 < argc) {
+                opts.progressSocket = argv[++i];
+            }
+            else if (arg == "--help" || arg == "-h") {
+                printUsage();
+                return 0;
+            }
+            else if (arg.compare(0, 2, "--") == 0) {
+                std::cerr << "Unknown or incomplete option: " << arg << std::endl;
+                printUsage();
+                return 1;
+            }
+            else {
+                opts.nsteps = std::stoi(arg);
+                opts.nstepsGiven = true;
+            }
         }
-        catch (const std::invalid_argument& ia) {
-            std::cerr << "Invalid argument: " << ia.what() << std::endl;
-            std::cerr << "First argument should be integer number of steps" << std::endl;
+        catch (const std::logic_error &) {     // std::stoi: std::invalid_argument or std::out_of_range
+            std::cerr << "Invalid number '" << argv[i] << "'" << (arg != argv[i] ? " for " + arg : "") << std::endl;
+            printUsage();
             return 1;
         }
     }
-    std::cout << "Running for " << nsteps << " steps" << std::endl;
 
-    // model object to be populated when reading the input file
-    Model *model;
+    // each member's steps are set by the manifest
+    if (opts.nstepsGiven && not opts.manifestFile.empty()) {
+        std::cerr << "NSTEPS can't be given with --ensemble: set the steps attribute of the manifest" << std::endl;
+        printUsage();
+        return 1;
+    }
+    return -1;
+}
 
-    // default input file name
-    std::string param_file = "Conway_Template.xml";
+// the run goes on without counters if the machine won't count
+static void startCounters(CliOptions &opts) {
+    if (not opts.counters)
+        return;
+    std::string why;
+    if (not countersStart(why)) {
+        std::cout << "Hardware counters unavailable: " << why << std::endl;
+        opts.counters = false;
+    }
+    else if (not why.empty()) {
+        std::cout << "Hardware counters: " << why << std::endl;
+    }
+}
 
-    // load xml input file
+static bool readInput(const std::string &param_file, std::string &input_text) {
+    std::ifstream input(param_file, std::ios::in | std::ios::binary);
+    input_text.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+    if (not input) {
+        std::cerr << "Error reading xml parameters:" << std::endl;
+        std::cerr << "Could not open '" << param_file << "'" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// for a job scheduler: the memory to ask for, before any of it is allocated. The xml is scanned
+// rather than loaded, as its document can take several times the size of the file
+static int predictMemory(const std::string &param_file) {
     std::cout << "Reading xml file: '" << param_file << "'" << std::endl;
-    XMLDocument xml_params;
-    if (xml_params.LoadFile(param_file.c_str()) != XML_SUCCESS) {
+    std::ifstream input(param_file, std::ios::in | std::ios::binary);
+    if (not input) {
         std::cerr << "Error reading xml parameters:" << std::endl;
-        std::cerr << xml_params.ErrorStr() << std::endl;
+        std::cerr << "Could not open '" << param_file << "'" << std::endl;
+        return 1;
+    }
+    ModelSetup setup;
+    try {
+        scanSetupSizes(input, setup);
+    }
+    catch (const GrateError &e) {
+        std::cerr << "Error reading xml parameters: " << e.what() << std::endl;
         return 1;
     }
-    else {
-        // file was loaded so initialise everything
+    std::cout << "Predicted memory for " << setup.nnodes << " nodes and " << setup.nlayer << " layers:" << std::endl;
+    predictFootprint(setup).print(std::cout, "Predicted");
+    return 0;
+}
 
-        // get the root element of the XML document
-        XMLElement *params_root = xml_params.FirstChildElement();
-        if (params_root == NULL) {
-            std::cerr << "Error getting root element from XML file" << std::endl;
-            std::cerr << xml_params.ErrorStr() << std::endl;
-            return 1;
-        }
-        else {
-            // initialise components
-            try {
-                model = new Model(params_root, "GrateResults.txt");
-            }
-            catch (std::string msg) {
-                std::cerr << "Error while initialising components: " << msg << std::endl;
-                return 1;
-            }
-        }
+// a setup cache that matches the xml saves parsing it (not for ensembles, which edit the xml)
+static bool useSetupCache(const CliOptions &opts, const std::string &cache_file, uint64_t input_hash,
+                          ModelSetup &setup) {
+    if (not opts.useSetupCache || opts.compileSetup || not opts.manifestFile.empty())
+        return false;
+    bool cached = loadSetupCache(cache_file, input_hash, setup);
+    if (cached) {
+        std::cout << "Using setup cache: '" << cache_file << "'" << std::endl;
+    }
+    else if (std::ifstream(cache_file)) {
+        std::cout << "Setup cache '" << cache_file << "' is out of date, reading the xml "
+                  << "(rerun with --compile-setup to update it)" << std::endl;
+    }
+    return cached;
+}
+
+// the setup from the parsed xml; false, having said why, if it can't be read
+static bool readXmlSetup(XMLDocument &xml_params, std::chrono::steady_clock::time_point parse_start,
+                         bool timings, ModelSetup &setup) {
+    // get the root element of the XML document
+    XMLElement *params_root = xml_params.FirstChildElement();
+    if (params_root == NULL) {
+        std::cerr << "Error getting root element from XML file" << std::endl;
+        std::cerr << xml_params.ErrorStr() << std::endl;
+        return false;
+    }
+    double parse_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - parse_start).count();
+    try {
+        readSetup(params_root, setup);
+    }
+    catch (const GrateError &e) {
+        std::cerr << "Error while initialising components: " << e.what() << std::endl;
+        return false;
+    }
+
+    // where the time went, for large inputs; kept out of the run's own output
+    if (timings) {
+        std::ostringstream times;
+        times << std::fixed << std::setprecision(1) << "Read xml (ms): parse " << parse_seconds * 1000;
+        for (unsigned int i = 0; i < setup.readTimes.size(); i++)
+            times << ", " << setup.readTimes[i].first << " " << setup.readTimes[i].second * 1000;
+        std::cerr << times.str() << std::endl;
+    }
+    return true;
+}
+
+// like the counters, the run goes on without it if it can't be served
+static std::unique_ptr<ProgressServer> startProgress(const std::string &progress_socket, int first, int nsteps) {
+    std::unique_ptr<ProgressServer> progress;
+    if (progress_socket.empty())
+        return progress;
+    try {
+        progress.reset(new ProgressServer(progress_socket, first, nsteps));
+        std::cout << "Serving progress on '" << progress_socket << "'" << std::endl;
+    }
+    catch (const GrateError &e) {
+        std::cout << "Progress not served: " << e.what() << std::endl;
+    }
+    return progress;
+}
+
+// phase times and memory of the last interval, to see a slowdown as it happens
+static void reportInterval(Model *model, const CliOptions &opts, int i, int first, PhaseTimes &last_timings) {
+    if (opts.timingsInterval > 0 && (i + 1 - first) % opts.timingsInterval == 0) {
+        std::cout << "Timings for steps " << i + 1 - opts.timingsInterval << " to " << i << ":" << std::endl;
+        model->timings().since(last_timings).print(std::cout);
+        if (opts.counters)
+            model->timings().since(last_timings).printCounts(std::cout, model->rn->nnodes);
+        last_timings = model->timings();
+    }
+
+    if (opts.memoryInterval > 0 && (i + 1 - first) % opts.memoryInterval == 0)
+        printMemory(model, "at step " + std::to_string(i));
+}
+
+static void reportRun(Model *model, const CliOptions &opts) {
+    if (opts.timings) {
+        std::cout << "Timings for the whole run (" << model->timings().count(PHASE_STEP) << " steps):" << std::endl;
+        model->timings().print(std::cout);
     }
+    if (opts.counters && model->timings().hasCounts()) {
+        std::cout << "Hardware counters for the whole run (" << model->timings().count(PHASE_STEP) << " steps, "
+                  << model->rn->nnodes << " nodes):" << std::endl;
+        model->timings().printCounts(std::cout, model->rn->nnodes);
+    }
+    if (opts.memory)
+        printMemory(model, "at the end of the run");
+}
+
+// a run that stopped early: summarised with the steps it did, then the model goes
+static int failRun(RunSummary &summary, Model *model, const SolverReport &solvers, int steps_done,
+                   const std::string &error, std::chrono::steady_clock::time_point run_start,
+                   const CliOptions &opts) {
+    summary.status = "failed";
+    summary.error = error;
+    std::vector<std::string> written_files = summariseModel(summary, model, solvers, steps_done);
+    delete model;
+
+    // the timeline up to the failure, after the model so the writer threads are in it
+    if (not opts.traceFile.empty())
+        saveTrace(opts.traceFile);
+    saveSummary(summary, run_start, written_files, opts.summaryFile, opts.historyFile);
+    return 1;
+}
+
+
+// steps the model to the end of the run, reporting as it goes; the model is deleted either way
+static int runModel(Model *model, const CliOptions &opts, int first, RunSummary &summary,
+                    std::chrono::steady_clock::time_point run_start) {
+    int nsteps = opts.nsteps;
+    std::unique_ptr<ProgressServer> progress = startProgress(opts.progressSocket, first, nsteps);
 
     // run the model
     std::cout << "Running model for " << nsteps << " steps..." << std::endl;
-    for (int i = 0; i < nsteps; i++) {
-        model->iteration();
+    PhaseTimes last_timings;
+    SolverReport solver_report;
+    int solver_first = first;
+    try {
+        for (int i = first; i < nsteps; i++) {
+            if (not model->iteration()) {
+                std::cerr << "Model stopped at step " << i << ": " << model->status().lastError() << std::endl;
+                // the counters up to the failure are the most useful ones
+                solver_report.add(solver_first, i, model->takeSolverStats(), opts.solverInterval > 0);
+                if (progress) {
+                    progress->update(*model, solver_report.totals());
+                    progress->finish(true);
+                }
+                if (not opts.solverReportFile.empty())
+                    solver_report.write(opts.solverReportFile);
+                return failRun(summary, model, solver_report, i - first, model->status().lastError(), run_start, opts);
+            }
+
+            if (progress)
+                progress->update(*model, solver_report.totals());
+
+            if (i % 100 == 0) {
+                std::cout << "Step " << i << " (" << static_cast<double>(i) / nsteps * 100.0 << " %)" << std::endl;
+            }
+
+            reportInterval(model, opts, i, first, last_timings);
 
-        if (i % 100 == 0) {
-            std::cout << "Step " << i << " (" << static_cast<double>(i) / nsteps * 100.0 << " %)" << std::endl;
+            if (opts.solverInterval > 0 && (i + 1 - first) % opts.solverInterval == 0) {
+                solver_report.add(solver_first, i, model->takeSolverStats(), true);
+                solver_first = i + 1;
+            }
         }
+        if (solver_first < nsteps)
+            solver_report.add(solver_first, nsteps - 1, model->takeSolverStats(), opts.solverInterval > 0);
+        if (not opts.solverReportFile.empty()) {
+            solver_report.write(opts.solverReportFile);
+            std::cout << "Solver report written to '" << opts.solverReportFile << "'" << std::endl;
+        }
+
+        // report a failure to write the last results rather than losing it in the destructor
+        model->flushResults();
+    }
+    catch (const GrateError &e) {
+        std::cerr << "Error while writing output: " << e.what() << std::endl;
+        if (progress)
+            progress->finish(true);
+        return failRun(summary, model, solver_report, model->timings().count(PHASE_STEP), e.what(), run_start, opts);
     }
 
+    if (progress)
+        progress->finish(false);
+
+    reportRun(model, opts);
+    std::vector<std::string> written_files = summariseModel(summary, model, solver_report,
+                                                            nsteps > first ? nsteps - first : 0);
+
     // free model object
     delete model;
 
+    // after the model, so the results writer threads have finished
+    if (not opts.traceFile.empty() && not saveTrace(opts.traceFile))
+        return 1;
+    saveSummary(summary, run_start, written_files, opts.summaryFile, opts.historyFile);
+
     std::cout << "Finished!" << std::endl;
+    return 0;
+}
+
+
+int main(int argc, char** argv) {
+    std::chrono::steady_clock::time_point run_start = std::chrono::steady_clock::now();
+
+    CliOptions opts;
+    int exit_code = parseOptions(argc, argv, opts);
+    if (exit_code >= 0)
+        return exit_code;
+
+    if (not opts.traceFile.empty()) {
+        traceStart();
+        traceThreadName("main");
+    }
+    startCounters(opts);
+
+    RunSummary summary;
+    std::vector<std::string> written_files;
+    summary.version = GRATE_VERSION;
+    summary.host = hostName();
+    summary.started = utcTimestamp();
+    summary.input = opts.paramFile;
+    summary.output = opts.outputFile;
+
+    // model object to be populated when reading the input file
+    Model *model;
+
+    if (opts.predictMemory)
+        return predictMemory(opts.paramFile);
+
+    // read the xml input file; its contents are hashed to check any setup cache against it
+    std::cout << "Reading xml file: '" << opts.paramFile << "'" << std::endl;
+    std::string input_text;
+    if (not readInput(opts.paramFile, input_text))
+        return 1;
+    uint64_t input_hash = hashInput(input_text.data(), input_text.size());
+    summary.inputHash = input_hash;
+    std::string cache_file = setupCacheName(opts.paramFile);
+
+    ModelSetup setup;
+    bool cached = useSetupCache(opts, cache_file, input_hash, setup);
+
+    XMLDocument xml_params;
+    if (not cached) {
+        std::chrono::steady_clock::time_point parse_start = std::chrono::steady_clock::now();
+        if (xml_params.Parse(input_text.data(), input_text.size()) != XML_SUCCESS) {
+            std::cerr << "Error reading xml parameters:" << std::endl;
+            std::cerr << xml_params.ErrorStr() << std::endl;
+            return 1;
+        }
+        if (not opts.manifestFile.empty()) {
+            if (not opts.progressSocket.empty())
+                std::cout << "--progress-socket is only served for single runs" << std::endl;
+            // the parsed input is shared by all members of the ensemble
+            int status = runEnsemble(xml_params, opts.manifestFile, opts.nthreads, summary);
+            saveSummary(summary, run_start, written_files, opts.summaryFile, opts.historyFile);
+            if (not opts.traceFile.empty() && not saveTrace(opts.traceFile))
+                return 1;
+            return status;
+        }
+        if (not readXmlSetup(xml_params, parse_start, opts.timings, setup))
+            return 1;
+    }
+
+    if (opts.compileSetup) {
+        try {
+            writeSetupCache(cache_file, input_hash, setup);
+        }
+        catch (const GrateError &e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        std::cout << "Setup cache written to '" << cache_file << "'" << std::endl;
+        return 0;
+    }
+
+    // initialise components
+    std::cout << "Running for " << opts.nsteps << " steps" << std::endl;
+    try {
+        model = new Model(setup, opts.outputFile, &std::cout, opts.restartFile);
+    }
+    catch (const GrateError &e) {
+        std::cerr << "Error while initialising components: " << e.what() << std::endl;
+        summary.status = "failed";
+        summary.error = e.what();
+        if (not opts.traceFile.empty())
+            saveTrace(opts.traceFile);
+        saveSummary(summary, run_start, written_files, opts.summaryFile, opts.historyFile);
+        return 1;
+    }
+
+    model->checkpointInterval = opts.checkpointInterval;
+    model->checkpointFile = opts.checkpointFile;
+    if (opts.asyncOutput) {
+        // results are formatted and written while the model carries on
+        model->asyncResults();
+    }
+
+    summary.setupSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - run_start).count();
+    summary.writerThreads = opts.asyncOutput ? model->outputs.size() : 0;
+
+    if (opts.memory)
+        printMemory(model, "after setup");
+
+    // a restarted run picks up the step count from the checkpoint
+    int first = model->rn->counter;
+    if (not opts.restartFile.empty()) {
+        std::cout << "Restarting from '" << opts.restartFile << "' at step " << first << std::endl;
+    }
+
+    return runModel(model, opts, first, summary, run_start);
 }
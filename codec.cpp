@@ -0,0 +1,315 @@
+/*******************
+ *
+ *
+ *  GRATE 9
+ *
+ *  Compression for results files: block compressor and frame delta codec
+ *
+ *
+ *
+*********************/
+
+#include "codec.h"
+#include "grateerror.h"
+#include <cmath>
+#include <cstring>
+#include <ciso646>
+
+namespace {
+
+const size_t minMatch = 4;
+const size_t lastLiterals = 5;                 // The end of a block is always literals
+const size_t matchLimit = 12;                  // No match starts this close to the end
+const unsigned int hashLog = 14;
+const size_t maxOffset = 65535;
+
+inline uint32_t read32(const uint8_t *p)
+{
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t hash32(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - hashLog);
+}
+
+void putLength(std::vector<uint8_t> &dst, size_t len)
+{
+    while (len >= 255)
+    {
+        dst.push_back(255);
+        len -= 255;
+    }
+    dst.push_back(uint8_t(len));
+}
+
+void putSequence(std::vector<uint8_t> &dst, const uint8_t *literals, size_t nlit, size_t offset, size_t mlen)
+{
+    size_t m = (mlen == 0) ? 0 : mlen - minMatch;
+    dst.push_back(uint8_t(((nlit < 15 ? nlit : 15) << 4) | (m < 15 ? m : 15)));
+    if (nlit >= 15)
+        putLength(dst, nlit - 15);
+    dst.insert(dst.end(), literals, literals + nlit);
+    if (mlen == 0)
+        return;
+    dst.push_back(uint8_t(offset & 0xff));
+    dst.push_back(uint8_t(offset >> 8));
+    if (m >= 15)
+        putLength(dst, m - 15);
+}
+
+size_t getLength(const uint8_t *&ip, const uint8_t *end, size_t len)
+{
+    if (len != 15)
+        return len;
+    uint8_t b;
+    do {
+        if (ip >= end)
+            throw GrateError("Compressed results frame is corrupt");
+        b = *ip++;
+        len += b;
+    } while (b == 255);
+    return len;
+}
+
+void putVarint(std::vector<uint8_t> &dst, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        dst.push_back(uint8_t(v | 0x80));
+        v >>= 7;
+    }
+    dst.push_back(uint8_t(v));
+}
+
+uint64_t getVarint(const uint8_t *&ip, const uint8_t *end)
+{
+    uint64_t v = 0;
+    for (unsigned int shift = 0; shift < 64; shift += 7)
+    {
+        if (ip >= end)
+            break;
+        uint8_t b = *ip++;
+        v |= uint64_t(b & 0x7f) << shift;
+        if (not (b & 0x80))
+            return v;
+    }
+    throw GrateError("Compressed results frame is corrupt");
+}
+
+const double maxQuantised = 1152921504606846976.;    // 2^60: larger values are stored raw
+
+}  // namespace
+
+
+void blockCompress(const uint8_t *src, size_t n, std::vector<uint8_t> &dst)
+{
+    BlockCompressor compressor;
+    compressor.compress(src, n, dst);
+}
+
+BlockCompressor::BlockCompressor() : table(size_t(1) << hashLog, 0), base(1)
+{
+}
+
+void BlockCompressor::compress(const uint8_t *src, size_t n, std::vector<uint8_t> &dst)
+{
+    dst.clear();
+    dst.reserve(n + n / 255 + 16);
+
+    size_t anchor = 0;
+    if (n > matchLimit)
+    {
+        size_t i = 0;
+        size_t limit = n - matchLimit;
+        while (i < limit)
+        {
+            uint32_t seq = read32(src + i);
+            uint32_t h = hash32(seq);
+            uint64_t entry = table[h];
+            table[h] = base + i;
+            size_t ref = size_t(entry - base);
+            if (entry < base || i - ref > maxOffset || read32(src + ref) != seq)
+            {
+                i++;
+                continue;
+            }
+
+            size_t mlen = minMatch;
+            while (i + mlen < n - lastLiterals && src[ref + mlen] == src[i + mlen])
+                mlen++;
+            putSequence(dst, src + anchor, i - anchor, i - ref, mlen);
+            i += mlen;
+            anchor = i;
+        }
+    }
+    putSequence(dst, src + anchor, n - anchor, 0, 0);
+    base += n;
+}
+
+void blockDecompress(const uint8_t *src, size_t n, std::vector<uint8_t> &dst, size_t rawBytes)
+{
+    dst.resize(rawBytes);
+    const uint8_t *ip = src;
+    const uint8_t *end = src + n;
+    size_t op = 0;
+
+    while (ip < end)
+    {
+        uint8_t token = *ip++;
+        size_t nlit = getLength(ip, end, token >> 4);
+        if (nlit > size_t(end - ip) || nlit > rawBytes - op)
+            throw GrateError("Compressed results frame is corrupt");
+        std::memcpy(dst.data() + op, ip, nlit);
+        ip += nlit;
+        op += nlit;
+        if (ip == end)
+            break;
+
+        if (end - ip < 2)
+            throw GrateError("Compressed results frame is corrupt");
+        size_t offset = ip[0] | (size_t(ip[1]) << 8);
+        ip += 2;
+        size_t mlen = getLength(ip, end, token & 0x0f) + minMatch;
+        if (offset == 0 || offset > op || mlen > rawBytes - op)
+            throw GrateError("Compressed results frame is corrupt");
+        // byte by byte: the match may overlap what it is copying (runs)
+        for (size_t k = 0; k < mlen; k++, op++)
+            dst[op] = dst[op - offset];
+    }
+    if (op != rawBytes)
+        throw GrateError("Compressed results frame is corrupt");
+}
+
+FrameCodec::FrameCodec(unsigned int c, double tolerance) :
+    codec(c), step(2. * tolerance)
+{
+    if (codec != CODEC_XOR && codec != CODEC_QUANTISED)
+        throw GrateError("Unknown results codec");
+    if (codec == CODEC_QUANTISED && not (tolerance > 0.))
+        throw GrateError("Quantised results need a tolerance greater than zero");
+}
+
+void FrameCodec::encode(const std::vector< std::vector<double> > &columns, bool keyframe,
+                        std::vector<uint8_t> &out, uint32_t &rawBytes)
+{
+    size_t n = 0;
+    for (unsigned int v = 0; v < columns.size(); v++)
+        n += columns[v].size();
+
+    raw.clear();
+    if (codec == CODEC_XOR)
+    {
+        if (keyframe || prevBits.size() != n)
+            prevBits.assign(n, 0);
+
+        // XOR with the previous frame, then shuffle so byte k of every value is together:
+        // the exponent and high mantissa bytes of a slowly changing field are mostly zero
+        words.resize(n);
+        size_t j = 0;
+        for (unsigned int v = 0; v < columns.size(); v++)
+            for (unsigned int i = 0; i < columns[v].size(); i++, j++)
+            {
+                uint64_t bits;
+                std::memcpy(&bits, &columns[v][i], sizeof(bits));
+                words[j] = bits ^ prevBits[j];
+                prevBits[j] = bits;
+            }
+        raw.resize(n * sizeof(uint64_t));
+        for (unsigned int b = 0; b < 8; b++)
+            for (j = 0; j < n; j++)
+                raw[b * n + j] = uint8_t(words[j] >> (8 * b));
+    }
+    else
+    {
+        if (keyframe || prevQ.size() != n)
+            prevQ.assign(n, 0);
+
+        // zigzag varint of the change in quantised value, low bit 0; non-finite or huge
+        // values are stored raw after a 1, and the next frame starts again from zero
+        size_t j = 0;
+        for (unsigned int v = 0; v < columns.size(); v++)
+            for (unsigned int i = 0; i < columns[v].size(); i++, j++)
+            {
+                double scaled = columns[v][i] / step;
+                if (std::isfinite(scaled) && std::fabs(scaled) < maxQuantised)
+                {
+                    int64_t q = std::llround(scaled);
+                    int64_t d = q - prevQ[j];
+                    uint64_t zz = (uint64_t(d) << 1) ^ uint64_t(d >> 63);
+                    putVarint(raw, zz << 1);
+                    prevQ[j] = q;
+                }
+                else
+                {
+                    raw.push_back(1);
+                    const uint8_t *p = reinterpret_cast<const uint8_t*>(&columns[v][i]);
+                    raw.insert(raw.end(), p, p + sizeof(double));
+                    prevQ[j] = 0;
+                }
+            }
+    }
+
+    rawBytes = raw.size();
+    compressor.compress(raw.data(), raw.size(), out);
+}
+
+void FrameCodec::decode(const uint8_t *payload, size_t n, uint32_t rawBytes, bool keyframe,
+                        std::vector< std::vector<double> > &columns)
+{
+    size_t nvalues = 0;
+    for (unsigned int v = 0; v < columns.size(); v++)
+        nvalues += columns[v].size();
+
+    blockDecompress(payload, n, raw, rawBytes);
+
+    if (codec == CODEC_XOR)
+    {
+        if (keyframe || prevBits.size() != nvalues)
+            prevBits.assign(nvalues, 0);
+        if (raw.size() != nvalues * sizeof(uint64_t))
+            throw GrateError("Compressed results frame is corrupt");
+
+        size_t j = 0;
+        for (unsigned int v = 0; v < columns.size(); v++)
+            for (unsigned int i = 0; i < columns[v].size(); i++, j++)
+            {
+                uint64_t w = 0;
+                for (unsigned int b = 0; b < 8; b++)
+                    w |= uint64_t(raw[b * nvalues + j]) << (8 * b);
+                prevBits[j] ^= w;
+                std::memcpy(&columns[v][i], &prevBits[j], sizeof(double));
+            }
+    }
+    else
+    {
+        if (keyframe || prevQ.size() != nvalues)
+            prevQ.assign(nvalues, 0);
+
+        const uint8_t *ip = raw.data();
+        const uint8_t *end = ip + raw.size();
+        size_t j = 0;
+        for (unsigned int v = 0; v < columns.size(); v++)
+            for (unsigned int i = 0; i < columns[v].size(); i++, j++)
+            {
+                uint64_t tagged = getVarint(ip, end);
+                if (tagged & 1)
+                {
+                    if (end - ip < int(sizeof(double)))
+                        throw GrateError("Compressed results frame is corrupt");
+                    std::memcpy(&columns[v][i], ip, sizeof(double));
+                    ip += sizeof(double);
+                    prevQ[j] = 0;
+                }
+                else
+                {
+                    uint64_t zz = tagged >> 1;
+                    int64_t d = int64_t(zz >> 1) ^ -int64_t(zz & 1);
+                    prevQ[j] += d;
+                    columns[v][i] = prevQ[j] * step;
+                }
+            }
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// Byte-oriented LZ77 block compressor in the style of LZ4: sequences of literals followed by a
+// match (16 bit offset, minimum length 4). Fast rather than tight; the frame codec below turns
+// slowly changing fields into long runs of zero bytes, which is what it is good at.
+void blockCompress(const uint8_t *src, size_t n, std::vector<uint8_t> &dst);
+void blockDecompress(const uint8_t *src, size_t n, std::vector<uint8_t> &dst, size_t rawBytes);  // throws GrateError if corrupt
+
+// The same compressor, keeping its match table from one block to the next so a small block
+// doesn't pay for allocating and clearing it. Entries left by earlier blocks are never matched,
+// so the output is exactly that of blockCompress.
+class BlockCompressor
+{
+public:
+
+    BlockCompressor();
+
+    void compress(const uint8_t *src, size_t n, std::vector<uint8_t> &dst);
+
+private:
+    std::vector<uint64_t> table;               // base + position of the last sequence with each hash
+    uint64_t base;                             // Entries below it are from earlier blocks
+};
+
+enum ResultsCodec {
+    CODEC_NONE = 0,                            // Plain doubles
+    CODEC_XOR = 1,                             // IEEE bits XORed with the previous frame: lossless
+    CODEC_QUANTISED = 2                        // Deltas of values rounded to 2 x tolerance: error <= tolerance
+};
+
+// Encodes and decodes output frames ([variable][node] values) against the previous frame.
+// Keyframes are encoded against zero, so decoding can start at any keyframe. The encoder and
+// decoder each keep their own copy of the previous frame.
+class FrameCodec
+{
+public:
+
+    FrameCodec(unsigned int codec, double tolerance);
+
+    void encode(const std::vector< std::vector<double> > &columns, bool keyframe, std::vector<uint8_t> &out, uint32_t &rawBytes);
+    void decode(const uint8_t *payload, size_t n, uint32_t rawBytes, bool keyframe, std::vector< std::vector<double> > &columns);
+
+private:
+    unsigned int codec;
+    double step;                               // Quantisation step, 2 x tolerance
+    std::vector<uint64_t> prevBits;            // CODEC_XOR: previous frame's IEEE bits
+    std::vector<int64_t> prevQ;                // CODEC_QUANTISED: previous frame's quantised values
+    std::vector<uint8_t> raw;                  // Reused encode/decode buffers
+    std::vector<uint64_t> words;
+    BlockCompressor compressor;
+};
+
+#endif // CODEC_H
@@ -0,0 +1,214 @@
+/*******************
+ *
+ *
+ *  GRATE 9
+ *
+ *  Hardware performance counters of each thread (perf_event_open on Linux)
+ *
+ *
+ *
+*********************/
+
+#include "counters.h"
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+std::atomic<bool> countersOn(false);
+
+namespace {
+
+const char *names[N_COUNTERS] = {
+    "cycles",
+    "instructions",
+    "LLC misses",
+    "branch misses",
+};
+
+#ifdef __linux__
+
+const uint64_t configs[N_COUNTERS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,                // "usually" the last level cache, says the kernel
+    PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+// The counters of one thread, in one group so a read is a single system call and the counts
+// cover the same instructions. Counters that don't open are left out of the group.
+class ThreadCounters
+{
+public:
+
+    ThreadCounters() : leader(-1), opened(0), firstError(0)
+    {
+        for (int c = 0; c < N_COUNTERS; c++)
+        {
+            fd[c] = -1;
+            slot[c] = -1;
+        }
+        for (int c = 0; c < N_COUNTERS; c++)
+            open(Counter(c));
+    }
+
+    ~ThreadCounters()
+    {
+        // the members before the leader
+        for (int c = N_COUNTERS - 1; c >= 0; c--)
+            if (fd[c] >= 0)
+                close(fd[c]);
+    }
+
+    bool any() const { return opened > 0; }
+    bool isOpen(Counter c) const { return slot[c] >= 0; }
+    int error() const { return firstError; }
+
+    CounterValues read() const
+    {
+        CounterValues v;
+        if (leader < 0)
+            return v;
+
+        // nr, time enabled, time running, then the values in the order the counters were opened
+        uint64_t buffer[3 + N_COUNTERS];
+        ssize_t got = ::read(leader, buffer, sizeof(buffer));
+        if (got < (ssize_t)(3 * sizeof(uint64_t)) || buffer[0] != (uint64_t)opened || buffer[2] == 0)
+            return v;
+
+        double scale = double(buffer[1]) / double(buffer[2]);
+        for (int c = 0; c < N_COUNTERS; c++)
+            if (slot[c] >= 0)
+            {
+                uint64_t raw = buffer[3 + slot[c]];
+                v.value[c] = scale > 1 ? uint64_t(raw * scale) : raw;
+                v.available[c] = true;
+            }
+        return v;
+    }
+
+private:
+    int fd[N_COUNTERS];
+    int slot[N_COUNTERS];                      // Position in the group's read, -1 if not open
+    int leader;
+    int opened;
+    int firstError;                            // errno of the first counter that didn't open
+
+    void open(Counter c)
+    {
+        struct perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[c];
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.exclude_kernel = 1;               // Allowed at perf_event_paranoid 2, the usual default
+        attr.exclude_hv = 1;
+
+        // this thread, on whichever CPU it runs
+        int f = (int)syscall(__NR_perf_event_open, &attr, 0, -1, leader, PERF_FLAG_FD_CLOEXEC);
+        if (f < 0)
+        {
+            if (firstError == 0)
+                firstError = errno;
+            return;
+        }
+        fd[c] = f;
+        slot[c] = opened++;
+        if (leader < 0)
+            leader = f;
+    }
+
+    ThreadCounters(const ThreadCounters &);
+    ThreadCounters &operator=(const ThreadCounters &);
+};
+
+// opened the first time the thread reads them, closed when it exits
+ThreadCounters &threadCounters()
+{
+    thread_local ThreadCounters counters;
+    return counters;
+}
+
+#endif
+
+}  // namespace
+
+
+const char *counterName(Counter counter)
+{
+    return names[counter];
+}
+
+CounterValues::CounterValues()
+{
+    for (int c = 0; c < N_COUNTERS; c++)
+    {
+        value[c] = 0;
+        available[c] = false;
+    }
+}
+
+CounterValues &CounterValues::operator+=(const CounterValues &other)
+{
+    for (int c = 0; c < N_COUNTERS; c++)
+    {
+        value[c] += other.value[c];
+        available[c] = available[c] || other.available[c];
+    }
+    return *this;
+}
+
+CounterValues CounterValues::operator-(const CounterValues &earlier) const
+{
+    CounterValues d;
+    for (int c = 0; c < N_COUNTERS; c++)
+    {
+        d.available[c] = available[c] && earlier.available[c];
+        // scaled counts of a multiplexed group can step back slightly
+        d.value[c] = d.available[c] && value[c] > earlier.value[c] ? value[c] - earlier.value[c] : 0;
+    }
+    return d;
+}
+
+bool countersStart(std::string &why)
+{
+#ifdef __linux__
+    ThreadCounters &counters = threadCounters();
+    if (not counters.any())
+    {
+        int e = counters.error();
+        if (e == EACCES || e == EPERM)
+            why = "not permitted, see /proc/sys/kernel/perf_event_paranoid";
+        else if (e == ENOENT || e == EOPNOTSUPP || e == ENODEV)
+            why = "not supported by this CPU or virtual machine";
+        else if (e == ENOSYS)
+            why = "perf_event_open is not available in this kernel";
+        else
+            why = std::strerror(e);
+        return false;
+    }
+    why.clear();
+    for (int c = 0; c < N_COUNTERS; c++)
+        if (not counters.isOpen(Counter(c)))
+            why += std::string(why.empty() ? "" : ", ") + names[c] + " unavailable";
+    countersOn.store(true, std::memory_order_relaxed);
+    return true;
+#else
+    why = "hardware counters are only supported on Linux";
+    return false;
+#endif
+}
+
+CounterValues readCounters()
+{
+#ifdef __linux__
+    if (countersEnabled())
+        return threadCounters().read();
+#endif
+    return CounterValues();
+}
@@ -0,0 +1,49 @@
+#ifndef COUNTERS_H
+#define COUNTERS_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+
+// Hardware performance counters of the calling thread, through perf_event_open on Linux. Off
+// unless countersStart() succeeds, and then each thread opens its own counters the first time it
+// reads them. Where the kernel or the CPU doesn't provide a counter (other platforms, virtual
+// machines, a strict perf_event_paranoid) it reads as unavailable and the others carry on.
+
+enum Counter {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_LLC_MISSES,                        // Last level cache misses
+    COUNTER_BRANCH_MISSES,
+    N_COUNTERS
+};
+
+const char *counterName(Counter counter);      // e.g. "cycles"
+
+struct CounterValues
+{
+    CounterValues();
+
+    uint64_t value[N_COUNTERS];                // Scaled for the time a counter was multiplexed out
+    bool available[N_COUNTERS];
+
+    CounterValues &operator+=(const CounterValues &other);
+    CounterValues operator-(const CounterValues &earlier) const;
+};
+
+extern std::atomic<bool> countersOn;
+
+inline bool countersEnabled()
+{
+    return countersOn.load(std::memory_order_relaxed);
+}
+
+// Turns counting on if the calling thread can open at least one counter; otherwise returns false
+// with the reason in 'why'
+bool countersStart(std::string &why);
+
+// The calling thread's counts so far; all unavailable if counting is off or couldn't be set up
+CounterValues readCounters();
+
+#endif // COUNTERS_H
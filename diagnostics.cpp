@@ -0,0 +1,70 @@
+/*******************
+ *
+ *
+ *  GRATE 9
+ *
+ *  Per-model status and log sink
+ *
+ *
+ *
+*********************/
+
+#include "diagnostics.h"
+#include <iostream>
+
+
+Diagnostics::Diagnostics()
+{
+    sink = &std::cout;
+    warnings = 0;
+    errors = 0;
+}
+
+void Diagnostics::setSink(std::ostream *s)
+{
+    sink = s;
+}
+
+void Diagnostics::write(const char *prefix, const std::string &msg)
+{
+    if (sink != NULL)
+        *sink << prefix << msg << '\n';
+}
+
+void Diagnostics::info(const std::string &msg)
+{
+    write("", msg);
+}
+
+void Diagnostics::warning(const std::string &msg)
+{
+    warnings++;
+    write("Warning: ", msg);
+}
+
+void Diagnostics::error(const std::string &msg)
+{
+    errors++;
+    lastErrorMsg = msg;
+    write("Error: ", msg);
+}
+
+bool Diagnostics::failed() const
+{
+    return errors > 0;
+}
+
+const std::string &Diagnostics::lastError() const
+{
+    return lastErrorMsg;
+}
+
+unsigned int Diagnostics::nWarnings() const
+{
+    return warnings;
+}
+
+unsigned int Diagnostics::nErrors() const
+{
+    return errors;
+}
@@ -0,0 +1,36 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <ostream>
+#include <string>
+
+
+// Per-model status and logging. Solver routines report problems here instead of
+// writing to stdout or terminating the process, so that several models can share a process.
+class Diagnostics
+{
+public:
+
+    Diagnostics();
+
+    void setSink(std::ostream *s);             // Where messages are written; NULL discards them
+
+    void info(const std::string &msg);
+    void warning(const std::string &msg);      // Recoverable problem, e.g. a solver fell back to a default
+    void error(const std::string &msg);        // Unrecoverable problem; the model should not be advanced further
+
+    bool failed() const;                       // True once an error has been reported
+    const std::string &lastError() const;
+    unsigned int nWarnings() const;
+    unsigned int nErrors() const;
+
+private:
+    std::ostream *sink;
+    std::string lastErrorMsg;
+    unsigned int warnings;
+    unsigned int errors;
+
+    void write(const char *prefix, const std::string &msg);
+};
+
+#endif // DIAGNOSTICS_H
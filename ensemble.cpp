@@ -0,0 +1,287 @@
+/*******************
+ *
+ *
+ *  GRATE 9
+ *
+ *  Ensemble runner: many model runs from one parsed input file
+ *
+ *
+ *
+*********************/
+
+#include "ensemble.h"
+#include "model.h"
+#include "checkpoint.h"
+#include "threadpool.h"
+#include "grateerror.h"
+#include "trace.h"
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+#include <ciso646>
+
+using namespace tinyxml2;
+
+// Randomisers are read from the optional RANDOMISERS element (see readSetup),
+// anything else in a member is taken to be a PARAMS value
+static const char *randomiserNames[] = {
+    "QSTWEAK", "QWTWEAK", "SUBSTRDIAL", "FEEDQW", "FEEDQS", "HMAXTWEAK", "RANDABR"
+};
+
+EnsembleMember::EnsembleMember()
+{
+    nsteps = 0;
+    finished = false;
+    failed = false;
+    firstStep = 0;
+    stepsDone = 0;
+    wallSeconds = 0.;
+    meanDeta = 0.;
+}
+
+Ensemble::Ensemble(XMLDocument *base, XMLElement *manifest_root) :
+    spinup(0), spinupDone(0), nodes(0), dt(0), baseDoc(base), snapshot(nullptr)
+{
+    int defaultSteps = 800;
+    if (manifest_root->QueryIntAttribute("steps", &defaultSteps) == XML_WRONG_ATTRIBUTE_TYPE) {
+        throw GrateError("Error getting steps attribute from ensemble manifest");
+    }
+    if (manifest_root->QueryIntAttribute("spinup", &spinup) == XML_WRONG_ATTRIBUTE_TYPE || spinup < 0) {
+        throw GrateError("Error getting spinup attribute from ensemble manifest");
+    }
+
+    const char *dir = manifest_root->Attribute("output_dir");
+    outputDir = (dir == NULL) ? "." : dir;
+
+    // members open their results and logs in it as soon as they start
+    std::error_code error;
+    std::filesystem::create_directories(outputDir, error);
+    if (error) {
+        throw GrateError("Error creating ensemble output directory " + outputDir + ": " + error.message());
+    }
+
+    int count = 0;
+    for (XMLElement* e = manifest_root->FirstChildElement("MEMBER"); e != NULL; e = e->NextSiblingElement("MEMBER")) {
+        EnsembleMember m;
+
+        const char *name = e->Attribute("name");
+        if (name == NULL) {
+            std::ostringstream oss;
+            oss << "member" << std::setfill('0') << std::setw(3) << count + 1;
+            m.name = oss.str();
+        }
+        else {
+            m.name = name;
+        }
+
+        m.nsteps = defaultSteps;
+        if (e->QueryIntAttribute("steps", &m.nsteps) == XML_WRONG_ATTRIBUTE_TYPE) {
+            throw GrateError("Error getting steps attribute for ensemble member " + m.name);
+        }
+        if (m.nsteps < spinup) {
+            throw GrateError("Ensemble member " + m.name + " is shorter than the spin-up");
+        }
+
+        m.outputFile = outputDir + "/" + m.name + "_Results.txt";
+        m.logFile = outputDir + "/" + m.name + ".log";
+
+        for (XMLElement* o = e->FirstChildElement(); o != NULL; o = o->NextSiblingElement()) {
+            const char *value = o->GetText();
+            if (value == NULL) {
+                throw GrateError("Empty override " + std::string(o->Name()) + " for ensemble member " + m.name);
+            }
+            m.overrides.push_back(std::make_pair(std::string(o->Name()), std::string(value)));
+        }
+
+        members.push_back(m);
+        count++;
+    }
+
+    if (members.empty()) {
+        throw GrateError("Ensemble manifest has no MEMBER elements");
+    }
+}
+
+Ensemble::~Ensemble()
+{
+    delete snapshot;
+}
+
+void Ensemble::applyOverrides(XMLDocument &doc, EnsembleMember &m)
+{
+    XMLElement *root = doc.FirstChildElement();
+    XMLElement *params = root->FirstChildElement("PARAMS");
+    if (params == NULL) {
+        throw GrateError("Error getting PARAMS element from XML file");
+    }
+
+    for (unsigned int i = 0; i < m.overrides.size(); i++) {
+        const std::string &name = m.overrides[i].first;
+        const std::string &value = m.overrides[i].second;
+
+        bool isRandomiser = false;
+        for (unsigned int r = 0; r < sizeof(randomiserNames) / sizeof(randomiserNames[0]); r++)
+            if (name == randomiserNames[r])
+                isRandomiser = true;
+
+        XMLElement *target;
+        if (isRandomiser) {
+            XMLElement *randElem = root->FirstChildElement("RANDOMISERS");
+            if (randElem == NULL) {
+                randElem = doc.NewElement("RANDOMISERS");
+                root->InsertFirstChild(randElem);
+            }
+            target = randElem->FirstChildElement(name.c_str());
+            if (target == NULL) {
+                target = doc.NewElement(name.c_str());
+                randElem->InsertEndChild(target);
+            }
+        }
+        else {
+            target = params->FirstChildElement(name.c_str());
+            if (target == NULL) {
+                throw GrateError("Override " + name + " is neither a randomiser nor a PARAMS value");
+            }
+        }
+        target->SetText(value.c_str());
+    }
+}
+
+void Ensemble::runMember(EnsembleMember &m, std::ostream &out)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::string spanName = "member " + m.name;
+    TraceScope span("ensemble", spanName.c_str());
+
+    try {
+        XMLDocument doc;
+        {
+            std::lock_guard<std::mutex> guard(copyLock);
+            baseDoc->DeepCopy(&doc);
+        }
+        applyOverrides(doc, m);
+
+        if (spinup > 0 && snapshot == nullptr) {
+            throw GrateError("Spin-up failed: " + spinupError);
+        }
+
+        // each member logs to its own file rather than interleaving on stdout
+        std::ofstream log(m.logFile);
+        Model *model;
+        if (snapshot != nullptr)
+            model = new Model(doc.FirstChildElement(), m.outputFile, &log, *snapshot);
+        else
+            model = new Model(doc.FirstChildElement(), m.outputFile, &log);
+        std::unique_ptr<Model> owner(model);
+        {
+            // the spin-up, if any, was built from the base input; otherwise whichever member gets here first
+            std::lock_guard<std::mutex> guard(outLock);
+            if (nodes == 0) {
+                nodes = model->rn->nnodes;
+                dt = model->rn->dt;
+            }
+        }
+        std::vector<double> eta0 = model->rn->eta;
+
+        // a forked member's steps and change in bed level are both counted from the fork
+        m.firstStep = model->rn->counter;
+        for (int i = m.firstStep; i < m.nsteps; i++, m.stepsDone++)
+            if (not model->iteration())
+                throw GrateError(model->status().lastError());
+
+        double sum = 0.;
+        for (int i = 0; i < model->rn->nnodes; i++)
+            sum += model->rn->eta[i] - eta0[i];
+        m.meanDeta = sum / model->rn->nnodes;
+    }
+    catch (const std::exception &e) {
+        m.failed = true;
+        m.message = e.what();
+    }
+
+    m.finished = true;
+    m.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // stream the result as soon as the member is done
+    std::lock_guard<std::mutex> guard(outLock);
+    out << "Member " << m.name << (m.failed ? " FAILED after " : " finished ") << m.stepsDone << " steps in "
+        << m.wallSeconds << " s";
+    if (m.failed)
+        out << ": " << m.message;
+    else
+        out << " -> " << m.outputFile;
+    out << std::endl;
+}
+
+void Ensemble::runSpinup(std::ostream &out)
+{
+    // the base input without overrides, run once for the steps every member has in common
+    out << "Running shared spin-up for " << spinup << " steps" << std::endl;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::ofstream log(outputDir + "/spinup.log");
+    Model *model = nullptr;
+    TraceScope span("ensemble", "spin-up");
+    try {
+        model = new Model(baseDoc->FirstChildElement(), outputDir + "/spinup_Results.txt", &log);
+        nodes = model->rn->nnodes;
+        dt = model->rn->dt;
+        for (spinupDone = 0; spinupDone < spinup; spinupDone++)
+            if (not model->iteration())
+                throw GrateError(model->status().lastError());
+        model->rn->diag.setSink(NULL);     // the snapshot is never stepped again
+        snapshot = model;
+    }
+    catch (const std::exception &e) {
+        delete model;
+        spinupError = e.what();
+        out << "Spin-up FAILED: " << spinupError << std::endl;
+        return;
+    }
+
+    out << "Spin-up finished in " <<
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s" << std::endl;
+}
+
+void Ensemble::run(unsigned int nthreads, std::ostream &out)
+{
+    if (spinup > 0)
+        runSpinup(out);
+
+    WorkStealingPool pool(nthreads);
+    out << "Running " << members.size() << " ensemble members on " << pool.size() << " threads" << std::endl;
+
+    for (unsigned int i = 0; i < members.size(); i++) {
+        EnsembleMember *m = &members[i];
+        pool.submit([this, m, &out] { runMember(*m, out); });
+    }
+
+    pool.wait();
+}
+
+void Ensemble::writeSummary(std::ostream &out)
+{
+    out << "member\tstatus\tsteps\twall_s\tmean_deta_m\tresult" << '\n';
+    for (unsigned int i = 0; i < members.size(); i++) {
+        const EnsembleMember &m = members[i];
+        out << m.name << '\t' <<
+            (m.failed ? "FAILED" : (m.finished ? "OK" : "NOT_RUN")) << '\t' <<
+            m.stepsDone << '\t' <<
+            m.wallSeconds << '\t' <<
+            m.meanDeta << '\t' <<
+            (m.failed ? m.message : m.outputFile) << '\n';
+    }
+}
+
+int Ensemble::failedCount()
+{
+    int n = 0;
+    for (unsigned int i = 0; i < members.size(); i++)
+        if (members[i].failed || not members[i].finished)
+            n++;
+    return n;
+}
@@ -0,0 +1,73 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <mutex>
+#include <ostream>
+#include "tinyxml2/tinyxml2.h"
+
+using namespace tinyxml2;
+
+class Model;
+
+class EnsembleMember
+{
+    // One run of the ensemble: the base input with a set of overrides applied
+public:
+
+    EnsembleMember();
+
+    std::string name;
+    int nsteps;                                         // Number of model iterations to run, including any spin-up
+    std::string outputFile;                             // Results file for this member
+    std::string logFile;                                // Model messages for this member
+    std::vector< std::pair<std::string, std::string> > overrides;  // (element name, value) pairs from the manifest
+
+    bool finished;
+    bool failed;
+    std::string message;                                // Error message if the member failed
+    int firstStep;                                      // Step the member starts from: the end of any spin-up
+    int stepsDone;                                      // Steps run by the member itself, from firstStep
+    double wallSeconds;
+    double meanDeta;                                    // Mean change in bed elevation over those steps (m)
+};
+
+class Ensemble
+{
+public:
+
+    Ensemble(XMLDocument *base, XMLElement *manifest_root);
+    ~Ensemble();
+
+    std::vector<EnsembleMember> members;
+    std::string outputDir;                              // Directory for member results and the summary table
+    int spinup;                                         // Steps of the shared spin-up run, 0 for none
+    int spinupDone;                                     // Of those, the steps that ran
+
+    int nodes;                                          // Of the base input, from the first model built; 0 if none was
+    unsigned int dt;                                    // Model time step (s)
+
+    void run(unsigned int nthreads, std::ostream &out); // Run all members, streaming progress to 'out'
+
+    void writeSummary(std::ostream &out);               // Tab separated table of member results
+
+    int failedCount();
+
+private:
+    XMLDocument *baseDoc;                               // Parsed once, copied for each member
+    std::mutex copyLock;                                // tinyxml2 resolves strings lazily, so copies are serialised
+    std::mutex outLock;
+
+    Model *snapshot;                                    // Model state at the end of the spin-up, members fork from it
+    std::string spinupError;
+
+    void runSpinup(std::ostream &out);
+
+    void runMember(EnsembleMember &m, std::ostream &out);
+
+    void applyOverrides(XMLDocument &doc, EnsembleMember &m);
+};
+
+#endif // ENSEMBLE_H
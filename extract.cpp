@@ -0,0 +1,143 @@
+/*******************
+ *
+ *
+ *  GRATE 9
+ *
+ *  Results extractor: binary and compressed results files to text
+ *
+ *
+ *
+*********************/
+#include "resultsfile.h"
+#include "grateerror.h"
+#include <iostream>
+#include <string>
+#include <stdexcept>
+#include <vector>
+#include <ciso646>
+
+
+static void printUsage() {
+    std::cerr << "Usage: GrateExtract FILE [options]" << std::endl;
+    std::cerr << "  FILE                   binary results file (.grb or .grz)" << std::endl;
+    std::cerr << "  --info                 describe the file instead of extracting values" << std::endl;
+    std::cerr << "  --var NAME             variable to extract; may be repeated (default: all)" << std::endl;
+    std::cerr << "  --step N               only the output at model step N" << std::endl;
+}
+
+static void printInfo(BinaryResultsFile &f) {
+    const char *codecs[] = {"none", "xor (lossless)", "quantised"};
+    std::cout << "Variables:";
+    for (unsigned int v = 0; v < f.layout.variables.size(); v++)
+        std::cout << " " << f.layout.variables[v];
+    std::cout << std::endl;
+    std::cout << "Nodes: " << f.layout.nodes.size() << std::endl;
+    for (unsigned int a = 0; a < f.layout.attributes.size(); a++)
+        std::cout << f.layout.attributes[a].first << ": " << f.layout.attributes[a].second << std::endl;
+    std::cout << "Codec: " << (f.encoding.codec < 3 ? codecs[f.encoding.codec] : "unknown");
+    if (f.encoding.codec != CODEC_NONE)
+        std::cout << ", keyframe every " << f.encoding.keyframeInterval << " frames";
+    if (f.encoding.codec == CODEC_QUANTISED)
+        std::cout << ", tolerance " << f.encoding.tolerance;
+    std::cout << std::endl;
+    std::cout << "Frames: " << f.frameCount();
+    if (f.frameCount() > 0)
+        std::cout << " (steps " << f.counter(0) << " to " << f.counter(f.frameCount() - 1) << ")";
+    std::cout << std::endl;
+}
+
+
+int main(int argc, char** argv) {
+    std::string file_name;
+    std::vector<std::string> var_names;
+    bool info = false;
+    bool one_step = false;
+    unsigned int step = 0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        try {
+            if (arg == "--info") {
+                info = true;
+            }
+            else if (arg == "--var" && i + 1 < argc) {
+                var_names.push_back(argv[++i]);
+            }
+            else if (arg == "--step" && i + 1 < argc) {
+                step = std::stoul(argv[++i]);
+                one_step = true;
+            }
+            else if (arg == "--help" || arg == "-h") {
+                printUsage();
+                return 0;
+            }
+            else if (arg.compare(0, 2, "--") == 0 || not file_name.empty()) {
+                std::cerr << "Unknown or incomplete option: " << arg << std::endl;
+                printUsage();
+                return 1;
+            }
+            else {
+                file_name = arg;
+            }
+        }
+        catch (const std::logic_error &) {
+            std::cerr << "Bad number for option " << arg << std::endl;
+            return 1;
+        }
+    }
+    if (file_name.empty()) {
+        printUsage();
+        return 1;
+    }
+
+    try {
+        BinaryResultsFile f(file_name);
+        if (info) {
+            printInfo(f);
+            return 0;
+        }
+
+        std::vector<int> vars;
+        if (var_names.empty())
+            for (unsigned int v = 0; v < f.layout.variables.size(); v++)
+                vars.push_back(v);
+        for (unsigned int v = 0; v < var_names.size(); v++) {
+            int index = f.variableIndex(var_names[v]);
+            if (index < 0) {
+                std::cerr << "No variable " << var_names[v] << " in " << file_name << std::endl;
+                return 1;
+            }
+            vars.push_back(index);
+        }
+
+        // one row per output point per frame, full precision so values can be compared exactly
+        std::cout.precision(17);
+        std::cout << "step\tseconds\tnode\tx";
+        for (unsigned int v = 0; v < vars.size(); v++)
+            std::cout << "\t" << f.layout.variables[vars[v]];
+        std::cout << "\n";
+
+        bool found = false;
+        for (size_t frame = 0; frame < f.frameCount(); frame++) {
+            if (one_step && f.counter(frame) != step)
+                continue;
+            found = true;
+            const std::vector< std::vector<double> > &values = f.readAll(frame);
+            for (unsigned int i = 0; i < f.layout.nodes.size(); i++) {
+                std::cout << f.counter(frame) << "\t" << f.seconds(frame) << "\t" << f.layout.nodes[i] << "\t" << f.layout.x[i];
+                for (unsigned int v = 0; v < vars.size(); v++)
+                    std::cout << "\t" << values[vars[v]][i];
+                std::cout << "\n";
+            }
+        }
+        if (one_step && not found) {
+            std::cerr << "No output at step " << step << " in " << file_name << std::endl;
+            return 1;
+        }
+    }
+    catch (const GrateError &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,330 @@
+/*******************
+ *
+ *
+ *  GRATE 9
+ *
+ *  Memory footprint: bytes held by the model's structures, measured or predicted
+ *
+ *
+ *
+*********************/
+
+#include "footprint.h"
+#include "model.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <unordered_set>
+#include <ciso646>
+
+namespace {
+
+// a make_shared block holds the reference counts (and a vtable pointer) ahead of the object
+const size_t SHARED_CONTROL = 16;
+
+const unsigned int LEGACY_COLUMNS = 24;        // Columns of the main results file (see legacyStream)
+const size_t TEXT_CHARS = 14;                  // Typical characters per number in a text results file
+
+// Capacity of a vector filled by push_back from empty: doubling from 1
+size_t grownCapacity(size_t n)
+{
+    size_t capacity = 0;
+    if (n > 0)
+        for (capacity = 1; capacity < n; capacity *= 2)
+            ;
+    return capacity;
+}
+
+// Heap held by a grain size distribution's vectors, not counting the object itself
+MemoryCount gsdHeap(const NodeGSDObject &g)
+{
+    MemoryCount c;
+    c.addVector(g.abrasion);
+    c.addVector(g.density);
+    c.addVector(g.psi);
+    c.addVector(g.pct);
+    for (unsigned int k = 0; k < g.pct.size(); k++)
+        c.addVector(g.pct[k]);
+    return c;
+}
+
+MemoryCount gsdArray(const vector<NodeGSDObject> &v)
+{
+    MemoryCount c;
+    c.addVector(v);
+    for (unsigned int i = 0; i < v.size(); i++)
+        c.add(gsdHeap(v[i]));
+    return c;
+}
+
+MemoryCount seriesArray(const vector< vector<TS_Object> > &v)
+{
+    MemoryCount c;
+    c.addVector(v);
+    for (unsigned int i = 0; i < v.size(); i++)
+        c.addVector(v[i]);
+    return c;
+}
+
+// Entries of each source in a hydro_series or sed_series, grouped as hydro and sed do: a new
+// source starts when the coordinate increases, and one before the first if that isn't at 0
+vector<size_t> seriesGroups(const vector<SeriesStep> &series)
+{
+    vector<size_t> groups(1, 0);
+    double current = 0.;
+    for (unsigned int i = 0; i < series.size(); i++)
+    {
+        if (series[i].loc > current)
+        {
+            groups.push_back(0);
+            current = series[i].loc;
+        }
+        groups.back()++;
+    }
+    return groups;
+}
+
+MemoryCount predictSeries(const vector<size_t> &groups)
+{
+    MemoryCount c;
+    c.addBlock(grownCapacity(groups.size()) * sizeof(vector<TS_Object>));
+    for (unsigned int i = 0; i < groups.size(); i++)
+        if (groups[i] > 0)
+            c.addBlock(groups[i] * sizeof(TS_Object));     // copied in, so no spare capacity
+    return c;
+}
+
+void printLine(std::ostream &out, const std::string &name, const MemoryCount &c)
+{
+    char line[160];
+    std::snprintf(line, sizeof(line), "%-34s %12.3f %12lu %12.3f\n", name.c_str(), c.bytes / 1e6,
+                  (unsigned long)c.blocks, c.overhead / 1e6);
+    out << line;
+}
+
+}  // namespace
+
+
+void MemoryCount::addBlock(size_t n, size_t count)
+{
+    size_t chunk = (n + 8 + 15) / 16 * 16;
+    if (chunk < 32)
+        chunk = 32;
+    bytes += n * count;
+    blocks += count;
+    overhead += (chunk - n) * count;
+}
+
+void MemoryCount::add(const MemoryCount &other, size_t times)
+{
+    bytes += other.bytes * times;
+    blocks += other.blocks * times;
+    overhead += other.overhead * times;
+}
+
+void MemoryReport::add(const std::string &name, const MemoryCount &count)
+{
+    Item item;
+    item.name = name;
+    item.count = count;
+    items.push_back(item);
+}
+
+size_t MemoryReport::total() const
+{
+    size_t t = 0;
+    for (unsigned int i = 0; i < items.size(); i++)
+        t += items[i].count.bytes + items[i].count.overhead;
+    return t;
+}
+
+void MemoryReport::print(std::ostream &out, const std::string &title) const
+{
+    std::ostringstream table;
+    char line[160];
+    std::snprintf(line, sizeof(line), "%-34s %12s %12s %12s\n", "structure", "MB", "allocations", "overhead MB");
+    table << line;
+
+    MemoryCount sum;
+    for (unsigned int i = 0; i < items.size(); i++)
+    {
+        printLine(table, items[i].name, items[i].count);
+        sum.add(items[i].count);
+    }
+    printLine(table, "total", sum);
+    table << title << " total: " << total() << " bytes\n";
+    out << table.str();
+}
+
+MemoryReport measureFootprint(Model &m)
+{
+    RiverProfile *r = m.rn;
+    hydro *wl = m.wl;
+    sed *sd = m.sd;
+    MemoryReport report;
+
+    // the stratigraphy: layers this model owns, and those it hasn't written yet, which it may share
+    // between its own layers or with other models forked from the same snapshot. Each shared
+    // layer is counted once, in full, whoever else holds it.
+    MemoryCount own, shared;
+    std::unordered_set<const NodeGSDObject*> seen;
+    own.addBlock(r->storedf.capacity() * sizeof(shared_ptr<NodeGSDObject>));
+    own.addBlock(r->storedf.capacity());       // Ownership flags
+    for (unsigned int i = 0; i < r->storedf.nodes(); i++)
+        for (unsigned int z = 0; z < r->storedf.layers(); z++)
+        {
+            const NodeGSDObject &g = r->storedf.layer(i, z);
+            MemoryCount cell;
+            cell.addBlock(SHARED_CONTROL + sizeof(NodeGSDObject));
+            cell.add(gsdHeap(g));
+            if (r->storedf.owns(i, z))
+                own.add(cell);
+            else if (seen.insert(&g).second)
+                shared.add(cell);
+        }
+    report.add("storedf", own);
+    report.add("storedf, shared layers", shared);
+
+    report.add("F", gsdArray(r->F));
+    report.add("p", gsdArray(sd->p));
+    report.add("df", gsdArray(sd->df));
+    report.add("grp (GSD library)", gsdArray(r->grp));
+
+    MemoryCount xs;
+    xs.addVector(r->RiverXS);
+    report.add("RiverXS", xs);
+
+    report.add("Qw", seriesArray(wl->Qw));
+    report.add("Qs_series", seriesArray(sd->Qs_series));
+
+    MemoryCount nodes;
+    nodes.addVector(r->xx);
+    nodes.addVector(r->eta);
+    nodes.addVector(r->la);
+    nodes.addVector(r->algrp);
+    nodes.addVector(r->ntop);
+    nodes.addVector(r->stgrp);
+    nodes.addVector(r->toplayer);
+    nodes.addVector(r->bedrock);
+    nodes.addVector(r->rand_nums);
+    nodes.addVector(r->tweakArray);
+    nodes.addVector(r->N);
+    nodes.addVector(wl->Qw_Ct);
+    nodes.addVector(wl->Fr2);
+    nodes.addVector(wl->QwCumul);
+    nodes.addVector(wl->bedSlope);
+    nodes.addVector(sd->Qs_bc);
+    nodes.addVector(sd->Qs);
+    nodes.addVector(sd->deta);
+    nodes.addVector(sd->dLa_over_dt);
+    report.add("node arrays", nodes);
+
+    MemoryCount objects;
+    objects.addBlock(sizeof(RiverProfile));
+    objects.addBlock(sizeof(hydro));
+    objects.addBlock(sizeof(sed));
+    objects.add(gsdHeap(sd->fpp));
+    report.add("model objects", objects);
+
+    MemoryCount outputs;
+    outputs.addVector(m.outputs);
+    for (unsigned int s = 0; s < m.outputs.size(); s++)
+    {
+        outputs.addBlock(sizeof(OutputStream));
+        m.outputs[s]->countMemory(outputs);
+    }
+    report.add("output buffers", outputs);
+    return report;
+}
+
+MemoryReport predictFootprint(const ModelSetup &setup)
+{
+    size_t nodes = setup.nnodes > 0 ? setup.nnodes : 0;
+    size_t layers = setup.nlayer > 0 ? setup.nlayer : 0;
+    size_t groups = setup.ngrp > 0 ? setup.ngrp : 0;
+    MemoryReport report;
+
+    // every GSD has the same shape: built by its constructor, or copied from one
+    NodeGSDObject built;
+    NodeGSDObject copied(built);
+    MemoryCount builtHeap = gsdHeap(built), copiedHeap = gsdHeap(copied);
+
+    MemoryCount strat;
+    strat.addBlock(nodes * layers * sizeof(shared_ptr<NodeGSDObject>));
+    strat.addBlock(nodes * layers);
+    strat.addBlock(SHARED_CONTROL + sizeof(NodeGSDObject), nodes * layers);
+    strat.add(copiedHeap, nodes * layers);
+    report.add("storedf", strat);
+    report.add("storedf, shared layers", MemoryCount());
+
+    MemoryCount f, p, grp;
+    f.addBlock(grownCapacity(nodes) * sizeof(NodeGSDObject));
+    f.add(copiedHeap, nodes);
+    p.addBlock(nodes * sizeof(NodeGSDObject));
+    p.add(builtHeap, nodes);
+    grp.addBlock(grownCapacity(groups) * sizeof(NodeGSDObject));
+    grp.add(copiedHeap, groups);
+    report.add("F", f);
+    report.add("p", p);
+    report.add("df", p);
+    report.add("grp (GSD library)", grp);
+
+    MemoryCount xs;
+    xs.addBlock(nodes * sizeof(NodeXSObject));
+    report.add("RiverXS", xs);
+
+    vector<size_t> hydroGroups = seriesGroups(setup.hydroSeries);
+    vector<size_t> sedGroups = seriesGroups(setup.sedSeries);
+    report.add("Qw", predictSeries(hydroGroups));
+    report.add("Qs_series", predictSeries(sedGroups));
+
+    // eleven arrays of doubles and three of node numbers, and a few small ones
+    MemoryCount arrays;
+    arrays.addBlock(nodes * sizeof(double), 11);
+    arrays.addBlock(nodes * sizeof(unsigned int), 3);
+    arrays.addBlock(grownCapacity(10) * sizeof(double));
+    arrays.addBlock(grownCapacity(5) * sizeof(double));
+    arrays.addBlock(grownCapacity(hydroGroups.size()) * sizeof(double));
+    arrays.addBlock(grownCapacity(sedGroups.size()) * sizeof(TS_Object));
+    report.add("node arrays", arrays);
+
+    MemoryCount objects;
+    objects.addBlock(sizeof(RiverProfile));
+    objects.addBlock(sizeof(hydro));
+    objects.addBlock(sizeof(sed));
+    objects.add(builtHeap);
+    report.add("model objects", objects);
+
+    // the main results file: its stream, the snapshot of the first step (written before results
+    // go to the writer thread), one being formatted and one being filled, and the text of a step
+    MemoryCount outputs;
+    outputs.addBlock(sizeof(OutputStream*));
+    outputs.addBlock(sizeof(OutputStream));
+    outputs.addBlock(grownCapacity(LEGACY_COLUMNS) * sizeof(OutputVariable));
+    outputs.addBlock(grownCapacity(nodes) * sizeof(unsigned int));
+    outputs.addBlock(grownCapacity(nodes) * sizeof(double), 2);
+    outputs.addBlock(2 * sizeof(ResultsSnapshot));
+    outputs.addBlock(LEGACY_COLUMNS * sizeof(vector<double>), 3);
+    outputs.addBlock(nodes * sizeof(double), 3 * LEGACY_COLUMNS);
+    outputs.addBlock(grownCapacity(LEGACY_COLUMNS * nodes * TEXT_CHARS));
+    report.add("output buffers", outputs);
+    return report;
+}
+
+bool residentMemory(size_t &resident, size_t &peak)
+{
+    std::ifstream status("/proc/self/status");
+    if (not status)
+        return false;
+    resident = peak = 0;
+    std::string line;
+    while (std::getline(status, line))
+    {
+        unsigned long kb;
+        if (std::sscanf(line.c_str(), "VmRSS: %lu kB", &kb) == 1)
+            resident = kb * 1024;
+        else if (std::sscanf(line.c_str(), "VmHWM: %lu kB", &kb) == 1)
+            peak = kb * 1024;
+    }
+    return resident > 0;
+}
@@ -0,0 +1,69 @@
+#ifndef FOOTPRINT_H
+#define FOOTPRINT_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class Model;
+class ModelSetup;
+
+
+// Bytes held on the heap by a group of objects: what was asked for (object sizes and vector
+// capacities), in how many blocks, and an estimate of what the allocator adds to each block
+// (glibc malloc: an 8 byte header, rounded up to 16 bytes, 32 at least)
+class MemoryCount
+{
+public:
+
+    MemoryCount() : bytes(0), blocks(0), overhead(0) {}
+
+    void addBlock(size_t n, size_t count = 1);             // 'count' heap allocations of n bytes
+    void add(const MemoryCount &other, size_t times = 1);
+
+    template <class T> void addVector(const std::vector<T> &v)
+    {
+        if (v.capacity() > 0)
+            addBlock(v.capacity() * sizeof(T));
+    }
+
+    size_t bytes;
+    size_t blocks;
+    size_t overhead;
+};
+
+// Memory held by each of the model's major structures
+class MemoryReport
+{
+public:
+
+    struct Item
+    {
+        std::string name;
+        MemoryCount count;
+    };
+
+    void add(const std::string &name, const MemoryCount &count);
+    size_t total() const;                      // Bytes with the allocator overhead
+
+    // Table in MB, then the total in bytes on a line of its own: "<title> total: N bytes"
+    void print(std::ostream &out, const std::string &title) const;
+
+    std::vector<Item> items;
+};
+
+// The model's structures as they are now. The stratigraphy grows as the run writes layers that
+// still share the initial GSD; layers shared with another model (a forked ensemble member) are
+// reported separately. Results writers finish any steps they hold before they are measured.
+MemoryReport measureFootprint(Model &m);
+
+// What the model built from 'setup' will hold at most, before anything is allocated: every
+// stratigraphy layer written, the main results file written in the background. Streams from the
+// OUTPUT element and the solvers' working arrays are not included.
+MemoryReport predictFootprint(const ModelSetup &setup);
+
+// The process's resident set and its peak, from /proc/self/status; false where that isn't available
+bool residentMemory(size_t &resident, size_t &peak);
+
+#endif // FOOTPRINT_H
@@ -0,0 +1,363 @@
+/*******************
+ *
+ *
+ *  GRATE 9
+ *
+ *  Synthetic river generator: input files of any size, for scaling runs
+ *
+ *
+ *
+*********************/
+#include "grateerror.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <stdexcept>
+#include <vector>
+#include <ciso646>
+
+
+// Input settings the generator doesn't vary
+static const int NGSZ = 13;                    // PSI_-3 .. PSI_9
+static const int NLITH = 3;
+static const int STRAT_LAYERS = 30;            // layer01 .. layer30
+static const double START_DATE = 36683.5;      // Excel serial date of the first series entry
+static const double MAIN_QW = 150;             // Mean discharge entering the top of the profile (m3/s)
+static const double MAIN_QS = 5;               // Mean sediment feed at the top (m3/s), as in test_out.xml
+static const double OUTLET_ETA = 200;          // Bed elevation at the last node (m)
+
+struct Options {
+    int nodes;
+    int nlayer;
+    int days;
+    int tributaries;
+    int ngrp;
+    double dx;
+    uint64_t seed;
+    std::string output;
+};
+
+// splitmix64: the same numbers from the same seed on every platform and standard library,
+// which the std:: distributions don't promise
+class Random {
+    public:
+        explicit Random(uint64_t seed) : state(seed) {}
+
+        uint64_t next() {
+            uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            return z ^ (z >> 31);
+        }
+        double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }    // [0, 1)
+        double between(double lo, double hi) { return lo + (hi - lo) * uniform(); }
+        int integer(int lo, int hi) { return lo + int(next() % uint64_t(hi - lo + 1)); }  // [lo, hi]
+
+    private:
+        uint64_t state;
+};
+
+// A source of water and sediment: the top of the profile, or a tributary joining at 'loc'
+struct Source {
+    int loc;                                   // Chainage (m)
+    double meanQw;
+    int gsd;                                   // Group of the sediment it brings, 1-based
+};
+
+// Writes the file with a large buffer; a 1e6 node input is about 1 GB. stdout keeps its own
+// buffer, which must outlive the Writer: it is flushed at exit
+class Writer {
+    public:
+        explicit Writer(const std::string &fileName) : name(fileName) {
+            f = fileName == "-" ? stdout : std::fopen(fileName.c_str(), "w");
+            if (f == NULL)
+                throw GrateError("Error writing generated input: " + fileName);
+            if (f != stdout) {
+                buffer.resize(1 << 20);
+                std::setvbuf(f, &buffer[0], _IOFBF, buffer.size());
+            }
+        }
+        ~Writer() {
+            if (f != NULL && f != stdout)
+                std::fclose(f);
+        }
+
+        template <typename... Args>
+        void line(const char *format, Args... args) {
+            std::fprintf(f, format, args...);
+            std::fputc('\n', f);
+        }
+        void close() {
+            bool failed = std::ferror(f) != 0;
+            if (f != stdout)
+                failed = std::fclose(f) != 0 || failed;
+            else
+                failed = std::fflush(f) != 0 || failed;
+            f = NULL;
+            if (failed)
+                throw GrateError("Error writing generated input: " + name);
+        }
+
+    private:
+        std::string name;
+        FILE *f;
+        std::vector<char> buffer;
+};
+
+static void printUsage() {
+    std::cerr << "Usage: GrateGenerate [options]" << std::endl;
+    std::cerr << "  --nodes N              NNODES, e.g. 1000 or 1e3 (default 100)" << std::endl;
+    std::cerr << "  --layers N             NLAYER, at least 12; the stratigraphy element is written for 30 or more (default 30)" << std::endl;
+    std::cerr << "  --days N               length of the daily hydro and sed series, at least 2 (default 15)" << std::endl;
+    std::cerr << "  --tributaries N        tributaries joining along the profile (default 2)" << std::endl;
+    std::cerr << "  --groups N             NGRP, grain size distributions in the library (default 12)" << std::endl;
+    std::cerr << "  --dx M                 node spacing in metres (default 100)" << std::endl;
+    std::cerr << "  --seed S               random seed; the same seed gives the same file (default 1)" << std::endl;
+    std::cerr << "  --output FILE          xml file to write, - for stdout (default synthetic.xml)" << std::endl;
+}
+
+// the whole of the text must be the number: std::stod and friends stop at the first character
+// they can't use, so "100e3" would otherwise be 100 nodes
+static double wholeDouble(const std::string &text) {
+    size_t end;
+    double value = std::stod(text, &end);
+    if (end != text.size())
+        throw std::invalid_argument(text);
+    return value;
+}
+
+// counts may be written as 1e5, as long as they are whole
+static int wholeInt(const std::string &text) {
+    double value = wholeDouble(text);
+    if (value != std::floor(value))
+        throw std::invalid_argument(text);
+    if (value < INT_MIN || value > INT_MAX)
+        throw std::out_of_range(text);
+    return int(value);
+}
+
+static uint64_t wholeSeed(const std::string &text) {
+    size_t end;
+    unsigned long long value = std::stoull(text, &end);
+    if (end != text.size())
+        throw std::invalid_argument(text);
+    return value;
+}
+
+static double normalCdf(double z) {
+    return 0.5 * std::erfc(-z / std::sqrt(2.0));
+}
+
+// Group fining downstream from 1 at the top to NGRP at the outlet
+static int groupAt(double fraction, int ngrp) {
+    return std::min(ngrp, 1 + int(fraction * ngrp));
+}
+
+static void generate(const Options &o) {
+    Random rnd(o.seed);
+    double length = o.dx * (o.nodes - 1);
+
+    // tributaries join at distinct nodes between 10% and 90% of the way down, each carrying a
+    // share of the main discharge, and the finer sediment of the reach they join
+    std::vector<Source> sources;
+    sources.push_back(Source{0, MAIN_QW, 1});
+    int first = std::max(1, int(0.1 * (o.nodes - 1))), last = std::max(first, int(0.9 * (o.nodes - 1)));
+    std::vector<int> joins;
+    while (int(joins.size()) < o.tributaries) {
+        int n = rnd.integer(first, last);
+        if (std::find(joins.begin(), joins.end(), n) == joins.end())
+            joins.push_back(n);
+    }
+    std::sort(joins.begin(), joins.end());
+    for (unsigned int t = 0; t < joins.size(); t++) {
+        double share = rnd.between(0.1, 0.4);
+        sources.push_back(Source{int(std::lround(joins[t] * o.dx)), share * MAIN_QW, groupAt(joins[t] / double(o.nodes - 1), o.ngrp)});
+    }
+
+    Writer out(o.output);
+    out.line("<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>");
+    out.line("<!-- GrateGenerate --nodes %d --layers %d --days %d --tributaries %d --groups %d --dx %g --seed %llu -->",
+             o.nodes, o.nlayer, o.days, o.tributaries, o.ngrp, o.dx, (unsigned long long)o.seed);
+    out.line("<GRATE_BoundaryConditions>");
+    out.line("\t<PARAMS>");
+    out.line("\t\t<NNODES>%d</NNODES>", o.nodes);
+    out.line("\t\t<LAYER>6</LAYER>");
+    out.line("\t\t<LA>0.5</LA>");
+    out.line("\t\t<NLAYER>%d</NLAYER>", o.nlayer);
+    out.line("\t\t<PORO>0.4</PORO>");
+    out.line("\t\t<NGSZ>%d</NGSZ>", NGSZ);
+    out.line("\t\t<NLITH>%d</NLITH>", NLITH);
+    out.line("\t\t<NGRP>%d</NGRP>", o.ngrp);
+    out.line("\t</PARAMS>");
+
+    // concave long profile: the slope decays from 4% at the top towards 0.4% at the outlet, with
+    // some reach to reach variation; elevations are built up from the outlet
+    std::vector<double> eta(o.nodes);
+    eta[o.nodes - 1] = OUTLET_ETA;
+    for (int n = o.nodes - 2; n >= 0; n--) {
+        double x = (n + 0.5) * o.dx;
+        double slope = 0.004 + 0.036 * std::exp(-3 * x / length);
+        eta[n] = eta[n + 1] + slope * rnd.between(0.9, 1.1) * o.dx;
+    }
+
+    // widths follow the downstream hydraulic geometry, w = 1.5 Q^0.5 of the discharge at each node
+    // and doubling along the profile as in test_out.xml; the floodplain widens and the channel
+    // meanders more downstream
+    std::vector<int> stgrp(o.nodes);
+    out.line("\t<profile>");
+    unsigned int joined = 1;
+    double q = MAIN_QW;
+    for (int n = 0; n < o.nodes; n++) {
+        double x = n * o.dx, fraction = x / length;
+        while (joined < sources.size() && sources[joined].loc <= x)
+            q += sources[joined++].meanQw;
+        int group = groupAt(fraction, o.ngrp);
+        stgrp[n] = std::max(1, std::min(o.ngrp, group + rnd.integer(-1, 1)));
+        out.line("\t\t<XX X=\"%.0f\">", x);
+        out.line("\t\t\t<ETA>%.4f</ETA>", eta[n]);
+        out.line("\t\t\t<BEDROCK>%.4f</BEDROCK>", eta[n] - rnd.between(4, 12));
+        out.line("\t\t\t<WIDTH>%.4f</WIDTH>", 1.5 * std::sqrt(q) * (1 + fraction) * rnd.between(0.85, 1.15));
+        out.line("\t\t\t<SINU>%.4f</SINU>", 1.05 + 0.2 * fraction);
+        out.line("\t\t\t<FPWIDTH>%.4f</FPWIDTH>", (2 + 8 * fraction) * rnd.between(0.7, 1.3));
+        out.line("\t\t\t<HMAX>0.8</HMAX>");
+        out.line("\t\t\t<THETA>40</THETA>");
+        out.line("\t\t\t<ALGRP>%d</ALGRP>", group);
+        out.line("\t\t\t<STGRP>%d</STGRP>", stgrp[n]);
+        out.line("\t\t</XX>");
+    }
+    out.line("\t</profile>");
+
+    // series: daily values around each source's mean, with one flood of two to three times the
+    // mean lasting a few days; sediment supply rises with discharge to the power 1.5
+    double floodDay = rnd.integer(0, o.days - 1), floodPeak = rnd.between(2, 3), floodDays = rnd.between(1, 3);
+    std::vector< std::vector<double> > qw(sources.size(), std::vector<double>(o.days));
+    for (unsigned int s = 0; s < sources.size(); s++)
+        for (int d = 0; d < o.days; d++) {
+            double flood = (floodPeak - 1) * std::exp(-0.5 * std::pow((d - floodDay) / floodDays, 2));
+            qw[s][d] = sources[s].meanQw * (1 + flood) * rnd.between(0.9, 1.1);
+        }
+
+    out.line("\t<hydro_series>");
+    for (unsigned int s = 0; s < sources.size(); s++)
+        for (int d = 0; d < o.days; d++)
+            out.line("\t\t<STEP><loc>%d</loc><datetime>%.1f</datetime><Qw>%.4f</Qw></STEP>",
+                     sources[s].loc, START_DATE + d, qw[s][d]);
+    out.line("\t</hydro_series>");
+    out.line("\t<sed_series>");
+    for (unsigned int s = 0; s < sources.size(); s++)
+        for (int d = 0; d < o.days; d++)
+            out.line("\t\t<STEP><loc>%d</loc><datetime>%.1f</datetime><Qs>%.6f</Qs><GSD>%d</GSD></STEP>",
+                     sources[s].loc, START_DATE + d, MAIN_QS * std::pow(qw[s][d] / MAIN_QW, 1.5), sources[s].gsd);
+    out.line("\t</sed_series>");
+
+    // GSD library: log-normal distributions on the psi scale, from a median of 45 mm and
+    // sorting of 1.6 psi for group 1 to 3 mm and 1.2 psi for the last; one lithology, the others
+    // present but empty as in test_out.xml
+    for (int lith = 1; lith <= NLITH; lith++) {
+        out.line("\t<LITH%d>", lith);
+        for (int g = 0; g < o.ngrp; g++) {
+            double f = o.ngrp > 1 ? g / double(o.ngrp - 1) : 0;
+            double median = 5.5 - 4.0 * f, sorting = 1.6 - 0.4 * f;
+            out.line("\t\t<GRP>");
+            out.line("\t\t\t<ID>Synthetic_%d</ID>", g + 1);
+            for (int k = 0; k < NGSZ; k++) {
+                int psi = k - 3;
+                double pct = (lith == 1) ? (psi >= 7 ? 100 : 100 * normalCdf((psi - median) / sorting)) : 0;
+                out.line("\t\t\t<PSI_%d>%.6f</PSI_%d>", psi, pct, psi);
+            }
+            out.line("\t\t\t<ABR>0.001</ABR>");
+            out.line("\t\t\t<RHOS>2.65</RHOS>");
+            out.line("\t\t</GRP>");
+        }
+        out.line("\t</LITH%d>", lith);
+    }
+
+    // stratigraphy: the node's substrate group, coarser with depth, with some variation
+    if (o.nlayer >= STRAT_LAYERS) {
+        out.line("\t<stratigraphy>");
+        for (int n = 0; n < o.nodes; n++) {
+            out.line("\t\t<XXX X1=\"%.0f\">", n * o.dx);
+            for (int z = 1; z <= STRAT_LAYERS; z++) {
+                int group = std::max(1, std::min(o.ngrp, stgrp[n] - (3 * z) / STRAT_LAYERS + rnd.integer(-1, 1)));
+                out.line("\t\t\t<layer%02d>%d</layer%02d>", z, group, z);
+            }
+            out.line("\t\t</XXX>");
+        }
+        out.line("\t</stratigraphy>");
+    }
+
+    out.line("</GRATE_BoundaryConditions>");
+    out.close();
+}
+
+
+int main(int argc, char** argv) {
+    Options o;
+    o.nodes = 100;
+    o.nlayer = STRAT_LAYERS;
+    o.days = 15;
+    o.tributaries = 2;
+    o.ngrp = 12;
+    o.dx = 100;
+    o.seed = 1;
+    o.output = "synthetic.xml";
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        bool has_value = i + 1 < argc;
+        try {
+            if (arg == "--nodes" && has_value)
+                o.nodes = wholeInt(argv[++i]);
+            else if (arg == "--layers" && has_value)
+                o.nlayer = wholeInt(argv[++i]);
+            else if (arg == "--days" && has_value)
+                o.days = wholeInt(argv[++i]);
+            else if (arg == "--tributaries" && has_value)
+                o.tributaries = wholeInt(argv[++i]);
+            else if (arg == "--groups" && has_value)
+                o.ngrp = wholeInt(argv[++i]);
+            else if (arg == "--dx" && has_value)
+                o.dx = wholeDouble(argv[++i]);
+            else if (arg == "--seed" && has_value)
+                o.seed = wholeSeed(argv[++i]);
+            else if (arg == "--output" && has_value)
+                o.output = argv[++i];
+            else if (arg == "--help" || arg == "-h") {
+                printUsage();
+                return 0;
+            }
+            else {
+                std::cerr << "Unknown or incomplete option: " << arg << std::endl;
+                printUsage();
+                return 1;
+            }
+        }
+        catch (const std::logic_error &) {
+            std::cerr << "Invalid value for " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    // the same limits as the model's input checks, and room for the tributaries to join
+    if (o.nodes < 10 || o.nlayer < 12 || o.days < 2 || o.ngrp < 1 || o.dx <= 0 ||
+            o.tributaries < 0 || o.tributaries > (o.nodes - 1) * 8 / 10 - 1) {
+        std::cerr << "Need at least 10 nodes, 12 layers, 2 days, 1 group, a positive dx and fewer tributaries than 80% of the nodes" << std::endl;
+        return 1;
+    }
+
+    try {
+        generate(o);
+    }
+    catch (const GrateError &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    if (o.output != "-")
+        std::cerr << "Generated " << o.nodes << " nodes, " << o.tributaries << " tributaries and " << o.days
+                  << " days of series in '" << o.output << "'" << std::endl;
+    return 0;
+}
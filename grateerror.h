@@ -0,0 +1,15 @@
+#ifndef GRATEERROR_H
+#define GRATEERROR_H
+
+#include <stdexcept>
+#include <string>
+
+
+// Exception thrown for errors in the input files or model setup
+class GrateError : public std::runtime_error
+{
+public:
+    explicit GrateError(const std::string &msg) : std::runtime_error(msg) {}
+};
+
+#endif // GRATEERROR_H
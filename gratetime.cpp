@@ -91,6 +91,19 @@ void GrateTime::setExcelTime(double nSerialDate)
 
 }
 
+// returns the broken-down time
+std::tm GrateTime::getTm() const {
+    return timeinfo;
+}
+
+// sets the broken-down time, including the DST flag, so a saved time is restored exactly
+void GrateTime::setTm(const std::tm &t) {
+    timeinfo = t;
+
+    // normalise it
+    std::mktime(&timeinfo);
+}
+
 // prints a string representation to stdout
 void GrateTime::print() {
     std::cout << std::asctime(&timeinfo) << std::endl;
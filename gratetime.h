@@ -17,6 +17,8 @@ class GrateTime
         void setTime(int hour, int minute, int second);  // set the time
         void setExcelTime(double nSerialDate);  // Convert from Excel serial date
         void print();  // print the current date time
+        std::tm getTm() const;  // broken-down time, e.g. for checkpointing
+        void setTm(const std::tm &t);  // restore a broken-down time exactly
 
     private:
         std::tm timeinfo;
@@ -14,8 +14,8 @@
 #include <iostream>
 #include <algorithm>
 #include <fstream>
-#include "tinyxml2/tinyxml2.h"
-#include "tinyxml2_wrapper.h"
+#include "grateerror.h"
+#include <sstream>
 using namespace std;
 
 #define PI 3.14159265
@@ -24,38 +24,30 @@ using namespace std;
 #define Gs 1.65   // submerged specific gravity
 
 
-hydro::hydro(RiverProfile *r, XMLElement *params_root)
+hydro::hydro(RiverProfile *r, const ModelSetup &setup)
 {
     preissTheta = 0.7;
     hydUpw = r->hydroUpw;
     regimeCounter = (r->nnodes-2);
 
-    initHydro(r->nnodes, params_root);
+    initHydro(r->nnodes, setup);
 }
 
-void hydro::initHydro(unsigned int nodes, XMLElement *params_root)
+void hydro::initHydro(unsigned int nodes, const ModelSetup &setup)
 {
     double currentCoord = 0.;
-    double SerialDate;
     GrateTime NewDate;
     vector< TS_Object > tmp;
     TS_Object NewEntry;
 
-    // get hydro_series element from XML file
-    XMLElement *hydro_series = params_root->FirstChildElement("hydro_series");
-    if (hydro_series == NULL) {
-        throw std::string("Error getting hydro_series element from XML file");
-    }
-
-    // loop over all "STEP" elements in the XML file
-    for (XMLElement* e = hydro_series->FirstChildElement("STEP"); e != NULL; e = e->NextSiblingElement("STEP")) {
+    for (unsigned int i = 0; i < setup.hydroSeries.size(); i++) {
+        const SeriesStep &step = setup.hydroSeries[i];
 
-        SerialDate = getDoubleValue(e, "datetime");
-        NewDate.setExcelTime(SerialDate);
+        NewDate.setExcelTime(step.datetime);
 
         NewEntry.date_time = NewDate;
-        NewEntry.Q = getDoubleValue(e, "Qw");
-        NewEntry.Coord = getIntValue(e, "loc");
+        NewEntry.Q = step.Q;
+        NewEntry.Coord = step.loc;
         NewEntry.GRP = 1;  // this could be added to the XML file if desired...
 
         if (NewEntry.Coord > currentCoord) {            // Have we moved to a new source coordinate?
@@ -77,6 +69,7 @@ void hydro::initHydro(unsigned int nodes, XMLElement *params_root)
 
 void hydro::backWater(RiverProfile *r)
 {
+    ScopedTimer timer(r->timings, PHASE_BACKWATER);
 
     double g = 9.81;
     double FrN2 = 0.8 * 0.8;                     // Threshold for critical flow - 0.8 (squared)
@@ -160,8 +153,12 @@ void hydro::backWater(RiverProfile *r)
             bQuasiNormal = 1;
         };
 
+        // whatever failed above, critical depth is what the node ends up with
         if ( ( iret > 0 ) || ( r->RiverXS[n].depth < r->RiverXS[n].critdepth ) )
+        {
             r->RiverXS[n].depth =  r->RiverXS[n].critdepth;
+            r->solvers.fallback(FALLBACK_CRITICAL_DEPTH, n);
+        }
 
         if ( ( r->RiverXS[n].depth > 0 ) && ( bedSlope[n] > 0 ) )
             r->RiverXS[n].ustar = sqrt( 9.81 * r->RiverXS[n].depth * bedSlope[n] );
@@ -173,6 +170,7 @@ void hydro::backWater(RiverProfile *r)
 }
 
 void hydro::setQuasiSteadyNodalFlows(RiverProfile *r){
+    ScopedTimer timer(r->timings, PHASE_NODAL_FLOWS);
 
     unsigned int j = 0;
     unsigned int i = 0;
@@ -247,8 +245,18 @@ void hydro::xsCritDepth(unsigned int n, RiverProfile *r, double Q){
         it++;
         if (it > itmax)
         {
-            cout << "Unable to initialise max depth for critical depth calculation at xc = \n";
-            exit(1);
+            std::ostringstream msg;
+            msg << "Unable to initialise max depth for critical depth calculation at node " << n;
+            r->diag.error(msg.str());
+
+            xs.depth = orig_depth;             // leave the cross-section as we found it
+            xs.xsArea();
+            xs.xsPerim();
+            xs.xsCentr();
+            xs.xsECI(r->F[n]);
+            xs.velocity = Q / xs.flow_area[2];
+            r->solvers.record(SOLVER_CRIT_DEPTH, it, false);
+            return;
         }
     }
 
@@ -279,13 +287,15 @@ void hydro::xsCritDepth(unsigned int n, RiverProfile *r, double Q){
 
         y1 = y2;
         it++;
+    }
 
-        if (it > itmax)
-        {
-            cout << "Critical depth did not converge \n";
-            exit(1);
-        }
+    if (it >= itmax)                             // keep the last bisection estimate
+    {
+        std::ostringstream msg;
+        msg << "Critical depth did not converge at node " << n;
+        r->diag.warning(msg.str());
     }
+    r->solvers.record(SOLVER_CRIT_DEPTH, it, it < itmax);
     //Success ... return critical depth
     xs.critdepth = y2;
 
@@ -399,20 +409,25 @@ int hydro::energyConserve(unsigned int n, RiverProfile *r)
 
         iter ++;
 
-        if (iter > itermax)
+        if (iter > itermax)                    // caller falls back to critical depth
         {
-            cout << "energy_conserve: std step backwater calculation failed to converge \n";
-            exit(1);
+            std::ostringstream msg;
+            msg << "energy_conserve: std step backwater calculation failed to converge at node " << n;
+            r->diag.warning(msg.str());
             flag = 8;
+            break;
         }
 
         if (XSu.depth < 0)
         {
-            cout << "energy_conserve: negative depth results \n";
-            exit(1);
+            std::ostringstream msg;
+            msg << "energy_conserve: negative depth results at node " << n;
+            r->diag.warning(msg.str());
             flag = 16;
+            break;
         }
     }
+    r->solvers.record(SOLVER_ENERGY_CONSERVE, iter, flag == 0);
     r->RiverXS[n] = XSu;
     return flag;
 }
@@ -454,6 +469,7 @@ int hydro::quasiNormal(unsigned int n, RiverProfile *r){
         if (iter> maxiter)
         {
             // cout << "Iteration Count exceeded in routine quasiNormal at " << n << "\n";
+            r->solvers.record(SOLVER_QUASI_NORMAL, iter, false);
             return 8;
         }
     }
@@ -463,6 +479,7 @@ int hydro::quasiNormal(unsigned int n, RiverProfile *r){
     XS.xsCentr();
     XS.xsECI(f);
 
+    r->solvers.record(SOLVER_QUASI_NORMAL, iter, true);
     return 0;
 }
 
@@ -738,7 +755,7 @@ void hydro::fullyDynamic(RiverProfile *r){
             }
 
         // SOLVE SYSTEM OF EQUATIONS
-        DF = matsol(NNODES, EQN);
+        DF = matsol(NNODES, EQN, r->diag);
 
         i = 0;
         SUMM = 0.0;
@@ -760,13 +777,13 @@ void hydro::fullyDynamic(RiverProfile *r){
         iter++;
 
         if (iter > 1500){
-            cout << "Preiss1: Maximum number of iterations exceeded";
+            r->diag.warning("Preiss1: Maximum number of iterations exceeded");
             break;
         }
     }
 }
 
-vector<double> hydro::matsol(int N, vector<vector<double> > A){
+vector<double> hydro::matsol(int N, vector<vector<double> > A, Diagnostics &diag){
 
     int i, j, k, inode, M;
     double t1, t2, t3, t4, d;
@@ -791,7 +808,7 @@ vector<double> hydro::matsol(int N, vector<vector<double> > A){
         d  = t1 * A[j+1][3] - t2 * A[j][3];
 
         if( abs(d) <= 1E-08 )
-            cout << "SINGULAR MATRIX --> NO UNIQUE SOLUTION EXISTS";
+            diag.warning("SINGULAR MATRIX --> NO UNIQUE SOLUTION EXISTS");
 
         C[k] = ( -t1 * A[j+1][2] + t2 * A[j][2]) / d;
         C[k+1] = ( t1 * t3 - t2 * t4 ) / d;
@@ -809,7 +826,7 @@ vector<double> hydro::matsol(int N, vector<vector<double> > A){
         d = A[j][0] + A[j][1] * C[k];
 
         if( abs(d) <= 1E-08 )
-        cout << "SINGULAR MATRIX --> NO UNIQUE SOLUTION EXISTS";
+            diag.warning("SINGULAR MATRIX --> NO UNIQUE SOLUTION EXISTS");
 
         X[k] = ( t4 - ( A[j][2] * X[k+2] + A[j][3] * X[k+3] ) ) / d;
         X[k+1] = C[k] * X[k] + C[k+1];
@@ -834,6 +851,7 @@ void hydro::regimeModel( unsigned int n, RiverProfile *r )
     double gradient_1 = 0;
     double gradient_2 = 0;
     double old_width = XS.width;
+    int iter = 0;                              // Search and bisection steps, for the solver counters
 
     p = 3 * pow( Q, 0.5 );
 
@@ -916,6 +934,7 @@ void hydro::regimeModel( unsigned int n, RiverProfile *r )
 
         gradient_2 = test_plus - test_minus;
         p2 = p;
+        iter++;
     }
 
     p_upper = max( p1, p2 );
@@ -945,7 +964,10 @@ void hydro::regimeModel( unsigned int n, RiverProfile *r )
             p_upper = p;
         p = 0.5 * ( p_upper + p_lower );
         converg = ( p_upper - p_lower ) / p;
+        iter++;
     }
+    // the loops only end once the bracket is within Tol, unless the gradients went NaN
+    r->solvers.record(SOLVER_REGIME_MODEL, iter, converg <= Tol);
 
     // Update reach geometry, with newly optimsed variables
 
@@ -1026,6 +1048,7 @@ void hydro::findStable( unsigned int n, RiverProfile *r )
 
         iter++;
     }
+    r->solvers.record(SOLVER_FIND_STABLE, iter, abs( converg ) <= Tol);
 }
 
 void hydro::findQ( unsigned int n, RiverProfile *r ){
@@ -1067,10 +1090,12 @@ void hydro::findQ( unsigned int n, RiverProfile *r ){
 
         iter++;
     }
+    r->solvers.record(SOLVER_FIND_Q, iter, abs(converg) <= tol);
 }
 
 void hydro::setRegimeWidth(RiverProfile *r)
 {
+    ScopedTimer timer(r->timings, PHASE_REGIME_WIDTH);
 
     // Adjust channel regime one cross-section at a time, marching upstream
 
@@ -19,11 +19,11 @@ public:
     vector<double> QwCumul;
     vector<double> bedSlope;                   // Bedslope
 
-    hydro(RiverProfile *r, XMLElement *params_root);                                   // Constructor
+    hydro(RiverProfile *r, const ModelSetup &setup);                                   // Constructor
 
     void backWater(RiverProfile *r);           // Principal Hydro routine: calculate water surface profile
 
-    void initHydro(unsigned int nodes, XMLElement *params_root);
+    void initHydro(unsigned int nodes, const ModelSetup &setup);
 
     void setQuasiSteadyNodalFlows(RiverProfile *r);
 
@@ -35,7 +35,7 @@ public:
 
     void fullyDynamic(RiverProfile *r);                            // Preissmann Scheme approximation of water-surface profile
 
-    vector<double> matsol(int N, vector<vector<double> > EQN);      // Matrix solver
+    vector<double> matsol(int N, vector<vector<double> > EQN, Diagnostics &diag);      // Matrix solver
 
     void regimeModel(unsigned int n, RiverProfile *r);                           // Compute Millar-Eaton equilibrium channel width
 
@@ -0,0 +1,64 @@
+/*******************
+ *
+ *
+ *  GRATE 9
+ *
+ *  JSON text: strings and numbers for the files and replies written as JSON
+ *
+ *
+ *
+*********************/
+
+#include "jsontext.h"
+#include <cmath>
+#include <cstdio>
+#include <ciso646>
+
+namespace {
+
+void writeEscaped(std::ostream &out, const char *s, size_t n)
+{
+    out << '"';
+    for (size_t i = 0; i < n; i++)
+    {
+        unsigned char c = s[i];
+        if (c == '"' || c == '\\')
+            out << '\\' << c;
+        else if (c == '\n')
+            out << "\\n";
+        else if (c == '\t')
+            out << "\\t";
+        else if (c < 0x20)
+        {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out << escaped;
+        }
+        else
+            out << c;
+    }
+    out << '"';
+}
+
+}  // namespace
+
+
+void writeJsonString(std::ostream &out, const char *s)
+{
+    writeEscaped(out, s, std::char_traits<char>::length(s));
+}
+
+void writeJsonString(std::ostream &out, const std::string &s)
+{
+    writeEscaped(out, s.data(), s.size());
+}
+
+void writeJsonNumber(std::ostream &out, double x)
+{
+    char text[32];
+    if (std::isfinite(x))
+        std::snprintf(text, sizeof(text), "%.6g", x);
+    else
+        std::snprintf(text, sizeof(text), "null");
+    out << text;
+}
@@ -0,0 +1,18 @@
+#ifndef JSONTEXT_H
+#define JSONTEXT_H
+
+#include <ostream>
+#include <string>
+
+
+// The two pieces of JSON that need more than operator<<, shared by every JSON file and reply the
+// model writes: the run summary, solver report, progress, trace and benchmark results
+
+// Quoted, with '"', '\' and control characters escaped
+void writeJsonString(std::ostream &out, const char *s);
+void writeJsonString(std::ostream &out, const std::string &s);
+
+// %.6g, or null for NaN and infinities, which JSON has no numbers for
+void writeJsonNumber(std::ostream &out, double x);
+
+#endif // JSONTEXT_H
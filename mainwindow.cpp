@@ -12,6 +12,7 @@
 
 #include "mainwindow.h"
 #include "model.h"
+#include "grateerror.h"
 #include "ui_RwaveWin.h"
 #include "tinyxml2/tinyxml2.h"
 #include <stdlib.h>
@@ -23,6 +24,9 @@
 #include <QString>
 #include <QDir>
 #include <QMessageBox>
+#include <QGuiApplication>
+#include <QScreen>
+#include <QElapsedTimer>
 #include <ciso646>
 
 #define PI 3.14159265
@@ -32,11 +36,39 @@ using namespace tinyxml2;
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow),
-    initialised(false)
+    initialised(false),
+    runner(NULL),
+    plotBudget(N_PLOTS, 0.008),
+    historyDepth(512),
+    historyStride(1)
 {
     // setup user interface
     ui->setupUi(this);
 
+    plots[PLOT_PROFILE] = ui->VectorPlot;
+    plots[PLOT_BEDLOAD] = ui->BedloadPlot;
+    plots[PLOT_BANKS] = ui->BankWidthPlot;
+    plots[PLOT_XSECT] = ui->XSectPlot;
+    plots[PLOT_HYDROGRAPH] = ui->QwSeries;
+    plots[PLOT_GSD] = ui->GSD_Dash;
+
+    // Floating text items, in GSD graph: made once and moved, shown or hidden as the run goes
+    for (int i = 0; i < 4; i++) {
+        gsdLabels[i] = new QCPItemText(ui->GSD_Dash);   // Label grain size info
+        ui->GSD_Dash->addItem(gsdLabels[i]);
+        gsdLabels[i]->setBrush(QColor(255, 255, 255, 127));
+        gsdLabels[i]->setVisible(false);
+    }
+
+    // how much of a run to keep to look back through: GrateRip --history-depth N --history-stride N
+    QStringList args = QCoreApplication::arguments();
+    for (int i = 1; i + 1 < args.size(); i++) {
+        if (args[i] == "--history-depth")
+            historyDepth = std::max(4, args[i + 1].toInt());
+        else if (args[i] == "--history-stride")
+            historyStride = std::max(1, args[i + 1].toInt());
+    }
+
     // default input file name
     std::string param_file = "test_out.xml";
 
@@ -51,6 +83,7 @@ MainWindow::MainWindow(QWidget *parent) :
     ui->startButton->setEnabled(0);     // Turn off start button until file is loaded.
 
     connect(ui->action_load_XML, SIGNAL(triggered()), this, SLOT(loadXML()));
+    connect(ui->historySlider, SIGNAL(valueChanged(int)), this, SLOT(scrubHistory()));
 }
 
 void MainWindow::loadXML()
@@ -58,6 +91,15 @@ void MainWindow::loadXML()
     std::string param_file;
     QString output_file;
 
+    // a run in progress steps the model being replaced: stop it, and let the old model go, first.
+    // Its snapshots and history are of the old river too
+    endRun();
+    ui->startButton->setEnabled(0);
+    shown.reset();
+    viewing.reset();
+    history.reset();
+    ui->historySlider->setEnabled(false);
+
     // check if file exists
     if (not std::fstream(param_file)) {
         std::cerr << "File does not exist... Need to specify..." << std::endl;
@@ -107,21 +149,23 @@ void MainWindow::loadXML()
                 ui->VectorPlot->replot();
 
                 // Use <Refresh Plot> button to start run
-                connect(ui->startButton, SIGNAL(clicked()), this, SLOT(kernel()), Qt::QueuedConnection);
+                connect(ui->startButton, SIGNAL(clicked()), this, SLOT(kernel()),
+                        static_cast<Qt::ConnectionType>(Qt::QueuedConnection | Qt::UniqueConnection));
 
                 initialised = true;
             }
-            catch (std::string msg) {
-                std::cerr << "Error while initialising components: " << msg << std::endl;
+            catch (const GrateError &e) {
+                std::cerr << "Error while initialising components: " << e.what() << std::endl;
                 std::stringstream error_stream;
-                error_stream << "Error while initialising components" << std::endl << std::endl << msg;
+                error_stream << "Error while initialising components" << std::endl << std::endl << e.what();
                 showErrorMessage("Error initialising components", error_stream);
             }
         }
     }
 
-    setupChart();                                // Setup GUI graph
-    ui->startButton->setEnabled(1);
+    // with no model loaded there is nothing to draw or run
+    if (initialised)
+        ui->startButton->setEnabled(1);
     ui->loadingAdvice->setVisible(0);
 }
 
@@ -273,6 +317,10 @@ void MainWindow::setupChart(){
     CursorY[0] = 0;
     CursorY[1] = 1200;
 
+    // graphs of a model loaded before this one
+    for ( i = 0; i < N_PLOTS; i++ )
+        plots[i]->clearGraphs();
+
     ui->VectorPlot->xAxis->setLabel("Distance Downstream");
     ui->VectorPlot->yAxis->setLabel("Elevation");
     ui->VectorPlot->xAxis->setRange(0, rn->nnodes + 1);
@@ -413,339 +461,474 @@ void MainWindow::setupChart(){
 
 void MainWindow::kernel(){
 
+    if (runner != NULL || not initialised)
+        return;
+
     ui->grateDateTime->setDateTime(QDateTime::fromTime_t(model->rn->cTime.getTime_t() + 50000));
 
-    connect(&dataTimer, SIGNAL(timeout()), this, SLOT( modelUpdate()) );
-    connect(&dataTimer, SIGNAL(timeout()), this, SLOT( updateProgress()) );
-    connect(ui->stopRun, SIGNAL(clicked()), this, SLOT( modelHalt()) );
+    // the model steps on its own thread at full speed; the plots are drawn from its latest
+    // snapshot once per screen refresh
+    double hz = 60;
+    if (QGuiApplication::primaryScreen() != NULL && QGuiApplication::primaryScreen()->refreshRate() >= 1)
+        hz = QGuiApplication::primaryScreen()->refreshRate();
+    int frame_ms = std::max(1, int(1000 / hz));
+
+    // half the frame for drawing plots, the rest for the window
+    plotBudget.budget = 0.5 * frame_ms / 1000.;
+    styleRunPlots();
+
+    // a new run, a new history, followed from its start
+    history.reset(new RunHistory(historyDepth, historyStride));
+    viewing.reset();
+    ui->historySlider->setEnabled(true);
+    updateHistorySlider(model->rn->counter);
+
+    runner = new ModelRunner(model, std::chrono::milliseconds(frame_ms), history.get());
+    runner->start(readControls());
+
+    connect(&dataTimer, SIGNAL(timeout()), this, SLOT( drawSnapshot()), Qt::UniqueConnection );
+    connect(&dataTimer, SIGNAL(timeout()), this, SLOT( updateProgress()), Qt::UniqueConnection );
+    connect(ui->stopRun, SIGNAL(clicked()), this, SLOT( modelHalt()), Qt::UniqueConnection );
+
+    dataTimer.start(frame_ms);
+}
+
+RunControls MainWindow::readControls(){
+
+    RunControls c;
+    c.dt = ui->deltaT->value();                       // Control dt with slider
+    c.writeInterval = ui->writeInt_disp->value();
+    c.sedUpw = ui->sedUpw_slider->value() / 100;      // upwind control
+    c.hydroUpw = ui->hydroUpw_slider->value() / 100;
+    c.regime = ui->RegimeButton->isChecked();         // regime routine on or off
+    c.cycle = ui->cycleButton->isChecked();
+    return c;
+}
+
+void MainWindow::drawSnapshot(){
+
+    if (runner == NULL)
+        return;
+
+    // settings go to the model after its next step
+    runner->setControls(readControls());
+    ui->dt_disp->setValue(ui->deltaT->value());
+
+    // only a new snapshot is drawn, and only while the history slider follows the run
+    std::shared_ptr<const ModelSnapshot> s = runner->latest();
+    updateHistorySlider(s->counter);
+    if (!ui->pausePlot->isChecked())
+    {
+        if (not viewing && s != shown)
+            plotSnapshot(*s);
+        replotDue();
+    }
+    shown = s;
+
+    if (s->state == RUN_FINISHED)
+    {
+        endRun();
+        ui->runProgress->setValue(100);
+        std::stringstream success_stream;
+        success_stream << "Model Successfully Completed: Check Results File" << std::endl << std::endl;
+        showInfoMessage("End Point Reached", success_stream);
+    }
+    else if (s->state == RUN_FAILED)
+    {
+        endRun();
+        std::stringstream error_stream;
+        error_stream << "Model stopped at step " << s->counter << std::endl << std::endl << s->error;
+        showErrorMessage("Model Stopped", error_stream);
+    }
+}
+
+// Replaces the values of a graph along the river, in place when its points are where they were.
+// Long rivers are cut to two points per pixel of the plot. Marks the plot changed if any value did.
+void MainWindow::updateNodeGraph(QCPGraph *graph, const std::vector<double> &values, int plot){
+
+    size_t pixels = std::max(plots[plot]->axisRect()->width(), 1);
+    decimateMinMax(nodeX.data(), values.data(), values.size(), 2 * pixels, lodX, lodY);
+
+    QCPDataMap *data = graph->data();
+    bool same_keys = data->size() == int(lodX.size());
+    QCPDataMap::iterator it = data->begin();
+    for (unsigned int i = 0; same_keys && i < lodX.size(); i++, ++it)
+        same_keys = it.key() == lodX[i];
+
+    if (not same_keys)
+    {
+        data->clear();
+        for (unsigned int i = 0; i < lodX.size(); i++)
+            data->insertMulti(lodX[i], QCPData(lodX[i], lodY[i]));
+        plotBudget.changed(plot);
+        return;
+    }
+    bool changed = false;
+    it = data->begin();
+    for (unsigned int i = 0; i < lodY.size(); i++, ++it)
+        if (it.value().value != lodY[i])
+        {
+            it.value().value = lodY[i];
+            changed = true;
+        }
+    if (changed)
+        plotBudget.changed(plot);
+}
+
+void MainWindow::setAxisRange(QCPAxis *axis, double lower, double upper, int plot){
+
+    if (axis->range().lower == lower && axis->range().upper == upper)
+        return;
+    axis->setRange(lower, upper);
+    plotBudget.changed(plot);
+}
+
+// Settings of the plots that stay the same for the whole run
+void MainWindow::styleRunPlots(){
+
+    ui->VectorPlot->xAxis->setLabel("Distance Downstream");
+    ui->VectorPlot->yAxis->setLabel("Elevation");
+
+    ui->BedloadPlot->graph(0)->setBrush(QColor(255, 161, 0, 50));
+    ui->BedloadPlot->graph(0)->setChannelFillGraph(nullptr);
+    ui->BedloadPlot->xAxis->setLabel("Distance Downstream");
+    ui->BedloadPlot->yAxis->setLabel("Qs, Qw Discharge");
 
-    dataTimer.start(0); // Interval 0 means to refresh as fast as possible
+    ui->BankWidthPlot->xAxis->setLabel("Distance Downstream");
+    ui->BankWidthPlot->yAxis->setLabel("Bank Width");
+
+    ui->XSectPlot->xAxis->setRange( -20, 120 );
+    ui->XSectPlot->yAxis->setRange( -7, 7 );
+
+    ui->GSD_Dash->graph(0)->setPen(QPen(QColor(0,0,0)));  // 0 is the finest grain size category: black
+    for ( int i = 1; i < 7 ; i++ )
+           ui->GSD_Dash->graph(i)->setPen(QPen(QColor((i * 30), 254 - (i * 30), 113)));
+    ui->GSD_Dash->yAxis->setRange(0, 1);
+
+    for ( int p = 0; p < N_PLOTS; p++ )
+        plotBudget.changed(p);
 }
 
-void MainWindow::modelUpdate(){
+void MainWindow::plotSnapshot(const ModelSnapshot &s){
 
-    unsigned int i, j, k, n, inc = 0;
+    unsigned int i, j, n;
     float theta_rad, a, b, c;
     float topFp, ovBank, ovFp;
-    RiverProfile* rn = model->rn;
-    hydro *wl = model->wl;
-    sed *sd = model->sd;
-    QVector<double> WSL( rn->nnodes );
-    QVector<double> x( rn->nnodes );
-    QVector<double> eta( rn->nnodes );
-    QVector<double> bedrock( rn->nnodes );
-    QVector<double> Froude( rn->nnodes );
-    QVector<double> Bedload( rn->nnodes );
-    QVector<double> Qw_Plot( rn->nnodes );
-    QVector<double> LeftBankLower( rn->nnodes );
-    QVector<double> RightBankLower( rn->nnodes );
-    QVector<double> LeftBankTop( rn->nnodes );
-    QVector<double> RightBankTop( rn->nnodes );
+    unsigned int nnodes = s.eta.size();
     QVector<double> XsPlotX( 11 );
     QVector<double> XsPlotY( 11 );
     QVector<double> wsXS_X( 2 );
     QVector<double> wsXS_Y( 2 );
     QVector<double> CursorX( 2 );
     QVector<double> CursorY( 2 );
-    QVector<double> PSI( 8 );
-    QVector<double> tmp( 8 );
-    QVector<QVector<double> > GSD_Data, GSD_Cumul;
+    GrateTime cTime = s.cTime;
+
+    nodeX.resize(nnodes);
+    series.resize(nnodes);
+    for ( i = 0; i < nnodes; i++ )
+        nodeX[i] = s.xs[i].node;
+
+    // Longitudinal Plot: bed and water surface (x8 exaggeration for display)
+    updateNodeGraph(ui->VectorPlot->graph(2), s.eta, PLOT_PROFILE);
+    for ( i = 0; i < nnodes; i++ )
+        series[i] = s.eta[i] + s.xs[i].depth * 8;
+    updateNodeGraph(ui->VectorPlot->graph(3), series, PLOT_PROFILE);
+    setAxisRange(ui->VectorPlot->xAxis, 0, nnodes + 1, PLOT_PROFILE);
+    setAxisRange(ui->VectorPlot->yAxis, round(s.eta[nnodes-1]-10), round(s.eta[1]+20), PLOT_PROFILE);
+
+    // Bedload and discharge
+    updateNodeGraph(ui->BedloadPlot->graph(0), s.Qs, PLOT_BEDLOAD);
+    for ( i = 0; i < nnodes; i++ )
+        series[i] = s.QwCumul[i] / 100;
+    updateNodeGraph(ui->BedloadPlot->graph(1), series, PLOT_BEDLOAD);
+    setAxisRange(ui->BedloadPlot->xAxis, 0, nnodes + 1, PLOT_BEDLOAD);
+    setAxisRange(ui->BedloadPlot->yAxis, 0, s.Qs[3] * 10, PLOT_BEDLOAD); //round(*max_element(Bedload.constBegin(), Bedload.constEnd()) * 1.5));
+
+    // Bank widths: lower banks either side, then upper banks
+    double widest = 0;
+    for ( i = 0; i < nnodes; i++ )
+    {
+        series[i] = s.xs[i].width/2;
+        widest = std::max(widest, series[i]);
+    }
+    updateNodeGraph(ui->BankWidthPlot->graph(0), series, PLOT_BANKS);
+    for ( i = 0; i < nnodes; i++ )
+        series[i] = -s.xs[i].width/2;
+    updateNodeGraph(ui->BankWidthPlot->graph(1), series, PLOT_BANKS);
+    for ( i = 0; i < nnodes; i++ )
+    {
+        theta_rad = s.xs[i].theta * PI / 180;
+        series[i] = ( s.xs[i].width + (2 * ( s.xs[i].bankHeight - s.xs[i].Hmax) / tan( theta_rad ) ) ) / 2;
+    }
+    updateNodeGraph(ui->BankWidthPlot->graph(2), series, PLOT_BANKS);
+    for ( i = 0; i < nnodes; i++ )
+    {
+        theta_rad = s.xs[i].theta * PI / 180;
+        series[i] = -( s.xs[i].width + (2 * ( s.xs[i].bankHeight - s.xs[i].Hmax) / tan( theta_rad ) ) ) / 2;
+    }
+    updateNodeGraph(ui->BankWidthPlot->graph(3), series, PLOT_BANKS);
+    setAxisRange(ui->BankWidthPlot->xAxis, 0, nnodes + 1, PLOT_BANKS);
+    setAxisRange(ui->BankWidthPlot->yAxis, -widest * 1.5, round(widest * 1.5), PLOT_BANKS);
 
-    tmp.fill( 0, rn -> nnodes );
-    GSD_Data.fill( tmp, 7);
-    GSD_Cumul.fill(tmp, 13);
+    // Setup cross-section graph
+    n = std::min<unsigned int>(ui->spinNode->value(), nnodes - 1);
+    theta_rad = s.xs[n].theta * PI / 180;
+    a = s.xs[n].bankHeight - s.xs[n].Hmax;  // Vert & Horiz triangle segments at lower channel.
+    c = tan(theta_rad);
+    b = a / c;              // aka dW, horizontal distance between bed and bank, under toe of channel edge
 
-    // Floating text items, in GSD graph
-    QCPItemText *PSI4Label = new QCPItemText(ui->GSD_Dash);   // Label grain size info
-    QCPItemText *PSI6Label = new QCPItemText(ui->GSD_Dash);   // Label grain size info
-    QCPItemText *PSI8Label = new QCPItemText(ui->GSD_Dash);   // Label grain size info
-    QCPItemText *PSI10Label = new QCPItemText(ui->GSD_Dash);   // Label grain size info
+    XsPlotX[2] = -1.5 * s.xs[n].fpSlope;
+    XsPlotY[2] = 0;
+    XsPlotX[3] = 0;
+    XsPlotY[3] = -1.5;
+    XsPlotX[4] = 0.001;
+    XsPlotY[4] = -1.5 - s.xs[n].Hmax;
+    XsPlotX[5] = b;
+    XsPlotY[5] = -1.5 - s.xs[n].bankHeight;
+    XsPlotX[6] = b + s.xs[n].width;
+    XsPlotY[6] = XsPlotY[5];
+    XsPlotX[7] = XsPlotX[6] + b;
+    XsPlotY[7] = XsPlotY[4];
+    XsPlotX[8] = XsPlotX[7] + 0.001;
+    XsPlotY[8] = -1.5;
+    XsPlotX[9] = XsPlotX[8] + 1.5;
+    XsPlotY[9] = 0;
+    XsPlotX[10] = XsPlotX[9] + 5 * s.xs[n].valleyWallSlp;
+    XsPlotY[10] = 5;
 
-    // model iteration
-    model->iteration();
+    XsPlotX[1] = XsPlotX[2];
+    XsPlotY[1] = 0;
+    XsPlotX[0] = XsPlotX[1] - ( 5 * s.xs[n].valleyWallSlp );
+    XsPlotY[0] = 5;
 
-    // dt control
-    rn->dt = ui->deltaT->value();
-    ui->dt_disp->setValue(rn->dt);                    // Control dt with slider
-    rn->writeInterval = ui->writeInt_disp->value();
+    wsXS_Y[0] = s.xs[n].depth;
 
-    // upwind control
-    rn->sedUpw = ui->sedUpw_slider->value() / 100;
-    rn->hydroUpw = ui->hydroUpw_slider->value() / 100;
+    topFp = s.xs[n].bankHeight + 1.5;
+    if (s.xs[n].depth > topFp)
+    {
+        ovFp = s.xs[n].depth - topFp;
+        ovBank = 1.5;
+        wsXS_X[0] = XsPlotX[1] - ( ovFp * s.xs[n].valleyWallSlp );
+        wsXS_X[1] = XsPlotX[9] + ( ovFp * s.xs[n].valleyWallSlp );
+        wsXS_Y[0] = ovFp;               // Floodplain elev. is '0' datum
+        wsXS_Y[1] = wsXS_Y[0];
+    }
+    else if (s.xs[n].depth > s.xs[n].bankHeight)
+    {
+        ovBank = s.xs[n].depth - s.xs[n].bankHeight;
+        wsXS_X[0] = - ( ovBank * s.xs[n].fpSlope );
+        wsXS_X[1] = XsPlotX[8] + ovBank;
+        wsXS_Y[0] = -1.5 + ovBank;
+        wsXS_Y[1] = wsXS_Y[0];
+    }
+    else if (s.xs[n].depth > a)   // 'a' is computed, above, as bottom of vertical banks
+    {
+        wsXS_X[0] = 0;
+        wsXS_X[1] = XsPlotX[8];
+        wsXS_Y[0] = -1.5 - (s.xs[n].bankHeight - s.xs[n].depth);
+        wsXS_Y[1] = wsXS_Y[0];
+    }
+    else   // otherwise, within the lower trapezoid
+    {
+        wsXS_X[0] = c;
+        wsXS_X[1] = XsPlotX[8] - c;
+        wsXS_Y[0] = -1.5 - (s.xs[n].bankHeight - s.xs[n].depth);
+        wsXS_Y[1] = wsXS_Y[0];
+    }
+
+    // a handful of points, and they move with every step
+    ui->XSectPlot->graph(0)->setData( XsPlotX, XsPlotY );
+    ui->XSectPlot->graph(1)->setData( wsXS_X, wsXS_Y );
+    plotBudget.changed(PLOT_XSECT);
 
-    float timeleft = ( model->rn->endTime.getTime_t() - model->rn->dt ) - ( model->rn->cTime.getTime_t() );
-    if ( timeleft <= 0 )
+    // Hydrograph cursor
+    CursorX[0] = s.hours;
+    CursorX[1] = CursorX[0];
+    CursorY[0] = 0;
+    CursorY[1] = 9999;
+    ui->QwSeries->graph(1)->setData(CursorX, CursorY);
+    plotBudget.changed(PLOT_HYDROGRAPH);
+
+    // Grain size fining plot
+    for ( j = 0; j < 7 && j * 2 < s.gsdCumul.size(); j++ )
+        updateNodeGraph(ui->GSD_Dash->graph(j), s.gsdCumul[j*2], PLOT_GSD);
+    setAxisRange(ui->GSD_Dash->xAxis, 0, nnodes + 1, PLOT_GSD);
+
+    // Grain Size info: 2, 8, 32, 128mm fractions at position 0.2, 0.4, 0.6, 0.8, on the labels
+    // made with the window, shown while the fraction is in range
+    const int psi_index[4] = {4, 6, 8, 10};
+    const double where[4] = {0.2, 0.4, 0.6, 0.8};
+    const double upper[4] = {0.95, 0.9, 0.9, 0.9};
+    for ( j = 0; j < 4; j++ )
     {
-        if ( ui->cycleButton->isChecked())
-        {
-            rn->cTime = wl->Qw[0][0].date_time;
-        }
-    else
+        unsigned int row = (j + 2) * 2;
+        unsigned int at = nnodes * where[j];
+        bool show = row < s.gsdCumul.size() && s.gsdCumul[row][at] > 0.1 && s.gsdCumul[row][at] < upper[j];
+        if (show)
         {
-            dataTimer.stop();
-            ui->runProgress->setValue(100);
-            std::stringstream success_stream;
-            success_stream << "Model Successfully Completed: Check Results File" << std::endl << std::endl;
-            showInfoMessage("End Point Reached", success_stream);
-            delete model;
+            gsdLabels[j]->setText( QString::number(pow(2,s.psi[psi_index[j]])) + " mm");
+            gsdLabels[j]->position->setCoords(nodeX[at], s.gsdCumul[row][at]);
         }
+        if (show || gsdLabels[j]->visible())
+            plotBudget.changed(PLOT_GSD);
+        gsdLabels[j]->setVisible(show);
     }
 
-    if (!ui->pausePlot->isChecked())
+    ui->grateDateTime->setDateTime(QDateTime::fromTime_t(cTime.getTime_t()));
+
+    ui->reportQw->setValue(s.QwCumul[nnodes-1] * s.qwTweak);
+    ui->reportQs->setValue(s.Qs[0]);
+    ui->reportStep->setValue(s.counter);
+
+    ui->spinBankHt->setValue(s.xs[n].bankHeight);
+    ui->spinTheta->setValue(s.xs[n].theta);
+    ui->spinDepth->setValue(s.xs[n].depth);
+    ui->spinWidth->setValue(s.xs[n].width);
+    ui->spinNoChnl->setValue(s.xs[n].noChannels);
+    ui->spinD50->setValue(pow(2, s.dsg[n]));
+    ui->spinDcomp->setValue(s.xs[n].comp_D);
+    ui->spinD90->setValue(pow(2, s.d90[n]));
+    ui->spinHmax->setValue(s.xs[n].Hmax);
+}
+
+// The long profile plots as they were at an earlier step. The history doesn't keep discharge,
+// the upper banks, the grain size distribution or the cross-section, so those are left out.
+void MainWindow::plotHistory(const HistoryFrame &f){
+
+    unsigned int i, n;
+    unsigned int nnodes = f.eta.size();
+    const std::vector<double> none;
+    QVector<double> CursorX( 2 );
+    QVector<double> CursorY( 2 );
+    GrateTime cTime = f.cTime;
+
+    if (nodeX.size() != nnodes)
+        return;
+
+    for ( i = 0; i < nnodes; i++ )
+        series[i] = f.eta[i];
+    updateNodeGraph(ui->VectorPlot->graph(2), series, PLOT_PROFILE);
+    for ( i = 0; i < nnodes; i++ )
+        series[i] = f.eta[i] + (f.wsl[i] - f.eta[i]) * 8;
+    updateNodeGraph(ui->VectorPlot->graph(3), series, PLOT_PROFILE);
+    setAxisRange(ui->VectorPlot->yAxis, round(f.eta[nnodes-1]-10), round(f.eta[1]+20), PLOT_PROFILE);
+
+    for ( i = 0; i < nnodes; i++ )
+        series[i] = f.Qs[i];
+    updateNodeGraph(ui->BedloadPlot->graph(0), series, PLOT_BEDLOAD);
+    updateNodeGraph(ui->BedloadPlot->graph(1), none, PLOT_BEDLOAD);
+    setAxisRange(ui->BedloadPlot->yAxis, 0, f.Qs[3] * 10, PLOT_BEDLOAD);
+
+    double widest = 0;
+    for ( i = 0; i < nnodes; i++ )
     {
+        series[i] = f.width[i]/2;
+        widest = std::max(widest, series[i]);
+    }
+    updateNodeGraph(ui->BankWidthPlot->graph(0), series, PLOT_BANKS);
+    for ( i = 0; i < nnodes; i++ )
+        series[i] = -f.width[i]/2;
+    updateNodeGraph(ui->BankWidthPlot->graph(1), series, PLOT_BANKS);
+    updateNodeGraph(ui->BankWidthPlot->graph(2), none, PLOT_BANKS);
+    updateNodeGraph(ui->BankWidthPlot->graph(3), none, PLOT_BANKS);
+    setAxisRange(ui->BankWidthPlot->yAxis, -widest * 1.5, round(widest * 1.5), PLOT_BANKS);
+
+    // Hydrograph cursor
+    CursorX[0] = f.hours;
+    CursorX[1] = CursorX[0];
+    CursorY[0] = 0;
+    CursorY[1] = 9999;
+    ui->QwSeries->graph(1)->setData(CursorX, CursorY);
+    plotBudget.changed(PLOT_HYDROGRAPH);
+
+    n = std::min<unsigned int>(ui->spinNode->value(), nnodes - 1);
+    ui->grateDateTime->setDateTime(QDateTime::fromTime_t(cTime.getTime_t()));
+    ui->reportQs->setValue(f.Qs[0]);
+    ui->reportStep->setValue(f.counter);
+    ui->spinDepth->setValue(f.wsl[n] - f.eta[n]);
+    ui->spinWidth->setValue(f.width[n]);
+    ui->spinD50->setValue(f.d50[n]);
+}
 
-        // Calculate water profile data points, bank widths
-        for ( i = 0; i < rn -> nnodes; i++ )
-        {
-            x[i] = rn->RiverXS[i].node;
-            eta[i] = rn->eta[i];
-            bedrock[i] = rn->bedrock[i];
-            WSL[i] = rn->eta[i] + rn->RiverXS[i].depth * 8;
-            Froude[i] = rn->ntop[i];               // RiverXS[i].ustar;
-            Bedload[i] = sd->Qs[i];
-
-            LeftBankLower[i] = rn->RiverXS[i].width/2;
-            RightBankLower[i] = -rn->RiverXS[i].width/2;
-            theta_rad = rn->RiverXS[i].theta * PI / 180;
-            LeftBankTop[i] = ( rn->RiverXS[i].width + (2 * ( rn->RiverXS[i].bankHeight - rn->RiverXS[i].Hmax) / tan( theta_rad ) ) ) / 2;
-            RightBankTop[i] = -( rn->RiverXS[i].width + (2 * ( rn->RiverXS[i].bankHeight - rn->RiverXS[i].Hmax) / tan( theta_rad ) ) ) / 2;
-
-            Qw_Plot[i] = wl->QwCumul[i] / 100;
-            for ( j = 0; j < rn->ngsz; j++ )            // Make a cumulative dist
-            {
-                if ( j > 0 )
-                    GSD_Cumul[j][i] = GSD_Cumul[j-1][i];
-                for ( k = 0; k < rn->nlith; k++  )
-                    GSD_Cumul[j][i] += rn->F[i].pct[k][j];
-                if (GSD_Cumul[j][i] < 0.0001)
-                    GSD_Cumul[j][i] = 0;
-            }
-        }
+// The slider runs from the first step in the history to the latest snapshot; all the way to the
+// right, it follows the run
+void MainWindow::updateHistorySlider(unsigned int counter){
 
-        // Setup cross-section graph
-        n = ui->spinNode->value();
-        theta_rad = rn->RiverXS[n].theta * PI / 180;
-        a = rn->RiverXS[n].bankHeight - rn->RiverXS[n].Hmax;  // Vert & Horiz triangle segments at lower channel.
-        c = tan(theta_rad);
-        b = a / c;              // aka dW, horizontal distance between bed and bank, under toe of channel edge
-        inc = 0.5;            // small increment to help with ordering linework.
-
-        XsPlotX[2] = -1.5 * rn->RiverXS[n].fpSlope;
-        XsPlotY[2] = 0;
-        XsPlotX[3] = 0;
-        XsPlotY[3] = -1.5;
-        XsPlotX[4] = 0.001;
-        XsPlotY[4] = -1.5 - rn->RiverXS[n].Hmax;
-        XsPlotX[5] = b;
-        XsPlotY[5] = -1.5 - rn->RiverXS[n].bankHeight;
-        XsPlotX[6] = b + rn->RiverXS[n].width;
-        XsPlotY[6] = XsPlotY[5];
-        XsPlotX[7] = XsPlotX[6] + b;
-        XsPlotY[7] = XsPlotY[4];
-        XsPlotX[8] = XsPlotX[7] + 0.001;
-        XsPlotY[8] = -1.5;
-        XsPlotX[9] = XsPlotX[8] + 1.5;
-        XsPlotY[9] = 0;
-        XsPlotX[10] = XsPlotX[9] + 5 * rn->RiverXS[n].valleyWallSlp;
-        XsPlotY[10] = 5;
-
-        XsPlotX[1] = XsPlotX[2];
-        XsPlotY[1] = 0;
-        XsPlotX[0] = XsPlotX[1] - ( 5 * rn->RiverXS[n].valleyWallSlp );
-        XsPlotY[0] = 5;
-
-        wsXS_Y[0] = rn->RiverXS[n].depth;
-
-        topFp = rn->RiverXS[n].bankHeight + 1.5;
-        if (rn->RiverXS[n].depth > topFp)
-        {
-            ovFp = rn->RiverXS[n].depth - topFp;
-            ovBank = 1.5;
-            wsXS_X[0] = XsPlotX[1] - ( ovFp * rn->RiverXS[n].valleyWallSlp );
-            wsXS_X[1] = XsPlotX[9] + ( ovFp * rn->RiverXS[n].valleyWallSlp );
-            wsXS_Y[0] = ovFp;               // Floodplain elev. is '0' datum
-            wsXS_Y[1] = wsXS_Y[0];
-        }
-        else if (rn->RiverXS[n].depth > rn->RiverXS[n].bankHeight)
-        {
-            ovBank = rn->RiverXS[n].depth - rn->RiverXS[n].bankHeight;
-            wsXS_X[0] = - ( ovBank * rn->RiverXS[n].fpSlope );
-            wsXS_X[1] = XsPlotX[8] + ovBank;
-            wsXS_Y[0] = -1.5 + ovBank;
-            wsXS_Y[1] = wsXS_Y[0];
-        }
-        else if (rn->RiverXS[n].depth > a)   // 'a' is computed, above, as bottom of vertical banks
-        {
-            wsXS_X[0] = 0;
-            wsXS_X[1] = XsPlotX[8];
-            wsXS_Y[0] = -1.5 - (rn->RiverXS[n].bankHeight - rn->RiverXS[n].depth);
-            wsXS_Y[1] = wsXS_Y[0];
-        }
-        else   // otherwise, within the lower trapezoid
-        {
-            wsXS_X[0] = c;
-            wsXS_X[1] = XsPlotX[8] - c;
-            wsXS_Y[0] = -1.5 - (rn->RiverXS[n].bankHeight - rn->RiverXS[n].depth);
-            wsXS_Y[1] = wsXS_Y[0];
-        }
+    std::shared_ptr<const HistoryFrame> first = history->first();
+    QSlider *slider = ui->historySlider;
+    bool following = slider->value() == slider->maximum();
+    QSignalBlocker block(slider);
 
-        // Grain size fining plot
-
-        for ( j = 0; j < 7 ; j++ )
-            for ( i = 0; i < rn -> nnodes; i++ )
-                    GSD_Data[j][i] = GSD_Cumul[j*2][i];
-
-        // t = ui->selectNode->value();
-
-        // Longitudinal Plot
-
-        CursorX[0] = ( wl->Qw[0][0].date_time.secsTo(rn->cTime) / 3600.);
-        CursorX[1] = CursorX[0];
-        CursorY[0] = 0;
-        CursorY[1] = 9999;
-
-        ui->VectorPlot->graph(2)->clearData();
-        ui->VectorPlot->graph(2)->setData(x, eta);
-        ui->VectorPlot->graph(3)->clearData();
-        ui->VectorPlot->graph(3)->setData(x, WSL);
-        //ui->VectorPlot->graph(1)->setPen(QPen(QColor(rand() % 254, rand() % 254, rand() % 254)));
-        ui->VectorPlot->xAxis->setLabel("Distance Downstream");
-        ui->VectorPlot->yAxis->setLabel("Elevation");
-        ui->VectorPlot->xAxis->setRange(0,rn->nnodes + 1);
-        ui->VectorPlot->yAxis->setRange(round(rn->eta[rn->nnodes-1]-10), round(rn->eta[1]+20));
-        //ui->VectorPlot->setRangeDrag(Qt::Horizontal|Qt::Vertical);
-        //ui->VectorPlot->setRangeZoom(Qt::Horizontal|Qt::Vertical);
-
-        ui->BedloadPlot->graph(0)->clearData();
-        ui->BedloadPlot->graph(0)->setData( x, Bedload );
-        ui->BedloadPlot->graph(0)->setBrush(QColor(255, 161, 0, 50));
-        ui->BedloadPlot->graph(0)->setChannelFillGraph(nullptr);
-        ui->BedloadPlot->graph(1)->clearData();
-        ui->BedloadPlot->graph(1)->setData( x, Qw_Plot );
-
-        ui->BedloadPlot->xAxis->setLabel("Distance Downstream");
-        ui->BedloadPlot->yAxis->setLabel("Qs, Qw Discharge");
-        ui->BedloadPlot->xAxis->setRange(0, rn->nnodes + 1);
-        ui->BedloadPlot->yAxis->setRange(0, Bedload[3] * 10 ); //round(*max_element(Bedload.constBegin(), Bedload.constEnd()) * 1.5));
-
-        ui->BankWidthPlot->graph(0)->clearData();
-        ui->BankWidthPlot->graph(0)->setData( x, LeftBankLower );
-        ui->BankWidthPlot->graph(1)->clearData();
-        ui->BankWidthPlot->graph(1)->setData( x, RightBankLower );
-        ui->BankWidthPlot->graph(2)->clearData();
-        ui->BankWidthPlot->graph(2)->setData( x, LeftBankTop );
-        ui->BankWidthPlot->graph(3)->clearData();
-        ui->BankWidthPlot->graph(3)->setData( x, RightBankTop );
-
-        ui->BankWidthPlot->xAxis->setLabel("Distance Downstream");
-        ui->BankWidthPlot->yAxis->setLabel("Bank Width");
-        ui->BankWidthPlot->xAxis->setRange(0,rn->nnodes + 1);
-        ui->BankWidthPlot->yAxis->setRange( ( *min_element(RightBankLower.constBegin(), RightBankLower.constEnd()) * 1.5),
-                  ( round(*max_element(LeftBankLower.constBegin(), LeftBankLower.constEnd()) * 1.5 ) ) );
-
-        ui->XSectPlot->xAxis->setRange( -20, 120 );
-        ui->XSectPlot->yAxis->setRange( -7, 7 );
-        ui->XSectPlot->graph(0)->clearData();
-        ui->XSectPlot->graph(0)->setData( XsPlotX, XsPlotY );
-        ui->XSectPlot->graph(1)->clearData();
-        ui->XSectPlot->graph(1)->setData( wsXS_X, wsXS_Y );
-
-        ui->QwSeries->graph(1)->clearData();
-        ui->QwSeries->graph(1)->setData(CursorX, CursorY);
-
-        // Grain Size info
-
-        //2, 8, 32, 128mm fractions at position 0.2, 0.4, 0.6, 0.8
-        if ((GSD_Data[2][rn->nnodes*0.2] > 0.1) && (GSD_Data[2][rn->nnodes*0.2] < 0.95))    // 2mm label
-        {
-            PSI4Label->setText( QString::number(pow(2,rn->F[0].psi[4])) + " mm");
-            PSI4Label->position->setCoords(x[int(rn->nnodes*0.2)], GSD_Data[2][int(rn->nnodes*0.2)]);
-            PSI4Label->setBrush(QColor(255, 255, 255, 127));
-        }
-        if ((GSD_Data[3][int(rn->nnodes*0.4)] > 0.1) && (GSD_Data[3][int(rn->nnodes*0.4)] < 0.9))    // 8mm label
-        {
-            PSI6Label->setText( QString::number(pow(2,rn->F[0].psi[6])) + " mm");
-            PSI6Label->position->setCoords(x[int(rn->nnodes*0.4)], GSD_Data[3][int(rn->nnodes*0.4)]);
-            PSI6Label->setBrush(QColor(255, 255, 255, 127));
-        }
-        if ((GSD_Data[4][int(rn->nnodes*0.6)] > 0.1) && (GSD_Data[4][int(rn->nnodes*0.6)] < 0.9))    // 32mm label
-        {
-            PSI8Label->setText( QString::number(pow(2,rn->F[0].psi[8])) + " mm");
-            PSI8Label->position->setCoords(x[int(rn->nnodes*0.6)], GSD_Data[4][int(rn->nnodes*0.6)]);
-            PSI8Label->setBrush(QColor(255, 255, 255, 127));
-        }
-        if ((GSD_Data[5][int(rn->nnodes*0.8)] > 0.1) && (GSD_Data[5][int(rn->nnodes*0.8)] < 0.9))    // 128mm label
+    slider->setRange(first ? first->counter : counter, counter);
+    if (following)
+        slider->setValue(counter);
+}
+
+// The slider moved: draw the step it points to, or the latest snapshot at the right-hand end
+void MainWindow::scrubHistory(){
+
+    if (!history)
+        return;
+
+    QSlider *slider = ui->historySlider;
+    if (slider->value() == slider->maximum())
+    {
+        if (viewing && shown)
+            plotSnapshot(*shown);
+        viewing.reset();
+    }
+    else
+    {
+        std::shared_ptr<const HistoryFrame> f = history->at(slider->value());
+        if (f && f != viewing)
         {
-            PSI10Label->setText( QString::number(pow(2,rn->F[0].psi[10])) + " mm");
-            PSI10Label->position->setCoords(x[int(rn->nnodes*0.8)], GSD_Data[5][int(rn->nnodes*0.8)]);
-            PSI10Label->setBrush(QColor(255, 255, 255, 127));
+            viewing = f;
+            plotHistory(*f);
         }
+    }
+    replotDue();
+}
+
+// Redraws the plots that changed, as many as fit in the frame's budget
+void MainWindow::replotDue(){
 
-        //ui->GSD_Dash->graph(0)->clearData();
-        ui->GSD_Dash->graph(0)->setData( x, GSD_Data[0] );
-        ui->GSD_Dash->graph(1)->setData( x, GSD_Data[1] );
-        ui->GSD_Dash->graph(2)->setData( x, GSD_Data[2] );
-        ui->GSD_Dash->graph(3)->setData( x, GSD_Data[3] );
-        ui->GSD_Dash->graph(4)->setData( x, GSD_Data[4] );
-        ui->GSD_Dash->graph(5)->setData( x, GSD_Data[5] );
-        ui->GSD_Dash->graph(6)->setData( x, GSD_Data[6] );
-        ui->GSD_Dash->graph(0)->setPen(QPen(QColor(0,0,0)));  // 0 is the finest grain size category: black
-        for ( i = 1; i < 7 ; i++ )
-               ui->GSD_Dash->graph(i)->setPen(QPen(QColor((i * 30), 254 - (i * 30), 113)));
-
-        ui->GSD_Dash->xAxis->setRange(0, rn->nnodes + 1);
-        ui->GSD_Dash->yAxis->setRange(0, 1);
-
-        ui->VectorPlot->replot();
-        ui->BankWidthPlot->replot();
-        ui->XSectPlot->replot();
-        ui->BedloadPlot->replot();
-        ui->QwSeries->replot();
-        ui->GSD_Dash->replot();
-        ui->grateDateTime->setDateTime(QDateTime::fromTime_t(rn->cTime.getTime_t()));
-
-        ui->reportQw->setValue(wl->QwCumul[rn->nnodes-1] * rn->qwTweak);
-        ui->reportQs->setValue(sd->Qs[0]);
-        ui->reportStep->setValue(rn->counter);
-        //ui->reportYear->setValue(rn->yearCounter);
-
-        ui->spinBankHt->setValue(rn->RiverXS[n].bankHeight);
-        ui->spinTheta->setValue(rn->RiverXS[n].theta);
-        ui->spinDepth->setValue(rn->RiverXS[n].depth);
-        ui->spinWidth->setValue(rn->RiverXS[n].width);
-        ui->spinNoChnl->setValue(rn->RiverXS[n].noChannels);
-        ui->spinD50->setValue(pow(2, rn->F[n].dsg));
-        ui->spinDcomp->setValue(rn->RiverXS[n].comp_D);
-        ui->spinD90->setValue(pow(2, rn->F[n].d90));
-        ui->spinHmax->setValue(rn->RiverXS[n].Hmax);
-
-    }  // End 'Pause Plot' statement
-
-    // Update Regime switch
-
-    rn->regimeFlag = ui->RegimeButton->isChecked();   // '1' means regime routine is on, else '0'
+    std::vector<int> due = plotBudget.due();
+    for ( unsigned int i = 0; i < due.size(); i++ )
+    {
+        QElapsedTimer timer;
+        timer.start();
+        plots[due[i]]->replot();
+        plotBudget.drawn(due[i], timer.nsecsElapsed() / 1e9);
+    }
 }
 
-void MainWindow::modelHalt(){    // Graceful exit, here?
+// the run is over: the runner's thread has finished with the model
+void MainWindow::endRun(){
     dataTimer.stop();
-    delete model;
+    if (runner != NULL) {
+        runner->stop();
+        delete runner;
+        runner = NULL;
+    }
+    if (initialised) {
+        delete model;
+        initialised = false;
+    }
+}
+
+void MainWindow::modelHalt(){    // Graceful exit: the step in progress finishes first
+    endRun();
 }
 
 void MainWindow::updateProgress(){
 
-    RiverProfile* rn = model->rn;
     // Progress bar
-    double i = rn->startTime.secsTo(rn->cTime);
-    double j = rn->startTime.secsTo(rn->endTime);
-    double prog = ( i / j ) * 100.;
-    if (prog < 100.)
-        ui->runProgress->setValue(prog);
+    if (shown && shown->progress < 100.)
+        ui->runProgress->setValue(shown->progress);
 }
 
 MainWindow::~MainWindow()
 {
+    endRun();
     delete ui;
-    if (initialised) {
-        delete model;
-    }
 }
@@ -9,6 +9,11 @@
 #include "hydro.h"
 #include "sed.h"
 #include "model.h"
+#include "modelrunner.h"
+#include "plotframe.h"
+#include "runhistory.h"
+#include <memory>
+#include <vector>
 
 #include <QtCore>
 #include <QWidget>
@@ -30,7 +35,8 @@ public:
 public slots:
     void kernel();
     void loadXML();
-    void modelUpdate();
+    void drawSnapshot();
+    void scrubHistory();
     void modelHalt();
     void updateProgress();
 
@@ -41,13 +47,45 @@ signals:
 private:
     void showErrorMessage(const char *title, std::stringstream &msg_stream);
     void showInfoMessage(const char *title, std::stringstream &msg_stream);
+    enum PlotId {
+        PLOT_PROFILE,                          // VectorPlot
+        PLOT_BEDLOAD,                          // BedloadPlot
+        PLOT_BANKS,                            // BankWidthPlot
+        PLOT_XSECT,                            // XSectPlot
+        PLOT_HYDROGRAPH,                       // QwSeries
+        PLOT_GSD,                              // GSD_Dash
+        N_PLOTS
+    };
+
+    RunControls readControls();
+    void styleRunPlots();
+    void plotSnapshot(const ModelSnapshot &s);
+    void plotHistory(const HistoryFrame &f);
+    void updateHistorySlider(unsigned int counter);
+    void updateNodeGraph(QCPGraph *graph, const std::vector<double> &values, int plot);
+    void setAxisRange(QCPAxis *axis, double lower, double upper, int plot);
+    void replotDue();
+    void endRun();
     Ui::MainWindow *ui;
     Model *model;
     QString demoName;
-    QTimer dataTimer;
+    QTimer dataTimer;                          // Draws the latest snapshot, once per screen refresh
     QCPItemTracer *itemDemoPhaseTracer;
     int currentDemoIndex;
     bool initialised;
+    ModelRunner *runner;                       // Steps the model on its own thread while it runs
+    std::shared_ptr<const ModelSnapshot> shown;
+    QCustomPlot *plots[N_PLOTS];
+    FrameBudget plotBudget;                    // Which changed plots to redraw in each frame
+    QCPItemText *gsdLabels[4];                 // Grain sizes on the GSD plot
+    std::vector<double> nodeX;                 // Working arrays, kept between frames
+    std::vector<double> series;
+    std::vector<double> lodX;
+    std::vector<double> lodY;
+    size_t historyDepth;                       // --history-depth: frames the run history keeps
+    unsigned int historyStride;                // --history-stride: steps between its frames
+    std::unique_ptr<RunHistory> history;       // Of the last run started, kept after it ends
+    std::shared_ptr<const HistoryFrame> viewing;    // The frame drawn, NULL while following the run
 };
 
 
@@ -0,0 +1,86 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+#ifdef _WIN32
+#include <fstream>
+#include <iterator>
+#include <vector>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+// A whole file, mapped read-only where the platform allows and read into memory elsewhere.
+// data is NULL if the file can't be opened or is empty.
+class MappedFile
+{
+public:
+
+    explicit MappedFile(const std::string &fileName) : data(NULL), size(0)
+    {
+#ifdef _WIN32
+        std::ifstream in(fileName, std::ios::in | std::ios::binary);
+        if (in)
+        {
+            copy.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            data = copy.data();
+            size = copy.size();
+        }
+#else
+        mapped = NULL;
+        int fd = open(fileName.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED)
+            {
+                mapped = p;
+                data = static_cast<const char*>(p);
+                size = st.st_size;
+            }
+        }
+        close(fd);
+#endif
+    }
+
+    ~MappedFile()
+    {
+#ifndef _WIN32
+        if (mapped != NULL)
+            munmap(mapped, size);
+#endif
+    }
+
+    // Tell the kernel the file will be read front to back, so it reads ahead and drops pages behind
+    void sequential()
+    {
+#ifndef _WIN32
+        if (mapped != NULL)
+            madvise(mapped, size, MADV_SEQUENTIAL);
+#endif
+    }
+
+    const char *data;
+    size_t size;
+
+private:
+#ifdef _WIN32
+    std::vector<char> copy;
+#else
+    void *mapped;
+#endif
+
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+};
+
+#endif // MAPPEDFILE_H
@@ -2,35 +2,118 @@
 #include "riverprofile.h"
 #include "hydro.h"
 #include "sed.h"
+#include "checkpoint.h"
+#include "results.h"
+#include "grateerror.h"
 #include "tinyxml2/tinyxml2.h"
 #include <iostream>
 #include <fstream>
+#include <ciso646>
 
 using namespace tinyxml2;
 
-Model::Model(XMLElement* params_root, string out1) :
-    rn(nullptr), wl(nullptr), sd(nullptr)
+static ModelSetup setupFromXml(XMLElement* params_root) {
+    ModelSetup setup;
+    readSetup(params_root, setup);
+    return setup;
+}
+
+Model::Model(XMLElement* params_root, string out1, ostream *logSink, const string &restartFile) :
+    Model(setupFromXml(params_root), out1, logSink, restartFile)
 {
-    rn = new RiverProfile(params_root);  // Long profile, channel geometry
-    wl = new hydro(rn, params_root);  // Channel hydraulic parameters
-    sd = new sed(rn, params_root);
+}
 
-    // initialise
-    rn->cTime = wl->Qw[0][0].date_time;
-    rn->startTime = wl->Qw[0][0].date_time;
-    rn->endTime = wl->Qw[0][wl->Qw[0].size() - 1].date_time;
-    rn->writeInterval = 100;  // CDJS: set to something small to get output for checking results
-    rn->outputFile = out1;
-    writeResults(0);
+Model::Model(const ModelSetup &setup, string out1, ostream *logSink, const string &restartFile) :
+    rn(nullptr), wl(nullptr), sd(nullptr), checkpointInterval(0)
+{
+    build(setup, out1, logSink);
+
+    try {
+        if (restartFile.empty()) {
+            openResults(false);
+            writeResults(true);
+        }
+        else {
+            readCheckpoint(*this, restartFile);     // also cuts the results back to the checkpoint
+            openResults(true);
+        }
+    }
+    catch (...) {
+        destroy();
+        throw;
+    }
 }
 
-Model::~Model() {
+Model::Model(XMLElement* params_root, string out1, ostream *logSink, const Model &snapshot) :
+    rn(nullptr), wl(nullptr), sd(nullptr), checkpointInterval(0)
+{
+    build(setupFromXml(params_root), out1, logSink);
+
+    try {
+        copyModelState(snapshot, *this);
+        openResults(false);
+        writeResults(true);             // results start at the fork point
+    }
+    catch (...) {
+        destroy();
+        throw;
+    }
+}
+
+void Model::build(const ModelSetup &setup, string out1, ostream *logSink) {
+    try {
+        rn = new RiverProfile(setup, logSink);  // Long profile, channel geometry
+        wl = new hydro(rn, setup);  // Channel hydraulic parameters
+        sd = new sed(rn, setup);
+
+        // initialise
+        rn->cTime = wl->Qw[0][0].date_time;
+        rn->startTime = wl->Qw[0][0].date_time;
+        rn->endTime = wl->Qw[0][wl->Qw[0].size() - 1].date_time;
+        rn->writeInterval = 100;  // CDJS: set to something small to get output for checking results
+        rn->outputFile = out1;
+
+        // the OUTPUT element is kept as xml in the setup
+        XMLDocument outputDoc;
+        XMLElement *outElem = NULL;
+        if (not setup.output.empty()) {
+            if (outputDoc.Parse(setup.output.c_str(), setup.output.size()) != XML_SUCCESS)
+                throw GrateError("Error reading OUTPUT element");
+            outElem = outputDoc.FirstChildElement("OUTPUT");
+        }
+        bool legacy;
+        outputs = readOutputStreams(outElem, rn, out1, legacy);
+        if (legacy)
+            outputs.insert(outputs.begin(), legacyStream(rn, out1));
+    }
+    catch (...) {
+        // don't leak the components that were built before the error
+        destroy();
+        throw;
+    }
+}
+
+void Model::destroy() {
+    for (unsigned int s = 0; s < outputs.size(); s++)
+        delete outputs[s];
+    outputs.clear();
     delete rn;
     delete wl;
     delete sd;
+    rn = nullptr;
+    wl = nullptr;
+    sd = nullptr;
 }
 
-void Model::iteration() {
+Model::~Model() {
+    destroy();
+}
+
+bool Model::iteration() {
+    if (rn->diag.failed())
+        return false;                   // state is not trustworthy after a solver error
+
+    ScopedTimer timer(rn->timings, PHASE_STEP);
     wl->backWater(rn);
     sd->computeTransport(rn);
     stepTime();
@@ -39,9 +122,51 @@ void Model::iteration() {
     if ( ( rn->regimeFlag == 1 ) && (rn->counter % 4 == 0) && ( rn->qwTweak < 1 ) )
             wl->setRegimeWidth(rn);         // kick off regime restraints, once hydraulics are working
 
-    if (rn->counter % rn->writeInterval == 0) {
-        writeResults(rn->counter);
+    {
+        ScopedTimer results(rn->timings, PHASE_RESULTS);
+        writeResults(false);
+    }
+
+    // checkpoint after the results, so the saved file length includes this step's output
+    if (checkpointInterval > 0 && rn->counter % checkpointInterval == 0 && not rn->diag.failed()) {
+        ScopedTimer checkpoint(rn->timings, PHASE_CHECKPOINT);
+        writeCheckpoint(*this, checkpointFile);
+    }
+
+    return not rn->diag.failed();
+}
+
+const Diagnostics &Model::status() const {
+    return rn->diag;
+}
+
+const PhaseTimes &Model::timings() const {
+    return rn->timings;
+}
+
+SolverStats Model::takeSolverStats() {
+    SolverStats stats = rn->solvers;
+    rn->solvers.clear();
+    return stats;
+}
+
+void Model::asyncResults() {
+    for (unsigned int s = 0; s < outputs.size(); s++)
+        outputs[s]->writer = new AsyncResultsWriter(outputs[s]->writer);
+}
+
+void Model::flushResults() {
+    for (unsigned int s = 0; s < outputs.size(); s++)
+        outputs[s]->writer->flush();
+}
+
+vector<string> Model::resultsFiles() const {
+    vector<string> files;
+    for (unsigned int s = 0; s < outputs.size(); s++) {
+        vector<string> f = outputs[s]->writer->files();
+        files.insert(files.end(), f.begin(), f.end());
     }
+    return files;
 }
 
 void Model::stepTime(){
@@ -53,104 +178,18 @@ void Model::stepTime(){
     //}
 }
 
-void Model::writeResults(int count){
-
-    int i = 0;
+void Model::openResults(bool resume) {
+    for (unsigned int s = 0; s < outputs.size(); s++)
+        outputs[s]->writer->open(outputs[s]->layout(rn), resume);
+}
 
-    if (count == 0)
-    {
-        ofstream outDatFile;
-        outDatFile.open(rn->outputFile);
-
-        outDatFile << "Output file for program Grate_NESI" << '\n' <<
-        "there are twenty-four columns in the output.  they are:" << '\n' <<
-        "column no. 1:  X coordinates in meters" << '\n' <<
-        "column no. 2:  Bed elevation in meters"  << '\n' <<
-        "column no. 3:  Flow depth in meters"  << '\n' <<
-        "column no. 4:  Channel width (m)"  << '\n' <<
-        "column no. 5:  Channel theta (deg)"  << '\n' <<
-        "column no. 6:  Number of channels"  << '\n' <<
-        "column no. 7:  Geometric mean grain size (mm) below the surface layer"  << '\n' <<
-        "column no. 8:  Geometric mean grain size (mm) of the surface layer"  << '\n' <<
-        "column no. 9:  Standard deviation at the same position."  << '\n' <<
-        "column no. 10:  Sediment transport rate (m2/s)"  << '\n' <<
-        "column no. 11:  Sand percentage (Fs)"  << '\n' <<
-        "column no. 12-24: Surface grain size matrix (12 classes)"  << '\n' <<
-        "qwTweak = " << rn->qwTweak << '\n' <<
-        "qsTweak = " << rn->qsTweak << '\n' <<
-        "substrDial = " << rn->substrDial << '\n' <<
-        "feedQw = " << rn->feedQw << '\n' <<
-        "feedQs = " << rn->feedQs << '\n' <<
-        "HmaxTweak = " << rn->HmaxTweak << '\n' <<
-        "randAbr = " << rn->randAbr << '\n' <<
-        "" << '\n';
-        
-        outDatFile << '\n';
-        outDatFile << "Count:  " << rn->counter << '\n';
-
-        for ( i = 0; i < rn->nnodes; i++ )
-        {
-            outDatFile << rn->xx[i] << '\t' <<
-            rn->eta[i] << '\t' <<
-            rn->RiverXS[i].depth << '\t' <<
-            rn->RiverXS[i].width << '\t' <<
-            rn->RiverXS[i].theta << '\t' <<
-            rn->RiverXS[i].noChannels << '\t' <<
-            rn->storedf[i][rn->ntop[i]].dsg << '\t' <<
-            rn->F[i].dsg << '\t' <<
-            rn->F[i].stdv << '\t' <<
-            sd->Qs[i] << '\t' <<
-            rn->F[i].sand_pct << '\t' <<
-            rn->F[i].pct[0][0] + rn->F[i].pct[1][0] + rn->F[i].pct[2][0] << '\t' <<
-            rn->F[i].pct[0][1] + rn->F[i].pct[1][1] + rn->F[i].pct[2][1] << '\t' <<
-            rn->F[i].pct[0][2] + rn->F[i].pct[1][2] + rn->F[i].pct[2][2] << '\t' <<
-            rn->F[i].pct[0][3] + rn->F[i].pct[1][3] + rn->F[i].pct[2][3] << '\t' <<
-            rn->F[i].pct[0][4] + rn->F[i].pct[1][4] + rn->F[i].pct[2][4] << '\t' <<
-            rn->F[i].pct[0][5] + rn->F[i].pct[1][5] + rn->F[i].pct[2][5] << '\t' <<
-            rn->F[i].pct[0][6] + rn->F[i].pct[1][6] + rn->F[i].pct[2][6] << '\t' <<
-            rn->F[i].pct[0][7] + rn->F[i].pct[1][7] + rn->F[i].pct[2][7] << '\t' <<
-            rn->F[i].pct[0][8] + rn->F[i].pct[1][8] + rn->F[i].pct[2][8] << '\t' <<
-            rn->F[i].pct[0][9] + rn->F[i].pct[1][9] + rn->F[i].pct[2][9] << '\t' <<
-            rn->F[i].pct[0][10] + rn->F[i].pct[1][10] + rn->F[i].pct[2][10] << '\t' <<
-            rn->F[i].pct[0][11] + rn->F[i].pct[1][11] + rn->F[i].pct[2][11] << '\t' <<
-            rn->F[i].pct[0][12] + rn->F[i].pct[1][12] + rn->F[i].pct[2][12] << '\n';
+void Model::writeResults(bool all) {
+    for (unsigned int s = 0; s < outputs.size(); s++) {
+        OutputStream *o = outputs[s];
+        int interval = (o->interval > 0) ? o->interval : rn->writeInterval;
+        if (all || rn->counter % interval == 0) {
+            o->capture(rn, sd, o->writer->buffer());
+            o->writer->commit();
         }
-        outDatFile << '\n';
-    }
-    else   // append records
-    {
-        ofstream outDatFile;
-        outDatFile.open(rn->outputFile, ios::out | ios::app);
-
-        outDatFile << "Count:  " << rn->counter << '\n';
-
-		for ( i = 0; i < rn->nnodes; i++ )
-		{
-		    outDatFile << rn->xx[i] << '\t' <<
-			rn->eta[i] << '\t' <<
-			rn->RiverXS[i].depth << '\t' <<
-			rn->RiverXS[i].width << '\t' <<
-			rn->RiverXS[i].theta << '\t' <<
-            rn->RiverXS[i].noChannels << '\t' <<
-			rn->storedf[i][rn->ntop[i]].dsg << '\t' <<
-			rn->F[i].dsg << '\t' <<
-			rn->F[i].stdv << '\t' <<
-			sd->Qs[i] << '\t' <<
-			rn->F[i].sand_pct << '\t' <<
-			rn->F[i].pct[0][0] + rn->F[i].pct[1][0] + rn->F[i].pct[2][0] << '\t' <<
-			rn->F[i].pct[0][1] + rn->F[i].pct[1][1] + rn->F[i].pct[2][1] << '\t' <<
-			rn->F[i].pct[0][2] + rn->F[i].pct[1][2] + rn->F[i].pct[2][2] << '\t' <<
-			rn->F[i].pct[0][3] + rn->F[i].pct[1][3] + rn->F[i].pct[2][3] << '\t' <<
-			rn->F[i].pct[0][4] + rn->F[i].pct[1][4] + rn->F[i].pct[2][4] << '\t' <<
-			rn->F[i].pct[0][5] + rn->F[i].pct[1][5] + rn->F[i].pct[2][5] << '\t' <<
-			rn->F[i].pct[0][6] + rn->F[i].pct[1][6] + rn->F[i].pct[2][6] << '\t' <<
-			rn->F[i].pct[0][7] + rn->F[i].pct[1][7] + rn->F[i].pct[2][7] << '\t' <<
-			rn->F[i].pct[0][8] + rn->F[i].pct[1][8] + rn->F[i].pct[2][8] << '\t' <<
-			rn->F[i].pct[0][9] + rn->F[i].pct[1][9] + rn->F[i].pct[2][9] << '\t' <<
-			rn->F[i].pct[0][10] + rn->F[i].pct[1][10] + rn->F[i].pct[2][10] << '\t' <<
-			rn->F[i].pct[0][11] + rn->F[i].pct[1][11] + rn->F[i].pct[2][11] << '\t' <<
-			rn->F[i].pct[0][12] + rn->F[i].pct[1][12] + rn->F[i].pct[2][12] << '\n';
-		}
-        outDatFile << '\n';
     }
 }
@@ -4,24 +4,45 @@
 #include "riverprofile.h"
 #include "hydro.h"
 #include "sed.h"
+#include "results.h"
+#include "setup.h"
 #include "tinyxml2/tinyxml2.h"
 
 using namespace tinyxml2;
 
 class Model {
     public:
-        Model(XMLElement* params_root, string out1);
+        Model(XMLElement* params_root, string out1, ostream *logSink = &cout,
+              const string &restartFile = "");  // continue from a checkpoint instead of starting afresh
+        Model(const ModelSetup &setup, string out1, ostream *logSink = &cout,
+              const string &restartFile = "");  // from an input already read, e.g. a setup cache
+        Model(XMLElement* params_root, string out1, ostream *logSink,
+              const Model &snapshot);          // fork: this input's settings, the snapshot's state
         ~Model();
-        void iteration();
+        bool iteration();                      // returns false once a solver error has been reported
+
+        const Diagnostics &status() const;     // solver status and messages for this instance
+        const PhaseTimes &timings() const;     // time spent in each phase of the step so far
+        SolverStats takeSolverStats();         // solver convergence counters since the last call
+
+        void asyncResults();                   // write results on a separate thread from now on
+        void flushResults();                   // everything written so far is on disk
+        vector<string> resultsFiles() const;   // every results file, in a fixed order
 
         RiverProfile *rn;
         hydro *wl;
         sed *sd;
+        vector<OutputStream*> outputs;         // main results file and any streams from the OUTPUT element
         int writeInterval;
+        int checkpointInterval;                // steps between checkpoints, 0 for none
+        string checkpointFile;
 
     private:
+        void build(const ModelSetup &setup, string out1, ostream *logSink);
+        void destroy();
         void stepTime();
-        void writeResults(int count);
+        void openResults(bool resume);
+        void writeResults(bool all);           // all streams, or those due at this step
 };
 
 #endif
@@ -0,0 +1,194 @@
+/*******************
+ *
+ *
+ *  GRATE 9
+ *
+ *  Model runner: steps a model on its own thread and publishes snapshots of it for drawing
+ *
+ *
+ *
+*********************/
+
+#include "modelrunner.h"
+#include "model.h"
+#include <ciso646>
+#include <cmath>
+
+
+ModelRunner::ModelRunner(Model *model, std::chrono::steady_clock::duration interval, RunHistory *history)
+    : model(model), interval(interval), history(history), active(false), stopping(false), snapshots(0)
+{
+}
+
+ModelRunner::~ModelRunner()
+{
+    stop();
+}
+
+void ModelRunner::start(const RunControls &c)
+{
+    if (worker.joinable())
+        return;
+    controls = c;
+    stopping.store(false);
+    active.store(true, std::memory_order_release);
+    publish(RUN_RUNNING);
+    record();
+    worker = std::thread(&ModelRunner::run, this);
+}
+
+void ModelRunner::stop()
+{
+    if (not worker.joinable())
+        return;
+    stopping.store(true);
+    worker.join();
+}
+
+void ModelRunner::setControls(const RunControls &c)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    controls = c;
+}
+
+std::shared_ptr<const ModelSnapshot> ModelRunner::latest() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return current;
+}
+
+void ModelRunner::run()
+{
+    RiverProfile *rn = model->rn;
+    std::chrono::steady_clock::time_point last = std::chrono::steady_clock::now();
+    int state = RUN_RUNNING;
+    std::string error;
+
+    while (not stopping.load(std::memory_order_relaxed))
+    {
+        if (not model->iteration())
+        {
+            state = RUN_FAILED;
+            error = model->status().lastError();
+            break;
+        }
+
+        // as the GUI did after each step: its settings, then the end of the flow record
+        apply();
+        double timeleft = double(rn->endTime.getTime_t() - rn->dt) - double(rn->cTime.getTime_t());
+        if (timeleft <= 0)
+        {
+            bool cycle;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                cycle = controls.cycle;
+            }
+            if (not cycle)
+            {
+                state = RUN_FINISHED;
+                break;
+            }
+            rn->cTime = model->wl->Qw[0][0].date_time;
+        }
+        record();
+
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now - last >= interval)
+        {
+            publish(RUN_RUNNING);
+            last = now;
+        }
+    }
+
+    // the state the model was left in, for the GUI to draw last
+    publish(state, error);
+    active.store(false, std::memory_order_release);
+}
+
+void ModelRunner::apply()
+{
+    RunControls c;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        c = controls;
+    }
+    RiverProfile *rn = model->rn;
+    rn->dt = c.dt;
+    rn->writeInterval = c.writeInterval;
+    rn->sedUpw = c.sedUpw;
+    rn->hydroUpw = c.hydroUpw;
+    rn->regimeFlag = c.regime;
+}
+
+void ModelRunner::publish(int state, const std::string &error)
+{
+    RiverProfile *rn = model->rn;
+    hydro *wl = model->wl;
+    std::shared_ptr<ModelSnapshot> s(new ModelSnapshot);
+    unsigned int nnodes = rn->nnodes;
+
+    s->state = state;
+    s->error = error;
+    s->counter = rn->counter;
+    s->cTime = rn->cTime;
+    s->hours = wl->Qw[0][0].date_time.secsTo(rn->cTime) / 3600.;
+    long span = rn->startTime.secsTo(rn->endTime);
+    s->progress = span > 0 ? 100. * rn->startTime.secsTo(rn->cTime) / span : 100.;
+    s->qwTweak = rn->qwTweak;
+
+    s->xs = rn->RiverXS;
+    s->eta = rn->eta;
+    s->bedrock = rn->bedrock;
+    s->ntop.assign(rn->ntop.begin(), rn->ntop.end());
+    s->Qs = model->sd->Qs;
+    s->QwCumul = wl->QwCumul;
+    s->dsg.resize(nnodes);
+    s->d90.resize(nnodes);
+    s->gsdCumul.assign(rn->ngsz, std::vector<double>(nnodes, 0.));
+    for (unsigned int i = 0; i < nnodes; i++)
+    {
+        s->dsg[i] = rn->F[i].dsg;
+        s->d90[i] = rn->F[i].d90;
+        for (unsigned int j = 0; j < rn->ngsz; j++)            // Make a cumulative dist
+        {
+            if (j > 0)
+                s->gsdCumul[j][i] = s->gsdCumul[j-1][i];
+            for (unsigned int k = 0; k < rn->nlith; k++)
+                s->gsdCumul[j][i] += rn->F[i].pct[k][j];
+            if (s->gsdCumul[j][i] < 0.0001)
+                s->gsdCumul[j][i] = 0;
+        }
+    }
+    s->psi = rn->F[0].psi;
+
+    std::lock_guard<std::mutex> guard(lock);
+    current = s;
+    snapshots.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ModelRunner::record()
+{
+    RiverProfile *rn = model->rn;
+    if (history == NULL || not history->wants(rn->counter))
+        return;
+
+    std::shared_ptr<HistoryFrame> f(new HistoryFrame);
+    unsigned int nnodes = rn->nnodes;
+    f->counter = rn->counter;
+    f->cTime = rn->cTime;
+    f->hours = model->wl->Qw[0][0].date_time.secsTo(rn->cTime) / 3600.;
+    f->eta.resize(nnodes);
+    f->wsl.resize(nnodes);
+    f->width.resize(nnodes);
+    f->Qs.resize(nnodes);
+    f->d50.resize(nnodes);
+    for (unsigned int i = 0; i < nnodes; i++)
+    {
+        f->eta[i] = rn->eta[i];
+        f->wsl[i] = rn->eta[i] + rn->RiverXS[i].depth;
+        f->width[i] = rn->RiverXS[i].width;
+        f->Qs[i] = model->sd->Qs[i];
+        f->d50[i] = std::pow(2., rn->F[i].dsg);
+    }
+    history->record(f);
+}
@@ -0,0 +1,97 @@
+#ifndef MODELRUNNER_H
+#define MODELRUNNER_H
+
+#include "gratetime.h"
+#include "progress.h"
+#include "riverprofile.h"
+#include "runhistory.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Model;
+
+
+// What the GUI draws of the model, copied between steps. Never changed once published, so the
+// GUI can keep drawing one while the model moves on.
+class ModelSnapshot
+{
+public:
+
+    int state;                                 // RunState
+    std::string error;                         // Why the run failed
+    unsigned int counter;
+    GrateTime cTime;
+    double hours;                              // Model time since the first flow record (h)
+    double progress;                           // % of the way from the start time to the end time
+    double qwTweak;
+
+    std::vector<NodeXSObject> xs;              // Cross-sections
+    std::vector<double> eta;
+    std::vector<double> bedrock;
+    std::vector<double> ntop;
+    std::vector<double> Qs;
+    std::vector<double> QwCumul;
+    std::vector<double> dsg;                   // Surface D50 (psi)
+    std::vector<double> d90;                   // Surface D90 (psi)
+    std::vector< std::vector<double> > gsdCumul;    // [grain size][node], surface fraction finer
+    std::vector<double> psi;                   // Grain sizes of the surface GSD (psi)
+};
+
+// Settings the GUI changes while the model runs, applied after each step
+struct RunControls
+{
+    unsigned int dt;
+    unsigned int writeInterval;
+    double sedUpw;
+    double hydroUpw;
+    bool regime;
+    bool cycle;                                // Go back to the start of the flow record at the end
+};
+
+// Runs a model on a thread of its own, publishing a snapshot at most every 'interval' and when
+// the run ends, so the model steps at full speed however slowly the snapshots are drawn. The
+// model belongs to the runner's thread from start() until stop() or the end of the run. With a
+// history, the steps it wants are recorded in it too, whether or not they are published.
+class ModelRunner
+{
+public:
+
+    ModelRunner(Model *model, std::chrono::steady_clock::duration interval, RunHistory *history = NULL);
+    ~ModelRunner();                            // Stops the run
+
+    void start(const RunControls &controls);
+    void stop();                               // Waits for the step in progress, then publishes
+    bool running() const { return active.load(std::memory_order_acquire); }
+
+    void setControls(const RunControls &controls);
+    std::shared_ptr<const ModelSnapshot> latest() const;
+    unsigned long published() const { return snapshots.load(std::memory_order_relaxed); }
+
+private:
+    Model *model;
+    std::chrono::steady_clock::duration interval;
+    RunHistory *history;
+    std::thread worker;
+    std::atomic<bool> active;
+    std::atomic<bool> stopping;
+    std::atomic<unsigned long> snapshots;
+
+    mutable std::mutex lock;                   // Guards the two below
+    std::shared_ptr<const ModelSnapshot> current;
+    RunControls controls;
+
+    void run();
+    void apply();
+    void publish(int state, const std::string &error = "");
+    void record();
+
+    ModelRunner(const ModelRunner &);
+    ModelRunner &operator=(const ModelRunner &);
+};
+
+#endif // MODELRUNNER_H
@@ -0,0 +1,92 @@
+/*******************
+ *
+ *
+ *  GRATE 9
+ *
+ *  Plot frames: level of detail and a time budget for redrawing the GUI's plots
+ *
+ *
+ *
+*********************/
+
+#include "plotframe.h"
+#include <algorithm>
+#include <ciso646>
+
+
+void decimateMinMax(const double *x, const double *y, size_t n, size_t maxPoints,
+                    std::vector<double> &outX, std::vector<double> &outY)
+{
+    outX.clear();
+    outY.clear();
+    if (n <= maxPoints || maxPoints < 2)
+    {
+        outX.assign(x, x + n);
+        outY.assign(y, y + n);
+        return;
+    }
+
+    size_t buckets = maxPoints / 2;
+    for (size_t b = 0; b < buckets; b++)
+    {
+        size_t first = b * n / buckets;
+        size_t last = (b + 1) * n / buckets;   // One past the bucket
+        size_t lo = first, hi = first;
+        for (size_t i = first + 1; i < last; i++)
+        {
+            if (y[i] < y[lo])
+                lo = i;
+            if (y[i] > y[hi])
+                hi = i;
+        }
+        outX.push_back(x[first]);
+        outY.push_back(y[std::min(lo, hi)]);
+        outX.push_back(x[last - 1]);
+        outY.push_back(y[std::max(lo, hi)]);
+    }
+}
+
+FrameBudget::FrameBudget(int plots, double budgetSeconds)
+    : budget(budgetSeconds), dirty(plots, false), costs(plots, 0.), since(plots, 0), frame(0)
+{
+}
+
+void FrameBudget::changed(int plot)
+{
+    if (not dirty[plot])
+        since[plot] = frame;
+    dirty[plot] = true;
+}
+
+std::vector<int> FrameBudget::due()
+{
+    std::vector<int> waiting;
+    for (unsigned int p = 0; p < dirty.size(); p++)
+        if (dirty[p])
+            waiting.push_back(p);
+    std::stable_sort(waiting.begin(), waiting.end(), [this](int a, int b) { return since[a] < since[b]; });
+
+    // the longest waiting always goes, then any others that fit
+    std::vector<int> chosen;
+    double spent = 0;
+    for (unsigned int i = 0; i < waiting.size(); i++)
+    {
+        if (not chosen.empty() && spent + costs[waiting[i]] > budget)
+            continue;
+        chosen.push_back(waiting[i]);
+        spent += costs[waiting[i]];
+    }
+    frame++;
+    return chosen;
+}
+
+void FrameBudget::drawn(int plot, double seconds)
+{
+    dirty[plot] = false;
+    costs[plot] = costs[plot] > 0 ? 0.8 * costs[plot] + 0.2 * seconds : seconds;
+}
+
+bool FrameBudget::pending() const
+{
+    return std::find(dirty.begin(), dirty.end(), true) != dirty.end();
+}
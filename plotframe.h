@@ -0,0 +1,41 @@
+#ifndef PLOTFRAME_H
+#define PLOTFRAME_H
+
+#include <cstddef>
+#include <vector>
+
+
+// Level of detail for a line plot of n points: at most 'maxPoints' of them. Each bucket of
+// neighbouring points becomes two, its lowest and highest values in the order they come, placed
+// at the bucket's first and last x, so peaks survive and the x of every point stays the same from
+// one call to the next as long as n and maxPoints do. Fewer than maxPoints points are copied.
+void decimateMinMax(const double *x, const double *y, size_t n, size_t maxPoints,
+                    std::vector<double> &outX, std::vector<double> &outY);
+
+// Chooses the plots to redraw in a frame: those whose data changed, the longest waiting first,
+// while the time they are expected to take fits in the budget. At least one is drawn each frame,
+// and plots left out go first in the next, so every change is drawn within a few frames however
+// slow the plots are.
+class FrameBudget
+{
+public:
+
+    FrameBudget(int plots, double budgetSeconds);
+
+    void changed(int plot);                    // Its data changed since it was drawn
+    std::vector<int> due();                    // The plots to draw now, in order; starts a frame
+    void drawn(int plot, double seconds);      // Drawn, taking this long
+    bool pending() const;                      // Changes not drawn yet
+
+    double cost(int plot) const { return costs[plot]; }     // Expected seconds to draw it
+
+    double budget;                             // Seconds of drawing per frame
+
+private:
+    std::vector<bool> dirty;
+    std::vector<double> costs;                 // Moving average of the time to draw each plot
+    std::vector<unsigned long> since;          // Frame in which each change was first not drawn
+    unsigned long frame;
+};
+
+#endif // PLOTFRAME_H
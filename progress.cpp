@@ -0,0 +1,391 @@
+/*******************
+ *
+ *
+ *  GRATE 9
+ *
+ *  Progress server: a running model's progress on a local UNIX domain socket
+ *
+ *
+ *
+*********************/
+
+#include "progress.h"
+#include "model.h"
+#include "grateerror.h"
+#include "jsontext.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <ciso646>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char *stateNames[] = {"running", "finished", "failed"};
+
+// e.g. "2d 03:04:05", "-" if unknown
+std::string durationText(double seconds)
+{
+    if (not (seconds >= 0) || seconds > 1e9)
+        return "-";
+    long s = long(seconds + 0.5);
+    char text[32];
+    if (s >= 86400)
+        std::snprintf(text, sizeof(text), "%ldd %02ld:%02ld:%02ld", s / 86400, s / 3600 % 24, s / 60 % 60, s % 60);
+    else
+        std::snprintf(text, sizeof(text), "%02ld:%02ld:%02ld", s / 3600, s / 60 % 60, s % 60);
+    return text;
+}
+
+std::string modelTimeText(const std::tm &t)
+{
+    char text[32];
+    std::strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &t);
+    return text;
+}
+
+double percentDone(const ProgressState &s)
+{
+    return s.lastStep > 0 ? 100. * s.counter / s.lastStep : 100.;
+}
+
+double secondsLeft(const ProgressState &s)
+{
+    if (s.state != RUN_RUNNING)
+        return 0;
+    return s.stepsPerSecond > 0 ? (s.lastStep - s.counter) / s.stepsPerSecond : -1;
+}
+
+unsigned long totalFailures(const ProgressState &s)
+{
+    unsigned long n = 0;
+    for (int i = 0; i < N_SOLVERS; i++)
+        n += s.solverFailures[i];
+    return n;
+}
+
+unsigned long totalFallbacks(const ProgressState &s)
+{
+    unsigned long n = 0;
+    for (int f = 0; f < N_FALLBACKS; f++)
+        n += s.fallbacks[f];
+    return n;
+}
+
+}  // namespace
+
+
+std::string progressLine(const ProgressState &s)
+{
+    char rate[32];
+    std::snprintf(rate, sizeof(rate), "%.1f", s.stepsPerSecond);
+    char percent[16];
+    std::snprintf(percent, sizeof(percent), "%.1f", percentDone(s));
+
+    std::ostringstream line;
+    line << stateNames[s.state] << ", step " << s.counter << " of " << s.lastStep << " (" << percent
+         << " %), model time " << modelTimeText(s.modelTime) << ", " << rate << " steps/s, ETA "
+         << durationText(secondsLeft(s)) << ", " << totalFailures(s) << " solver failures, "
+         << totalFallbacks(s) << " fallbacks";
+    return line.str();
+}
+
+std::string progressJson(const ProgressState &s)
+{
+    std::ostringstream out;
+    out << "{\n  \"state\": ";
+    writeJsonString(out, stateNames[s.state]);
+    out << ",\n  \"counter\": " << s.counter << ",\n  \"first_step\": " << s.firstStep
+        << ",\n  \"last_step\": " << s.lastStep << ",\n  \"percent\": ";
+    writeJsonNumber(out, percentDone(s));
+    out << ",\n  \"model_time\": ";
+    writeJsonString(out, modelTimeText(s.modelTime));
+    out << ",\n  \"nodes\": " << s.nodes << ",\n  \"dt\": " << s.dt << ",\n  \"elapsed_seconds\": ";
+    writeJsonNumber(out, s.elapsed);
+    out << ",\n  \"steps_per_second\": ";
+    writeJsonNumber(out, s.stepsPerSecond);
+    out << ",\n  \"eta_seconds\": ";
+    writeJsonNumber(out, secondsLeft(s));
+    out << ",\n";
+
+    out << "  \"phases\": {\n";
+    for (int p = 0; p < N_PHASES; p++)
+    {
+        out << "    ";
+        writeJsonString(out, phaseName(Phase(p)));
+        out << ": {\"seconds\": ";
+        writeJsonNumber(out, s.phaseSeconds[p]);
+        out << ", \"calls\": " << s.phaseCalls[p] << "}" << (p + 1 < N_PHASES ? "," : "") << "\n";
+    }
+    out << "  },\n  \"solvers\": {\n";
+    for (int i = 0; i < N_SOLVERS; i++)
+    {
+        out << "    ";
+        writeJsonString(out, SolverStats::name(Solver(i)));
+        out << ": {\"calls\": " << s.solverCalls[i] << ", \"iterations\": " << s.solverIterations[i]
+            << ", \"not_converged\": " << s.solverFailures[i] << "}" << (i + 1 < N_SOLVERS ? "," : "") << "\n";
+    }
+    out << "  },\n  \"fallbacks\": {";
+    for (int f = 0; f < N_FALLBACKS; f++)
+    {
+        out << (f > 0 ? ", " : "");
+        writeJsonString(out, SolverStats::name(Fallback(f)));
+        out << ": " << s.fallbacks[f];
+    }
+    out << "}\n}\n";
+    return out.str();
+}
+
+bool ProgressServer::supported()
+{
+#ifdef _WIN32
+    return false;
+#else
+    return true;
+#endif
+}
+
+ProgressServer::ProgressServer(const std::string &socketPath, int firstStep, int lastStep)
+    : path(socketPath), listener(-1), sequence(0), windowCounter(firstStep)
+{
+    for (size_t w = 0; w < publishedWords; w++)
+        published[w].store(0, std::memory_order_relaxed);
+    std::memset(&next, 0, sizeof(next));
+    next.firstStep = firstStep;
+    next.lastStep = lastStep;
+    next.counter = firstStep;
+    started = windowStart = std::chrono::steady_clock::now();
+    publish();
+
+#ifdef _WIN32
+    stopPipe[0] = stopPipe[1] = -1;
+    throw GrateError("Progress sockets are not supported on Windows");
+#else
+    struct sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path))
+        throw GrateError("Progress socket path is empty or too long: " + path);
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+    // a socket nobody answers on was left by a run that died
+    struct stat info;
+    if (lstat(path.c_str(), &info) == 0)
+    {
+        if (not S_ISSOCK(info.st_mode))
+            throw GrateError("Progress socket path exists and is not a socket: " + path);
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool live = probe >= 0 && connect(probe, (struct sockaddr *)&address, sizeof(address)) == 0;
+        if (probe >= 0)
+            close(probe);
+        if (live)
+            throw GrateError("Another run is serving progress on " + path);
+        unlink(path.c_str());
+    }
+
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0)
+        throw GrateError("Error creating progress socket: " + std::string(std::strerror(errno)));
+    fcntl(listener, F_SETFD, FD_CLOEXEC);
+    if (bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 16) != 0)
+    {
+        std::string why = std::strerror(errno);
+        close(listener);
+        throw GrateError("Error listening on progress socket " + path + ": " + why);
+    }
+    chmod(path.c_str(), 0600);                 // Only the user running the model
+
+    if (pipe(stopPipe) != 0)
+    {
+        std::string why = std::strerror(errno);
+        close(listener);
+        unlink(path.c_str());
+        throw GrateError("Error creating progress server: " + why);
+    }
+    server = std::thread(&ProgressServer::serve, this);
+#endif
+}
+
+ProgressServer::~ProgressServer()
+{
+#ifndef _WIN32
+    // the server thread stops when its poll sees the pipe; if the pipe can't be written, shutting
+    // the listener down wakes the poll instead
+    char stop = 0;
+    ssize_t written;
+    do
+        written = write(stopPipe[1], &stop, 1);
+    while (written < 0 && errno == EINTR);
+    if (written != 1)
+        shutdown(listener, SHUT_RDWR);
+    server.join();
+    close(stopPipe[0]);
+    close(stopPipe[1]);
+    close(listener);
+    unlink(path.c_str());
+#endif
+}
+
+void ProgressServer::update(const Model &model, const SolverStats &taken)
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    const RiverProfile *r = model.rn;
+    next.state = RUN_RUNNING;
+    next.counter = r->counter;
+    next.nodes = r->nnodes;
+    next.dt = r->dt;
+    next.modelTime = r->cTime.getTm();
+    next.elapsed = std::chrono::duration<double>(now - started).count();
+
+    // the rate of the last window once there is one, so it follows a run that slows down
+    double window = std::chrono::duration<double>(now - windowStart).count();
+    if (window >= 1.0)
+    {
+        next.stepsPerSecond = (next.counter - windowCounter) / window;
+        windowStart = now;
+        windowCounter = next.counter;
+    }
+    else if (windowCounter == next.firstStep && next.elapsed > 0)
+        next.stepsPerSecond = (next.counter - next.firstStep) / next.elapsed;
+
+    const PhaseTimes &times = model.timings();
+    for (int p = 0; p < N_PHASES; p++)
+    {
+        next.phaseSeconds[p] = times.seconds(Phase(p));
+        next.phaseCalls[p] = times.count(Phase(p));
+    }
+    for (int s = 0; s < N_SOLVERS; s++)
+    {
+        next.solverCalls[s] = taken.count(Solver(s)) + r->solvers.count(Solver(s));
+        next.solverIterations[s] = taken.iterations(Solver(s)) + r->solvers.iterations(Solver(s));
+        next.solverFailures[s] = taken.failures(Solver(s)) + r->solvers.failures(Solver(s));
+    }
+    for (int f = 0; f < N_FALLBACKS; f++)
+        next.fallbacks[f] = taken.fallbacks(Fallback(f)) + r->solvers.fallbacks(Fallback(f));
+    publish();
+}
+
+void ProgressServer::finish(bool failed)
+{
+    next.state = failed ? RUN_FAILED : RUN_FINISHED;
+    next.elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    publish();
+}
+
+void ProgressServer::publish()
+{
+    unsigned int s = sequence.load(std::memory_order_relaxed);
+    sequence.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    uint64_t words[publishedWords] = {};
+    std::memcpy(words, &next, sizeof(ProgressState));
+    for (size_t w = 0; w < publishedWords; w++)
+        published[w].store(words[w], std::memory_order_relaxed);
+    sequence.store(s + 2, std::memory_order_release);
+}
+
+ProgressState ProgressServer::snapshot() const
+{
+    uint64_t words[publishedWords];
+    for (;;)
+    {
+        unsigned int before = sequence.load(std::memory_order_acquire);
+        if (before & 1)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        for (size_t w = 0; w < publishedWords; w++)
+            words[w] = published[w].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence.load(std::memory_order_relaxed) == before)
+            break;
+    }
+    ProgressState copy;
+    std::memcpy(&copy, words, sizeof(ProgressState));
+    return copy;
+}
+
+void ProgressServer::serve()
+{
+#ifndef _WIN32
+    struct pollfd fds[2];
+    fds[0].fd = listener;
+    fds[0].events = POLLIN;
+    fds[1].fd = stopPipe[0];
+    fds[1].events = POLLIN;
+    for (;;)
+    {
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        if (fds[1].revents != 0 || (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) != 0)
+            return;
+        if (fds[0].revents & POLLIN)
+        {
+            int connection = accept(listener, NULL, NULL);
+            if (connection >= 0)
+            {
+                answer(connection);
+                close(connection);
+            }
+            else if (errno == EINVAL)
+                return;                        // The listener was shut down
+        }
+    }
+#endif
+}
+
+void ProgressServer::answer(int connection)
+{
+#ifndef _WIN32
+    // one client at a time, so one that stalls is dropped rather than holding up the others
+    struct timeval timeout;
+    timeout.tv_sec = 1;
+    timeout.tv_usec = 0;
+    setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    int flags = 0;
+#ifdef MSG_NOSIGNAL
+    flags = MSG_NOSIGNAL;
+#elif defined(SO_NOSIGPIPE)
+    int on = 1;
+    setsockopt(connection, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+
+    std::string request;
+    char c;
+    while (request.size() < 64 && recv(connection, &c, 1, 0) == 1 && c != '\n')
+        request += c;
+    if (not request.empty() && request[request.size() - 1] == '\r')
+        request.erase(request.size() - 1);
+
+    std::string reply;
+    if (request == "status")
+        reply = progressLine(snapshot()) + "\n";
+    else if (request == "json")
+        reply = progressJson(snapshot());
+    else
+        reply = "unknown request '" + request + "', send status or json\n";
+
+    for (size_t sent = 0; sent < reply.size(); )
+    {
+        ssize_t n = send(connection, reply.data() + sent, reply.size() - sent, flags);
+        if (n <= 0)
+            break;
+        sent += n;
+    }
+#endif
+}
@@ -0,0 +1,96 @@
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include "timings.h"
+#include "solverstats.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <thread>
+
+class Model;
+
+
+enum RunState {
+    RUN_RUNNING,
+    RUN_FINISHED,
+    RUN_FAILED
+};
+
+// Where a run has got to, as published after each step. Plain data, copied whole.
+struct ProgressState
+{
+    int state;                                 // RunState
+    int firstStep;                             // Step the run started (or restarted) from
+    int lastStep;                              // Step it will stop at
+    int counter;                               // Steps done
+    int nodes;
+    unsigned int dt;                           // Model time step (s)
+    std::tm modelTime;                         // cTime
+    double elapsed;                            // Wall seconds since the first step
+    double stepsPerSecond;                     // Over the last few seconds
+    double phaseSeconds[N_PHASES];
+    unsigned long phaseCalls[N_PHASES];
+    unsigned long solverCalls[N_SOLVERS];
+    unsigned long solverIterations[N_SOLVERS];
+    unsigned long solverFailures[N_SOLVERS];
+    unsigned long fallbacks[N_FALLBACKS];
+};
+
+// Progress of a running model, served on a local UNIX domain socket so runs in batch jobs can be
+// watched without their stdout. A client connects, sends "status" (one line of text) or "json"
+// followed by a newline, reads the reply and the server closes the connection; GrateStatus is
+// such a client.
+//
+// The thread advancing the model publishes with update(), which copies the state under a sequence
+// counter (a seqlock) and never waits or makes a system call; a thread of the server's own
+// accepts connections and retries its copy if an update overlapped it.
+class ProgressServer
+{
+public:
+
+    // Listens on 'socketPath', replacing a stale socket left by a run that died. Throws GrateError
+    // if the socket can't be made or another run is listening on it.
+    ProgressServer(const std::string &socketPath, int firstStep, int lastStep);
+    ~ProgressServer();                         // Stops serving and removes the socket
+
+    // from the thread advancing the model; 'taken' are the solver counters already taken from it
+    void update(const Model &model, const SolverStats &taken);
+    void finish(bool failed);                  // Answer with the final state until destroyed
+
+    static bool supported();                   // False where there are no UNIX domain sockets
+
+private:
+    std::string path;
+    int listener;
+    int stopPipe[2];                           // Written to wake the server thread to stop
+    std::thread server;
+
+    // seqlock: odd while the state is being written. The state is stored as atomic words, so a
+    // read that overlaps a write is a retry, not a data race
+    static const size_t publishedWords = (sizeof(ProgressState) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+    std::atomic<unsigned int> sequence;
+    std::atomic<uint64_t> published[publishedWords];
+
+    // rate over a window of at least a second, kept by the updating thread
+    ProgressState next;
+    std::chrono::steady_clock::time_point started;
+    std::chrono::steady_clock::time_point windowStart;
+    int windowCounter;
+
+    void publish();
+    ProgressState snapshot() const;
+    void serve();
+    void answer(int connection);
+
+    ProgressServer(const ProgressServer &);
+    ProgressServer &operator=(const ProgressServer &);
+};
+
+// Reply to a request, formatted from a state
+std::string progressLine(const ProgressState &s);
+std::string progressJson(const ProgressState &s);
+
+#endif // PROGRESS_H
@@ -0,0 +1,870 @@
+/*******************
+ *
+ *
+ *  GRATE 9
+ *
+ *  Results files: text and binary writers, output streams
+ *
+ *
+ *
+*********************/
+
+#include "results.h"
+#include "riverprofile.h"
+#include "sed.h"
+#include "grateerror.h"
+#include "trace.h"
+#include <charconv>
+#include <cstring>
+#include <ciso646>
+
+namespace {
+
+typedef OutputVariable::NodeValue NodeValue;
+
+double xValue(const RiverProfile *rn, const sed *, unsigned int i, int) { return rn->xx[i]; }
+double etaValue(const RiverProfile *rn, const sed *, unsigned int i, int) { return rn->eta[i]; }
+double bedrockValue(const RiverProfile *rn, const sed *, unsigned int i, int) { return rn->bedrock[i]; }
+double laValue(const RiverProfile *rn, const sed *, unsigned int i, int) { return rn->la[i]; }
+double toplayerValue(const RiverProfile *rn, const sed *, unsigned int i, int) { return rn->toplayer[i]; }
+double ntopValue(const RiverProfile *rn, const sed *, unsigned int i, int) { return rn->ntop[i]; }
+double subsurfaceDsgValue(const RiverProfile *rn, const sed *, unsigned int i, int) { return rn->storedf.layer(i, rn->ntop[i]).dsg; }
+double dsgValue(const RiverProfile *rn, const sed *, unsigned int i, int) { return rn->F[i].dsg; }
+double d84Value(const RiverProfile *rn, const sed *, unsigned int i, int) { return rn->F[i].d84; }
+double d90Value(const RiverProfile *rn, const sed *, unsigned int i, int) { return rn->F[i].d90; }
+double stdvValue(const RiverProfile *rn, const sed *, unsigned int i, int) { return rn->F[i].stdv; }
+double sandValue(const RiverProfile *rn, const sed *, unsigned int i, int) { return rn->F[i].sand_pct; }
+double qsValue(const RiverProfile *, const sed *sd, unsigned int i, int) { return sd->Qs[i]; }
+double detaValue(const RiverProfile *, const sed *sd, unsigned int i, int) { return sd->deta[i]; }
+
+// Surface fraction in size class 'j', summed over the lithologies in use
+double pctValue(const RiverProfile *rn, const sed *, unsigned int i, int j)
+{
+    double sum = 0.;
+    for (unsigned int k = 0; k < rn->nlith; k++)
+        sum += rn->F[i].pct[k][j];
+    return sum;
+}
+
+// Statistics of a storage layer are not kept up to date by the model, so work them out here
+double storeDsgValue(const RiverProfile *rn, const sed *, unsigned int i, int z)
+{
+    NodeGSDObject g = rn->storedf.layer(i, z);
+    g.norm_frac();
+    g.dg_and_std();
+    return g.dsg;
+}
+
+double storeSandValue(const RiverProfile *rn, const sed *, unsigned int i, int z)
+{
+    NodeGSDObject g = rn->storedf.layer(i, z);
+    g.norm_frac();
+    return g.sand_pct;
+}
+
+#define XS_VALUE(field) \
+    [](const RiverProfile *rn, const sed *, unsigned int i, int) -> double { return rn->RiverXS[i].field; }
+
+struct NamedValue
+{
+    const char *name;
+    NodeValue value;
+};
+
+const NamedValue namedValues[] = {
+    {"X", xValue},
+    {"ETA", etaValue},
+    {"BEDROCK", bedrockValue},
+    {"LA", laValue},
+    {"TOPLAYER", toplayerValue},
+    {"NTOP", ntopValue},
+    {"DSG_SUBSURFACE", subsurfaceDsgValue},
+    {"DSG", dsgValue},
+    {"D84", d84Value},
+    {"D90", d90Value},
+    {"STDV", stdvValue},
+    {"SAND_PCT", sandValue},
+    {"QS", qsValue},
+    {"DETA", detaValue},
+    {"NOCHANNELS", XS_VALUE(noChannels)},
+    {"DEPTH", XS_VALUE(depth)},
+    {"WSL", XS_VALUE(wsl)},
+    {"WIDTH", XS_VALUE(width)},
+    {"B2B", XS_VALUE(b2b)},
+    {"VELOCITY", XS_VALUE(velocity)},
+    {"USTAR", XS_VALUE(ustar)},
+    {"THETA", XS_VALUE(theta)},
+    {"HMAX", XS_VALUE(Hmax)},
+    {"MU", XS_VALUE(mu)},
+    {"FPSLOPE", XS_VALUE(fpSlope)},
+    {"VALLEYWALLSLP", XS_VALUE(valleyWallSlp)},
+    {"FPWIDTH", XS_VALUE(fpWidth)},
+    {"BANKHEIGHT", XS_VALUE(bankHeight)},
+    {"CHSINU", XS_VALUE(chSinu)},
+    {"TOPW", XS_VALUE(topW)},
+    {"FLOW_AREA_0", XS_VALUE(flow_area[0])},
+    {"FLOW_AREA_1", XS_VALUE(flow_area[1])},
+    {"FLOW_AREA_2", XS_VALUE(flow_area[2])},
+    {"FLOW_PERIM_0", XS_VALUE(flow_perim[0])},
+    {"FLOW_PERIM_1", XS_VALUE(flow_perim[1])},
+    {"FLOW_PERIM_2", XS_VALUE(flow_perim[2])},
+    {"HYDRADIUS", XS_VALUE(hydRadius)},
+    {"CENTR", XS_VALUE(centr)},
+    {"K_MEAN", XS_VALUE(k_mean)},
+    {"ECI", XS_VALUE(eci)},
+    {"CRITDEPTH", XS_VALUE(critdepth)},
+    {"ROUGH", XS_VALUE(rough)},
+    {"OMEGA", XS_VALUE(omega)},
+    {"TBED", XS_VALUE(Tbed)},
+    {"TBANK", XS_VALUE(Tbank)},
+    {"QB_CAP", XS_VALUE(Qb_cap)},
+    {"COMP_D", XS_VALUE(comp_D)},
+    {"K", XS_VALUE(K)},
+    {"DELTAW", XS_VALUE(deltaW)}
+};
+
+// Numbered variables: a prefix followed by a size class or storage layer, e.g. PCT03, STORE_DSG_12
+struct NumberedValue
+{
+    const char *prefix;
+    NodeValue value;
+    bool layer;                                // numbered by storage layer rather than size class
+};
+
+const NumberedValue numberedValues[] = {
+    {"PCT", pctValue, false},
+    {"STORE_DSG_", storeDsgValue, true},
+    {"STORE_SAND_", storeSandValue, true}
+};
+
+const char *legacyColumns[] = {
+    "X", "ETA", "DEPTH", "WIDTH", "THETA", "NOCHANNELS", "DSG_SUBSURFACE", "DSG", "STDV", "QS", "SAND_PCT",
+    "PCT00", "PCT01", "PCT02", "PCT03", "PCT04", "PCT05", "PCT06", "PCT07", "PCT08", "PCT09", "PCT10", "PCT11", "PCT12"
+};
+const unsigned int nLegacyColumns = sizeof(legacyColumns) / sizeof(legacyColumns[0]);
+
+bool isLegacy(const ResultsLayout &layout)
+{
+    if (layout.variables.size() != nLegacyColumns)
+        return false;
+    for (unsigned int v = 0; v < nLegacyColumns; v++)
+        if (layout.variables[v] != legacyColumns[v])
+            return false;
+    return true;
+}
+
+std::vector<std::string> splitList(const char *text)
+{
+    std::vector<std::string> items;
+    std::string item;
+    for (const char *c = text; *c != '\0'; c++)
+    {
+        if (*c == ' ' || *c == ',' || *c == '\t' || *c == '\n' || *c == '\r')
+        {
+            if (not item.empty())
+                items.push_back(item);
+            item.clear();
+        }
+        else
+            item += *c;
+    }
+    if (not item.empty())
+        items.push_back(item);
+    return items;
+}
+
+template <class T> void put(std::vector<char> &buf, const T &v)
+{
+    const char *p = reinterpret_cast<const char*>(&v);
+    buf.insert(buf.end(), p, p + sizeof(T));
+}
+
+void countSnapshot(MemoryCount &c, const ResultsSnapshot &s)
+{
+    c.addVector(s.columns);
+    for (unsigned int v = 0; v < s.columns.size(); v++)
+        c.addVector(s.columns[v]);
+}
+
+}  // namespace
+
+
+ResultsWriter::ResultsWriter(const std::string &name) :
+    fileName(name)
+{
+}
+
+ResultsWriter::~ResultsWriter()
+{
+}
+
+std::vector<std::string> ResultsWriter::files() const
+{
+    return std::vector<std::string>(1, fileName);
+}
+
+void ResultsWriter::countMemory(MemoryCount &c)
+{
+    countSnapshot(c, step);
+}
+
+ResultsSnapshot &ResultsWriter::buffer()
+{
+    return step;
+}
+
+void ResultsWriter::commit()
+{
+    write(step);
+}
+
+void ResultsWriter::flush()
+{
+}
+
+TextResultsWriter::TextResultsWriter(const std::string &name) :
+    ResultsWriter(name)
+{
+}
+
+void TextResultsWriter::open(const ResultsLayout &layout, bool resume)
+{
+    out.open(fileName, resume ? (std::ios::out | std::ios::app | std::ios::binary) : (std::ios::out | std::ios::binary));
+    if (not out)
+        throw GrateError("Error opening results file: " + fileName);
+    if (resume)
+        return;
+
+    buf.clear();
+    if (not isLegacy(layout))
+    {
+        put("Output file for program Grate_NESI\n");
+        put("there are ");
+        put((unsigned int)layout.variables.size());
+        put(" columns at ");
+        put((unsigned int)layout.x.size());
+        put(" output points.  they are:\n");
+        for (unsigned int v = 0; v < layout.variables.size(); v++)
+        {
+            put("column no. ");
+            put(v + 1);
+            put(":  " + layout.variables[v] + "\n");
+        }
+        put("rows are at chainage (m):");
+        for (unsigned int p = 0; p < layout.x.size(); p++)
+        {
+            put(' ');
+            put(layout.x[p]);
+        }
+        put('\n');
+    }
+    else
+    {
+        put("Output file for program Grate_NESI\n"
+            "there are twenty-four columns in the output.  they are:\n"
+            "column no. 1:  X coordinates in meters\n"
+            "column no. 2:  Bed elevation in meters\n"
+            "column no. 3:  Flow depth in meters\n"
+            "column no. 4:  Channel width (m)\n"
+            "column no. 5:  Channel theta (deg)\n"
+            "column no. 6:  Number of channels\n"
+            "column no. 7:  Geometric mean grain size (mm) below the surface layer\n"
+            "column no. 8:  Geometric mean grain size (mm) of the surface layer\n"
+            "column no. 9:  Standard deviation at the same position.\n"
+            "column no. 10:  Sediment transport rate (m2/s)\n"
+            "column no. 11:  Sand percentage (Fs)\n"
+            "column no. 12-24: Surface grain size matrix (12 classes)\n");
+    }
+
+    for (unsigned int a = 0; a < layout.attributes.size(); a++)
+    {
+        put(layout.attributes[a].first + " = ");
+        put(layout.attributes[a].second);
+        put('\n');
+    }
+    put("\n\n");
+    writeBuffer();
+}
+
+void TextResultsWriter::write(const ResultsSnapshot &s)
+{
+    size_t nvars = s.columns.size();
+    size_t nnodes = nvars > 0 ? s.columns[0].size() : 0;
+
+    buf.clear();
+    buf.reserve(16 * (nvars + 1) * (nnodes + 1));      // no reallocation after the first step
+    put("Count:  ");
+    put(s.counter);
+    put('\n');
+    for (size_t i = 0; i < nnodes; i++)
+        for (size_t v = 0; v < nvars; v++)
+        {
+            put(s.columns[v][i]);
+            put(v + 1 < nvars ? '\t' : '\n');
+        }
+    put('\n');
+
+    // a complete record is on disk after every write, so a checkpoint sees a consistent file
+    writeBuffer();
+}
+
+void TextResultsWriter::put(double v)
+{
+    // same as ostream's default: %g, 6 significant digits
+    char text[32];
+    std::to_chars_result r = std::to_chars(text, text + sizeof(text), v, std::chars_format::general, 6);
+    buf.append(text, r.ptr);
+}
+
+void TextResultsWriter::put(unsigned int v)
+{
+    char text[16];
+    std::to_chars_result r = std::to_chars(text, text + sizeof(text), v);
+    buf.append(text, r.ptr);
+}
+
+void TextResultsWriter::countMemory(MemoryCount &c)
+{
+    ResultsWriter::countMemory(c);
+    if (buf.capacity() > std::string().capacity())          // beyond the short string buffer
+        c.addBlock(buf.capacity() + 1);
+}
+
+void TextResultsWriter::writeBuffer()
+{
+    out.write(buf.data(), buf.size());
+    out.flush();
+    if (not out)
+        throw GrateError("Error writing results file: " + fileName);
+}
+
+BinaryResultsWriter::BinaryResultsWriter(const std::string &name, const ResultsEncoding &enc) :
+    ResultsWriter(name), offset(0), encoding(enc), sinceKeyframe(0)
+{
+    if (encoding.codec != CODEC_NONE)
+        encoder.reset(new FrameCodec(encoding.codec, encoding.tolerance));
+    if (encoding.keyframeInterval < 1)
+        encoding.keyframeInterval = 1;
+}
+
+std::vector<std::string> BinaryResultsWriter::files() const
+{
+    std::vector<std::string> f;
+    f.push_back(fileName);
+    f.push_back(fileName + ".idx");
+    return f;
+}
+
+void BinaryResultsWriter::countMemory(MemoryCount &c)
+{
+    // not the codec's copy of the previous frame
+    ResultsWriter::countMemory(c);
+    c.addVector(frame);
+    c.addVector(encoded);
+}
+
+void BinaryResultsWriter::open(const ResultsLayout &layout, bool resume)
+{
+    std::ios::openmode mode = std::ios::out | std::ios::binary | (resume ? std::ios::app : std::ios::trunc);
+    data.open(fileName, mode);
+    index.open(fileName + ".idx", mode);
+    if (not data || not index)
+        throw GrateError("Error opening binary results file: " + fileName);
+
+    // the first frame written is always a keyframe, so a resumed file never depends on
+    // frames from before the restart
+    sinceKeyframe = 0;
+
+    if (resume)
+    {
+        data.seekp(0, std::ios::end);
+        offset = data.tellp();
+        return;
+    }
+
+    std::vector<char> header = resultsHeader(layout, encoding);
+    data.write(header.data(), header.size());
+    offset = header.size();
+
+    std::vector<char> indexHeader = resultsIndexHeader();
+    index.write(indexHeader.data(), indexHeader.size());
+
+    data.flush();
+    index.flush();
+    if (not data || not index)
+        throw GrateError("Error writing binary results file: " + fileName);
+}
+
+void BinaryResultsWriter::write(const ResultsSnapshot &s)
+{
+    frame.clear();
+    put(frame, uint64_t(s.counter));
+    put(frame, s.seconds);
+    if (encoder)
+    {
+        bool keyframe = (sinceKeyframe == 0);
+        uint32_t rawBytes;
+        encoder->encode(s.columns, keyframe, encoded, rawBytes);
+        put(frame, keyframe ? FRAME_KEYFRAME : uint32_t(0));
+        put(frame, rawBytes);
+        frame.insert(frame.end(), encoded.begin(), encoded.end());
+        sinceKeyframe = (sinceKeyframe + 1) % encoding.keyframeInterval;
+    }
+    else
+    {
+        for (unsigned int v = 0; v < s.columns.size(); v++)
+        {
+            const char *p = reinterpret_cast<const char*>(s.columns[v].data());
+            frame.insert(frame.end(), p, p + s.columns[v].size() * sizeof(double));
+        }
+    }
+
+    data.write(frame.data(), frame.size());
+
+    // both buffered: a reader drops index entries past the end of the data, should the index
+    // reach the disk first
+    uint64_t record[4];
+    record[0] = s.counter;
+    std::memcpy(&record[1], &s.seconds, sizeof(double));
+    record[2] = offset;
+    record[3] = frame.size();
+    index.write(reinterpret_cast<const char*>(record), sizeof(record));
+
+    if (not data || not index)
+        throw GrateError("Error writing binary results file: " + fileName);
+    offset += frame.size();
+}
+
+void BinaryResultsWriter::flush()
+{
+    // the index entry goes last, so it never points past the end of the data
+    data.flush();
+    index.flush();
+    if (not data || not index)
+        throw GrateError("Error writing binary results file: " + fileName);
+}
+
+BinaryResultsWriter::~BinaryResultsWriter()
+{
+    // too late to report a failure: Model::flushResults() does that for a finished run
+    data.flush();
+    index.flush();
+}
+
+AsyncResultsWriter::AsyncResultsWriter(ResultsWriter *w, unsigned int nbuffers) :
+    ResultsWriter(w->fileName), inner(w), buffers(nbuffers < 1 ? 1 : nbuffers),
+    current(0), holding(false), writing(false), stopping(false)
+{
+    for (size_t b = 0; b < buffers.size(); b++)
+        freeBuffers.push_back(b);
+    worker = std::thread(&AsyncResultsWriter::run, this);
+}
+
+AsyncResultsWriter::~AsyncResultsWriter()
+{
+    // write whatever is still pending, then stop
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    changed.notify_all();
+    worker.join();
+    delete inner;
+}
+
+void AsyncResultsWriter::open(const ResultsLayout &layout, bool resume)
+{
+    flush();
+    inner->open(layout, resume);
+}
+
+void AsyncResultsWriter::write(const ResultsSnapshot &s)
+{
+    buffer() = s;
+    commit();
+}
+
+std::vector<std::string> AsyncResultsWriter::files() const
+{
+    return inner->files();
+}
+
+void AsyncResultsWriter::countMemory(MemoryCount &c)
+{
+    // the writer thread changes its own buffers while it writes
+    std::unique_lock<std::mutex> guard(lock);
+    changed.wait(guard, [this] { return (pending.empty() && not writing) || error; });
+    c.addVector(buffers);
+    for (size_t b = 0; b < buffers.size(); b++)
+        countSnapshot(c, buffers[b]);
+    if (not error)
+        inner->countMemory(c);
+}
+
+ResultsSnapshot &AsyncResultsWriter::buffer()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    if (not holding)
+    {
+        // back-pressure: only wait if the writer thread has fallen behind
+        if (freeBuffers.empty() && not error)
+        {
+            TraceScope stall("results", "wait for writer");
+            changed.wait(guard, [this] { return not freeBuffers.empty() || error; });
+        }
+        rethrow();
+        current = freeBuffers.front();
+        freeBuffers.pop_front();
+        holding = true;
+    }
+    return buffers[current];
+}
+
+void AsyncResultsWriter::commit()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        rethrow();
+        if (not holding)
+            return;
+        pending.push_back(current);
+        holding = false;
+    }
+    changed.notify_all();
+}
+
+void AsyncResultsWriter::flush()
+{
+    TraceScope wait("results", "flush");
+    std::unique_lock<std::mutex> guard(lock);
+    changed.wait(guard, [this] { return (pending.empty() && not writing) || error; });
+    rethrow();
+
+    // the writer thread is idle until the next commit, which only this thread makes
+    inner->flush();
+}
+
+void AsyncResultsWriter::rethrow()
+{
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void AsyncResultsWriter::run()
+{
+    traceThreadName("writer " + fileName);
+    std::unique_lock<std::mutex> guard(lock);
+    for (;;)
+    {
+        changed.wait(guard, [this] { return not pending.empty() || stopping; });
+        if (pending.empty())
+            return;                            // stopping, and nothing left to write
+
+        size_t b = pending.front();
+        writing = true;
+        guard.unlock();
+
+        // after an error the remaining steps are dropped; the model sees the error instead
+        if (not error)
+        {
+            try {
+                TraceScope span("results", "write");
+                inner->write(buffers[b]);
+            }
+            catch (...) {
+                guard.lock();
+                error = std::current_exception();
+                guard.unlock();
+            }
+        }
+
+        guard.lock();
+        pending.pop_front();
+        freeBuffers.push_back(b);
+        writing = false;
+        changed.notify_all();
+    }
+}
+
+ResultsWriter *makeResultsWriter(const std::string &fileName, const ResultsEncoding &encoding)
+{
+    std::string ext;
+    size_t dot = fileName.find_last_of('.');
+    if (dot != std::string::npos)
+        ext = fileName.substr(dot);
+    if (ext == ".grb")
+        return new BinaryResultsWriter(fileName);
+    if (ext == ".grz")
+    {
+        ResultsEncoding compressed = encoding;
+        if (compressed.codec == CODEC_NONE)
+            compressed.codec = CODEC_XOR;
+        return new BinaryResultsWriter(fileName, compressed);
+    }
+    return new TextResultsWriter(fileName);
+}
+
+OutputVariable::OutputVariable()
+{
+    value = nullptr;
+    arg = 0;
+}
+
+bool findOutputVariable(const std::string &name, const RiverProfile *rn, OutputVariable &v)
+{
+    v.name = name;
+    v.arg = 0;
+
+    for (unsigned int n = 0; n < sizeof(namedValues) / sizeof(namedValues[0]); n++)
+    {
+        if (name == namedValues[n].name)
+        {
+            v.value = namedValues[n].value;
+            return true;
+        }
+    }
+
+    for (unsigned int n = 0; n < sizeof(numberedValues) / sizeof(numberedValues[0]); n++)
+    {
+        std::string prefix = numberedValues[n].prefix;
+        if (name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix) != 0)
+            continue;
+        std::string number = name.substr(prefix.size());
+        if (number.find_first_not_of("0123456789") != std::string::npos)
+            return false;
+        v.arg = std::stoi(number);
+        unsigned int limit = numberedValues[n].layer ? rn->nlayer : rn->ngsz;
+        if (v.arg < 0 || (unsigned int)v.arg >= limit)
+            return false;
+        v.value = numberedValues[n].value;
+        return true;
+    }
+
+    return false;
+}
+
+OutputStream::OutputStream(ResultsWriter *w, int interval) :
+    writer(w), interval(interval)
+{
+}
+
+OutputStream::~OutputStream()
+{
+    delete writer;
+}
+
+void OutputStream::addNode(const RiverProfile *rn, unsigned int node)
+{
+    if (node >= (unsigned int)rn->nnodes)
+        throw GrateError("Output node is outside the grid: " + std::to_string(node));
+    nodes.push_back(node);
+    weights.push_back(0.);
+    x.push_back(rn->xx[node]);
+}
+
+void OutputStream::addGauge(const RiverProfile *rn, double chainage)
+{
+    if (rn->nnodes < 2 || chainage < rn->xx[0] || chainage > rn->xx[rn->nnodes - 1])
+        throw GrateError("Gauge is outside the grid at chainage " + std::to_string(chainage));
+
+    unsigned int i = 0;
+    while (i + 2 < (unsigned int)rn->nnodes && rn->xx[i + 1] <= chainage)
+        i++;
+    nodes.push_back(i);
+    weights.push_back((chainage - rn->xx[i]) / (rn->xx[i + 1] - rn->xx[i]));
+    x.push_back(chainage);
+}
+
+void OutputStream::countMemory(MemoryCount &c) const
+{
+    c.addVector(variables);
+    c.addVector(nodes);
+    c.addVector(weights);
+    c.addVector(x);
+    writer->countMemory(c);
+}
+
+ResultsLayout OutputStream::layout(const RiverProfile *rn) const
+{
+    ResultsLayout layout;
+
+    for (unsigned int v = 0; v < variables.size(); v++)
+        layout.variables.push_back(variables[v].name);
+    layout.nodes = nodes;
+    layout.x = x;
+
+    layout.attributes.push_back(std::make_pair(std::string("qwTweak"), rn->qwTweak));
+    layout.attributes.push_back(std::make_pair(std::string("qsTweak"), rn->qsTweak));
+    layout.attributes.push_back(std::make_pair(std::string("substrDial"), rn->substrDial));
+    layout.attributes.push_back(std::make_pair(std::string("feedQw"), rn->feedQw));
+    layout.attributes.push_back(std::make_pair(std::string("feedQs"), rn->feedQs));
+    layout.attributes.push_back(std::make_pair(std::string("HmaxTweak"), rn->HmaxTweak));
+    layout.attributes.push_back(std::make_pair(std::string("randAbr"), rn->randAbr));
+
+    layout.startTime = rn->startTime;
+    return layout;
+}
+
+void OutputStream::capture(const RiverProfile *rn, const sed *sd, ResultsSnapshot &s) const
+{
+    GrateTime start = rn->startTime;
+    s.counter = rn->counter;
+    s.seconds = start.secsTo(rn->cTime);
+
+    s.columns.resize(variables.size());
+    for (unsigned int v = 0; v < variables.size(); v++)
+    {
+        const OutputVariable &var = variables[v];
+        std::vector<double> &col = s.columns[v];
+        col.resize(nodes.size());
+        for (unsigned int p = 0; p < nodes.size(); p++)
+        {
+            unsigned int i = nodes[p];
+            if (weights[p] == 0.)
+                col[p] = var.value(rn, sd, i, var.arg);
+            else
+                col[p] = (1. - weights[p]) * var.value(rn, sd, i, var.arg) + weights[p] * var.value(rn, sd, i + 1, var.arg);
+        }
+    }
+}
+
+OutputStream *legacyStream(const RiverProfile *rn, const std::string &fileName)
+{
+    OutputStream *stream = new OutputStream(makeResultsWriter(fileName), 0);
+    for (unsigned int v = 0; v < nLegacyColumns; v++)
+    {
+        OutputVariable var;
+        findOutputVariable(legacyColumns[v], rn, var);
+        stream->variables.push_back(var);
+    }
+    for (int i = 0; i < rn->nnodes; i++)
+        stream->addNode(rn, i);
+    return stream;
+}
+
+static OutputStream *readStream(XMLElement *e, const RiverProfile *rn, const std::string &mainFile)
+{
+    const char *name = e->Attribute("name");
+    if (name == NULL)
+        throw GrateError("Output stream without a name attribute");
+
+    // file name from the main results file: GrateResults.txt + "gauges" -> GrateResults_gauges.grb
+    std::string stem = mainFile;
+    size_t dot = stem.find_last_of('.');
+    if (dot != std::string::npos && stem.find_first_of("/\\", dot) == std::string::npos)
+        stem = stem.substr(0, dot);
+    const char *format = e->Attribute("format");
+    std::string ext;
+    ResultsEncoding encoding;
+    if (format == NULL || std::string(format) == "binary")
+        ext = ".grb";
+    else if (std::string(format) == "text")
+        ext = ".txt";
+    else if (std::string(format) == "compressed")
+    {
+        // lossless unless given a tolerance: then values are quantised to within it
+        ext = ".grz";
+        encoding.codec = CODEC_XOR;
+        if (e->QueryDoubleAttribute("tolerance", &encoding.tolerance) == XML_SUCCESS)
+        {
+            if (not (encoding.tolerance > 0.))
+                throw GrateError("Bad tolerance for output stream " + std::string(name));
+            encoding.codec = CODEC_QUANTISED;
+        }
+        else if (e->Attribute("tolerance") != NULL)
+            throw GrateError("Bad tolerance for output stream " + std::string(name));
+        if (e->QueryUnsignedAttribute("keyframe", &encoding.keyframeInterval) == XML_WRONG_ATTRIBUTE_TYPE ||
+                encoding.keyframeInterval < 1)
+            throw GrateError("Bad keyframe interval for output stream " + std::string(name));
+    }
+    else
+        throw GrateError("Unknown format for output stream " + std::string(name) + ": " + format);
+
+    bool gauges = std::string(e->Name()) == "GAUGES";
+    int interval = gauges ? 1 : rn->writeInterval;
+    if (e->QueryIntAttribute("interval", &interval) == XML_WRONG_ATTRIBUTE_TYPE || interval < 1)
+        throw GrateError("Bad interval for output stream " + std::string(name));
+
+    OutputStream *stream = new OutputStream(makeResultsWriter(stem + "_" + name + ext, encoding), interval);
+    try {
+        const char *vars = e->Attribute("variables");
+        if (vars == NULL)
+            throw GrateError("Output stream " + std::string(name) + " has no variables");
+        std::vector<std::string> varNames = splitList(vars);
+        for (unsigned int v = 0; v < varNames.size(); v++)
+        {
+            OutputVariable var;
+            if (not findOutputVariable(varNames[v], rn, var))
+                throw GrateError("Unknown output variable " + varNames[v] + " in stream " + name);
+            stream->variables.push_back(var);
+        }
+
+        if (gauges)
+        {
+            const char *xs = e->Attribute("x");
+            if (xs == NULL)
+                throw GrateError("Gauges " + std::string(name) + " have no x attribute");
+            std::vector<std::string> chainages = splitList(xs);
+            for (unsigned int g = 0; g < chainages.size(); g++)
+                stream->addGauge(rn, std::stod(chainages[g]));
+        }
+        else if (e->Attribute("nodes") != NULL)
+        {
+            std::vector<std::string> list = splitList(e->Attribute("nodes"));
+            for (unsigned int n = 0; n < list.size(); n++)
+                stream->addNode(rn, std::stoi(list[n]));
+        }
+        else
+        {
+            int first = 0, last = rn->nnodes - 1, stride = 1;
+            if (e->QueryIntAttribute("first", &first) == XML_WRONG_ATTRIBUTE_TYPE ||
+                    e->QueryIntAttribute("last", &last) == XML_WRONG_ATTRIBUTE_TYPE ||
+                    e->QueryIntAttribute("stride", &stride) == XML_WRONG_ATTRIBUTE_TYPE ||
+                    stride < 1 || first < 0 || last < first)
+                throw GrateError("Bad node range for output stream " + std::string(name));
+            for (int i = first; i <= last; i += stride)
+                stream->addNode(rn, i);
+        }
+
+        if (stream->nodes.empty())
+            throw GrateError("Output stream " + std::string(name) + " has no output points");
+    }
+    catch (const std::logic_error &) {
+        delete stream;
+        throw GrateError("Bad number in output stream " + std::string(name));
+    }
+    catch (...) {
+        delete stream;
+        throw;
+    }
+    return stream;
+}
+
+std::vector<OutputStream*> readOutputStreams(XMLElement *outElem, const RiverProfile *rn,
+                                             const std::string &mainFile, bool &legacy)
+{
+    std::vector<OutputStream*> streams;
+    legacy = true;
+
+    if (outElem == NULL)
+        return streams;
+
+    if (outElem->QueryBoolAttribute("legacy", &legacy) == XML_WRONG_ATTRIBUTE_TYPE)
+        throw GrateError("Error getting legacy attribute of OUTPUT element");
+
+    try {
+        for (XMLElement* e = outElem->FirstChildElement(); e != NULL; e = e->NextSiblingElement())
+        {
+            std::string kind = e->Name();
+            if (kind != "STREAM" && kind != "GAUGES")
+                throw GrateError("Unknown element in OUTPUT: " + kind);
+            streams.push_back(readStream(e, rn, mainFile));
+        }
+    }
+    catch (...) {
+        for (unsigned int s = 0; s < streams.size(); s++)
+            delete streams[s];
+        throw;
+    }
+    return streams;
+}
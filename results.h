@@ -0,0 +1,199 @@
+#ifndef RESULTS_H
+#define RESULTS_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "footprint.h"
+#include "resultsfile.h"
+#include "tinyxml2/tinyxml2.h"
+
+using namespace tinyxml2;
+
+class RiverProfile;
+class sed;
+
+
+// A named quantity that can be written for each node, e.g. ETA or PCT03 (see results.cpp for the list)
+class OutputVariable
+{
+public:
+
+    typedef double (*NodeValue)(const RiverProfile *rn, const sed *sd, unsigned int node, int arg);
+
+    OutputVariable();
+
+    std::string name;
+    NodeValue value;
+    int arg;                                   // Size class or storage layer, for the numbered variables
+};
+
+bool findOutputVariable(const std::string &name, const RiverProfile *rn, OutputVariable &v);
+
+class ResultsWriter
+{
+public:
+
+    explicit ResultsWriter(const std::string &name);
+    virtual ~ResultsWriter();
+
+    virtual void open(const ResultsLayout &layout, bool resume) = 0;   // resume appends to the existing file(s)
+    virtual void write(const ResultsSnapshot &s) = 0;                  // on disk by the next flush(), or when closed
+    virtual std::vector<std::string> files() const;                    // every file written, e.g. for checkpoints
+    virtual void countMemory(MemoryCount &c);                          // buffers held, see footprint.h
+
+    // The model captures each output step into buffer() and then calls commit()
+    virtual ResultsSnapshot &buffer();
+    virtual void commit();
+    virtual void flush();                                              // everything committed is on disk
+
+    std::string fileName;
+
+protected:
+    ResultsSnapshot step;
+};
+
+// Text results file, as read by tests/compare and post-processing scripts. Numbers are formatted
+// with std::to_chars into a reused buffer, exactly as ostream's default %g with 6 digits would,
+// and each output step reaches the file in a single write.
+class TextResultsWriter : public ResultsWriter
+{
+public:
+
+    explicit TextResultsWriter(const std::string &name);
+
+    void open(const ResultsLayout &layout, bool resume);
+    void write(const ResultsSnapshot &s);
+    void countMemory(MemoryCount &c);
+
+private:
+    std::ofstream out;
+    std::string buf;
+
+    void put(const std::string &text) { buf += text; }
+    void put(char c) { buf += c; }
+    void put(double v);
+    void put(unsigned int v);
+    void writeBuffer();
+};
+
+// Writes binary results files (see resultsfile.h). With a codec, each frame is encoded against
+// the one before, with a keyframe every encoding.keyframeInterval frames and at every resume.
+// Frames are buffered, and reach the disk at a flush() (a checkpoint) or when the writer closes:
+// the data file first, then its index.
+class BinaryResultsWriter : public ResultsWriter
+{
+public:
+
+    explicit BinaryResultsWriter(const std::string &name, const ResultsEncoding &encoding = ResultsEncoding());
+    ~BinaryResultsWriter();
+
+    void open(const ResultsLayout &layout, bool resume);
+    void write(const ResultsSnapshot &s);
+    void flush();
+    std::vector<std::string> files() const;
+    void countMemory(MemoryCount &c);
+
+private:
+    std::ofstream data;
+    std::ofstream index;
+    uint64_t offset;                           // Where the next frame starts in the data file
+    std::vector<char> frame;                   // Reused frame buffer, so each frame is one write
+
+    ResultsEncoding encoding;
+    std::unique_ptr<FrameCodec> encoder;
+    unsigned int sinceKeyframe;                // Frames written since the last keyframe
+    std::vector<uint8_t> encoded;
+};
+
+// Hands output steps to a writer thread, so the model doesn't wait for formatting and disk I/O.
+// Steps are captured into a small ring of reused buffers; the model only blocks in buffer()
+// when every buffer is still waiting to be written. Errors from the writer thread are
+// rethrown on the model thread by the next buffer(), commit() or flush().
+class AsyncResultsWriter : public ResultsWriter
+{
+public:
+
+    explicit AsyncResultsWriter(ResultsWriter *w, unsigned int nbuffers = 2);    // takes ownership of w
+    ~AsyncResultsWriter();
+
+    void open(const ResultsLayout &layout, bool resume);
+    void write(const ResultsSnapshot &s);
+    std::vector<std::string> files() const;
+    void countMemory(MemoryCount &c);          // waits for the steps pending to be written
+
+    ResultsSnapshot &buffer();
+    void commit();
+    void flush();
+
+private:
+    ResultsWriter *inner;
+    std::vector<ResultsSnapshot> buffers;
+    std::deque<size_t> freeBuffers;
+    std::deque<size_t> pending;                // committed, in order, not yet written
+    size_t current;                            // buffer handed out by buffer(), if holding
+    bool holding;
+    bool writing;                              // writer thread is busy with the front of pending
+    bool stopping;
+    std::exception_ptr error;
+
+    std::mutex lock;
+    std::condition_variable changed;
+    std::thread worker;
+
+    void run();
+    void rethrow();                            // call with lock held
+};
+
+// Text or binary, depending on the file extension: .grb is binary, .grz is binary compressed
+// with the lossless codec unless 'encoding' says otherwise
+ResultsWriter *makeResultsWriter(const std::string &fileName, const ResultsEncoding &encoding = ResultsEncoding());
+
+// One results file: a set of variables at a set of nodes, written every 'interval' steps.
+// Output points can be grid nodes or virtual gauges, which interpolate between the two
+// nodes either side of a chainage.
+class OutputStream
+{
+public:
+
+    OutputStream(ResultsWriter *w, int interval);   // takes ownership of w
+    ~OutputStream();
+
+    ResultsWriter *writer;
+    int interval;                              // Steps between outputs; 0 follows RiverProfile::writeInterval
+
+    std::vector<OutputVariable> variables;
+    std::vector<unsigned int> nodes;           // Node, or the node upstream of a gauge
+    std::vector<double> weights;               // Weight of the next node, 0 at grid nodes
+    std::vector<double> x;                     // Chainage (m) of each output point
+
+    void addNode(const RiverProfile *rn, unsigned int node);
+    void addGauge(const RiverProfile *rn, double chainage);
+
+    ResultsLayout layout(const RiverProfile *rn) const;
+    void countMemory(MemoryCount &c) const;
+    void capture(const RiverProfile *rn, const sed *sd, ResultsSnapshot &s) const;
+
+private:
+    OutputStream(const OutputStream &);             // not copyable: owns the writer
+    OutputStream &operator=(const OutputStream &);
+};
+
+// The 24 columns at every node, as in the original results file
+OutputStream *legacyStream(const RiverProfile *rn, const std::string &fileName);
+
+// Streams from the optional OUTPUT element of the input file (NULL if there isn't one). Stream
+// file names are built from the main results file name, e.g. GrateResults_gauges.grb, so ensemble
+// members don't collide. 'legacy' is set false if the OUTPUT element turns off the main results file.
+std::vector<OutputStream*> readOutputStreams(XMLElement *outElem, const RiverProfile *rn,
+                                             const std::string &mainFile, bool &legacy);
+
+#endif // RESULTS_H
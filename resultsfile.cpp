@@ -0,0 +1,315 @@
+/*******************
+ *
+ *
+ *  GRATE 9
+ *
+ *  Binary results files: header and reader
+ *
+ *
+ *
+*********************/
+
+#include "resultsfile.h"
+#include "grateerror.h"
+#include <cstring>
+#include <ciso646>
+
+namespace {
+
+const char resultsMagic[8] = {'G', 'R', 'A', 'T', 'E', 'R', 'E', 'S'};
+const char indexMagic[8] = {'G', 'R', 'A', 'T', 'E', 'I', 'D', 'X'};
+const uint32_t endianMarker = 0x01020304;
+const size_t nameLength = 32;                  // Variable and attribute names are fixed width in the header
+const size_t frameHeaderBytes = 2 * sizeof(uint64_t);
+const size_t noFrame = size_t(-1);
+
+template <class T> void put(std::vector<char> &buf, const T &v)
+{
+    const char *p = reinterpret_cast<const char*>(&v);
+    buf.insert(buf.end(), p, p + sizeof(T));
+}
+
+void putName(std::vector<char> &buf, const std::string &name)
+{
+    if (name.size() >= nameLength)
+        throw GrateError("Name too long for the binary results header: " + name);
+    std::vector<char> field(nameLength, '\0');
+    std::memcpy(field.data(), name.data(), name.size());
+    buf.insert(buf.end(), field.begin(), field.end());
+}
+
+void pad8(std::vector<char> &buf)
+{
+    while (buf.size() % 8 != 0)
+        buf.push_back('\0');
+}
+
+template <class T> void get(std::ifstream &in, T &v, const std::string &fileName)
+{
+    in.read(reinterpret_cast<char*>(&v), sizeof(T));
+    if (not in)
+        throw GrateError("Binary results file is truncated: " + fileName);
+}
+
+std::string getName(std::ifstream &in, const std::string &fileName)
+{
+    char field[nameLength];
+    in.read(field, nameLength);
+    if (not in)
+        throw GrateError("Binary results file is truncated: " + fileName);
+    field[nameLength - 1] = '\0';
+    return std::string(field);
+}
+
+void skipPad8(std::ifstream &in)
+{
+    std::streamoff pos = in.tellg();
+    if (pos % 8 != 0)
+        in.seekg(8 - pos % 8, std::ios::cur);
+}
+
+}  // namespace
+
+
+ResultsSnapshot::ResultsSnapshot()
+{
+    counter = 0;
+    seconds = 0.;
+}
+
+ResultsEncoding::ResultsEncoding()
+{
+    codec = CODEC_NONE;
+    keyframeInterval = 16;
+    tolerance = 0.;
+}
+
+std::vector<char> resultsHeader(const ResultsLayout &layout, const ResultsEncoding &encoding)
+{
+    std::vector<char> header;
+    header.insert(header.end(), resultsMagic, resultsMagic + sizeof(resultsMagic));
+    put(header, uint32_t(RESULTS_VERSION));
+    put(header, endianMarker);
+    put(header, uint32_t(layout.variables.size()));
+    put(header, uint32_t(layout.nodes.size()));
+    put(header, uint32_t(layout.attributes.size()));
+    put(header, uint32_t(encoding.codec));
+    put(header, uint32_t(encoding.keyframeInterval));
+    put(header, encoding.tolerance);
+
+    std::tm t = layout.startTime.getTm();
+    int32_t start[6] = {t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec};
+    for (int i = 0; i < 6; i++)
+        put(header, start[i]);
+
+    for (unsigned int v = 0; v < layout.variables.size(); v++)
+        putName(header, layout.variables[v]);
+    for (unsigned int a = 0; a < layout.attributes.size(); a++)
+    {
+        putName(header, layout.attributes[a].first);
+        put(header, layout.attributes[a].second);
+    }
+    for (unsigned int i = 0; i < layout.nodes.size(); i++)
+        put(header, uint32_t(layout.nodes[i]));
+    pad8(header);
+    for (unsigned int i = 0; i < layout.x.size(); i++)
+        put(header, layout.x[i]);
+    return header;
+}
+
+std::vector<char> resultsIndexHeader()
+{
+    // sized up front: GCC 12 sees a write past the end in growing an empty vector here
+    std::vector<char> header(indexMagic, indexMagic + sizeof(indexMagic));
+    header.reserve(sizeof(indexMagic) + 2 * sizeof(uint32_t));
+    put(header, uint32_t(RESULTS_INDEX_VERSION));
+    put(header, uint32_t(4 * sizeof(uint64_t)));    // record size
+    return header;
+}
+
+BinaryResultsFile::BinaryResultsFile(const std::string &name) :
+    fileName(name), decodedFrame(noFrame)
+{
+    data.open(fileName, std::ios::in | std::ios::binary);
+    if (not data)
+        throw GrateError("Error opening binary results file: " + fileName);
+
+    char magic[8];
+    data.read(magic, sizeof(magic));
+    if (not data || std::memcmp(magic, resultsMagic, sizeof(magic)) != 0)
+        throw GrateError("Not a Grate binary results file: " + fileName);
+
+    uint32_t version, endian, nvars, nnodes, nattrs;
+    get(data, version, fileName);
+    get(data, endian, fileName);
+    if (endian != endianMarker)
+        throw GrateError("Binary results file was written with a different byte order: " + fileName);
+    if (version != 1 && version != RESULTS_VERSION)
+        throw GrateError("Unsupported binary results version in " + fileName);
+    get(data, nvars, fileName);
+    get(data, nnodes, fileName);
+    get(data, nattrs, fileName);
+
+    // version 1 files are always uncompressed
+    if (version >= 2)
+    {
+        uint32_t codec, keyframeInterval;
+        get(data, codec, fileName);
+        get(data, keyframeInterval, fileName);
+        get(data, encoding.tolerance, fileName);
+        encoding.codec = codec;
+        encoding.keyframeInterval = keyframeInterval;
+        if (codec != CODEC_NONE)
+            decoder.reset(new FrameCodec(codec, encoding.tolerance));
+    }
+
+    int32_t start[6];
+    for (int i = 0; i < 6; i++)
+        get(data, start[i], fileName);
+    layout.startTime = GrateTime(start[0], start[1], start[2], start[3], start[4], start[5]);
+
+    for (unsigned int v = 0; v < nvars; v++)
+        layout.variables.push_back(getName(data, fileName));
+    for (unsigned int a = 0; a < nattrs; a++)
+    {
+        std::string attrName = getName(data, fileName);
+        double value;
+        get(data, value, fileName);
+        layout.attributes.push_back(std::make_pair(attrName, value));
+    }
+    layout.nodes.resize(nnodes);
+    for (unsigned int i = 0; i < nnodes; i++)
+        get(data, layout.nodes[i], fileName);
+    skipPad8(data);
+    layout.x.resize(nnodes);
+    for (unsigned int i = 0; i < nnodes; i++)
+        get(data, layout.x[i], fileName);
+
+    decoded.assign(nvars, std::vector<double>(nnodes));
+
+    // the index is small: read it whole
+    std::ifstream index(fileName + ".idx", std::ios::in | std::ios::binary);
+    if (not index)
+        throw GrateError("Error opening binary results index: " + fileName + ".idx");
+    index.read(magic, sizeof(magic));
+    uint32_t indexVersion, recordSize;
+    if (not index || std::memcmp(magic, indexMagic, sizeof(magic)) != 0)
+        throw GrateError("Not a Grate binary results index: " + fileName + ".idx");
+    get(index, indexVersion, fileName);
+    get(index, recordSize, fileName);
+    if (indexVersion != RESULTS_INDEX_VERSION || recordSize != sizeof(IndexRecord))
+        throw GrateError("Unsupported binary results index in " + fileName + ".idx");
+
+    // a run that stopped before all its frames reached the disk may have indexed some that didn't
+    data.seekg(0, std::ios::end);
+    uint64_t dataBytes = uint64_t(data.tellg());
+    IndexRecord r;
+    while (index.read(reinterpret_cast<char*>(&r), sizeof(r)) && r.offset + r.bytes <= dataBytes)
+        records.push_back(r);
+}
+
+size_t BinaryResultsFile::frameCount() const
+{
+    return records.size();
+}
+
+unsigned int BinaryResultsFile::counter(size_t frame) const
+{
+    return records.at(frame).counter;
+}
+
+double BinaryResultsFile::seconds(size_t frame) const
+{
+    return records.at(frame).seconds;
+}
+
+int BinaryResultsFile::variableIndex(const std::string &name) const
+{
+    for (unsigned int v = 0; v < layout.variables.size(); v++)
+        if (layout.variables[v] == name)
+            return v;
+    return -1;
+}
+
+std::vector<double> BinaryResultsFile::read(size_t frame, int variable)
+{
+    if (variable < 0 || variable >= int(layout.variables.size()))
+        throw GrateError("No such variable in binary results file: " + fileName);
+
+    if (decoder)
+        return readAll(frame)[variable];
+
+    const IndexRecord &r = records.at(frame);
+    size_t nnodes = layout.nodes.size();
+    uint64_t pos = r.offset + frameHeaderBytes + uint64_t(variable) * nnodes * sizeof(double);
+
+    std::vector<double> values(nnodes);
+    data.clear();
+    data.seekg(pos);
+    data.read(reinterpret_cast<char*>(values.data()), nnodes * sizeof(double));
+    if (not data)
+        throw GrateError("Binary results file is truncated: " + fileName);
+    return values;
+}
+
+const std::vector< std::vector<double> > &BinaryResultsFile::readAll(size_t frame)
+{
+    if (frame >= records.size())
+        throw GrateError("No such frame in binary results file: " + fileName);
+    if (frame == decodedFrame)
+        return decoded;
+
+    if (not decoder)
+    {
+        for (unsigned int v = 0; v < layout.variables.size(); v++)
+            decoded[v] = read(frame, v);
+        decodedFrame = frame;
+        return decoded;
+    }
+
+    // carry on from the last frame decoded if that's the one before; otherwise go back to
+    // the keyframe at or before this frame
+    uint32_t flags, rawBytes;
+    size_t first = frame;
+    if (decodedFrame == noFrame || decodedFrame + 1 != frame)
+    {
+        for (;; first--)
+        {
+            readFrame(first, flags, rawBytes);
+            if (flags & FRAME_KEYFRAME)
+                break;
+            if (first == 0)
+                throw GrateError("Compressed results file has no keyframe: " + fileName);
+        }
+    }
+    else
+        readFrame(first, flags, rawBytes);
+
+    for (size_t f = first; ; )
+    {
+        decodedFrame = noFrame;
+        decoder->decode(payload.data(), payload.size(), rawBytes, flags & FRAME_KEYFRAME, decoded);
+        decodedFrame = f;
+        if (f == frame)
+            break;
+        readFrame(++f, flags, rawBytes);
+    }
+    return decoded;
+}
+
+void BinaryResultsFile::readFrame(size_t frame, uint32_t &flags, uint32_t &rawBytes)
+{
+    const IndexRecord &r = records.at(frame);
+    size_t headerBytes = frameHeaderBytes + 2 * sizeof(uint32_t);
+    if (r.bytes < headerBytes)
+        throw GrateError("Compressed results frame is corrupt in " + fileName);
+
+    data.clear();
+    data.seekg(r.offset + frameHeaderBytes);
+    get(data, flags, fileName);
+    get(data, rawBytes, fileName);
+    payload.resize(r.bytes - headerBytes);
+    data.read(reinterpret_cast<char*>(payload.data()), payload.size());
+    if (not data)
+        throw GrateError("Binary results file is truncated: " + fileName);
+}
@@ -0,0 +1,106 @@
+#ifndef RESULTSFILE_H
+#define RESULTSFILE_H
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "codec.h"
+#include "gratetime.h"
+
+// Binary results files, without the model: the grate_results library that post-processing
+// tools (e.g. GrateExtract) link against.
+
+
+// Results of one output step: the output variables at the output nodes, stored by variable
+class ResultsSnapshot
+{
+public:
+
+    ResultsSnapshot();
+
+    unsigned int counter;                      // Model step
+    double seconds;                            // Model time since the start of the run (s)
+    std::vector< std::vector<double> > columns;    // [variable][node]
+};
+
+// What a results file contains; written once at the top of the file
+class ResultsLayout
+{
+public:
+
+    std::vector<std::string> variables;
+    std::vector<unsigned int> nodes;           // Grid nodes that are written
+    std::vector<double> x;                     // Chainage (m) of those nodes
+    std::vector< std::pair<std::string, double> > attributes;    // Run settings, e.g. randomisers
+    GrateTime startTime;
+};
+
+// How the frames of a binary results file are stored (see codec.h)
+class ResultsEncoding
+{
+public:
+
+    ResultsEncoding();
+
+    unsigned int codec;                        // CODEC_NONE for plain .grb files
+    unsigned int keyframeInterval;             // Frames between keyframes
+    double tolerance;                          // Largest error, for CODEC_QUANTISED
+};
+
+// Binary results file (.grb, or .grz when compressed). After a header describing the variables,
+// nodes and encoding, each output step is one frame: counter, time, then every variable as a
+// contiguous block of doubles. Compressed frames hold flags and the decoded size instead, then
+// the encoded values. A fixed-record index (<file>.idx) gives the offset of each frame.
+#define RESULTS_VERSION 2
+#define RESULTS_INDEX_VERSION 1
+
+std::vector<char> resultsHeader(const ResultsLayout &layout, const ResultsEncoding &encoding);
+std::vector<char> resultsIndexHeader();
+
+const uint32_t FRAME_KEYFRAME = 1;             // Compressed frame flags
+
+// Binary results reader: any variable at any output step, without reading the rest of the file.
+// Compressed frames are decoded from the nearest keyframe, and the last frame decoded is kept,
+// so reading frames in order costs one decode each.
+class BinaryResultsFile
+{
+public:
+
+    explicit BinaryResultsFile(const std::string &name);
+
+    ResultsLayout layout;
+    ResultsEncoding encoding;
+
+    size_t frameCount() const;
+    unsigned int counter(size_t frame) const;
+    double seconds(size_t frame) const;
+    int variableIndex(const std::string &name) const;     // -1 if not in the file
+
+    std::vector<double> read(size_t frame, int variable);  // variable at every output node
+    const std::vector< std::vector<double> > &readAll(size_t frame);  // [variable][node]
+
+private:
+    struct IndexRecord
+    {
+        uint64_t counter;
+        double seconds;
+        uint64_t offset;
+        uint64_t bytes;
+    };
+
+    std::string fileName;
+    std::ifstream data;
+    std::vector<IndexRecord> records;
+
+    std::unique_ptr<FrameCodec> decoder;
+    std::vector< std::vector<double> > decoded;
+    size_t decodedFrame;                       // frameCount() if none
+    std::vector<uint8_t> payload;
+
+    void readFrame(size_t frame, uint32_t &flags, uint32_t &rawBytes);   // compressed frames
+};
+
+#endif // RESULTSFILE_H
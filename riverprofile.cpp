@@ -18,8 +18,7 @@
 #include <iomanip>
 #include <iostream>
 #include "riverprofile.h"
-#include "tinyxml2/tinyxml2.h"
-#include "tinyxml2_wrapper.h"
+#include "grateerror.h"
 
 using namespace std;
 using namespace tinyxml2;
@@ -32,7 +31,7 @@ using namespace tinyxml2;
 double gammln2(double xx)
 {
   double x,y,tmp,ser;
-  static double cof[6]={76.18009172947146,    -86.50532032941677,
+  static const double cof[6]={76.18009172947146,    -86.50532032941677,
             24.01409824083091,    -1.231739572450155,
             0.1208650973866179e-2,-0.5395239384953e-5};
   int j;
@@ -144,6 +143,72 @@ void NodeGSDObject::dg_and_std()
         stdv = sqrt(stdv);
 }
 
+Stratigraphy::Stratigraphy() : copiesTaken(0)
+{
+    nnodes = 0;
+    nlayer = 0;
+    copiesSeen = 0;
+}
+
+Stratigraphy::Stratigraphy(const Stratigraphy &other) : copiesTaken(0)
+{
+    nnodes = 0;
+    nlayer = 0;
+    copiesSeen = 0;
+    *this = other;
+}
+
+Stratigraphy &Stratigraphy::operator=(const Stratigraphy &other)
+{
+    if (this == &other)
+        return *this;
+
+    // neither side owns a layer they now share: this one clears its flags, the other clears its
+    // own when it next edits and finds another copy has been taken
+    nnodes = other.nnodes;
+    nlayer = other.nlayer;
+    cells = other.cells;
+    owned.assign(cells.size(), 0);
+    copiesSeen = copiesTaken.load(memory_order_acquire);
+    other.copiesTaken.fetch_add(1, memory_order_acq_rel);
+    return *this;
+}
+
+void Stratigraphy::assign(unsigned int nodes, unsigned int layers, const NodeGSDObject &init)
+{
+    nnodes = nodes;
+    nlayer = layers;
+
+    // every layer starts out sharing the one initial GSD
+    shared_ptr<NodeGSDObject> shared = make_shared<NodeGSDObject>(init);
+    cells.assign(nnodes * nlayer, shared);
+    owned.assign(cells.size(), 0);
+}
+
+NodeGSDObject &Stratigraphy::edit(unsigned int node, unsigned int z)
+{
+    // a copy taken since the flags were set shares every layer with this one
+    unsigned long taken = copiesTaken.load(memory_order_acquire);
+    if (taken != copiesSeen)
+    {
+        owned.assign(cells.size(), 0);
+        copiesSeen = taken;
+    }
+
+    unsigned int c = node * nlayer + z;
+    if (not owned[c])
+    {
+        cells[c] = make_shared<NodeGSDObject>(*cells[c]);   // another layer or copy may still refer to it
+        owned[c] = 1;
+    }
+    return *cells[c];
+}
+
+bool Stratigraphy::owns(unsigned int node, unsigned int z) const
+{
+    return copiesTaken.load(memory_order_acquire) == copiesSeen && owned[node * nlayer + z];
+}
+
 NodeXSObject::NodeXSObject()                  //Initialize list
 {
      node = 0;
@@ -455,8 +520,9 @@ TS_Object::TS_Object()
 
 }
 
-RiverProfile::RiverProfile(XMLElement* params_root)
+RiverProfile::RiverProfile(const ModelSetup &setup, ostream *logSink)
 {
+    diag.setSink(logSink);
 
     NodeXSObject tmp;       // to initialize RiverXS
     nnodes = 0;
@@ -496,13 +562,13 @@ RiverProfile::RiverProfile(XMLElement* params_root)
                                                  // Random tweak variables are based on logarithmic (e) scaled values
                                                  // Augment the rate of tributary Qs, Qw inputs
     //tweakArray = hydroGraph();                        // A gamma-distribution that simulates hydrograph form
-    qsTweak = 1;                                      // rand_nums[1] * 1.5 + 0.5;        // qs between 0.5 and 2
-    qwTweak = 1;                                      // Hydrograph multiplier
-    substrDial = 0;                                   // rand_nums[3]  * 3.8 - 1.9;      // Positive (up to +2) makes finer mix, negative (down to -2) coarsens all grain groups
-    feedQw =  1;                                      // rand_nums[4]  * 0.5 + 0.75;     // between 0.75 and 1.25
-    feedQs =  1;                                      // rand_nums[5] + 0.5;                     // between 0.5 and 1.5
-    HmaxTweak = 1;                                    // See line ~750ff
-    randAbr = 0.00001;                                // between 10^-4 and 10^-7
+    qsTweak = setup.qsTweak;                          // rand_nums[1] * 1.5 + 0.5;        // qs between 0.5 and 2
+    qwTweak = setup.qwTweak;                          // Hydrograph multiplier
+    substrDial = setup.substrDial;                    // rand_nums[3]  * 3.8 - 1.9;      // Positive (up to +2) makes finer mix, negative (down to -2) coarsens all grain groups
+    feedQw = setup.feedQw;                            // rand_nums[4]  * 0.5 + 0.75;     // between 0.75 and 1.25
+    feedQs = setup.feedQs;                            // rand_nums[5] + 0.5;                     // between 0.5 and 1.5
+    HmaxTweak = setup.HmaxTweak;                      // See line ~750ff
+    randAbr = setup.randAbr;                          // between 10^-4 and 10^-7; RANDOMISERS may override any of these
 
     // Set up substrate shift matrix
 
@@ -532,12 +598,12 @@ RiverProfile::RiverProfile(XMLElement* params_root)
     if (substrDial <= -2) N[0] = 1;
 
     if ( ( N[0] + N[1] + N[2] + N[3] + N[4] ) > 1)
-       cout << "Interpolation Array is over 1.0";
+       diag.warning("Interpolation Array is over 1.0");
 
     sedUpw = 1.00;
     hydroUpw = 0.33;                        // Upwinding constant for finite difference scheme
 
-    initData(params_root);
+    initData(setup);
 
     outputFile = "RunResults.txt";         //  TXT file to write results
 
@@ -584,18 +650,11 @@ vector<double> RiverProfile::hydroGraph()
   return fac;
 }
 
-void RiverProfile::initData(XMLElement* params_root)
+void RiverProfile::initData(const ModelSetup &setup)
 {
-    // get params element
-    XMLElement *params = params_root->FirstChildElement("PARAMS");
-    if (params == NULL) {
-        throw std::string("Error getting PARAMS element from XML file");
-    }
-
     NodeGSDObject tmp;
-    vector < NodeGSDObject > tmp2;
 
-    nnodes = getIntValue(params, "NNODES");
+    nnodes = setup.nnodes;
 
     // Allocate vectors
     xx.resize(nnodes);
@@ -605,37 +664,33 @@ void RiverProfile::initData(XMLElement* params_root)
     bedrock.resize(nnodes);
     RiverXS.resize(nnodes);
 
-    layer = getDoubleValue(params, "LAYER");
+    layer = setup.layer;
 
     toplayer.assign(nnodes, layer);               // Thickness of the top storage layer; starts at 5 and erodes down
 
-    default_la = getDoubleValue(params, "LA");
+    default_la = setup.la;
     la.assign(nnodes, default_la);                // Default active layer thickness
 
-    nlayer = getIntValue(params, "NLAYER");
+    nlayer = setup.nlayer;
     ntop.assign(nnodes, nlayer-12);                // Indicates # of layers remaining, below current (couple of layers left for aggradation)
 
-    poro = getDoubleValue(params, "PORO");
+    poro = setup.poro;
 
-    for (unsigned int i = 0; i < nlayer; i++)                  // Init storedf stratigraphy matrix
-        tmp2.push_back(tmp);
+    storedf.assign(nnodes, nlayer, tmp);         // Init storedf stratigraphy matrix
 
     for (unsigned int i = 0; i < nnodes; i++)
-    {
-        storedf.push_back(tmp2);
         F.push_back(tmp);
-    }
 
-    ngsz = getIntValue(params, "NGSZ");
+    ngsz = setup.ngsz;
 
-    nlith = getIntValue(params, "NLITH");
+    nlith = setup.nlith;
 
-    ngrp = getIntValue(params, "NGRP");
+    ngrp = setup.ngrp;
 
     for (unsigned int i = 0; i < ngrp; i++)
         grp.push_back(tmp);
 
-    getGSDLibrary(params_root);
+    getGSDLibrary(setup);
 
     for (unsigned int i = 0; i < nnodes; i++)
     {
@@ -659,9 +714,9 @@ void RiverProfile::initData(XMLElement* params_root)
     // TODO: NPTS not in xml file but was in the old dat file (is it the same as NNODES??)
     npts = nnodes;
 
-    getLongProfile(params_root);
+    getLongProfile(setup);
 
-    getStratigraphy(params_root);
+    getStratigraphy(setup);
 
     dx = xx[1]-xx[0];                       // Assume uniform grid
     dt = 10;
@@ -669,65 +724,22 @@ void RiverProfile::initData(XMLElement* params_root)
 
 }
 
-void RiverProfile::getGSDLibrary(XMLElement* params_root)
+void RiverProfile::getGSDLibrary(const ModelSetup &setup)
 {
-    // loop over lithologies
-    for (unsigned int lithCount = 0; lithCount < nlith; lithCount++)
-    {
-        // name of this element
-        std::stringstream ss;
-        ss << "LITH" << lithCount + 1;
-        std::string lithName = ss.str();
-
-        // get the element
-        XMLElement *lithElem = params_root->FirstChildElement(lithName.c_str());
-        if (lithElem == NULL) {
-            std::ostringstream oss;
-            oss << "Error getting " << lithName << " element";
-            throw oss.str();
-        }
-
-        // loop over groups
-        int grpCount = 0;
-        for (XMLElement* e = lithElem->FirstChildElement("GRP"); e != NULL; e = e->NextSiblingElement("GRP")) {
-            // loop over psi
-            for (int gsCount = 0; gsCount < ngsz; gsCount++) {
-                // name of this psi element
-                // CHECK: do they alway start -3 to 9
-                std::stringstream ss_psi;
-                ss_psi << "PSI_" << gsCount - 3;
-                std::string psiName = ss_psi.str();
-                
-                // get the element
-                XMLElement* psiElem = e->FirstChildElement(psiName.c_str());
-                if (psiElem == NULL) {
-                    std::ostringstream oss;
-                    oss << "Error getting element " << psiName << " for " << lithName;
-                    throw oss.str();
-                }
+    for (unsigned int i = 0; i < setup.warnings.size(); i++)
+        diag.warning(setup.warnings[i]);
 
-                // get the value
-                double tmpval;
-                if (psiElem->QueryDoubleText(&tmpval)) {
-                    std::cerr << "Error getting value for " << lithName << " - " << psiName << std::endl;
-                }
-                grp[grpCount].pct[lithCount][gsCount] = tmpval;
-
-                // TODO: get other things, i.e. ABR, RHOS
-            }
+    for (unsigned int lithCount = 0; lithCount < nlith; lithCount++)
+        for (int grpCount = 0; grpCount < ngrp; grpCount++)
+        {
+            for (int gsCount = 0; gsCount < ngsz; gsCount++)
+                grp[grpCount].pct[lithCount][gsCount] = setup.psi(lithCount, grpCount, gsCount);
 
             grp[grpCount].pct[lithCount][13] = 100;    // Extra grain size slots - temporary fix.
             grp[grpCount].pct[lithCount][14] = 100;
-            grp[grpCount].abrasion[lithCount] = getDoubleValue(e, "ABR");
-            grp[grpCount].density[lithCount] = getDoubleValue(e, "RHOS");
-            grpCount++;
-        }
-        if (grpCount != ngrp) {
-            std::ostringstream oss;
-            oss << "Wrong number of groups for " << lithName;
-            throw oss.str();
+            grp[grpCount].abrasion[lithCount] = setup.gsdAbrasion[lithCount * ngrp + grpCount];
+            grp[grpCount].density[lithCount] = setup.gsdDensity[lithCount * ngrp + grpCount];
         }
-    }
 
     // Take cumulative data and turn it into normalized fractions
     for (int grpCount = 0; grpCount < ngrp; grpCount++)
@@ -775,67 +787,51 @@ void RiverProfile::getGSDLibrary(XMLElement* params_root)
     }
 }
 
-void RiverProfile::getLongProfile(XMLElement* params_root)
+void RiverProfile::getLongProfile(const ModelSetup &setup)
 {
-    // get the "profile" element
-    XMLElement *profileElem = params_root->FirstChildElement("profile");
-    if (profileElem == NULL) {
-        throw std::string("Error getting profile element from XML file");
-    }
-
-    // loop over entries
-    int m = 0;
-    for (XMLElement* e = profileElem->FirstChildElement("XX"); e != NULL; e = e->NextSiblingElement("XX")) {
-        // xx
-        if (e->QueryDoubleAttribute("X", &xx[m])) {
-            throw std::string("Error getting X attribute from XX profile element");
-        }
+    for (unsigned int m = 0; m < setup.x.size(); m++) {
+        xx[m] = setup.x[m];
 
-        eta[m] = getDoubleValue(e, "ETA");
+        eta[m] = setup.eta[m];
 
-        bedrock[m] = getDoubleValue(e, "BEDROCK");
+        bedrock[m] = setup.bedrock[m];
         if (bedrock[m] > eta[m])
             bedrock[m] = eta[m];       // bedrock must be at, or lower than, initial bed
 
-        RiverXS[m].width = getDoubleValue(e, "WIDTH");
+        RiverXS[m].width = setup.width[m];
 
-        RiverXS[m].chSinu = getDoubleValue(e, "SINU");
+        RiverXS[m].chSinu = setup.sinu[m];
 
-        RiverXS[m].fpWidth = getDoubleValue(e, "FPWIDTH") * RiverXS[m].width;
+        RiverXS[m].fpWidth = setup.fpWidth[m] * RiverXS[m].width;
 
 /*        if ( HmaxTweak < 0.5 )
             RiverXS[m].Hmax = atof(token[4]) + ( HmaxTweak * 2 - 0.5 );    // Add height in the range [-0.5 to +0.5]
         else
             RiverXS[m].Hmax = (HmaxTweak - 0.5) * 3.5 + 0.75; */             // Uniform range from 0.75 to 2.5
-        RiverXS[m].Hmax = getDoubleValue(e, "HMAX");
+        RiverXS[m].Hmax = setup.Hmax[m];
         RiverXS[m].bankHeight = RiverXS[m].Hmax + 1;  // initial guess
 
-        RiverXS[m].theta = getDoubleValue(e, "THETA");
-
-        algrp[m] = getIntValue(e, "ALGRP") - 1;
-        stgrp[m] = getIntValue(e, "STGRP") - 1;
+        RiverXS[m].theta = setup.theta[m];
 
-        m++;
+        algrp[m] = setup.algrp[m] - 1;
+        stgrp[m] = setup.stgrp[m] - 1;
     }
 }
 
-void RiverProfile::getStratigraphy(XMLElement* params_root)
+void RiverProfile::getStratigraphy(const ModelSetup &setup)
 {
-    std::ostringstream layername;
     int node = 0;
 
-    // get the "stratigraphy" element
-    XMLElement *stratElem = params_root->FirstChildElement("stratigraphy");
-    if (stratElem == 0) {
-        //throw std::string("Error getting stratigraphy element from XML file");
+    if (not setup.hasStratigraphy) {
         for (int z = 1; z < (nlayer + 1); z++){
             int st_grp = stgrp[node];      // Build stratigraphy from subsurface information
+            NodeGSDObject &st = storedf.edit(node, z-1);
             for (int j = 0; j < ngsz; j++) {
                 for (int k = 0; k < nlith; k++) {
-                    storedf[node][z-1].pct[k][j] = grp[st_grp].pct[k][j];
+                    st.pct[k][j] = grp[st_grp].pct[k][j];
                     if (j == 0){
-                        storedf[node][z-1].abrasion[k] = grp[st_grp].abrasion[k];
-                        storedf[node][z-1].density[k] = grp[st_grp].density[k];
+                        st.abrasion[k] = grp[st_grp].abrasion[k];
+                        st.density[k] = grp[st_grp].density[k];
                     }
                 }
             }
@@ -843,25 +839,21 @@ void RiverProfile::getStratigraphy(XMLElement* params_root)
     }
     else
     {   // Or, if stratigraphy does exist in the xml file, then read it in
-    for (XMLElement* e = stratElem->FirstChildElement("XXX"); e != NULL; e = e->NextSiblingElement("XXX")) {
-        if (e->QueryDoubleAttribute("X1", &xx[node])) {
-            throw std::string("Error getting X attribute from X1 stratigraphy element");
-        }
-        for (int z = 1; z < 31; z++){
-            layername << "layer" << std::setfill('0') << std::setw(2) << ( z );         // Get 'layer01', 'layer02', etc.
-            int st_grp = getIntValue(e, layername.str().c_str());
+    for (node = 0; node < int(setup.stratX.size()); node++) {
+        xx[node] = setup.stratX[node];
+        for (int z = 1; z < STRAT_LAYERS + 1; z++){
+            int st_grp = setup.stratGroups[node * STRAT_LAYERS + z - 1];
+            NodeGSDObject &st = storedf.edit(node, z-1);
             for (int j = 0; j < ngsz; j++) {
                 for (int k = 0; k < nlith; k++) {
-                    storedf[node][z-1].pct[k][j] = grp[st_grp-1].pct[k][j];
+                    st.pct[k][j] = grp[st_grp-1].pct[k][j];
                     if (j == 0){
-                        storedf[node][z-1].abrasion[k] = grp[st_grp-1].abrasion[k];
-                        storedf[node][z-1].density[k] = grp[st_grp-1].density[k];
+                        st.abrasion[k] = grp[st_grp-1].abrasion[k];
+                        st.density[k] = grp[st_grp-1].density[k];
                     }
                 }
             }
-            layername.str("");                  // clear contents of ostringstream object
             }
-        node++;
         }
     }
 
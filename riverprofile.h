@@ -2,9 +2,16 @@
 #define RIVERPROFILE_H
 
 #include <vector>
+#include <memory>
+#include <atomic>
 #include <cmath>
 #include <fstream>
+#include <iostream>
 #include "gratetime.h"
+#include "diagnostics.h"
+#include "timings.h"
+#include "solverstats.h"
+#include "setup.h"
 #include "tinyxml2/tinyxml2.h"
 
 using namespace std;
@@ -36,6 +43,42 @@ public:
     void dg_and_std();                         // Calculate D50, sand%, geometric (log2)
 };
 
+class Stratigraphy
+{
+    // Subsurface GSD elements [nnodes][nlayer]. Copies share their layers until one side
+    // modifies a layer (copy on write), so forked models don't duplicate unchanged storage layers.
+    // Each side keeps a flag for the layers it made itself since the last copy was taken of it,
+    // and only writes those in place; reference counts are never consulted, as other models may
+    // be dropping theirs on other threads.
+
+public:
+
+    Stratigraphy();
+    Stratigraphy(const Stratigraphy &other);
+    Stratigraphy &operator=(const Stratigraphy &other);
+
+    void assign(unsigned int nodes, unsigned int layers, const NodeGSDObject &init);
+
+    unsigned int nodes() const { return nnodes; }
+    unsigned int layers() const { return nlayer; }
+
+    const NodeGSDObject &layer(unsigned int node, unsigned int z) const { return *cells[node * nlayer + z]; }
+
+    NodeGSDObject &edit(unsigned int node, unsigned int z);    // Layer for writing; unshared first if need be
+
+    bool owns(unsigned int node, unsigned int z) const;     // Written in place: shared with no other layer or copy
+    size_t capacity() const { return cells.capacity(); }
+
+private:
+
+    unsigned int nnodes;
+    unsigned int nlayer;
+    vector< shared_ptr<NodeGSDObject> > cells;
+    vector<unsigned char> owned;               // 1 for a layer made by edit() since copiesSeen
+    mutable atomic<unsigned long> copiesTaken; // Copies made of this one, perhaps on other threads
+    unsigned long copiesSeen;                  // Copies taken when 'owned' was last cleared
+};
+
 class NodeXSObject
 {
 
@@ -109,7 +152,7 @@ class RiverProfile
 
 public:
 
-    RiverProfile(XMLElement* params_root);                            // Constructor
+    RiverProfile(const ModelSetup &setup, ostream *logSink = &cout);  // Constructor
     // Profile Elements
 
     int nnodes;                                // No. of points in the computational grid
@@ -136,7 +179,7 @@ public:
     double default_la;                         // Active layer default thickness at each node (0.5)
     double layer;                              // Storage layer default thickness (5 m)
 
-    vector< vector < NodeGSDObject > > storedf;// Array of subsurface GSD elements [nnodes][#store layers]
+    Stratigraphy storedf;                      // Array of subsurface GSD elements [nnodes][#store layers]
     vector<NodeGSDObject> grp;                 // 'Library' of grain size distributions
     vector<NodeGSDObject> F;                   // Array of surface GSD elements [nnodes]
     vector<double> la;                         // Thickness of the active layer (~2 D90)
@@ -164,17 +207,21 @@ public:
 
     vector<double> N;                           // Transition matrix for coarsening or fining mixtures
 
-    void initData(XMLElement* params_root);
+    void initData(const ModelSetup &setup);
     
     string outputFile;                                 //  TXT file to write results
 
+    Diagnostics diag;                          // Solver status and log sink for this model instance
+    PhaseTimes timings;                        // Time spent in each phase of the step, for this model instance
+    SolverStats solvers;                       // Convergence counters for the hydraulics since last taken
+
     vector<double> hydroGraph();
 
-    void getLongProfile(XMLElement* params_root);
+    void getLongProfile(const ModelSetup &setup);
 
-    void getGSDLibrary(XMLElement* params_root);
+    void getGSDLibrary(const ModelSetup &setup);
 
-    void getStratigraphy(XMLElement* params_root);
+    void getStratigraphy(const ModelSetup &setup);
 
     void writeResults(int count);
 
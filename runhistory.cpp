@@ -0,0 +1,107 @@
+/*******************
+ *
+ *
+ *  GRATE 9
+ *
+ *  Run history: a bounded record of the run's past steps, for the GUI to look back through
+ *
+ *
+ *
+*********************/
+
+#include "runhistory.h"
+#include "grateerror.h"
+#include <algorithm>
+#include <ciso646>
+
+
+MemoryCount HistoryFrame::memory() const
+{
+    MemoryCount m;
+    m.addBlock(sizeof(HistoryFrame));
+    m.addVector(eta);
+    m.addVector(wsl);
+    m.addVector(width);
+    m.addVector(Qs);
+    m.addVector(d50);
+    return m;
+}
+
+RunHistory::RunHistory(size_t depth, unsigned int stride)
+    : depth(depth), stride(stride), thins(0)
+{
+    if (depth < 4)
+        throw GrateError("The run history must hold at least 4 frames");
+    if (stride == 0)
+        throw GrateError("The run history stride must be at least 1 step");
+}
+
+void RunHistory::record(std::shared_ptr<const HistoryFrame> frame)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (frames.size() >= depth)
+    {
+        // keep the even frames of the older half, the first of the run among them
+        size_t older = frames.size() / 2, kept = 0;
+        for (size_t i = 0; i < older; i += 2)
+            frames[kept++] = frames[i];
+        frames.erase(frames.begin() + kept, frames.begin() + older);
+        thins++;
+    }
+    frames.push_back(frame);
+}
+
+void RunHistory::clear()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    frames.clear();
+    thins = 0;
+}
+
+size_t RunHistory::size() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return frames.size();
+}
+
+std::shared_ptr<const HistoryFrame> RunHistory::first() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return frames.empty() ? std::shared_ptr<const HistoryFrame>() : frames.front();
+}
+
+std::shared_ptr<const HistoryFrame> RunHistory::last() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return frames.empty() ? std::shared_ptr<const HistoryFrame>() : frames.back();
+}
+
+std::shared_ptr<const HistoryFrame> RunHistory::at(unsigned int counter) const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (frames.empty())
+        return std::shared_ptr<const HistoryFrame>();
+
+    // frames are in step order: the first one after the step, then back one
+    std::deque< std::shared_ptr<const HistoryFrame> >::const_iterator it =
+        std::upper_bound(frames.begin(), frames.end(), counter,
+                         [](unsigned int c, const std::shared_ptr<const HistoryFrame> &f) { return c < f->counter; });
+    if (it != frames.begin())
+        --it;
+    return *it;
+}
+
+unsigned long RunHistory::thinned() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return thins;
+}
+
+MemoryCount RunHistory::memory() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    MemoryCount m;
+    for (size_t i = 0; i < frames.size(); i++)
+        m.add(frames[i]->memory());
+    return m;
+}
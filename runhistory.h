@@ -0,0 +1,65 @@
+#ifndef RUNHISTORY_H
+#define RUNHISTORY_H
+
+#include "footprint.h"
+#include "gratetime.h"
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+// One step of a run as the history keeps it: the values along the river the long profile plots
+// are drawn from, in single precision
+class HistoryFrame
+{
+public:
+
+    unsigned int counter;
+    GrateTime cTime;
+    double hours;                              // Model time since the first flow record (h)
+
+    std::vector<float> eta;                    // Bed elevation
+    std::vector<float> wsl;                    // Water surface elevation
+    std::vector<float> width;
+    std::vector<float> Qs;
+    std::vector<float> d50;                    // Surface D50 (mm)
+
+    MemoryCount memory() const;
+};
+
+// The frames of a run, oldest first, recorded every 'stride' steps. At most 'depth' are kept:
+// when the history is full, every other frame of its older half is dropped, so the recent past
+// stays at full detail and older steps thin out, while the whole run stays covered. Recorded by
+// the model's thread, read by the GUI's; frames are never changed once recorded.
+class RunHistory
+{
+public:
+
+    RunHistory(size_t depth, unsigned int stride);          // throws GrateError if depth < 4 or stride is 0
+
+    bool wants(unsigned int counter) const { return counter % stride == 0; }
+    void record(std::shared_ptr<const HistoryFrame> frame);
+    void clear();
+
+    size_t size() const;
+    std::shared_ptr<const HistoryFrame> first() const;      // NULL if empty
+    std::shared_ptr<const HistoryFrame> last() const;
+    std::shared_ptr<const HistoryFrame> at(unsigned int counter) const;    // Last frame at or before the step, or the first
+    unsigned long thinned() const;             // Times the older half was thinned
+    MemoryCount memory() const;
+
+    const size_t depth;
+    const unsigned int stride;
+
+private:
+    mutable std::mutex lock;
+    std::deque< std::shared_ptr<const HistoryFrame> > frames;
+    unsigned long thins;
+
+    RunHistory(const RunHistory &);
+    RunHistory &operator=(const RunHistory &);
+};
+
+#endif // RUNHISTORY_H
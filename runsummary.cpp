@@ -0,0 +1,238 @@
+/*******************
+ *
+ *
+ *  GRATE 9
+ *
+ *  Run summary: a JSON record of each run, and a history of them
+ *
+ *
+ *
+*********************/
+
+#include "runsummary.h"
+#include "grateerror.h"
+#include "jsontext.h"
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <ciso646>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace {
+
+// The members of one object, either one per line or all on one line
+class JsonWriter
+{
+public:
+
+    JsonWriter(std::ostream &out, bool oneLine) : out(out), oneLine(oneLine), depth(0), first(true) {}
+
+    void open(const char *key)
+    {
+        next(key);
+        out << "{";
+        depth++;
+        first = true;
+    }
+
+    void close()
+    {
+        depth--;
+        if (not first && not oneLine)
+            out << "\n" << std::string(2 * depth, ' ');
+        out << "}";
+        first = false;
+    }
+
+    void value(const char *key, const std::string &s)
+    {
+        next(key);
+        writeJsonString(out, s);
+    }
+
+    void value(const char *key, double x)
+    {
+        next(key);
+        writeJsonNumber(out, x);
+    }
+
+    void value(const char *key, unsigned long long n)
+    {
+        next(key);
+        out << n;
+    }
+
+private:
+    std::ostream &out;
+    bool oneLine;
+    int depth;
+    bool first;                                // Nothing written yet in the current object
+
+    void next(const char *key)
+    {
+        if (not first)
+            out << ",";
+        if (key == NULL)
+            return;
+        if (oneLine)
+            out << (first ? "" : " ");
+        else
+            out << "\n" << std::string(2 * depth, ' ');
+        writeJsonString(out, key);
+        out << ": ";
+        first = false;
+    }
+};
+
+}  // namespace
+
+
+RunSummary::RunSummary()
+{
+    mode = "single";
+    status = "finished";
+    inputHash = 0;
+    nodes = 0;
+    steps = 0;
+    dt = 0;
+    threads = 1;
+    writerThreads = 0;
+    members = 0;
+    failedMembers = 0;
+    wallSeconds = 0;
+    setupSeconds = 0;
+    stepSeconds = 0;
+    bytesWritten = 0;
+    peakResident = 0;
+    hasPhases = false;
+}
+
+void RunSummary::writeJson(std::ostream &out, bool oneLine) const
+{
+    JsonWriter json(out, oneLine);
+    char hash[20];
+    std::snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)inputHash);
+
+    json.open(NULL);
+    json.value("version", version);
+    json.value("host", host);
+    json.value("started", started);
+    json.value("mode", mode);
+    json.value("status", status);
+    if (not error.empty())
+        json.value("error", error);
+    json.value("input", input);
+    json.value("input_hash", std::string(hash));
+    json.value("output", output);
+    json.value("nodes", (unsigned long long)nodes);
+    json.value("steps", (unsigned long long)steps);
+    json.value("dt", (unsigned long long)dt);
+    json.value("threads", (unsigned long long)threads);
+    json.value("writer_threads", (unsigned long long)writerThreads);
+    if (mode == "ensemble")
+    {
+        json.value("members", (unsigned long long)members);
+        json.value("failed_members", (unsigned long long)failedMembers);
+    }
+
+    // throughput over the time spent stepping; simulated time over the whole run
+    json.value("wall_seconds", wallSeconds);
+    json.value("setup_seconds", setupSeconds);
+    json.value("step_seconds", stepSeconds);
+    json.value("steps_per_second", stepSeconds > 0 ? steps / stepSeconds : NAN);
+    json.value("node_steps_per_second", stepSeconds > 0 ? double(steps) * nodes / stepSeconds : NAN);
+    json.value("simulated_seconds", double(steps) * dt);
+    json.value("simulated_to_wall", wallSeconds > 0 ? double(steps) * dt / wallSeconds : NAN);
+    json.value("peak_rss_bytes", (unsigned long long)peakResident);
+    json.value("bytes_written", (unsigned long long)bytesWritten);
+
+    if (hasPhases)
+    {
+        json.open("phases");
+        for (int p = 0; p < N_PHASES; p++)
+        {
+            json.open(phaseName(Phase(p)));
+            json.value("seconds", phases.seconds(Phase(p)));
+            json.value("calls", (unsigned long long)phases.count(Phase(p)));
+            json.close();
+        }
+        json.close();
+
+        json.open("solvers");
+        for (int s = 0; s < N_SOLVERS; s++)
+        {
+            json.open(SolverStats::name(Solver(s)));
+            json.value("calls", (unsigned long long)solvers.count(Solver(s)));
+            json.value("iterations", (unsigned long long)solvers.iterations(Solver(s)));
+            json.value("not_converged", (unsigned long long)solvers.failures(Solver(s)));
+            json.close();
+        }
+        json.close();
+
+        json.open("fallbacks");
+        for (int f = 0; f < N_FALLBACKS; f++)
+            json.value(SolverStats::name(Fallback(f)), (unsigned long long)solvers.fallbacks(Fallback(f)));
+        json.close();
+    }
+    json.close();
+}
+
+void RunSummary::write(const std::string &fileName) const
+{
+    std::ofstream out(fileName);
+    if (not out)
+        throw GrateError("Error writing run summary: " + fileName);
+    writeJson(out, false);
+    out << "\n";
+    if (not out)
+        throw GrateError("Error writing run summary: " + fileName);
+}
+
+void RunSummary::appendTo(const std::string &historyFile) const
+{
+    // a single write in append mode, so runs finishing together don't interleave their lines
+    std::ostringstream line;
+    writeJson(line, true);
+    line << "\n";
+    std::string text = line.str();
+
+    std::ofstream out(historyFile, std::ios::out | std::ios::app | std::ios::binary);
+    if (not out)
+        throw GrateError("Error writing run history: " + historyFile);
+    out.write(text.data(), text.size());
+    out.flush();
+    if (not out)
+        throw GrateError("Error writing run history: " + historyFile);
+}
+
+std::string utcTimestamp()
+{
+    std::time_t now = std::time(NULL);
+    std::tm utc;
+#ifdef _WIN32
+    gmtime_s(&utc, &now);
+#else
+    gmtime_r(&now, &utc);
+#endif
+    char text[32];
+    std::strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%SZ", &utc);
+    return text;
+}
+
+std::string hostName()
+{
+#ifndef _WIN32
+    char name[256];
+    if (gethostname(name, sizeof(name)) == 0)
+    {
+        name[sizeof(name) - 1] = '\0';
+        return name;
+    }
+#endif
+    return "";
+}
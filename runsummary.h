@@ -0,0 +1,59 @@
+#ifndef RUNSUMMARY_H
+#define RUNSUMMARY_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include "timings.h"
+#include "solverstats.h"
+
+
+// Machine readable record of one run of the CLI: what was run, where, by which build, and how
+// fast. Written as a JSON object, and appended as one line to a history file so throughput can
+// be followed across code versions and inputs.
+class RunSummary
+{
+public:
+
+    RunSummary();
+
+    std::string version;                       // Build, from git describe
+    std::string host;
+    std::string started;                       // UTC, ISO 8601
+    std::string mode;                          // "single" or "ensemble"
+    std::string status;                        // "finished" or "failed"
+    std::string error;                         // Why it failed
+
+    std::string input;
+    uint64_t inputHash;                        // hashInput() of the xml, to tell inputs apart
+    std::string output;                        // Results file, or the ensemble's output directory
+
+    int nodes;
+    int steps;                                 // Steps run, over all members of an ensemble
+    unsigned int dt;                           // Model time step (s)
+    int threads;                               // Threads running models
+    int writerThreads;                         // Results writer threads
+    int members;                               // Ensembles only
+    int failedMembers;
+
+    double wallSeconds;                        // The whole run, reading the input included
+    double setupSeconds;                       // Reading the input and building the model
+    double stepSeconds;                        // Advancing the model(s)
+    uint64_t bytesWritten;                     // Size of the results files
+    size_t peakResident;                       // Peak resident set (bytes), 0 if unknown
+
+    bool hasPhases;                            // Single runs: phase times and solver counters
+    PhaseTimes phases;
+    SolverStats solvers;
+
+    void writeJson(std::ostream &out, bool oneLine) const;
+
+    // throw GrateError if the file can't be written
+    void write(const std::string &fileName) const;
+    void appendTo(const std::string &historyFile) const;     // One line, in a single write
+};
+
+std::string utcTimestamp();                    // e.g. "2024-05-01T09:30:00Z"
+std::string hostName();
+
+#endif // RUNSUMMARY_H
@@ -2,39 +2,31 @@
 #include <math.h>
 #include<iostream>
 #include<fstream>
-#include "tinyxml2/tinyxml2.h"
-#include "tinyxml2_wrapper.h"
+#include "grateerror.h"
+#include <sstream>
 using namespace std;
 
-sed::sed(RiverProfile *r, XMLElement *params_root)
+sed::sed(RiverProfile *r, const ModelSetup &setup)
 {
-    initSedSeries(r->nnodes, params_root);
+    initSedSeries(r->nnodes, setup);
 }
 
-void sed::initSedSeries(unsigned int nodes, XMLElement *params_root)
+void sed::initSedSeries(unsigned int nodes, const ModelSetup &setup)
 {
     double currentCoord = 0.;
-    double SerialDate;
     GrateTime NewDate;
     vector< TS_Object > tmp;
     TS_Object NewEntry;
 
-    // get sed_series element from XML file
-    XMLElement *sed_series = params_root->FirstChildElement("sed_series");
-    if (sed_series == NULL) {
-        throw std::string("Error getting sed_series element from XML file");
-    }
-
-    // loop over all "STEP" elements in the XML file
-    for (XMLElement* e = sed_series->FirstChildElement("STEP"); e != NULL; e = e->NextSiblingElement("STEP")) {
+    for (unsigned int i = 0; i < setup.sedSeries.size(); i++) {
+        const SeriesStep &step = setup.sedSeries[i];
 
-        SerialDate = getDoubleValue(e, "datetime");
-        NewDate.setExcelTime(SerialDate);
+        NewDate.setExcelTime(step.datetime);
 
         NewEntry.date_time = NewDate;
-        NewEntry.Q = getDoubleValue(e, "Qs");
-        NewEntry.Coord = getIntValue(e, "loc");
-        NewEntry.GRP = getIntValue(e, "GSD") - 1;       // Input GSD is 1-based, adjust here to 0-based.
+        NewEntry.Q = step.Q;
+        NewEntry.Coord = step.loc;
+        NewEntry.GRP = step.gsd - 1;       // Input GSD is 1-based, adjust here to 0-based.
 
         if (NewEntry.Coord > currentCoord) {            // Have we moved to a new source coordinate?
             Qs_series.push_back( tmp );
@@ -57,6 +49,8 @@ void sed::initSedSeries(unsigned int nodes, XMLElement *params_root)
 
 void sed::setNodalSedInputs(RiverProfile *r)
 {
+    ScopedTimer timer(r->timings, PHASE_SED_INPUTS);
+
     unsigned int j = 0;
     unsigned int i = 0;
 
@@ -110,6 +104,8 @@ NodeGSDObject sed::multiplyGSD(NodeGSDObject &M, NodeGSDObject &N, double weight
 
 void sed::computeTransport(RiverProfile *r)
 {
+    ScopedTimer timer(r->timings, PHASE_TRANSPORT);
+
     unsigned int bc;
     unsigned int i, j, k;
     unsigned int inode;
@@ -236,6 +232,8 @@ void sed::computeTransport(RiverProfile *r)
 
 void sed::exner(RiverProfile *r)
 {
+    ScopedTimer timer(r->timings, PHASE_EXNER);
+
     unsigned int i, j, k, m = 0;
     double upw = r->sedUpw;                                             // Upwinding constant
     double chi = 0.7;                                              // weighting for interfacial exchange
@@ -289,7 +287,7 @@ void sed::exner(RiverProfile *r)
         {
             for ( j = 0; j < r->ngsz; j++ )
                 for ( k = 0; k < r->nlith; k++ )
-                    fi.pct[k][j] = r->storedf[i][r->ntop[i]].pct[k][j];    // applied to all degrading nodes
+                    fi.pct[k][j] = r->storedf.layer(i, r->ntop[i]).pct[k][j];    // applied to all degrading nodes
 
             if ( -deta[i] > r->toplayer[i] )      // degrade more than one layer
             {
@@ -304,11 +302,15 @@ void sed::exner(RiverProfile *r)
                 while (dmy > 0.0)
                 {
                     if (m <= 0)
-                        cout << "Erosion has reached the bottom of the lowest storage layer at node " <<  i;
+                    {
+                        std::ostringstream msg;
+                        msg << "Erosion has reached the bottom of the lowest storage layer at node " <<  i;
+                        r->diag.warning(msg.str());
+                    }
 
                     for (  j = 0; j < r->ngsz; j++ )
                         for (  k = 0; k < r->nlith; k++ )
-                            fi.pct[k][j] += r->layer * r->storedf[i][m].pct[k][j];   // applied to all degrading nodes
+                            fi.pct[k][j] += r->layer * r->storedf.layer(i, m).pct[k][j];   // applied to all degrading nodes
                     fi.norm_frac();
 
                     dmy = dmy - r->layer;
@@ -317,13 +319,15 @@ void sed::exner(RiverProfile *r)
 
                 if (m <= 0)
                 {
-                    cout << "Erosion has reached the bottom of the lowest storage layer at node " <<  i;
+                    std::ostringstream msg;
+                    msg << "Erosion has reached the bottom of the lowest storage layer at node " <<  i;
+                    r->diag.warning(msg.str());
                     break;
                 }
 
                 for ( j = 0; j < r->ngsz; j++ )
                     for ( k = 0; k < r->nlith; k++ )
-                        fi.pct[k][j] += ( r->layer + dmy ) * r->storedf[i][m].pct[k][j];
+                        fi.pct[k][j] += ( r->layer + dmy ) * r->storedf.layer(i, m).pct[k][j];
                 fi.norm_frac();
             }                                  // end degrading more than 1 layer
         }                                      // end aggradational/degradational cases
@@ -384,7 +388,9 @@ void sed::exner(RiverProfile *r)
                 r->ntop[i]--;
                 if (r->ntop[i] <= 0.0)            // Raise exception here; bedrock reached.
                 {
-                    cout << "Bedrock reached at node " <<  i;
+                    std::ostringstream msg;
+                    msg << "Bedrock reached at node " <<  i;
+                    r->diag.warning(msg.str());
                     break;
                 }
             }
@@ -394,27 +400,29 @@ void sed::exner(RiverProfile *r)
         {
             if ((deta[i] + r->toplayer[i]) <= r->layer)
             {
+                NodeGSDObject &top = r->storedf.edit(i, r->ntop[i]);
                 for ( j = 0; j < r->ngsz; j++ )
                 {
                     for ( k = 0; k < r->nlith; k++ )
                     {
-                        r->storedf[i][r->ntop[i]].pct[k][j] = deta[i] * (chi * p[i].pct[k][j] + ( 1.0 - chi ) *
-                                                      r->F[i].pct[k][j]) + r->toplayer[i] * r->storedf[i][r->ntop[i]].pct[k][j];
+                        top.pct[k][j] = deta[i] * (chi * p[i].pct[k][j] + ( 1.0 - chi ) *
+                                                      r->F[i].pct[k][j]) + r->toplayer[i] * top.pct[k][j];
                     }                          // aggraded material is a mixture of p and f.
                 }
 
-                r->storedf[i][r->ntop[i]].norm_frac();
+                top.norm_frac();
                 r->toplayer[i] += deta[i];
             }
             else
             {                                  //aggrade more than current layer
+                NodeGSDObject &top = r->storedf.edit(i, r->ntop[i]);
                 for ( j = 0; j < r->ngsz; j++ )
                     for ( k = 0; k < r->nlith; k++ )
-                        r->storedf[i][r->ntop[i]].pct[k][j] = ( r->layer - r->toplayer[i] ) * ( chi * p[i].pct[k][j] +
-                                ( 1.0 - chi ) * r->F[i].pct[k][j] ) + r->toplayer[i] * r->storedf[i][r->ntop[i]].pct[k][j];
+                        top.pct[k][j] = ( r->layer - r->toplayer[i] ) * ( chi * p[i].pct[k][j] +
+                                ( 1.0 - chi ) * r->F[i].pct[k][j] ) + r->toplayer[i] * top.pct[k][j];
                                                // fill in additional stratigraphy w/ mixture of p and f.
 
-                r->storedf[i][r->ntop[i]].norm_frac();
+                top.norm_frac();
 
                 dmy = deta[i] + r->toplayer[i] - r->layer;
                 while (dmy > 0.0)
@@ -422,13 +430,16 @@ void sed::exner(RiverProfile *r)
                         r->ntop[i]++;
                         if (r->ntop[i] > (r->nlayer - 2))      //raise Exception: 'not enough storage layers for aggradation.'
                         {
-                            cout << "Note enough storage layers for aggradation at node " <<  i;
+                            std::ostringstream msg;
+                            msg << "Not enough storage layers for aggradation at node " <<  i;
+                            r->diag.warning(msg.str());
                             break;
                         }
+                        NodeGSDObject &fill = r->storedf.edit(i, r->ntop[i]);
                         for ( j = 0; j < r->ngsz; j++ )
                             for ( k = 0; k < r->nlith; k++ )
-                                r->storedf[i][r->ntop[i]].pct[k][j] = chi * p[i].pct[k][j] + (1.0 - chi) * r->F[i].pct[k][j];
-                        r->storedf[i][r->ntop[i]].norm_frac();
+                                fill.pct[k][j] = chi * p[i].pct[k][j] + (1.0 - chi) * r->F[i].pct[k][j];
+                        fill.norm_frac();
                         dmy -= r->layer;
                     }
                     r->toplayer[i] = dmy + r->layer;
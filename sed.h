@@ -23,9 +23,9 @@ public:
     vector <double> deta;                      // Delta bed elevation change
     vector <double> dLa_over_dt;
 
-    sed(RiverProfile *r, XMLElement *params_root);
+    sed(RiverProfile *r, const ModelSetup &setup);
 
-    void initSedSeries(unsigned int nodes, XMLElement *params_root);    // Set inputs
+    void initSedSeries(unsigned int nodes, const ModelSetup &setup);    // Set inputs
 
     void setNodalSedInputs(RiverProfile *r);
 
@@ -0,0 +1,913 @@
+/*******************
+ *
+ *
+ *  GRATE 9
+ *
+ *  Model setup: reading the xml input, and the binary setup cache
+ *
+ *
+ *
+*********************/
+
+#include "setup.h"
+#include "tinyxml2_wrapper.h"
+#include "grateerror.h"
+#include "mappedfile.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <ciso646>
+
+namespace {
+
+const char setupMagic[8] = {'G', 'R', 'A', 'T', 'E', 'S', 'U', 'P'};
+const char setupTrailer[8] = {'E', 'N', 'D', 'S', 'E', 'T', 'U', 'P'};
+const uint32_t endianMarker = 0x01020304;
+#define SETUP_VERSION 1
+
+// Cache writing
+template <class T> void put(std::vector<char> &buf, const T &v)
+{
+    const char *p = reinterpret_cast<const char*>(&v);
+    buf.insert(buf.end(), p, p + sizeof(T));
+}
+
+template <class T> void putArray(std::vector<char> &buf, const std::vector<T> &v)
+{
+    put(buf, uint64_t(v.size()));
+    const char *p = reinterpret_cast<const char*>(v.data());
+    buf.insert(buf.end(), p, p + v.size() * sizeof(T));
+}
+
+void putString(std::vector<char> &buf, const std::string &s)
+{
+    put(buf, uint64_t(s.size()));
+    buf.insert(buf.end(), s.begin(), s.end());
+}
+
+void putSeries(std::vector<char> &buf, const std::vector<SeriesStep> &series)
+{
+    put(buf, uint64_t(series.size()));
+    for (unsigned int i = 0; i < series.size(); i++)
+    {
+        put(buf, series[i].datetime);
+        put(buf, series[i].Q);
+        put(buf, int32_t(series[i].loc));
+        put(buf, int32_t(series[i].gsd));
+    }
+}
+
+// Cache reading: every read is bounds checked, and a short or damaged cache reads as stale
+class Cursor
+{
+public:
+
+    Cursor(const char *begin, const char *end) : p(begin), end(end) {}
+
+    template <class T> T get()
+    {
+        T v;
+        take(&v, sizeof(T));
+        return v;
+    }
+
+    template <class T> void getArray(std::vector<T> &v)
+    {
+        uint64_t n = get<uint64_t>();
+        if (n > uint64_t(end - p) / sizeof(T))
+            throw GrateError("short");
+        v.resize(n);
+        take(v.data(), n * sizeof(T));
+    }
+
+    void getString(std::string &s)
+    {
+        uint64_t n = get<uint64_t>();
+        if (n > uint64_t(end - p))
+            throw GrateError("short");
+        s.assign(p, n);
+        p += n;
+    }
+
+    void getSeries(std::vector<SeriesStep> &series)
+    {
+        uint64_t n = get<uint64_t>();
+        if (n > uint64_t(end - p) / 24)
+            throw GrateError("short");
+        series.resize(n);
+        for (unsigned int i = 0; i < n; i++)
+        {
+            series[i].datetime = get<double>();
+            series[i].Q = get<double>();
+            series[i].loc = get<int32_t>();
+            series[i].gsd = get<int32_t>();
+        }
+    }
+
+    void take(void *dst, size_t n)
+    {
+        if (n > size_t(end - p))
+            throw GrateError("short");
+        std::memcpy(dst, p, n);
+        p += n;
+    }
+
+    const char *p;
+    const char *end;
+};
+
+// Names of the child elements a section reads, in a small open-addressed hash table built
+// once, so each child costs one hash and usually one string compare
+class NameIndex
+{
+public:
+
+    NameIndex(const char *const *names, int n) : names(names)
+    {
+        std::fill(table, table + slots, -1);
+        for (int i = 0; i < n; i++)
+        {
+            unsigned int h = hash(names[i]);
+            while (table[h] != -1)
+                h = (h + 1) % slots;
+            table[h] = i;
+        }
+    }
+
+    int find(const char *name) const
+    {
+        for (unsigned int h = hash(name); table[h] != -1; h = (h + 1) % slots)
+            if (std::strcmp(names[table[h]], name) == 0)
+                return table[h];
+        return -1;
+    }
+
+private:
+    static const unsigned int slots = 64;      // more than twice the longest list of names
+    const char *const *names;
+    int table[slots];
+
+    static unsigned int hash(const char *name)
+    {
+        uint32_t h = 2166136261u;
+        for (const char *c = name; *c != '\0'; c++)
+            h = (h ^ uint8_t(*c)) * 16777619u;
+        return h % slots;
+    }
+};
+
+enum RootElement { EL_PARAMS, EL_RANDOMISERS, EL_PROFILE, EL_STRATIGRAPHY, EL_HYDRO_SERIES, EL_SED_SERIES, EL_OUTPUT,
+                   ROOT_ELEMENTS };
+const char *const rootNames[ROOT_ELEMENTS] = {"PARAMS", "RANDOMISERS", "profile", "stratigraphy", "hydro_series",
+                                              "sed_series", "OUTPUT"};
+
+enum ParamField { P_NNODES, P_LAYER, P_LA, P_NLAYER, P_PORO, P_NGSZ, P_NLITH, P_NGRP, PARAM_FIELDS };
+const char *const paramNames[PARAM_FIELDS] = {"NNODES", "LAYER", "LA", "NLAYER", "PORO", "NGSZ", "NLITH", "NGRP"};
+
+enum { RAND_FIELDS = 7 };
+const char *const randNames[RAND_FIELDS] = {"QSTWEAK", "QWTWEAK", "SUBSTRDIAL", "FEEDQW", "FEEDQS", "HMAXTWEAK", "RANDABR"};
+
+enum GrpField { G_ABR, G_RHOS, GRP_FIELDS };
+const char *const grpNames[GRP_FIELDS] = {"ABR", "RHOS"};
+
+enum ProfileField { XX_ETA, XX_BEDROCK, XX_WIDTH, XX_SINU, XX_FPWIDTH, XX_HMAX, XX_THETA, XX_ALGRP, XX_STGRP,
+                    PROFILE_FIELDS };
+const char *const profileNames[PROFILE_FIELDS] = {"ETA", "BEDROCK", "WIDTH", "SINU", "FPWIDTH", "HMAX", "THETA",
+                                                  "ALGRP", "STGRP"};
+
+enum SeriesField { S_DATETIME, S_QW, S_QS, S_LOC, S_GSD, SERIES_FIELDS };
+const char *const seriesNames[SERIES_FIELDS] = {"datetime", "Qw", "Qs", "loc", "GSD"};
+
+const NameIndex &rootIndex() { static const NameIndex index(rootNames, ROOT_ELEMENTS); return index; }
+const NameIndex &paramIndex() { static const NameIndex index(paramNames, PARAM_FIELDS); return index; }
+const NameIndex &randIndex() { static const NameIndex index(randNames, RAND_FIELDS); return index; }
+const NameIndex &grpIndex() { static const NameIndex index(grpNames, GRP_FIELDS); return index; }
+const NameIndex &profileIndex() { static const NameIndex index(profileNames, PROFILE_FIELDS); return index; }
+const NameIndex &seriesIndex() { static const NameIndex index(seriesNames, SERIES_FIELDS); return index; }
+
+// Like FirstChildElement(name) for every name at once: the first child with each name
+inline void keepFirst(const NameIndex &index, const char *name, XMLElement *e, XMLElement **found)
+{
+    int k = index.find(name);
+    if (k >= 0 && found[k] == NULL)
+        found[k] = e;
+}
+
+void collectChildren(XMLElement *parent, const NameIndex &index, XMLElement **found)
+{
+    for (XMLElement *e = parent->FirstChildElement(); e != NULL; e = e->NextSiblingElement())
+        keepFirst(index, e->Name(), e, found);
+}
+
+// n for prefix + n (e.g. LITH2), 0 if the name isn't one of those
+int numberedName(const char *name, const char *prefix)
+{
+    size_t len = std::strlen(prefix);
+    if (std::strncmp(name, prefix, len) != 0 || name[len] < '1' || name[len] > '9')
+        return 0;
+    int n = 0;
+    for (const char *c = name + len; *c != '\0'; c++)
+    {
+        if (*c < '0' || *c > '9' || n > 100000)
+            return 0;
+        n = 10 * n + (*c - '0');
+    }
+    return n;
+}
+
+// Size class of PSI_-3, PSI_-2, ... (0, 1, ...); false if the name isn't a PSI_ element
+bool psiSize(const char *name, int &size)
+{
+    if (std::strncmp(name, "PSI_", 4) != 0)
+        return false;
+    const char *c = name + 4;
+    bool negative = (*c == '-');
+    if (negative)
+        c++;
+    if (*c == '\0' || (*c == '0' && (negative || c[1] != '\0')))
+        return false;                           // only the names PSI_%d gives: no leading zeros or -0
+    int v = 0;
+    for (; *c != '\0'; c++)
+    {
+        if (*c < '0' || *c > '9' || v > 100000)
+            return false;
+        v = 10 * v + (*c - '0');
+    }
+    size = (negative ? -v : v) + 3;
+    return true;
+}
+
+// z for layer01 .. layer99, 0 otherwise
+int layerNumber(const char *name)
+{
+    if (std::strncmp(name, "layer", 5) != 0 || name[5] < '0' || name[5] > '9' ||
+            name[6] < '0' || name[6] > '9' || name[7] != '\0')
+        return 0;
+    return 10 * (name[5] - '0') + (name[6] - '0');
+}
+
+void readSeries(XMLElement *seriesElem, const char *name, SeriesField q, bool withGSD, std::vector<SeriesStep> &series)
+{
+    if (seriesElem == NULL)
+        throw GrateError(std::string("Error getting ") + name + " element from XML file");
+
+    for (XMLElement* e = seriesElem->FirstChildElement("STEP"); e != NULL; e = e->NextSiblingElement("STEP"))
+    {
+        XMLElement *f[SERIES_FIELDS] = {};
+        collectChildren(e, seriesIndex(), f);
+        SeriesStep s;
+        s.datetime = getDoubleText(f[S_DATETIME], seriesNames[S_DATETIME]);
+        s.Q = getDoubleText(f[q], seriesNames[q]);
+        s.loc = getIntText(f[S_LOC], seriesNames[S_LOC]);
+        if (withGSD)
+            s.gsd = getIntText(f[S_GSD], seriesNames[S_GSD]);
+        series.push_back(s);
+    }
+}
+
+// Time spent on each section of the input, kept in the setup
+class SectionTimer
+{
+public:
+
+    explicit SectionTimer(ModelSetup &setup) : setup(setup), last(std::chrono::steady_clock::now()) {}
+
+    void lap(const char *section)
+    {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        setup.readTimes.push_back(std::make_pair(std::string(section), std::chrono::duration<double>(now - last).count()));
+        last = now;
+    }
+
+private:
+    ModelSetup &setup;
+    std::chrono::steady_clock::time_point last;
+};
+
+// The tags and text of an xml stream, one at a time, without building a document: enough xml
+// for the input files, whose values hold no CDATA or entities. Comments, declarations and
+// processing instructions are skipped.
+class TagScanner
+{
+public:
+
+    enum Token { START, END, EMPTY, TEXT, DONE };
+
+    explicit TagScanner(std::istream &in) : buf(*in.rdbuf()) {}
+
+    Token next()
+    {
+        for (;;)
+        {
+            value.clear();
+            int c = buf.sgetc();
+            if (c == std::char_traits<char>::eof())
+                return DONE;
+            if (c != '<')
+            {
+                for (; c != std::char_traits<char>::eof() && c != '<'; c = buf.snextc())
+                    value += char(c);
+                return TEXT;
+            }
+
+            buf.sbumpc();
+            char quote = 0;                    // Attribute values may hold '>'
+            for (c = buf.sbumpc(); c != std::char_traits<char>::eof() && (c != '>' || quote); c = buf.sbumpc())
+            {
+                if (c == '"' || c == '\'')
+                    quote = (quote == 0) ? char(c) : (quote == c ? 0 : quote);
+                value += char(c);
+                if (value.size() == 3 && value == "!--")
+                {
+                    skipComment();
+                    break;
+                }
+            }
+            if (value.empty() || value[0] == '!' || value[0] == '?')
+                continue;
+
+            Token token = START;
+            if (value[0] == '/')
+            {
+                token = END;
+                value.erase(0, 1);
+            }
+            else if (value[value.size() - 1] == '/')
+                token = EMPTY;
+            value.resize(std::min(value.find_first_of(" \t\r\n/"), value.size()));
+            return token;
+        }
+    }
+
+    const std::string &name() const { return value; }       // Of a tag
+    const std::string &text() const { return value; }
+
+private:
+    std::streambuf &buf;
+    std::string value;
+
+    void skipComment()
+    {
+        int dashes = 0;
+        for (int c = buf.sbumpc(); c != std::char_traits<char>::eof(); c = buf.sbumpc())
+        {
+            if (c == '>' && dashes >= 2)
+                return;
+            dashes = (c == '-') ? dashes + 1 : 0;
+        }
+    }
+};
+
+int scannedInt(const std::string &text, const char *name)
+{
+    size_t first = text.find_first_not_of(" \t\r\n");
+    size_t last = text.find_last_not_of(" \t\r\n");
+    try
+    {
+        if (first != std::string::npos)
+        {
+            size_t end;
+            int value = std::stoi(text.substr(first, last + 1 - first), &end);
+            if (end == last + 1 - first)
+                return value;
+        }
+    }
+    catch (const std::logic_error &)
+    {
+    }
+    throw GrateError(std::string("Error getting int value for child element: ") + name);
+}
+
+}  // namespace
+
+
+SeriesStep::SeriesStep()
+{
+    datetime = 0.;
+    Q = 0.;
+    loc = 0;
+    gsd = 1;
+}
+
+ModelSetup::ModelSetup()
+{
+    nnodes = 0;
+    nlayer = 0;
+    ngsz = 0;
+    nlith = 0;
+    ngrp = 0;
+    layer = 5.0;
+    la = 0.0;
+    poro = 0.0;
+
+    qsTweak = 1;
+    qwTweak = 1;
+    substrDial = 0;
+    feedQw = 1;
+    feedQs = 1;
+    HmaxTweak = 1;
+    randAbr = 0.00001;
+
+    hasStratigraphy = false;
+}
+
+void readSetup(XMLElement *params_root, ModelSetup &setup)
+{
+    // one pass over the top level elements; LITH1, LITH2, ... are numbered
+    XMLElement *root[ROOT_ELEMENTS] = {};
+    std::vector<XMLElement*> liths;
+    for (XMLElement *e = params_root->FirstChildElement(); e != NULL; e = e->NextSiblingElement())
+    {
+        const char *name = e->Name();
+        int n = numberedName(name, "LITH");
+        if (n > 0)
+        {
+            if (size_t(n) > liths.size())
+                liths.resize(n, NULL);
+            if (liths[n - 1] == NULL)
+                liths[n - 1] = e;
+        }
+        else
+            keepFirst(rootIndex(), name, e, root);
+    }
+
+    SectionTimer timer(setup);
+
+    // the "RANDOMISERS" element is optional; any value it gives replaces the default
+    if (root[EL_RANDOMISERS] != NULL)
+    {
+        XMLElement *r[RAND_FIELDS] = {};
+        collectChildren(root[EL_RANDOMISERS], randIndex(), r);
+        double *values[RAND_FIELDS] = {&setup.qsTweak, &setup.qwTweak, &setup.substrDial, &setup.feedQw,
+                                       &setup.feedQs, &setup.HmaxTweak, &setup.randAbr};
+        for (int f = 0; f < RAND_FIELDS; f++)
+            if (r[f] != NULL)
+                *values[f] = getDoubleText(r[f], randNames[f]);
+    }
+
+    if (root[EL_PARAMS] == NULL)
+        throw GrateError("Error getting PARAMS element from XML file");
+    XMLElement *p[PARAM_FIELDS] = {};
+    collectChildren(root[EL_PARAMS], paramIndex(), p);
+    setup.nnodes = getIntText(p[P_NNODES], paramNames[P_NNODES]);
+    setup.layer = getDoubleText(p[P_LAYER], paramNames[P_LAYER]);
+    setup.la = getDoubleText(p[P_LA], paramNames[P_LA]);
+    setup.nlayer = getIntText(p[P_NLAYER], paramNames[P_NLAYER]);
+    setup.poro = getDoubleText(p[P_PORO], paramNames[P_PORO]);
+    setup.ngsz = getIntText(p[P_NGSZ], paramNames[P_NGSZ]);
+    setup.nlith = getIntText(p[P_NLITH], paramNames[P_NLITH]);
+    setup.ngrp = getIntText(p[P_NGRP], paramNames[P_NGRP]);
+    if (setup.nlith < 0 || setup.ngrp < 0 || setup.ngsz < 0)
+        throw GrateError("NGSZ, NLITH and NGRP must not be negative");
+
+    // sizes are known from here on
+    if (setup.nnodes > 0)
+    {
+        size_t nnodes = setup.nnodes;
+        std::vector<double> *doubles[] = {&setup.x, &setup.eta, &setup.bedrock, &setup.width, &setup.sinu,
+                                          &setup.fpWidth, &setup.Hmax, &setup.theta, &setup.stratX};
+        for (unsigned int v = 0; v < sizeof(doubles) / sizeof(doubles[0]); v++)
+            doubles[v]->reserve(nnodes);
+        setup.algrp.reserve(nnodes);
+        setup.stgrp.reserve(nnodes);
+        setup.stratGroups.reserve(nnodes * STRAT_LAYERS);
+    }
+    timer.lap("PARAMS");
+
+    // GSD library: LITH1, LITH2, ... each with NGRP groups of cumulative % finer at PSI_-3, PSI_-2, ...
+    setup.gsdPct.assign(size_t(setup.nlith) * setup.ngrp * setup.ngsz, 0.);
+    setup.gsdAbrasion.assign(size_t(setup.nlith) * setup.ngrp, 0.);
+    setup.gsdDensity.assign(size_t(setup.nlith) * setup.ngrp, 0.);
+    std::vector<XMLElement*> psi(setup.ngsz);
+    for (int lith = 0; lith < setup.nlith; lith++)
+    {
+        char lithName[16];
+        std::snprintf(lithName, sizeof(lithName), "LITH%d", lith + 1);
+        if (size_t(lith) >= liths.size() || liths[lith] == NULL)
+            throw GrateError(std::string("Error getting ") + lithName + " element");
+
+        int grp = 0;
+        for (XMLElement* e = liths[lith]->FirstChildElement("GRP"); e != NULL; e = e->NextSiblingElement("GRP"), grp++)
+        {
+            if (grp >= setup.ngrp)
+                continue;                       // too many: counted for the error below
+
+            // CHECK: do they alway start -3 to 9
+            XMLElement *g[GRP_FIELDS] = {};
+            std::fill(psi.begin(), psi.end(), (XMLElement*)NULL);
+            for (XMLElement *c = e->FirstChildElement(); c != NULL; c = c->NextSiblingElement())
+            {
+                int size;
+                if (psiSize(c->Name(), size))
+                {
+                    if (size >= 0 && size < setup.ngsz && psi[size] == NULL)
+                        psi[size] = c;
+                }
+                else
+                    keepFirst(grpIndex(), c->Name(), c, g);
+            }
+
+            for (int size = 0; size < setup.ngsz; size++)
+            {
+                if (psi[size] == NULL)
+                {
+                    char psiName[16];
+                    std::snprintf(psiName, sizeof(psiName), "PSI_%d", size - 3);
+                    throw GrateError(std::string("Error getting element ") + psiName + " for " + lithName);
+                }
+                double value = 0.;
+                if (psi[size]->QueryDoubleText(&value))
+                    setup.warnings.push_back(std::string("Error getting value for ") + lithName + " - " + psi[size]->Name());
+                setup.gsdPct[(size_t(lith) * setup.ngrp + grp) * setup.ngsz + size] = value;
+            }
+            setup.gsdAbrasion[lith * setup.ngrp + grp] = getDoubleText(g[G_ABR], grpNames[G_ABR]);
+            setup.gsdDensity[lith * setup.ngrp + grp] = getDoubleText(g[G_RHOS], grpNames[G_RHOS]);
+        }
+        if (grp != setup.ngrp)
+            throw GrateError(std::string("Wrong number of groups for ") + lithName);
+    }
+    timer.lap("GSD library");
+
+    if (root[EL_PROFILE] == NULL)
+        throw GrateError("Error getting profile element from XML file");
+    for (XMLElement* e = root[EL_PROFILE]->FirstChildElement("XX"); e != NULL; e = e->NextSiblingElement("XX"))
+    {
+        double x;
+        if (e->QueryDoubleAttribute("X", &x))
+            throw GrateError("Error getting X attribute from XX profile element");
+        XMLElement *f[PROFILE_FIELDS] = {};
+        collectChildren(e, profileIndex(), f);
+        setup.x.push_back(x);
+        setup.eta.push_back(getDoubleText(f[XX_ETA], profileNames[XX_ETA]));
+        setup.bedrock.push_back(getDoubleText(f[XX_BEDROCK], profileNames[XX_BEDROCK]));
+        setup.width.push_back(getDoubleText(f[XX_WIDTH], profileNames[XX_WIDTH]));
+        setup.sinu.push_back(getDoubleText(f[XX_SINU], profileNames[XX_SINU]));
+        setup.fpWidth.push_back(getDoubleText(f[XX_FPWIDTH], profileNames[XX_FPWIDTH]));
+        setup.Hmax.push_back(getDoubleText(f[XX_HMAX], profileNames[XX_HMAX]));
+        setup.theta.push_back(getDoubleText(f[XX_THETA], profileNames[XX_THETA]));
+        setup.algrp.push_back(getIntText(f[XX_ALGRP], profileNames[XX_ALGRP]));
+        setup.stgrp.push_back(getIntText(f[XX_STGRP], profileNames[XX_STGRP]));
+    }
+    timer.lap("profile");
+
+    // the stratigraphy element is optional: without it storage layers come from the STGRP groups
+    setup.hasStratigraphy = (root[EL_STRATIGRAPHY] != NULL);
+    if (setup.hasStratigraphy)
+    {
+        XMLElement *layers[STRAT_LAYERS];
+        for (XMLElement* e = root[EL_STRATIGRAPHY]->FirstChildElement("XXX"); e != NULL; e = e->NextSiblingElement("XXX"))
+        {
+            double x;
+            if (e->QueryDoubleAttribute("X1", &x))
+                throw GrateError("Error getting X attribute from X1 stratigraphy element");
+            setup.stratX.push_back(x);
+
+            // 'layer01', 'layer02', etc.
+            std::fill(layers, layers + STRAT_LAYERS, (XMLElement*)NULL);
+            for (XMLElement *c = e->FirstChildElement(); c != NULL; c = c->NextSiblingElement())
+            {
+                int z = layerNumber(c->Name());
+                if (z >= 1 && z <= STRAT_LAYERS && layers[z - 1] == NULL)
+                    layers[z - 1] = c;
+            }
+            for (int z = 1; z <= STRAT_LAYERS; z++)
+            {
+                char layerName[16];
+                std::snprintf(layerName, sizeof(layerName), "layer%02d", z);
+                setup.stratGroups.push_back(getIntText(layers[z - 1], layerName));
+            }
+        }
+    }
+    timer.lap("stratigraphy");
+
+    readSeries(root[EL_HYDRO_SERIES], "hydro_series", S_QW, false, setup.hydroSeries);
+    timer.lap("hydro_series");
+    readSeries(root[EL_SED_SERIES], "sed_series", S_QS, true, setup.sedSeries);
+    timer.lap("sed_series");
+
+    if (root[EL_OUTPUT] != NULL)
+    {
+        XMLPrinter printer(NULL, true);
+        root[EL_OUTPUT]->Accept(&printer);
+        setup.output = printer.CStr();
+    }
+
+    checkSetup(setup);
+    timer.lap("checks");
+}
+
+void scanSetupSizes(std::istream &in, ModelSetup &setup)
+{
+    // like readSetup, the first of each top level element, PARAMS value and loc counts
+    bool seenRoot[ROOT_ELEMENTS] = {}, seenParam[PARAM_FIELDS] = {};
+    int *params[PARAM_FIELDS] = {&setup.nnodes, NULL, NULL, &setup.nlayer, NULL, &setup.ngsz, &setup.nlith, &setup.ngrp};
+    int section = -1, param = -1;
+    std::vector<SeriesStep> *series = NULL;
+    bool inStep = false, hasLoc = false, inLoc = false;
+    SeriesStep step;
+    std::string text;
+
+    TagScanner scanner(in);
+    int depth = 0;                             // Elements open, the root element included
+    for (TagScanner::Token token = scanner.next(); token != TagScanner::DONE; token = scanner.next())
+    {
+        if (token == TagScanner::TEXT)
+        {
+            if (param >= 0 || inLoc)
+                text += scanner.text();
+            continue;
+        }
+
+        if (token == TagScanner::START || token == TagScanner::EMPTY)
+        {
+            depth++;
+            text.clear();
+            if (depth == 2)
+            {
+                section = rootIndex().find(scanner.name().c_str());
+                if (section >= 0 && seenRoot[section])
+                    section = -1;
+                else if (section >= 0)
+                    seenRoot[section] = true;
+                series = (section == EL_HYDRO_SERIES) ? &setup.hydroSeries :
+                         (section == EL_SED_SERIES) ? &setup.sedSeries : NULL;
+            }
+            else if (depth == 3 && section == EL_PARAMS)
+            {
+                param = paramIndex().find(scanner.name().c_str());
+                if (param >= 0 && (seenParam[param] || params[param] == NULL))
+                    param = -1;
+            }
+            else if (depth == 3 && series != NULL && scanner.name() == "STEP")
+            {
+                inStep = true;
+                hasLoc = false;
+            }
+            else if (depth == 4 && inStep && not hasLoc && scanner.name() == seriesNames[S_LOC])
+                inLoc = true;
+        }
+        if (token == TagScanner::START)
+            continue;
+
+        // the end of the element, or of one with no content
+        if (param >= 0)
+        {
+            *params[param] = scannedInt(text, paramNames[param]);
+            seenParam[param] = true;
+            param = -1;
+        }
+        else if (inLoc)
+        {
+            step.loc = scannedInt(text, seriesNames[S_LOC]);
+            hasLoc = true;
+            inLoc = false;
+        }
+        else if (inStep && depth == 3)
+        {
+            if (not hasLoc)
+                throw GrateError(std::string("Error getting child element: ") + seriesNames[S_LOC]);
+            series->push_back(step);
+            inStep = false;
+        }
+        else if (depth == 2)
+            section = -1, series = NULL;
+        depth--;
+    }
+
+    for (int f = 0; f < PARAM_FIELDS; f++)
+        if (params[f] != NULL && not seenParam[f])
+            throw GrateError(std::string("Error getting child element: ") + paramNames[f]);
+    if (not seenRoot[EL_PARAMS])
+        throw GrateError("Error getting PARAMS element from XML file");
+}
+
+void checkSetup(const ModelSetup &s)
+{
+    // NodeGSDObject holds 3 lithologies and NGSZ + 2 size classes
+    if (s.nnodes < 2)
+        throw GrateError("NNODES must be at least 2");
+    if (s.nlith < 0 || s.nlith > 3 || s.ngsz < 0 || s.ngsz > 13 || s.ngrp < 1)
+        throw GrateError("NLITH must be at most 3, NGSZ at most 13 and NGRP at least 1");
+    if (s.nlayer < 12)
+        throw GrateError("NLAYER must be at least 12");
+
+    size_t ngroups = size_t(s.nlith) * s.ngrp;
+    if (s.gsdPct.size() != ngroups * s.ngsz || s.gsdAbrasion.size() != ngroups || s.gsdDensity.size() != ngroups)
+        throw GrateError("GSD library does not match NLITH, NGRP and NGSZ");
+
+    size_t n = s.x.size();
+    if (n > size_t(s.nnodes))
+        throw GrateError("More profile entries than NNODES");
+    if (s.eta.size() != n || s.bedrock.size() != n || s.width.size() != n || s.sinu.size() != n ||
+            s.fpWidth.size() != n || s.Hmax.size() != n || s.theta.size() != n ||
+            s.algrp.size() != n || s.stgrp.size() != n)
+        throw GrateError("Incomplete profile");
+    for (size_t i = 0; i < n; i++)
+        if (s.algrp[i] < 1 || s.algrp[i] > s.ngrp || s.stgrp[i] < 1 || s.stgrp[i] > s.ngrp)
+            throw GrateError("ALGRP and STGRP must be between 1 and NGRP");
+
+    if (s.hasStratigraphy)
+    {
+        if (s.stratX.size() > size_t(s.nnodes))
+            throw GrateError("More stratigraphy entries than NNODES");
+        if (s.nlayer < STRAT_LAYERS)
+            throw GrateError("NLAYER must be at least 30 to read the stratigraphy element");
+        if (s.stratGroups.size() != s.stratX.size() * STRAT_LAYERS)
+            throw GrateError("Incomplete stratigraphy");
+        for (size_t i = 0; i < s.stratGroups.size(); i++)
+            if (s.stratGroups[i] < 1 || s.stratGroups[i] > s.ngrp)
+                throw GrateError("Stratigraphy layer groups must be between 1 and NGRP");
+    }
+
+    if (s.hydroSeries.empty())
+        throw GrateError("hydro_series has no STEP elements");
+    if (s.sedSeries.empty())
+        throw GrateError("sed_series has no STEP elements");
+    for (size_t i = 0; i < s.sedSeries.size(); i++)
+        if (s.sedSeries[i].gsd < 1 || s.sedSeries[i].gsd > s.ngrp)
+            throw GrateError("Sediment series GSD must be between 1 and NGRP");
+}
+
+uint64_t hashInput(const char *data, size_t n)
+{
+    // not cryptographic: this only has to notice that the file was edited
+    uint64_t h = 0x9e3779b97f4a7c15ull ^ n;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        uint64_t w;
+        std::memcpy(&w, data + i, 8);
+        h = (h ^ w) * 0xff51afd7ed558ccdull;
+        h ^= h >> 32;
+    }
+    if (i < n)
+    {
+        uint64_t w = 0;
+        std::memcpy(&w, data + i, n - i);
+        h = (h ^ w) * 0xff51afd7ed558ccdull;
+        h ^= h >> 32;
+    }
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+std::string setupCacheName(const std::string &inputFile)
+{
+    return inputFile + ".setup";
+}
+
+void writeSetupCache(const std::string &fileName, uint64_t inputHash, const ModelSetup &s)
+{
+    std::vector<char> body;
+    put(body, int32_t(s.nnodes));
+    put(body, int32_t(s.nlayer));
+    put(body, int32_t(s.ngsz));
+    put(body, int32_t(s.nlith));
+    put(body, int32_t(s.ngrp));
+    put(body, s.layer);
+    put(body, s.la);
+    put(body, s.poro);
+
+    put(body, s.qsTweak);
+    put(body, s.qwTweak);
+    put(body, s.substrDial);
+    put(body, s.feedQw);
+    put(body, s.feedQs);
+    put(body, s.HmaxTweak);
+    put(body, s.randAbr);
+
+    putArray(body, s.gsdPct);
+    putArray(body, s.gsdAbrasion);
+    putArray(body, s.gsdDensity);
+
+    putArray(body, s.x);
+    putArray(body, s.eta);
+    putArray(body, s.bedrock);
+    putArray(body, s.width);
+    putArray(body, s.sinu);
+    putArray(body, s.fpWidth);
+    putArray(body, s.Hmax);
+    putArray(body, s.theta);
+    putArray(body, s.algrp);
+    putArray(body, s.stgrp);
+
+    put(body, uint32_t(s.hasStratigraphy ? 1 : 0));
+    putArray(body, s.stratX);
+    putArray(body, s.stratGroups);
+
+    putSeries(body, s.hydroSeries);
+    putSeries(body, s.sedSeries);
+
+    putString(body, s.output);
+    put(body, uint64_t(s.warnings.size()));
+    for (unsigned int i = 0; i < s.warnings.size(); i++)
+        putString(body, s.warnings[i]);
+
+    std::vector<char> header;
+    header.insert(header.end(), setupMagic, setupMagic + sizeof(setupMagic));
+    put(header, uint32_t(SETUP_VERSION));
+    put(header, endianMarker);
+    put(header, inputHash);
+    put(header, uint64_t(body.size()));
+
+    // write to a temporary file and rename, so a run never maps a half-written cache
+    std::string tmpName = fileName + ".tmp";
+    {
+        std::ofstream out(tmpName, std::ios::out | std::ios::binary | std::ios::trunc);
+        out.write(header.data(), header.size());
+        out.write(body.data(), body.size());
+        out.write(setupTrailer, sizeof(setupTrailer));
+        out.close();
+        if (not out)
+            throw GrateError("Error writing setup cache: " + fileName);
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmpName, fileName, ec);
+    if (ec)
+        throw GrateError("Error writing setup cache: " + fileName + ": " + ec.message());
+}
+
+bool loadSetupCache(const std::string &fileName, uint64_t inputHash, ModelSetup &s)
+{
+    MappedFile file(fileName);
+    if (file.data == NULL)
+        return false;
+
+    try {
+        Cursor c(file.data, file.data + file.size);
+        char magic[8];
+        c.take(magic, sizeof(magic));
+        if (std::memcmp(magic, setupMagic, sizeof(magic)) != 0 || c.get<uint32_t>() != SETUP_VERSION ||
+                c.get<uint32_t>() != endianMarker || c.get<uint64_t>() != inputHash)
+            return false;
+        uint64_t bodyBytes = c.get<uint64_t>();
+        if (bodyBytes + sizeof(setupTrailer) != uint64_t(c.end - c.p) ||
+                std::memcmp(c.end - sizeof(setupTrailer), setupTrailer, sizeof(setupTrailer)) != 0)
+            return false;
+        c.end -= sizeof(setupTrailer);
+
+        ModelSetup loaded;
+        loaded.nnodes = c.get<int32_t>();
+        loaded.nlayer = c.get<int32_t>();
+        loaded.ngsz = c.get<int32_t>();
+        loaded.nlith = c.get<int32_t>();
+        loaded.ngrp = c.get<int32_t>();
+        loaded.layer = c.get<double>();
+        loaded.la = c.get<double>();
+        loaded.poro = c.get<double>();
+
+        loaded.qsTweak = c.get<double>();
+        loaded.qwTweak = c.get<double>();
+        loaded.substrDial = c.get<double>();
+        loaded.feedQw = c.get<double>();
+        loaded.feedQs = c.get<double>();
+        loaded.HmaxTweak = c.get<double>();
+        loaded.randAbr = c.get<double>();
+
+        c.getArray(loaded.gsdPct);
+        c.getArray(loaded.gsdAbrasion);
+        c.getArray(loaded.gsdDensity);
+
+        c.getArray(loaded.x);
+        c.getArray(loaded.eta);
+        c.getArray(loaded.bedrock);
+        c.getArray(loaded.width);
+        c.getArray(loaded.sinu);
+        c.getArray(loaded.fpWidth);
+        c.getArray(loaded.Hmax);
+        c.getArray(loaded.theta);
+        c.getArray(loaded.algrp);
+        c.getArray(loaded.stgrp);
+
+        loaded.hasStratigraphy = c.get<uint32_t>() != 0;
+        c.getArray(loaded.stratX);
+        c.getArray(loaded.stratGroups);
+
+        c.getSeries(loaded.hydroSeries);
+        c.getSeries(loaded.sedSeries);
+
+        c.getString(loaded.output);
+        uint64_t nwarnings = c.get<uint64_t>();
+        for (uint64_t i = 0; i < nwarnings; i++)
+        {
+            std::string w;
+            c.getString(w);
+            loaded.warnings.push_back(w);
+        }
+        if (c.p != c.end)
+            return false;
+
+        checkSetup(loaded);
+        s = loaded;
+    }
+    catch (const GrateError &) {
+        return false;                           // damaged: the xml will be read instead
+    }
+    return true;
+}
@@ -0,0 +1,107 @@
+#ifndef SETUP_H
+#define SETUP_H
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "tinyxml2/tinyxml2.h"
+
+using namespace tinyxml2;
+
+
+// One entry of the hydro_series or sed_series input
+class SeriesStep
+{
+public:
+
+    SeriesStep();
+
+    double datetime;                           // Excel serial date
+    double Q;                                  // Qw or Qs (m3/s)
+    int loc;                                   // Source coordinate
+    int gsd;                                   // Sediment group, 1-based as in the input (sed_series only)
+};
+
+// Everything the model reads from the input file, as read, before any of it is used. Built from
+// the xml by readSetup(), or loaded from a setup cache; RiverProfile, hydro and sed build from it.
+class ModelSetup
+{
+public:
+
+    ModelSetup();
+
+    // PARAMS
+    int nnodes;
+    int nlayer;
+    int ngsz;
+    int nlith;
+    int ngrp;
+    double layer;
+    double la;
+    double poro;
+
+    // RANDOMISERS, with their defaults if not in the input
+    double qsTweak;
+    double qwTweak;
+    double substrDial;
+    double feedQw;
+    double feedQs;
+    double HmaxTweak;
+    double randAbr;
+
+    // LITH1.. GSD library: cumulative % finer at PSI_-3.. for [lith][grp][size], ABR and RHOS for [lith][grp]
+    std::vector<double> gsdPct;
+    std::vector<double> gsdAbrasion;
+    std::vector<double> gsdDensity;
+
+    // profile: one entry per XX element
+    std::vector<double> x;
+    std::vector<double> eta;
+    std::vector<double> bedrock;
+    std::vector<double> width;
+    std::vector<double> sinu;
+    std::vector<double> fpWidth;               // As a multiple of width
+    std::vector<double> Hmax;
+    std::vector<double> theta;
+    std::vector<int> algrp;                    // 1-based as in the input
+    std::vector<int> stgrp;
+
+    // stratigraphy: X1 and the groups of layer01..layer30 for each XXX element
+    bool hasStratigraphy;
+    std::vector<double> stratX;
+    std::vector<int> stratGroups;              // [node][layer], 1-based
+
+    std::vector<SeriesStep> hydroSeries;
+    std::vector<SeriesStep> sedSeries;
+
+    std::string output;                        // The OUTPUT element as xml, empty if there isn't one
+
+    std::vector<std::string> warnings;         // Problems that don't stop the run
+
+    std::vector< std::pair<std::string, double> > readTimes;    // Seconds spent on each section by readSetup (not cached)
+
+    double psi(int lith, int grp, int size) const { return gsdPct[(lith * ngrp + grp) * ngsz + size]; }
+};
+
+const int STRAT_LAYERS = 30;                   // layer01..layer30 in the stratigraphy element
+
+// One pass over the document: each element is visited once, and children are matched to the
+// values they hold through precomputed name tables rather than a search per value
+void readSetup(XMLElement *params_root, ModelSetup &setup);     // throws GrateError
+void checkSetup(const ModelSetup &setup);                       // throws GrateError if inconsistent
+
+// Only what the memory footprint depends on (see predictFootprint): the PARAMS counts, and the
+// loc of each series entry. Read from the xml as a stream, without building the document, so an
+// input too large to load can still be sized. Throws GrateError if any of them is missing.
+void scanSetupSizes(std::istream &in, ModelSetup &setup);
+
+// Setup cache: a binary image of a ModelSetup, tagged with a hash of the xml file it was read
+// from. The xml stays the source of truth: a cache is only used if the hash still matches.
+uint64_t hashInput(const char *data, size_t n);
+void writeSetupCache(const std::string &fileName, uint64_t inputHash, const ModelSetup &setup);
+bool loadSetupCache(const std::string &fileName, uint64_t inputHash, ModelSetup &setup);   // false if missing or stale
+std::string setupCacheName(const std::string &inputFile);      // e.g. Conway.xml -> Conway.xml.setup
+
+#endif // SETUP_H
@@ -0,0 +1,224 @@
+/*******************
+ *
+ *
+ *  GRATE 9
+ *
+ *  Convergence counters for the iterative hydraulics
+ *
+ *
+ *
+*********************/
+
+#include "solverstats.h"
+#include "grateerror.h"
+#include "jsontext.h"
+#include <fstream>
+#include <ciso646>
+
+namespace {
+
+const char *solverNames[N_SOLVERS] = {
+    "energyConserve", "xsCritDepth", "quasiNormal", "findQ", "findStable", "regimeModel"
+};
+
+const char *fallbackNames[N_FALLBACKS] = {
+    "critical_depth"
+};
+
+bool endsWith(const std::string &s, const std::string &suffix)
+{
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+}  // namespace
+
+
+SolverStats::SolverStats()
+{
+    clear();
+}
+
+void SolverStats::clear()
+{
+    for (int s = 0; s < N_SOLVERS; s++)
+    {
+        calls[s] = 0;
+        totalIterations[s] = 0;
+        maxIterations[s] = 0;
+        notConverged[s] = 0;
+        for (int b = 0; b < ITERATION_BUCKETS; b++)
+            histogram[s][b] = 0;
+    }
+    for (int f = 0; f < N_FALLBACKS; f++)
+        nodeFallbacks[f].clear();
+}
+
+void SolverStats::fallback(Fallback kind, unsigned int node)
+{
+    std::vector<unsigned long> &nodes = nodeFallbacks[kind];
+    if (node >= nodes.size())
+        nodes.resize(node + 1, 0);
+    nodes[node]++;
+}
+
+void SolverStats::merge(const SolverStats &other)
+{
+    for (int s = 0; s < N_SOLVERS; s++)
+    {
+        calls[s] += other.calls[s];
+        totalIterations[s] += other.totalIterations[s];
+        if (other.maxIterations[s] > maxIterations[s])
+            maxIterations[s] = other.maxIterations[s];
+        notConverged[s] += other.notConverged[s];
+        for (int b = 0; b < ITERATION_BUCKETS; b++)
+            histogram[s][b] += other.histogram[s][b];
+    }
+    for (int f = 0; f < N_FALLBACKS; f++)
+    {
+        const std::vector<unsigned long> &from = other.nodeFallbacks[f];
+        std::vector<unsigned long> &to = nodeFallbacks[f];
+        if (from.size() > to.size())
+            to.resize(from.size(), 0);
+        for (unsigned int n = 0; n < from.size(); n++)
+            to[n] += from[n];
+    }
+}
+
+unsigned long SolverStats::fallbacks(Fallback kind) const
+{
+    unsigned long total = 0;
+    for (unsigned int n = 0; n < nodeFallbacks[kind].size(); n++)
+        total += nodeFallbacks[kind][n];
+    return total;
+}
+
+const char *SolverStats::name(Solver solver)
+{
+    return solverNames[solver];
+}
+
+const char *SolverStats::name(Fallback kind)
+{
+    return fallbackNames[kind];
+}
+
+std::string SolverStats::bucketName(int b)
+{
+    if (b < 2)
+        return std::to_string(b);
+    if (b == ITERATION_BUCKETS - 1)
+        return std::to_string(1 << (b - 1)) + "+";
+    return std::to_string(1 << (b - 1)) + "-" + std::to_string((1 << b) - 1);
+}
+
+void SolverStats::writeJson(std::ostream &out, const std::string &indent) const
+{
+    out << indent << "\"solvers\": {\n";
+    for (int s = 0; s < N_SOLVERS; s++)
+    {
+        out << indent << "  ";
+        writeJsonString(out, solverNames[s]);
+        out << ": {\"calls\": " << calls[s]
+            << ", \"iterations\": " << totalIterations[s] << ", \"max_iterations\": " << maxIterations[s]
+            << ", \"not_converged\": " << notConverged[s] << ", \"histogram\": {";
+        bool first = true;
+        for (int b = 0; b < ITERATION_BUCKETS; b++)
+        {
+            if (histogram[s][b] == 0)
+                continue;
+            out << (first ? "" : ", ");
+            writeJsonString(out, bucketName(b));
+            out << ": " << histogram[s][b];
+            first = false;
+        }
+        out << "}}" << (s + 1 < N_SOLVERS ? "," : "") << "\n";
+    }
+    out << indent << "},\n";
+
+    // nodes without fallbacks are left out
+    out << indent << "\"fallbacks\": {\n";
+    for (int f = 0; f < N_FALLBACKS; f++)
+    {
+        out << indent << "  ";
+        writeJsonString(out, fallbackNames[f]);
+        out << ": {\"total\": " << fallbacks(Fallback(f)) << ", \"nodes\": {";
+        bool first = true;
+        for (unsigned int n = 0; n < nodeFallbacks[f].size(); n++)
+        {
+            if (nodeFallbacks[f][n] == 0)
+                continue;
+            out << (first ? "" : ", ") << "\"" << n << "\": " << nodeFallbacks[f][n];
+            first = false;
+        }
+        out << "}}" << (f + 1 < N_FALLBACKS ? "," : "") << "\n";
+    }
+    out << indent << "}";
+}
+
+void SolverStats::writeCsv(std::ostream &out, const std::string &prefix) const
+{
+    for (int s = 0; s < N_SOLVERS; s++)
+    {
+        out << prefix << "solver," << solverNames[s] << ",calls," << calls[s] << "\n";
+        out << prefix << "solver," << solverNames[s] << ",iterations," << totalIterations[s] << "\n";
+        out << prefix << "solver," << solverNames[s] << ",max_iterations," << maxIterations[s] << "\n";
+        out << prefix << "solver," << solverNames[s] << ",not_converged," << notConverged[s] << "\n";
+        for (int b = 0; b < ITERATION_BUCKETS; b++)
+            if (histogram[s][b] > 0)
+                out << prefix << "histogram," << solverNames[s] << "," << bucketName(b) << "," << histogram[s][b] << "\n";
+    }
+    for (int f = 0; f < N_FALLBACKS; f++)
+        for (unsigned int n = 0; n < nodeFallbacks[f].size(); n++)
+            if (nodeFallbacks[f][n] > 0)
+                out << prefix << "fallback," << fallbackNames[f] << "," << n << "," << nodeFallbacks[f][n] << "\n";
+}
+
+
+SolverReport::SolverReport()
+{
+    firstStep = -1;
+    lastStep = -1;
+}
+
+void SolverReport::add(int first, int last, const SolverStats &stats, bool interval)
+{
+    if (firstStep < 0)
+        firstStep = first;
+    lastStep = last;
+    total.merge(stats);
+    if (interval)
+        intervals.push_back(Interval{first, last, stats});
+}
+
+void SolverReport::write(const std::string &fileName) const
+{
+    std::ofstream out(fileName);
+    if (not out)
+        throw GrateError("Error writing solver report: " + fileName);
+
+    if (endsWith(fileName, ".csv"))
+    {
+        // long format, one count per row
+        out << "first_step,last_step,record,name,key,count\n";
+        total.writeCsv(out, std::to_string(firstStep) + "," + std::to_string(lastStep) + ",");
+        for (unsigned int i = 0; i < intervals.size(); i++)
+            intervals[i].stats.writeCsv(out, std::to_string(intervals[i].firstStep) + "," + std::to_string(intervals[i].lastStep) + ",");
+    }
+    else
+    {
+        out << "{\n  \"first_step\": " << firstStep << ",\n  \"last_step\": " << lastStep << ",\n";
+        total.writeJson(out, "  ");
+        out << ",\n  \"intervals\": [";
+        for (unsigned int i = 0; i < intervals.size(); i++)
+        {
+            out << (i > 0 ? "," : "") << "\n    {\n      \"first_step\": " << intervals[i].firstStep
+                << ",\n      \"last_step\": " << intervals[i].lastStep << ",\n";
+            intervals[i].stats.writeJson(out, "      ");
+            out << "\n    }";
+        }
+        out << (intervals.empty() ? "]\n" : "\n  ]\n") << "}\n";
+    }
+
+    if (not out)
+        throw GrateError("Error writing solver report: " + fileName);
+}
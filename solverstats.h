@@ -0,0 +1,111 @@
+#ifndef SOLVERSTATS_H
+#define SOLVERSTATS_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include <ciso646>
+
+
+// Iterative solvers in hydro whose convergence is counted
+enum Solver {
+    SOLVER_ENERGY_CONSERVE,                    // hydro::energyConserve (bisection on the energy equation)
+    SOLVER_CRIT_DEPTH,                         // hydro::xsCritDepth
+    SOLVER_QUASI_NORMAL,                       // hydro::quasiNormal (Newton)
+    SOLVER_FIND_Q,                             // hydro::findQ
+    SOLVER_FIND_STABLE,                        // hydro::findStable
+    SOLVER_REGIME_MODEL,                       // hydro::regimeModel (gradient search and bisection)
+    N_SOLVERS
+};
+
+// Places where backWater gives up on a solution and substitutes another
+enum Fallback {
+    FALLBACK_CRITICAL_DEPTH,                   // Depth set to critical depth: no subcritical solution, or a solver failed
+    N_FALLBACKS
+};
+
+const int ITERATION_BUCKETS = 12;              // 0, 1, 2-3, 4-7, ... 512-1023, 1024 and over
+
+// Convergence counters for one model: iterations used by each solver, as a histogram with
+// power of two buckets, how often it stopped without converging, and the nodes where backWater
+// fell back to a substitute depth. Only touched by the thread advancing the model.
+class SolverStats
+{
+public:
+
+    SolverStats();
+
+    void record(Solver solver, int iterations, bool converged)
+    {
+        calls[solver]++;
+        totalIterations[solver] += iterations;
+        if (iterations > maxIterations[solver])
+            maxIterations[solver] = iterations;
+        if (not converged)
+            notConverged[solver]++;
+        histogram[solver][bucket(iterations)]++;
+    }
+
+    void fallback(Fallback kind, unsigned int node);
+
+    void merge(const SolverStats &other);
+    void clear();
+
+    unsigned long count(Solver solver) const { return calls[solver]; }
+    unsigned long iterations(Solver solver) const { return totalIterations[solver]; }
+    unsigned long failures(Solver solver) const { return notConverged[solver]; }
+    unsigned long fallbacks(Fallback kind) const;
+
+    static const char *name(Solver solver);
+    static const char *name(Fallback kind);
+    static std::string bucketName(int b);      // e.g. "4-7"
+
+    void writeJson(std::ostream &out, const std::string &indent) const;
+    void writeCsv(std::ostream &out, const std::string &prefix) const;    // rows start with prefix
+
+private:
+    unsigned long calls[N_SOLVERS];
+    unsigned long totalIterations[N_SOLVERS];
+    int maxIterations[N_SOLVERS];
+    unsigned long notConverged[N_SOLVERS];
+    unsigned long histogram[N_SOLVERS][ITERATION_BUCKETS];
+    std::vector<unsigned long> nodeFallbacks[N_FALLBACKS];    // Count per node, grown as needed
+
+    static int bucket(int iterations)
+    {
+        int b = 0;
+        for (; iterations > 0 && b < ITERATION_BUCKETS - 1; iterations >>= 1)
+            b++;
+        return b;
+    }
+};
+
+// Solver counters for a whole run, and optionally for each interval of it
+class SolverReport
+{
+public:
+
+    SolverReport();
+
+    void add(int firstStep, int lastStep, const SolverStats &stats, bool interval);
+
+    // JSON, or CSV if the name ends in .csv; throws GrateError if it can't be written
+    void write(const std::string &fileName) const;
+
+    const SolverStats &totals() const { return total; }
+
+private:
+    struct Interval
+    {
+        int firstStep;
+        int lastStep;
+        SolverStats stats;
+    };
+
+    int firstStep;
+    int lastStep;
+    SolverStats total;
+    std::vector<Interval> intervals;
+};
+
+#endif // SOLVERSTATS_H
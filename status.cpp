@@ -0,0 +1,166 @@
+/*******************
+ *
+ *
+ *  GRATE 9
+ *
+ *  Progress client: asks running models for their progress over their sockets
+ *
+ *
+ *
+*********************/
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <ciso646>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+static void printUsage() {
+    std::cerr << "Usage: GrateStatus SOCKET... [options]" << std::endl;
+    std::cerr << "  SOCKET                 progress socket of a run (GrateCLI --progress-socket), or a" << std::endl;
+    std::cerr << "                         directory: every socket in it" << std::endl;
+    std::cerr << "  --json                 the full progress of each run, phase times and solver counters included," << std::endl;
+    std::cerr << "                         as one JSON object keyed by socket (null if a run doesn't answer)" << std::endl;
+    std::cerr << "  --watch SECONDS        ask again every SECONDS seconds until interrupted" << std::endl;
+}
+
+// the reply to one request, false if nothing is listening
+static bool query(const std::string &path, const std::string &request, std::string &reply) {
+    struct sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        reply = "path too long";
+        return false;
+    }
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+    int s = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s < 0 || connect(s, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        reply = std::strerror(errno);
+        if (s >= 0)
+            close(s);
+        return false;
+    }
+    struct timeval timeout;
+    timeout.tv_sec = 5;
+    timeout.tv_usec = 0;
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    std::string line = request + "\n";
+    bool ok = send(s, line.data(), line.size(), 0) == (ssize_t)line.size();
+    reply.clear();
+    char buffer[4096];
+    ssize_t n;
+    while (ok && (n = recv(s, buffer, sizeof(buffer), 0)) > 0)
+        reply.append(buffer, n);
+    close(s);
+    if (not ok || reply.empty()) {
+        reply = "no reply";
+        return false;
+    }
+    return true;
+}
+
+// sockets named on the command line, and those in directories, in order
+static std::vector<std::string> findSockets(const std::vector<std::string> &names) {
+    std::vector<std::string> sockets;
+    for (unsigned int i = 0; i < names.size(); i++) {
+        std::error_code error;
+        if (not std::filesystem::is_directory(names[i], error)) {
+            sockets.push_back(names[i]);
+            continue;
+        }
+        std::vector<std::string> found;
+        for (std::filesystem::directory_iterator d(names[i], error), end; not error && d != end; d.increment(error))
+            if (d->is_socket(error))
+                found.push_back(d->path().string());
+        std::sort(found.begin(), found.end());
+        sockets.insert(sockets.end(), found.begin(), found.end());
+    }
+    return sockets;
+}
+
+
+int main(int argc, char** argv) {
+    std::vector<std::string> names;
+    bool json = false;
+    int watch = 0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        try {
+            if (arg == "--json") {
+                json = true;
+            }
+            else if (arg == "--watch" && i + 1 < argc) {
+                watch = std::stoi(argv[++i]);
+            }
+            else if (arg == "--help" || arg == "-h") {
+                printUsage();
+                return 0;
+            }
+            else if (arg.compare(0, 2, "--") == 0) {
+                std::cerr << "Unknown or incomplete option: " << arg << std::endl;
+                printUsage();
+                return 1;
+            }
+            else {
+                names.push_back(arg);
+            }
+        }
+        catch (const std::logic_error &) {     // std::stoi: std::invalid_argument or std::out_of_range
+            std::cerr << "Invalid number '" << argv[i] << "'" << (arg != argv[i] ? " for " + arg : "") << std::endl;
+            printUsage();
+            return 1;
+        }
+    }
+    if (names.empty()) {
+        printUsage();
+        return 1;
+    }
+
+    // the exit code says whether every run answered the last time round
+    int status;
+    for (;;) {
+        std::vector<std::string> sockets = findSockets(names);
+        status = sockets.empty() ? 1 : 0;
+        if (json)
+            std::cout << "{";
+        for (unsigned int s = 0; s < sockets.size(); s++) {
+            std::string reply;
+            bool ok = query(sockets[s], json ? "json" : "status", reply);
+            if (not ok)
+                status = 1;
+            if (json) {
+                // the reply ends with a newline
+                std::cout << (s > 0 ? ",\n" : "\n") << "\"" << sockets[s] << "\": ";
+                if (ok)
+                    std::cout << reply.substr(0, reply.size() - 1);
+                else
+                    std::cout << "null";
+            }
+            else if (ok)
+                std::cout << sockets[s] << ": " << reply;
+            else
+                std::cout << sockets[s] << ": not answering (" << reply << ")" << std::endl;
+        }
+        if (json)
+            std::cout << "\n}" << std::endl;
+        if (watch <= 0)
+            break;
+        std::cout << std::endl;
+        std::this_thread::sleep_for(std::chrono::seconds(watch));
+    }
+    return status;
+}
@@ -1,12 +1,34 @@
 /*
  * Compare two output files
+ *
+ * Text results files are mapped and cut into chunks of whole lines, which are compared on a pool
+ * of threads while the main thread finds the next chunk boundaries. Binary results (.grb, .grz)
+ * are not mapped: they are compared frame by frame, each thread taking a contiguous run of frames
+ * and reading it through its own BinaryResultsFile, which decodes each frame once. The comparison
+ * carries on past the first difference and reports, for each variable (column), the largest
+ * absolute, relative and ULP differences and the first step where it is out of tolerance.
+ *
+ * Exit code 0 if the files match within tolerance, 1 otherwise.
  */
 
-#include <fstream>
+#include "mappedfile.h"
+#include "resultsfile.h"
+#include "grateerror.h"
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <condition_variable>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
 #include <sstream>
+#include <stdexcept>
 #include <string>
-#include <iostream>
-#include <cmath>
+#include <thread>
+#include <vector>
 #include <ciso646>
 
 
@@ -15,118 +37,628 @@
 #define ATOL 1e-08
 #define RTOL 1e-05
 
+const size_t CHUNK_BYTES = 4 << 20;            // Text is handed to the threads in chunks of about this size
 
-int main(int argc, char** argv) {
-    if (argc != 3) {
-        std::cerr << "Usage: compare <REF_FILE> <NEW_FILE>" << std::endl;
-        return 1;
+
+struct Options
+{
+    double atol = ATOL;
+    double rtol = RTOL;
+    unsigned int threads = 0;                  // 0: one per core
+    size_t maxReports = 20;                    // Differences listed individually
+};
+
+// Distance in units in the last place: the number of doubles between a and b
+static uint64_t ulpDistance(double a, double b) {
+    uint64_t ua, ub;
+    std::memcpy(&ua, &a, sizeof(a));
+    std::memcpy(&ub, &b, sizeof(b));
+    // map sign-magnitude onto a monotonic integer scale, with -0 and +0 the same
+    if (ua >> 63)
+        ua = 0x8000000000000000ULL - ua;
+    if (ub >> 63)
+        ub = 0x8000000000000000ULL - ub;
+    return int64_t(ua) > int64_t(ub) ? ua - ub : ub - ua;
+}
+
+static std::string columnName(const std::vector<std::string> &names, size_t v) {
+    return v < names.size() && not names[v].empty() ? names[v] : "col " + std::to_string(v + 1);
+}
+
+static std::string shortest(double v) {
+    char text[32];
+    std::to_chars_result r = std::to_chars(text, text + sizeof(text), v);
+    return std::string(text, r.ptr);
+}
+
+// Where something was found: line (text) or frame (binary), and the model step. The step of a
+// text line isn't known inside a chunk until its first Count line; -1 until it is filled in.
+struct Position
+{
+    size_t ordinal = SIZE_MAX;
+    long step = -1;
+
+    bool found() const { return ordinal != SIZE_MAX; }
+};
+
+struct VarStats
+{
+    size_t compared = 0;
+    size_t differ = 0;                         // Not bit for bit the same
+    size_t failed = 0;                         // Outside tolerance
+    double maxAbs = 0;
+    double maxRel = 0;                         // Relative to the ref value, where that isn't 0
+    uint64_t maxUlp = 0;
+    double sumUlp = 0;
+    Position firstFail;
+
+    // returns false if the values are outside tolerance
+    bool add(double ref, double val, const Options &opt, const Position &where) {
+        compared++;
+        if (std::isnan(ref) && std::isnan(val))
+            return true;
+        if (ref == val && std::signbit(ref) == std::signbit(val))
+            return true;
+        differ++;
+
+        bool close = false;
+        if (std::isfinite(ref) && std::isfinite(val)) {
+            double diff = std::abs(val - ref);
+            close = diff <= opt.atol + opt.rtol * std::abs(ref);
+            maxAbs = std::max(maxAbs, diff);
+            if (ref != 0)
+                maxRel = std::max(maxRel, diff / std::abs(ref));
+            uint64_t ulp = ulpDistance(ref, val);
+            maxUlp = std::max(maxUlp, ulp);
+            sumUlp += double(ulp);
+        }
+        if (close)
+            return true;
+        failed++;
+        if (not firstFail.found())
+            firstFail = where;
+        return false;
     }
-    std::string refFileName(argv[1]);
-    std::string newFileName(argv[2]);
 
-    std::cout << "Comparing Grate output files" << std::endl;
+    void merge(const VarStats &o) {
+        compared += o.compared;
+        differ += o.differ;
+        failed += o.failed;
+        maxAbs = std::max(maxAbs, o.maxAbs);
+        maxRel = std::max(maxRel, o.maxRel);
+        maxUlp = std::max(maxUlp, o.maxUlp);
+        sumUlp += o.sumUlp;
+        if (not firstFail.found())
+            firstFail = o.firstFail;
+    }
+};
+
+struct Report
+{
+    Position where;
+    std::string text;
+};
+
+// Everything found in one chunk of text or run of frames
+struct Tally
+{
+    std::vector<VarStats> vars;
+    std::vector<Report> reports;               // The first few, in file order
+    size_t failures = 0;                       // Values out of tolerance and lines that don't match
+    long lastStep = -1;                        // Last Count line seen (text)
+
+    void fail(const Position &where, const std::string &text, const Options &opt) {
+        failures++;
+        if (keeps(opt))
+            reports.push_back(Report{where, text});
+    }
+
+    // false once enough reports are kept; the rest are only counted, so needn't be formatted
+    bool keeps(const Options &opt) const {
+        return reports.size() < std::max<size_t>(opt.maxReports, 1);
+    }
+
+    VarStats &var(size_t v) {
+        if (v >= vars.size())
+            vars.resize(v + 1);
+        return vars[v];
+    }
+};
+
+// Chunks are merged in file order so the first failure and the steps of text lines come out right
+static void mergeTallies(std::vector<Tally> &parts, Tally &total) {
+    long step = total.lastStep;
+    for (size_t p = 0; p < parts.size(); p++) {
+        Tally &t = parts[p];
+        for (size_t r = 0; r < t.reports.size(); r++) {
+            if (t.reports[r].where.step < 0)
+                t.reports[r].where.step = step;
+            total.reports.push_back(t.reports[r]);
+        }
+        for (size_t v = 0; v < t.vars.size(); v++) {
+            if (t.vars[v].firstFail.found() && t.vars[v].firstFail.step < 0)
+                t.vars[v].firstFail.step = step;
+            total.var(v).merge(t.vars[v]);
+        }
+        total.failures += t.failures;
+        if (t.lastStep >= 0)
+            step = t.lastStep;
+    }
+    total.lastStep = step;
+}
+
+
+/*
+ * Text files
+ */
 
-    // open reference file
-    std::ifstream refFile(refFileName);
-    if (refFile.fail()) {
+struct TextChunk
+{
+    const char *ref;
+    const char *refEnd;
+    const char *cmp;
+    const char *cmpEnd;
+    size_t firstLine;
+};
+
+static const char *lineEnd(const char *p, const char *end) {
+    const void *nl = std::memchr(p, '\n', end - p);
+    return nl != NULL ? static_cast<const char*>(nl) : end;
+}
+
+static const char *nextLine(const char *p, const char *end) {
+    const char *e = lineEnd(p, end);
+    return e < end ? e + 1 : end;
+}
+
+static bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static bool nextToken(const char *&p, const char *end, const char *&tok, const char *&tokEnd) {
+    while (p < end && isSpace(*p))
+        p++;
+    if (p == end)
+        return false;
+    tok = p;
+    while (p < end && not isSpace(*p))
+        p++;
+    tokEnd = p;
+    return true;
+}
+
+static bool parseNumber(const char *tok, const char *tokEnd, double &v) {
+    std::from_chars_result r = std::from_chars(tok, tokEnd, v);
+    return r.ec == std::errc() && r.ptr == tokEnd;
+}
+
+// Count lines start a step: "Count:  <step>"
+static bool countLine(const char *p, const char *end, long &step) {
+    const char *tok, *tokEnd;
+    if (not nextToken(p, end, tok, tokEnd) || tokEnd - tok != 6 || std::memcmp(tok, "Count:", 6) != 0)
+        return false;
+    step = -1;
+    double v;
+    if (nextToken(p, end, tok, tokEnd) && parseNumber(tok, tokEnd, v))
+        step = long(v);
+    return true;
+}
+
+static std::string lineText(const char *p, const char *e) {
+    return std::string(p, e);
+}
+
+static void compareLines(const TextChunk &c, const std::vector<std::string> &names, const Options &opt, Tally &t) {
+    const char *r = c.ref;
+    const char *n = c.cmp;
+    Position where;
+    where.ordinal = c.firstLine;
+
+    for (; r < c.refEnd; where.ordinal++) {
+        if (n >= c.cmpEnd) {
+            t.fail(where, "New file ends before the ref file", opt);
+            return;
+        }
+        const char *re = lineEnd(r, c.refEnd);
+        const char *ne = lineEnd(n, c.cmpEnd);
+
+        long step;
+        if (countLine(r, re, step)) {
+            where.step = step;
+            t.lastStep = step;
+            // check count line matches directly
+            if (re - r != ne - n || std::memcmp(r, n, re - r) != 0)
+                t.fail(where, t.keeps(opt) ? "Lines differ:\n" + lineText(r, re) + "\n" + lineText(n, ne) : "", opt);
+        }
+        else {
+            // for other lines, we split into tokens and look at relative differences (allowed to be small difference)
+            const char *rp = r, *np = n;
+            const char *rt, *rtEnd, *nt, *ntEnd;
+            for (size_t col = 0; nextToken(rp, re, rt, rtEnd); col++) {
+                if (not nextToken(np, ne, nt, ntEnd)) {
+                    t.fail(where, "Ran out of tokens in the new file", opt);
+                    break;
+                }
+                double refval, newval;
+                if (not parseNumber(rt, rtEnd, refval) || not parseNumber(nt, ntEnd, newval)) {
+                    if (rtEnd - rt != ntEnd - nt || std::memcmp(rt, nt, rtEnd - rt) != 0)
+                        t.fail(where, t.keeps(opt) ? "Tokens differ: " + lineText(nt, ntEnd) + " vs " + lineText(rt, rtEnd) : "", opt);
+                    continue;
+                }
+                if (not t.var(col).add(refval, newval, opt, where))
+                    t.fail(where, t.keeps(opt) ? "Values differ (" + columnName(names, col) + "): " +
+                           shortest(newval) + " vs " + shortest(refval) : "", opt);
+            }
+            if (nextToken(np, ne, nt, ntEnd))
+                t.fail(where, "New file has extra tokens", opt);
+        }
+
+        r = re < c.refEnd ? re + 1 : c.refEnd;
+        n = ne < c.cmpEnd ? ne + 1 : c.cmpEnd;
+    }
+}
+
+// "column no. N:  NAME" in the header names column N; otherwise it is "col N"
+static void columnNames(const char *p, const char *e, std::vector<std::string> &names) {
+    const char *prefix = "column no. ";
+    size_t len = std::strlen(prefix);
+    if (size_t(e - p) <= len || std::memcmp(p, prefix, len) != 0)
+        return;
+    unsigned int col = 0;
+    std::from_chars_result r = std::from_chars(p + len, e, col);
+    if (r.ec != std::errc() || r.ptr == e || *r.ptr != ':' || col == 0 || col > 10000)
+        return;
+    const char *q = r.ptr + 1;
+    const char *tok, *tokEnd, *more, *moreEnd;
+    if (not nextToken(q, e, tok, tokEnd) || nextToken(q, e, more, moreEnd))
+        return;
+    if (names.size() < col)
+        names.resize(col);
+    names[col - 1] = std::string(tok, tokEnd);
+}
+
+static bool compareText(const std::string &refFileName, const std::string &newFileName, const Options &opt, Tally &total,
+                        std::vector<std::string> &names) {
+    MappedFile refFile(refFileName);
+    if (refFile.data == NULL) {
         std::cerr << "Error opening file: " << refFileName << std::endl;
-        return 1;
+        return false;
     }
     std::cout << "Opened ref file: " << refFileName << std::endl;
-
-    // open new file
-    std::ifstream newFile(newFileName);
-    if (newFile.fail()) {
+    MappedFile newFile(newFileName);
+    if (newFile.data == NULL) {
         std::cerr << "Error opening file: " << newFileName << std::endl;
-        return 1;
+        return false;
     }
     std::cout << "Opened new file: " << newFileName << std::endl;
+    refFile.sequential();
+    newFile.sequential();
 
-    // loop over header lines
-    std::string newLine, refLine;
-    bool gotHeader = false;
-    int lineNumber = 0;
-    while (not gotHeader) {
-        lineNumber++; 
+    const char *refEnd = refFile.data + refFile.size;
+    const char *newEnd = newFile.data + newFile.size;
 
-        // ref line
-        if (not std::getline(refFile, refLine)) {
-            std::cerr << "Error reading line in ref file line " << lineNumber << std::endl;
-            return 1;
+    // header: every line before the first Count line must match exactly
+    const char *r = refFile.data;
+    const char *n = newFile.data;
+    Position where;
+    where.ordinal = 1;
+    size_t headerFailures = total.failures;
+    for (;; where.ordinal++) {
+        if (r == refEnd) {
+            std::cerr << "Error reading line in ref file line " << where.ordinal << std::endl;
+            return false;
         }
-
-        // check if the line starts with Count
-        std::istringstream refiss(refLine);
-        std::string token;
-        refiss >> token;
-        if (token.compare("Count:") == 0) {
-            // header ends when we find a Count line
-            gotHeader = true;
+        const char *re = lineEnd(r, refEnd);
+        long step;
+        if (countLine(r, re, step))
+            break;
+        if (n == newEnd) {
+            total.fail(where, "New file ends in the header", opt);
+            return true;
         }
-        else {
-            // new line
-            if (not std::getline(newFile, newLine)) {
-                std::cerr << "Error reading line in new file line " << lineNumber << std::endl;
-                return 1;
+        const char *ne = lineEnd(n, newEnd);
+        if (re - r != ne - n || std::memcmp(r, n, re - r) != 0)
+            total.fail(where, "Lines differ:\n" + lineText(r, re) + "\n" + lineText(n, ne), opt);
+        columnNames(r, re, names);
+        r = nextLine(r, refEnd);
+        n = nextLine(n, newEnd);
+    }
+    if (total.failures == headerFailures)
+        std::cout << "Header matches!" << std::endl;
+
+    // body: the main thread cuts both files into chunks of the same lines, the workers compare them
+    std::vector<TextChunk> chunks;
+    chunks.reserve((refEnd - r) / CHUNK_BYTES + 2);        // never reallocated, so workers can read it
+    std::atomic<size_t> published(0);
+    bool finished = false;
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::vector<Tally> parts(chunks.capacity());
+    std::atomic<size_t> next(0);
+
+    auto worker = [&]() {
+        for (;;) {
+            size_t c = next++;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [&]() { return c < published || finished; });
+                if (c >= published)
+                    return;
             }
+            compareLines(chunks[c], names, opt, parts[c]);
+        }
+    };
+    unsigned int nthreads = opt.threads > 0 ? opt.threads : std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < nthreads; i++)
+        threads.emplace_back(worker);
 
-            // compare
-            if (refLine.compare(newLine)) {
-                std::cerr << "Lines differ:" << std::endl << refLine << std::endl << newLine << std::endl;
-                return 1;
+    size_t line = where.ordinal;
+    while (r < refEnd) {
+        TextChunk c;
+        c.ref = r;
+        c.refEnd = r + std::min<size_t>(CHUNK_BYTES, refEnd - r);
+        c.refEnd = c.refEnd < refEnd ? nextLine(c.refEnd, refEnd) : refEnd;
+        c.cmp = n;
+        c.firstLine = line;
+        for (const char *p = r; p < c.refEnd; p = nextLine(p, c.refEnd)) {
+            n = nextLine(n, newEnd);
+            line++;
+        }
+        c.cmpEnd = n;
+        r = c.refEnd;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            chunks.push_back(c);
+            published = chunks.size();
+        }
+        // each worker waits for its own chunk, so wake them all: only the one it belongs to goes on
+        ready.notify_all();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+    }
+    ready.notify_all();
+    for (unsigned int i = 0; i < threads.size(); i++)
+        threads[i].join();
+
+    parts.resize(chunks.size());
+    mergeTallies(parts, total);
+
+    // check if any extra lines left at the end of the new file
+    if (n < newEnd) {
+        where.ordinal = line;
+        where.step = total.lastStep;
+        total.fail(where, "New file has extra lines at the end", opt);
+    }
+    return true;
+}
+
+
+/*
+ * Binary files
+ */
+
+static bool binaryName(const std::string &name) {
+    return name.size() > 4 && (name.compare(name.size() - 4, 4, ".grb") == 0 || name.compare(name.size() - 4, 4, ".grz") == 0);
+}
+
+static void compareFrames(const std::string &refFileName, const std::string &newFileName, size_t first, size_t last,
+                          const std::vector<int> &newVar, const Options &opt, const std::vector<std::string> &names, Tally &t) {
+    try {
+        BinaryResultsFile ref(refFileName);
+        BinaryResultsFile cmp(newFileName);
+        Position where;
+        for (size_t f = first; f < last; f++) {
+            where.ordinal = f;
+            where.step = ref.counter(f);
+            if (cmp.counter(f) != ref.counter(f))
+                t.fail(where, "Step counter differs: " + std::to_string(cmp.counter(f)) + " vs " + std::to_string(ref.counter(f)), opt);
+            const std::vector< std::vector<double> > &refvals = ref.readAll(f);
+            const std::vector< std::vector<double> > &newvals = cmp.readAll(f);
+            for (size_t v = 0; v < newVar.size(); v++) {
+                if (newVar[v] < 0)
+                    continue;
+                VarStats &stats = t.var(v);
+                const std::vector<double> &a = refvals[v];
+                const std::vector<double> &b = newvals[newVar[v]];
+                for (size_t i = 0; i < a.size(); i++)
+                    if (not stats.add(a[i], b[i], opt, where))
+                        t.fail(where, t.keeps(opt) ? "Values differ (" + names[v] + " node " + std::to_string(ref.layout.nodes[i]) +
+                               "): " + shortest(b[i]) + " vs " + shortest(a[i]) : "", opt);
             }
         }
     }
-    std::cout << "Header matches!" << std::endl;
+    catch (const GrateError &e) {
+        Position where;
+        where.ordinal = first;
+        t.fail(where, std::string("Error reading frames: ") + e.what(), opt);
+    }
+}
 
-    // loop over the rest of the file
-    do {
-        // we have refLine already; get newLine to match
-        if (not std::getline(newFile, newLine)) {
-            std::cerr << "Error reading line in new file " << lineNumber << std::endl;
-            return 1;
+static bool compareBinary(const std::string &refFileName, const std::string &newFileName, const Options &opt, Tally &total,
+                          std::vector<std::string> &names) {
+    size_t refFrames, newFrames;
+    std::vector<int> newVar;
+    try {
+        BinaryResultsFile ref(refFileName);
+        std::cout << "Opened ref file: " << refFileName << std::endl;
+        BinaryResultsFile cmp(newFileName);
+        std::cout << "Opened new file: " << newFileName << std::endl;
+
+        // variables are matched by name; the output nodes must be the same
+        Position where;
+        names = ref.layout.variables;
+        for (size_t v = 0; v < names.size(); v++) {
+            newVar.push_back(cmp.variableIndex(names[v]));
+            if (newVar[v] < 0)
+                total.fail(where, "Variable " + names[v] + " is missing from the new file", opt);
+        }
+        for (size_t v = 0; v < cmp.layout.variables.size(); v++)
+            if (ref.variableIndex(cmp.layout.variables[v]) < 0)
+                total.fail(where, "New file has an extra variable " + cmp.layout.variables[v], opt);
+        if (cmp.layout.nodes != ref.layout.nodes || cmp.layout.x != ref.layout.x) {
+            total.fail(where, "Output nodes differ", opt);
+            return true;
         }
+        if (ref.layout.attributes != cmp.layout.attributes)
+            total.fail(where, "Header attributes differ", opt);
+        if (total.failures == 0)
+            std::cout << "Header matches!" << std::endl;
 
-        std::istringstream refiss(refLine);
-        std::istringstream newiss(newLine);
-        std::string reftok;
-        refiss >> reftok;
-        if (reftok.compare("Count:") == 0) {
-            // check count line matches directly
-            if (refLine.compare(newLine)) {
-                std::cerr << "Lines differ (L" << lineNumber << "):" << std::endl << refLine << std::endl << newLine << std::endl;
+        refFrames = ref.frameCount();
+        newFrames = cmp.frameCount();
+    }
+    catch (const GrateError &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return false;
+    }
+
+    // each thread reads its own run of frames, so compressed frames are decoded once each
+    size_t nframes = std::min(refFrames, newFrames);
+    unsigned int nthreads = opt.threads > 0 ? opt.threads : std::max(1u, std::thread::hardware_concurrency());
+    nthreads = std::max<size_t>(1, std::min<size_t>(nthreads, nframes));
+    std::vector<Tally> parts(nthreads);
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < nthreads; i++)
+        threads.emplace_back(compareFrames, std::cref(refFileName), std::cref(newFileName), nframes * i / nthreads,
+                             nframes * (i + 1) / nthreads, std::cref(newVar), std::cref(opt), std::cref(names), std::ref(parts[i]));
+    for (unsigned int i = 0; i < threads.size(); i++)
+        threads[i].join();
+
+    mergeTallies(parts, total);
+    if (refFrames != newFrames) {
+        Position where;
+        where.ordinal = nframes;
+        total.fail(where, "Frame counts differ: " + std::to_string(newFrames) + " vs " + std::to_string(refFrames), opt);
+    }
+    return true;
+}
+
+
+/*
+ * Summary
+ */
+
+static void printSummary(const Tally &total, const std::vector<std::string> &names, const Options &opt, bool binary) {
+    const char *unit = binary ? "frame " : "L";
+    size_t shown = std::min(total.reports.size(), opt.maxReports);
+    for (size_t r = 0; r < shown; r++) {
+        const Report &rep = total.reports[r];
+        std::cerr << rep.text;
+        if (rep.where.found()) {
+            std::cerr << " (" << unit << rep.where.ordinal;
+            if (rep.where.step >= 0)
+                std::cerr << ", step " << rep.where.step;
+            std::cerr << ")";
+        }
+        std::cerr << std::endl;
+    }
+    if (total.failures > shown)
+        std::cerr << "... and " << total.failures - shown << " more" << std::endl;
+
+    if (not total.vars.empty()) {
+        std::ios::fmtflags flags = std::cout.flags();
+        std::streamsize precision = std::cout.precision(4);
+        std::cout << std::endl << "Per variable (atol " << opt.atol << ", rtol " << opt.rtol << "):" << std::endl;
+        std::cout << std::left << std::setw(16) << "variable" << std::right
+                  << std::setw(12) << "values" << std::setw(12) << "differ" << std::setw(12) << "outside"
+                  << std::setw(13) << "max abs" << std::setw(13) << "max rel" << std::setw(13) << "max ulp"
+                  << std::setw(13) << "mean ulp" << std::setw(12) << "first step" << std::endl;
+        for (size_t v = 0; v < total.vars.size(); v++) {
+            const VarStats &s = total.vars[v];
+            std::cout << std::left << std::setw(16) << columnName(names, v) << std::right
+                      << std::setw(12) << s.compared << std::setw(12) << s.differ << std::setw(12) << s.failed
+                      << std::setw(13) << s.maxAbs << std::setw(13) << s.maxRel << std::setw(13) << double(s.maxUlp)
+                      << std::setw(13) << (s.compared > 0 ? s.sumUlp / s.compared : 0.0) << std::setw(12);
+            if (s.firstFail.found())
+                std::cout << s.firstFail.step << std::endl;
+            else
+                std::cout << "-" << std::endl;
+        }
+        std::cout.flags(flags);
+        std::cout.precision(precision);
+    }
+
+    // the reports are in file order, so the first is the first difference of any kind
+    if (total.reports.empty())
+        std::cout << "No differences outside tolerance" << std::endl;
+    else if (total.reports[0].where.step >= 0)
+        std::cout << "First diverging step: " << total.reports[0].where.step << std::endl;
+    else if (total.reports[0].where.found())
+        std::cout << "First difference at " << unit << total.reports[0].where.ordinal << std::endl;
+    else
+        std::cout << "Headers differ" << std::endl;
+}
+
+static void printUsage() {
+    std::cerr << "Usage: compare [options] <REF_FILE> <NEW_FILE>" << std::endl;
+    std::cerr << "  text results, or binary results if both files end in .grb or .grz" << std::endl;
+    std::cerr << "  --atol X               absolute tolerance (default " << ATOL << ")" << std::endl;
+    std::cerr << "  --rtol X               relative tolerance (default " << RTOL << ")" << std::endl;
+    std::cerr << "  --threads N            threads to compare with (default: one per core)" << std::endl;
+    std::cerr << "  --max-reports N        differences to list individually (default 20)" << std::endl;
+}
+
+
+int main(int argc, char** argv) {
+    Options opt;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        try {
+            if (arg == "--atol" && i + 1 < argc) {
+                opt.atol = std::stod(argv[++i]);
+            }
+            else if (arg == "--rtol" && i + 1 < argc) {
+                opt.rtol = std::stod(argv[++i]);
+            }
+            else if (arg == "--threads" && i + 1 < argc) {
+                opt.threads = std::stoul(argv[++i]);
+            }
+            else if (arg == "--max-reports" && i + 1 < argc) {
+                opt.maxReports = std::stoul(argv[++i]);
+            }
+            else if (arg.compare(0, 2, "--") == 0) {
+                std::cerr << "Unknown or incomplete option: " << arg << std::endl;
+                printUsage();
                 return 1;
             }
-        }
-        else {
-            // for other lines, we split into tokens and look at relative differences (allowed to be small difference)
-            std::istringstream refstream(refLine);
-            std::istringstream newstream(newLine);
-            double newval, refval;
-            while (refstream >> refval) {
-                if (not (newstream >> newval)) {
-                    std::cerr << "Ran out of tokens: " << lineNumber << std::endl;
-                    return 1;
-                }
-                
-                // formula from numpy.isclose
-                if (abs(newval - refval) > (ATOL + RTOL * abs(refval))) {
-                    std::cerr << "Values differ (L" << lineNumber << "): " << newval << " vs " << refval << std::endl;
-                    return 1;
-                }
+            else {
+                files.push_back(arg);
             }
         }
-
-        lineNumber++;
+        catch (const std::logic_error &) {
+            std::cerr << "Bad number for option " << arg << std::endl;
+            return 1;
+        }
     }
-    while (std::getline(refFile, refLine));
-    std::cout << "Body matches!" << std::endl;
+    if (files.size() != 2) {
+        printUsage();
+        return 1;
+    }
+    std::string refFileName(files[0]);
+    std::string newFileName(files[1]);
 
-    // check if any extra lines left at the end of the new file
-    if (std::getline(newFile, newLine)) {
-        std::cerr << "New file has extra lines at the end" << std::endl;
+    std::cout << "Comparing Grate output files" << std::endl;
+
+    bool binary = binaryName(refFileName);
+    if (binary != binaryName(newFileName)) {
+        std::cerr << "Can't compare a text results file with a binary one" << std::endl;
         return 1;
     }
 
+    Tally total;
+    std::vector<std::string> names;
+    bool ok = binary ? compareBinary(refFileName, newFileName, opt, total, names)
+                     : compareText(refFileName, newFileName, opt, total, names);
+    if (not ok)
+        return 1;
+    printSummary(total, names, opt, binary);
+
+    if (total.failures > 0)
+        return 1;
+    std::cout << "Body matches!" << std::endl;
     return 0;
 }
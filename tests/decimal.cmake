@@ -0,0 +1,36 @@
+#
+# Fixed point helpers for the timing scripts, as CMake's math() only does integer arithmetic
+#
+
+# "12.345" with DIGITS 6 -> 12345000; extra digits are truncated
+function(decimal_to_int VALUE DIGITS RESULT)
+    if (NOT VALUE MATCHES "^([0-9]+)\\.?([0-9]*)$")
+        message(FATAL_ERROR "Not a non-negative decimal number: '${VALUE}'")
+    endif ()
+    set(whole ${CMAKE_MATCH_1})
+    set(fraction "${CMAKE_MATCH_2}000000000")
+    string(SUBSTRING ${fraction} 0 ${DIGITS} fraction)
+    set(scale 1)
+    foreach (d RANGE 1 ${DIGITS})
+        math(EXPR scale "${scale} * 10")
+    endforeach ()
+    # leading zeros would be octal to math()
+    string(REGEX MATCH "[1-9][0-9]*$" fraction "${fraction}")
+    if (fraction STREQUAL "")
+        set(fraction 0)
+    endif ()
+    math(EXPR value "${whole} * ${scale} + ${fraction}")
+    set(${RESULT} ${value} PARENT_SCOPE)
+endfunction()
+
+# 12345000 with DIGITS 6 -> "12.345000"
+function(int_to_decimal VALUE DIGITS RESULT)
+    set(scale 1)
+    foreach (d RANGE 1 ${DIGITS})
+        math(EXPR scale "${scale} * 10")
+    endforeach ()
+    math(EXPR whole "${VALUE} / ${scale}")
+    math(EXPR fraction "${VALUE} % ${scale} + ${scale}")
+    string(SUBSTRING ${fraction} 1 ${DIGITS} fraction)
+    set(${RESULT} "${whole}.${fraction}" PARENT_SCOPE)
+endfunction()
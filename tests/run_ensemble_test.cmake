@@ -0,0 +1,114 @@
+#
+# CMake script to run a small ensemble, including one member that is expected to fail
+#
+message(STATUS "Running GrateCLI ensemble test")
+message(STATUS "  Test run directory: ${TEST_RUN_DIR}")
+message(STATUS "  Test src directory: ${TEST_SRC_DIR}")
+message(STATUS "  Test input: ${TEST_INPUT}")
+message(STATUS "  Test binary: ${TEST_BINARY}")
+
+#
+# start from an empty test directory
+#
+execute_process(COMMAND ${CMAKE_COMMAND} -E remove_directory ${TEST_RUN_DIR})
+
+#
+# copy input files
+#
+file(COPY ${TEST_INPUT} DESTINATION ${TEST_RUN_DIR})
+file(COPY ${TEST_SRC_DIR}/ensemble/manifest.xml DESTINATION ${TEST_RUN_DIR})
+get_filename_component(INPUT_NAME ${TEST_INPUT} NAME)
+
+#
+# run the ensemble on two threads, with a trace; exit code 2 means some members failed
+#
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E chdir ${TEST_RUN_DIR} ${TEST_BINARY}
+            --input ${INPUT_NAME} --ensemble manifest.xml --threads 2 --trace trace.json
+    RESULT_VARIABLE status
+)
+if (NOT status EQUAL 2)
+    message(FATAL_ERROR "Expected exit code 2 (one failed member), got: '${status}'")
+endif ()
+file(READ ${TEST_RUN_DIR}/trace.json trace)
+if (NOT trace MATCHES "\"name\": \"member porous\", \"cat\": \"ensemble\"" OR NOT trace MATCHES "\"pool worker 1\"")
+    message(FATAL_ERROR "Ensemble members are missing from the trace")
+endif ()
+
+#
+# check the results of the members that should have run
+#
+foreach (MEMBER base base_again wetter porous)
+    if (NOT EXISTS ${TEST_RUN_DIR}/${MEMBER}_Results.txt)
+        message(FATAL_ERROR "Missing results for ensemble member ${MEMBER}")
+    endif ()
+endforeach ()
+file(STRINGS ${TEST_RUN_DIR}/EnsembleSummary.txt summary)
+list(LENGTH summary nlines)
+if (NOT nlines EQUAL 6)
+    message(FATAL_ERROR "Expected 5 members in the ensemble summary, got:\n${summary}")
+endif ()
+file(STRINGS ${TEST_RUN_DIR}/EnsembleSummary.txt failed REGEX "FAILED")
+if (NOT failed MATCHES "^broken")
+    message(FATAL_ERROR "Expected only member 'broken' to fail:\n${summary}")
+endif ()
+
+#
+# models running concurrently in one process must not affect each other
+#
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E compare_files ${TEST_RUN_DIR}/base_Results.txt ${TEST_RUN_DIR}/base_again_Results.txt
+    RESULT_VARIABLE status
+)
+if (status)
+    message(FATAL_ERROR "Identical ensemble members gave different results")
+endif (status)
+
+#
+# fork members from a shared spin-up, into an output directory the ensemble creates
+#
+file(COPY ${TEST_SRC_DIR}/ensemble/spinup_manifest.xml DESTINATION ${TEST_RUN_DIR})
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E chdir ${TEST_RUN_DIR} ${TEST_BINARY}
+            --input ${INPUT_NAME} --ensemble spinup_manifest.xml --threads 2 --summary spinup_summary.json
+    RESULT_VARIABLE status
+)
+if (status)
+    message(FATAL_ERROR "Spin-up ensemble failed: '${status}'")
+endif (status)
+
+# the spin-up's 100 steps are counted once, then 200, 200 and 50 after the fork
+file(READ ${TEST_RUN_DIR}/spinup_summary.json run_summary)
+if (NOT run_summary MATCHES "\"steps\": 550," OR run_summary MATCHES "\"nodes\": 0,")
+    message(FATAL_ERROR "Wrong steps or nodes in the spin-up ensemble's summary:\n${run_summary}")
+endif ()
+
+# members report the steps they ran after the fork, the span their change in bed level covers
+file(STRINGS ${TEST_RUN_DIR}/spinup/EnsembleSummary.txt forked_members REGEX "^base\t")
+if (NOT forked_members MATCHES "^base\tOK\t200\t")
+    message(FATAL_ERROR "Expected member 'base' to run 200 steps after the spin-up:\n${forked_members}")
+endif ()
+
+#
+# a member forked without overrides must continue exactly like an unbroken run
+#
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E chdir ${TEST_RUN_DIR} ${TEST_BINARY} 300
+            --input ${INPUT_NAME} --output Unbroken_Results.txt
+    RESULT_VARIABLE status
+)
+if (status)
+    message(FATAL_ERROR "Unbroken run failed: '${status}'")
+endif (status)
+file(READ ${TEST_RUN_DIR}/Unbroken_Results.txt unbroken)
+file(READ ${TEST_RUN_DIR}/spinup/base_Results.txt forked)
+string(FIND "${unbroken}" "Count:  200" unbroken_pos)
+string(FIND "${forked}" "Count:  200" forked_pos)
+if (unbroken_pos EQUAL -1 OR forked_pos EQUAL -1)
+    message(FATAL_ERROR "Missing step 200 results in the spin-up ensemble test")
+endif ()
+string(SUBSTRING "${unbroken}" ${unbroken_pos} -1 unbroken)
+string(SUBSTRING "${forked}" ${forked_pos} -1 forked)
+if (NOT unbroken STREQUAL forked)
+    message(FATAL_ERROR "Member forked from the spin-up differs from an unbroken run")
+endif ()
@@ -0,0 +1,50 @@
+#
+# CMake script to check the synthetic river generator: the same seed gives the same file, another
+# seed a different one, and the model runs on what it generates
+#
+message(STATUS "Running GrateGenerate test")
+message(STATUS "  Test run directory: ${TEST_RUN_DIR}")
+message(STATUS "  Generator binary: ${GENERATE_BINARY}")
+message(STATUS "  Test binary: ${TEST_BINARY}")
+
+#
+# make the test directory
+#
+execute_process(COMMAND ${CMAKE_COMMAND} -E remove_directory ${TEST_RUN_DIR})
+execute_process(COMMAND ${CMAKE_COMMAND} -E make_directory ${TEST_RUN_DIR})
+
+foreach (RUN a:7 b:7 c:8)
+    string(REPLACE ":" ";" RUN ${RUN})
+    list(GET RUN 0 NAME)
+    list(GET RUN 1 SEED)
+    execute_process(
+        COMMAND ${GENERATE_BINARY} --nodes 300 --tributaries 4 --days 3 --seed ${SEED} --output ${TEST_RUN_DIR}/${NAME}.xml
+        RESULT_VARIABLE status
+    )
+    if (status)
+        message(FATAL_ERROR "GrateGenerate failed: '${status}'")
+    endif (status)
+endforeach ()
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${TEST_RUN_DIR}/a.xml ${TEST_RUN_DIR}/b.xml RESULT_VARIABLE status)
+if (status)
+    message(FATAL_ERROR "The same seed generated different inputs")
+endif (status)
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${TEST_RUN_DIR}/a.xml ${TEST_RUN_DIR}/c.xml RESULT_VARIABLE status)
+if (NOT status)
+    message(FATAL_ERROR "Different seeds generated the same input")
+endif (NOT status)
+
+#
+# the generated river has to run: 100 steps, with a depth at every node
+#
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E chdir ${TEST_RUN_DIR} ${TEST_BINARY} 100 --input a.xml --output results.txt
+    RESULT_VARIABLE status
+)
+if (status)
+    message(FATAL_ERROR "GrateCLI failed on the generated input: '${status}'")
+endif (status)
+file(READ ${TEST_RUN_DIR}/results.txt results)
+if (NOT results MATCHES "Count:  100" OR results MATCHES "nan")
+    message(FATAL_ERROR "GrateCLI did not run the generated input cleanly")
+endif ()
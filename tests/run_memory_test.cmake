@@ -0,0 +1,42 @@
+#
+# CMake script to check the memory report: the footprint predicted from the input must cover
+# what the model measures at the end of a run, and not by more than a tenth
+#
+message(STATUS "Running GrateCLI memory test")
+message(STATUS "  Test run directory: ${TEST_RUN_DIR}")
+message(STATUS "  Test binary: ${TEST_BINARY}")
+message(STATUS "  Test input: ${TEST_INPUT}")
+
+execute_process(COMMAND ${CMAKE_COMMAND} -E remove_directory ${TEST_RUN_DIR})
+execute_process(COMMAND ${CMAKE_COMMAND} -E make_directory ${TEST_RUN_DIR})
+
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E chdir ${TEST_RUN_DIR} ${TEST_BINARY} --input ${TEST_INPUT} --predict-memory
+    OUTPUT_VARIABLE output
+    RESULT_VARIABLE status
+)
+if (status OR NOT output MATCHES "\nstoredf .*Predicted total: ([0-9]+) bytes")
+    message(FATAL_ERROR "No prediction: '${status}'\n${output}")
+endif ()
+set(predicted ${CMAKE_MATCH_1})
+if (output MATCHES "Running model")
+    message(FATAL_ERROR "--predict-memory ran the model\n${output}")
+endif ()
+
+# past the first results written, so the output buffers are full size
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E chdir ${TEST_RUN_DIR} ${TEST_BINARY} 120 --input ${TEST_INPUT}
+            --output results.txt --memory
+    OUTPUT_VARIABLE output
+    RESULT_VARIABLE status
+)
+if (status OR NOT output MATCHES "Memory after setup:.*Memory at the end of the run:.*Measured total: ([0-9]+) bytes")
+    message(FATAL_ERROR "No memory report: '${status}'\n${output}")
+endif ()
+set(measured ${CMAKE_MATCH_1})
+
+message(STATUS "  Predicted ${predicted} bytes, measured ${measured} bytes")
+math(EXPR limit "${measured} + ${measured} / 10")
+if (predicted LESS measured OR predicted GREATER limit)
+    message(FATAL_ERROR "Predicted ${predicted} bytes, but the model held ${measured} bytes")
+endif ()
@@ -0,0 +1,141 @@
+#
+# CMake script to check output streams and gauges selected in the OUTPUT element of the input file
+#
+message(STATUS "Running GrateCLI output streams test")
+message(STATUS "  Test run directory: ${TEST_RUN_DIR}")
+message(STATUS "  Test input: ${TEST_INPUT}")
+message(STATUS "  Test binary: ${TEST_BINARY}")
+message(STATUS "  Extract binary: ${EXTRACT_BINARY}")
+message(STATUS "  Compare binary: ${COMPARE_BINARY}")
+
+#
+# make the test directory
+#
+execute_process(COMMAND ${CMAKE_COMMAND} -E remove_directory ${TEST_RUN_DIR})
+execute_process(COMMAND ${CMAKE_COMMAND} -E make_directory ${TEST_RUN_DIR})
+
+#
+# copy the input, and a version of it with output streams added
+#
+file(COPY ${TEST_INPUT} DESTINATION ${TEST_RUN_DIR})
+get_filename_component(INPUT_NAME ${TEST_INPUT} NAME)
+file(READ ${TEST_INPUT} input)
+string(REPLACE "</PARAMS>" "</PARAMS>
+	<OUTPUT>
+		<STREAM name=\"sections\" nodes=\"10 40\" variables=\"ETA DSG\" format=\"text\"/>
+		<STREAM name=\"profile\" stride=\"5\" interval=\"50\" variables=\"X ETA STORE_DSG_10 VELOCITY PCT03\"/>
+		<STREAM name=\"profilez\" stride=\"5\" interval=\"50\" variables=\"X ETA STORE_DSG_10 VELOCITY PCT03\" format=\"compressed\" keyframe=\"3\"/>
+		<STREAM name=\"profileq\" stride=\"5\" interval=\"50\" variables=\"X ETA STORE_DSG_10 VELOCITY PCT03\" format=\"compressed\" tolerance=\"1e-4\"/>
+		<GAUGES name=\"gauges\" x=\"1000 1050\" variables=\"ETA DSG\" format=\"text\"/>
+	</OUTPUT>" input "${input}")
+file(WRITE ${TEST_RUN_DIR}/streams.xml "${input}")
+
+#
+# the same run with and without streams
+#
+foreach (RUN plain streams)
+    if (RUN STREQUAL "plain")
+        set(RUN_INPUT ${INPUT_NAME})
+    else ()
+        set(RUN_INPUT streams.xml)
+    endif ()
+    execute_process(
+        COMMAND ${CMAKE_COMMAND} -E chdir ${TEST_RUN_DIR} ${TEST_BINARY} 300
+                --input ${RUN_INPUT} --output ${RUN}.txt
+        RESULT_VARIABLE status
+    )
+    if (status)
+        message(FATAL_ERROR "GrateCLI run '${RUN}' failed: '${status}'")
+    endif (status)
+endforeach ()
+
+#
+# extra streams must not change the main results file
+#
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E compare_files ${TEST_RUN_DIR}/plain.txt ${TEST_RUN_DIR}/streams.txt
+    RESULT_VARIABLE status
+)
+if (status)
+    message(FATAL_ERROR "Output streams changed the main results file")
+endif (status)
+
+#
+# each stream writes at its own interval
+#
+foreach (STREAM sections gauges)
+    if (NOT EXISTS ${TEST_RUN_DIR}/streams_${STREAM}.txt)
+        message(FATAL_ERROR "Missing results for output stream ${STREAM}")
+    endif ()
+endforeach ()
+file(STRINGS ${TEST_RUN_DIR}/streams_sections.txt counts REGEX "^Count:")
+list(LENGTH counts nsections)
+file(STRINGS ${TEST_RUN_DIR}/streams_gauges.txt counts REGEX "^Count:")
+list(LENGTH counts ngauges)
+if (NOT nsections EQUAL 4 OR NOT ngauges EQUAL 301)
+    message(FATAL_ERROR "Expected 4 section and 301 gauge records, got ${nsections} and ${ngauges}")
+endif ()
+file(SIZE ${TEST_RUN_DIR}/streams_profile.grb.idx index_size)
+if (NOT index_size EQUAL 240)
+    message(FATAL_ERROR "Expected 7 records in the binary profile index, got ${index_size} bytes")
+endif ()
+
+#
+# a gauge on a grid node records exactly what that node does
+#
+file(READ ${TEST_RUN_DIR}/streams_sections.txt sections)
+file(READ ${TEST_RUN_DIR}/streams_gauges.txt gauges)
+string(REGEX MATCH "Count:  200\n[^\n]*" section_row "${sections}")
+string(REGEX MATCH "Count:  200\n[^\n]*" gauge_row "${gauges}")
+if (section_row STREQUAL "" OR NOT section_row STREQUAL gauge_row)
+    message(FATAL_ERROR "Gauge at node 10 differs from the node:\n${section_row}\n${gauge_row}")
+endif ()
+
+#
+# the lossless compressed stream extracts to exactly the same values as the plain binary one
+#
+foreach (STREAM profile.grb profilez.grz)
+    get_filename_component(STREAM_NAME ${STREAM} NAME_WE)
+    execute_process(
+        COMMAND ${EXTRACT_BINARY} ${TEST_RUN_DIR}/streams_${STREAM}
+        OUTPUT_FILE ${TEST_RUN_DIR}/${STREAM_NAME}_extract.txt
+        RESULT_VARIABLE status
+    )
+    if (status)
+        message(FATAL_ERROR "GrateExtract failed on stream ${STREAM}: '${status}'")
+    endif (status)
+endforeach ()
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E compare_files ${TEST_RUN_DIR}/profile_extract.txt ${TEST_RUN_DIR}/profilez_extract.txt
+    RESULT_VARIABLE status
+)
+if (status)
+    message(FATAL_ERROR "Compressed stream differs from the binary stream")
+endif (status)
+
+#
+# the comparator reads binary results: the lossless stream matches exactly, the quantised one
+# only within its tolerance
+#
+execute_process(
+    COMMAND ${COMPARE_BINARY} --atol 0 --rtol 0 ${TEST_RUN_DIR}/streams_profile.grb ${TEST_RUN_DIR}/streams_profilez.grz
+    RESULT_VARIABLE status
+)
+if (status)
+    message(FATAL_ERROR "compare found differences between the binary and compressed streams")
+endif (status)
+execute_process(
+    COMMAND ${COMPARE_BINARY} --atol 2e-4 --rtol 0 ${TEST_RUN_DIR}/streams_profile.grb ${TEST_RUN_DIR}/streams_profileq.grz
+    RESULT_VARIABLE status
+)
+if (status)
+    message(FATAL_ERROR "Quantised stream is not within its tolerance of the binary stream")
+endif (status)
+execute_process(
+    COMMAND ${COMPARE_BINARY} --atol 0 --rtol 0 ${TEST_RUN_DIR}/streams_profile.grb ${TEST_RUN_DIR}/streams_profileq.grz
+    OUTPUT_QUIET ERROR_QUIET
+    RESULT_VARIABLE status
+)
+if (NOT status)
+    message(FATAL_ERROR "compare didn't see the quantisation error with zero tolerance")
+endif ()
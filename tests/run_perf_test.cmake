@@ -0,0 +1,215 @@
+#
+# CMake script for the performance regression test: GrateCLI is run RUNS times on a fixed input,
+# and the BENCHMARKS are measured as often, each run giving the 95% confidence interval of each
+# median time per call. Timings differ more between processes than within one, so the figures kept
+# are ranges over the runs: from the model's fastest run to its slowest, and for each benchmark the
+# union of its intervals. They are appended to HISTORY. The baseline in BASELINE is recorded from
+# BASELINE_RUNS times as many runs, and the test fails only if the model's fastest run, or the fast
+# end of a benchmark's range, is more than MARGIN percent slower than the slow end of the
+# baseline's. The first run, or any run with GRATE_PERF_UPDATE=1 in the environment, records the
+# baseline instead.
+#
+string(REPLACE "," ";" BENCHMARKS "${BENCHMARKS}")
+set(recording FALSE)
+if (NOT EXISTS ${BASELINE} OR "$ENV{GRATE_PERF_UPDATE}" STREQUAL "1")
+    set(recording TRUE)
+endif ()
+set(runs ${RUNS})
+if (recording)
+    math(EXPR runs "${RUNS} * ${BASELINE_RUNS}")
+endif ()
+message(STATUS "Running GrateCLI performance test")
+message(STATUS "  Test run directory: ${TEST_RUN_DIR}")
+message(STATUS "  Input: ${TEST_INPUT}, ${STEPS} steps, ${runs} runs")
+message(STATUS "  History: ${HISTORY}")
+message(STATUS "  Baseline: ${BASELINE}, margin ${MARGIN}%")
+
+include(${CMAKE_CURRENT_LIST_DIR}/decimal.cmake)
+
+execute_process(COMMAND ${CMAKE_COMMAND} -E remove_directory ${TEST_RUN_DIR})
+execute_process(COMMAND ${CMAKE_COMMAND} -E make_directory ${TEST_RUN_DIR})
+
+#
+# the model, timed by --timings: the fastest run is the one compared, the spread of the runs is
+# recorded with it
+#
+set(best_us 0)
+set(worst_us 0)
+foreach (R RANGE 1 ${runs})
+    execute_process(
+        COMMAND ${CMAKE_COMMAND} -E chdir ${TEST_RUN_DIR} ${TEST_BINARY} ${STEPS} --input ${TEST_INPUT}
+                --output results.txt --timings
+        OUTPUT_VARIABLE output
+        RESULT_VARIABLE status
+    )
+    if (status OR NOT output MATCHES "\nstep +([0-9.]+) +${STEPS} ")
+        message(FATAL_ERROR "GrateCLI failed: '${status}'\n${output}")
+    endif ()
+    decimal_to_int(${CMAKE_MATCH_1} 3 us)
+    if (us EQUAL 0)
+        set(us 1)
+    endif ()
+    if (best_us EQUAL 0 OR us LESS best_us)
+        set(best_us ${us})
+        set(best_output "${output}")
+    endif ()
+    if (us GREATER worst_us)
+        set(worst_us ${us})
+    endif ()
+endforeach ()
+math(EXPR rate "${STEPS} * 1000000000 / ${best_us}")     # steps per second, to 3 places
+int_to_decimal(${rate} 3 steps_per_second)
+int_to_decimal(${best_us} 6 seconds)
+int_to_decimal(${worst_us} 6 slowest)
+message(STATUS "  ${STEPS} steps in ${seconds} to ${slowest} s: ${steps_per_second} steps/s")
+
+# per call times of the phases that ran, in the order of the table
+string(REGEX MATCHALL "\n *[A-Za-z]+ +[0-9.]+ +[0-9]+ +[0-9.]+ " rows "${best_output}")
+set(phases "")
+foreach (row ${rows})
+    string(REGEX MATCH "([A-Za-z]+) +[0-9.]+ +([0-9]+) +([0-9.]+)" row "${row}")
+    if (CMAKE_MATCH_2 GREATER 0)
+        if (phases)
+            set(phases "${phases}, ")
+        endif ()
+        set(phases "${phases}\"${CMAKE_MATCH_1}\": ${CMAKE_MATCH_3}")
+    endif ()
+endforeach ()
+
+#
+# the benchmarks: median nanoseconds per call and its confidence interval, from the table the
+# harness prints, as integer tenths of a nanosecond
+#
+set(benchmarks "")
+set(intervals "")
+if (BENCH_BINARY AND BENCHMARKS)
+    set(filters "")
+    foreach (B ${BENCHMARKS})
+        list(APPEND filters --filter ${B})
+    endforeach ()
+    foreach (R RANGE 1 ${runs})
+        execute_process(
+            COMMAND ${BENCH_BINARY} --input ${TEST_INPUT} --spin-up 50 --repetitions 15 ${filters}
+            OUTPUT_VARIABLE output
+            RESULT_VARIABLE status
+        )
+        if (status)
+            message(FATAL_ERROR "grate_benchmarks failed: '${status}'\n${output}")
+        endif ()
+        foreach (B ${BENCHMARKS})
+            if (NOT output MATCHES "\n${B} +[0-9]+ +[0-9.]+ +[^ ]+% +([0-9.]+) +\\[ *([0-9.]+), *([0-9.]+)\\]")
+                message(FATAL_ERROR "No result for benchmark ${B}\n${output}")
+            endif ()
+            string(MAKE_C_IDENTIFIER ${B} id)
+            decimal_to_int(${CMAKE_MATCH_1} 1 median)
+            decimal_to_int(${CMAKE_MATCH_2} 1 low)
+            decimal_to_int(${CMAKE_MATCH_3} 1 high)
+            if (R EQUAL 1)
+                set(${id}_sum ${median})
+                set(${id}_low ${low})
+                set(${id}_high ${high})
+            else ()
+                math(EXPR ${id}_sum "${${id}_sum} + ${median}")
+                if (low LESS ${id}_low)
+                    set(${id}_low ${low})
+                endif ()
+                if (high GREATER ${id}_high)
+                    set(${id}_high ${high})
+                endif ()
+            endif ()
+        endforeach ()
+    endforeach ()
+    foreach (B ${BENCHMARKS})
+        string(MAKE_C_IDENTIFIER ${B} id)
+        math(EXPR median "${${id}_sum} / ${runs}")
+        int_to_decimal(${median} 1 median)
+        int_to_decimal(${${id}_low} 1 low)
+        int_to_decimal(${${id}_high} 1 high)
+        if (benchmarks)
+            set(benchmarks "${benchmarks}, ")
+            set(intervals "${intervals}, ")
+        endif ()
+        set(benchmarks "${benchmarks}\"${B}\": ${median}")
+        set(intervals "${intervals}\"${B}\": [${low}, ${high}]")
+        message(STATUS "  ${B}: ${median} ns per call [${low}, ${high}]")
+    endforeach ()
+endif ()
+
+#
+# compare with the baseline: slower only if the fast end of the new figures is beyond the slow end
+# of the baseline's by more than the margin
+#
+set(result pass)
+set(failures "")
+if (recording)
+    set(result baseline)
+else ()
+    file(READ ${BASELINE} baseline)
+    if (NOT baseline MATCHES "\"steps_per_second\": ([0-9.]+)")
+        message(FATAL_ERROR "No steps_per_second in ${BASELINE}; remove it to record a new baseline")
+    endif ()
+    set(base_steps_per_second ${CMAKE_MATCH_1})
+    decimal_to_int(${CMAKE_MATCH_1} 3 base_rate)
+    math(EXPR change "(${rate} - ${base_rate}) * 100 / ${base_rate}")
+    if (NOT baseline MATCHES "\"seconds_range\": \\[([0-9.]+), ([0-9.]+)\\]")
+        message(FATAL_ERROR "No seconds_range in ${BASELINE}; remove it to record a new baseline")
+    endif ()
+    set(base_slowest ${CMAKE_MATCH_2})
+    message(STATUS "  Baseline ${base_steps_per_second} steps/s, ${CMAKE_MATCH_1} to ${CMAKE_MATCH_2} s, change ${change}%")
+    decimal_to_int(${base_slowest} 6 base_worst_us)
+    math(EXPR limit "${base_worst_us} * (100 + ${MARGIN})")
+    math(EXPR scaled "${best_us} * 100")
+    if (scaled GREATER limit)
+        set(failures "${failures}\n  model: fastest run ${seconds} s against ${base_slowest} s for the slowest baseline run (${change}% steps/s)")
+    endif ()
+
+    foreach (B ${BENCHMARKS})
+        if (intervals MATCHES "\"${B}\": \\[([0-9.]+), ([0-9.]+)\\]")
+            set(now "[${CMAKE_MATCH_1}, ${CMAKE_MATCH_2}]")
+            decimal_to_int(${CMAKE_MATCH_1} 1 now_low)
+            if (baseline MATCHES "\"${B}\": \\[([0-9.]+), ([0-9.]+)\\]")
+                set(then "[${CMAKE_MATCH_1}, ${CMAKE_MATCH_2}]")
+                decimal_to_int(${CMAKE_MATCH_2} 1 then_high)
+                math(EXPR limit "${then_high} * (100 + ${MARGIN})")
+                math(EXPR scaled "${now_low} * 100")
+                if (scaled GREATER limit)
+                    set(failures "${failures}\n  ${B}: ${now} ns per call against ${then} ns")
+                endif ()
+            endif ()
+        endif ()
+    endforeach ()
+    if (failures)
+        set(result fail)
+    endif ()
+endif ()
+
+#
+# one line per run in the history, a json array
+#
+string(TIMESTAMP now "%Y-%m-%dT%H:%M:%S")
+set(commit "")
+if (SOURCE_DIR)
+    execute_process(
+        COMMAND git rev-parse --short HEAD
+        WORKING_DIRECTORY ${SOURCE_DIR}
+        OUTPUT_VARIABLE commit
+        OUTPUT_STRIP_TRAILING_WHITESPACE
+        ERROR_QUIET
+    )
+endif ()
+set(record "{\"time\": \"${now}\", \"commit\": \"${commit}\", \"input\": \"${TEST_INPUT}\", \"steps\": ${STEPS}, \"seconds\": ${seconds}, \"seconds_range\": [${seconds}, ${slowest}], \"steps_per_second\": ${steps_per_second}, \"phase_ms_per_call\": {${phases}}, \"benchmark_ns_per_call\": {${benchmarks}}, \"benchmark_ns_ci\": {${intervals}}, \"result\": \"${result}\"}")
+
+if (EXISTS ${HISTORY})
+    file(READ ${HISTORY} history)
+    string(REGEX REPLACE "\n\\]\n*$" "" history "${history}")
+    file(WRITE ${HISTORY} "${history},\n${record}\n]\n")
+else ()
+    file(WRITE ${HISTORY} "[\n${record}\n]\n")
+endif ()
+
+if (result STREQUAL "baseline")
+    file(WRITE ${BASELINE} "${record}\n")
+    message(STATUS "  Recorded a new baseline")
+elseif (result STREQUAL "fail")
+    message(FATAL_ERROR "Slower than the baseline in ${BASELINE} by more than its spread and ${MARGIN}%:${failures}")
+endif ()
@@ -0,0 +1,63 @@
+#
+# CMake script to check the progress socket: GrateStatus must get the progress of a run while it
+# runs, and the socket must be gone when it finishes. The run and the queries are a pipeline, so
+# they run together; the script calls itself with POLL set for the queries.
+#
+if (POLL)
+    # give the model time to read its input, then ask once for each format
+    foreach (try RANGE 20)
+        execute_process(COMMAND ${TEST_STATUS} ${SOCKET} OUTPUT_VARIABLE line RESULT_VARIABLE status)
+        if (NOT status)
+            break ()
+        endif ()
+        execute_process(COMMAND ${CMAKE_COMMAND} -E sleep 1)
+    endforeach ()
+    execute_process(COMMAND ${TEST_STATUS} ${SOCKET} --json OUTPUT_VARIABLE json)
+    message("${line}${json}")
+    return ()
+endif ()
+
+message(STATUS "Running GrateCLI progress socket test")
+message(STATUS "  Test run directory: ${TEST_RUN_DIR}")
+message(STATUS "  Test binary: ${TEST_BINARY}")
+message(STATUS "  Test input: ${TEST_INPUT}")
+
+execute_process(COMMAND ${CMAKE_COMMAND} -E remove_directory ${TEST_RUN_DIR})
+execute_process(COMMAND ${CMAKE_COMMAND} -E make_directory ${TEST_RUN_DIR})
+
+set(socket ${TEST_RUN_DIR}/run.sock)
+# the queries first in the pipeline, as they write nothing to the model's input; the other way
+# round, the model would lose its stdout when they finish
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -DPOLL=1 -DTEST_STATUS=${TEST_STATUS} -DSOCKET=${socket}
+            -P ${CMAKE_CURRENT_LIST_FILE}
+    COMMAND ${CMAKE_COMMAND} -E chdir ${TEST_RUN_DIR} ${TEST_BINARY} 2000 --input ${TEST_INPUT}
+            --output results.txt --progress-socket ${socket}
+    OUTPUT_VARIABLE run
+    ERROR_VARIABLE output
+    RESULT_VARIABLE status
+)
+if (status OR NOT run MATCHES "Serving progress on .*Finished!")
+    message(FATAL_ERROR "Run failed: '${status}'\n${run}\n${output}")
+endif ()
+if (NOT output MATCHES "run.sock: running, step [0-9]+ of 2000 \\([0-9.]+ %\\), model time [0-9-]+ [0-9:]+, [0-9.]+ steps/s, ETA [0-9:]+")
+    message(FATAL_ERROR "No progress from the running model\n${output}")
+endif ()
+foreach (pattern
+        "\"state\": \"running\""
+        "\"last_step\": 2000,"
+        "\"nodes\": 85,"
+        "\"backWater\": {\"seconds\": [0-9.e+-]+, \"calls\": [1-9][0-9]*}"
+        "\"quasiNormal\": {\"calls\": [1-9][0-9]*, \"iterations\": [1-9][0-9]*, \"not_converged\": 0}")
+    if (NOT output MATCHES "${pattern}")
+        message(FATAL_ERROR "No match for '${pattern}' in the progress\n${output}")
+    endif ()
+endforeach ()
+
+if (EXISTS ${socket})
+    message(FATAL_ERROR "The socket was left behind")
+endif ()
+execute_process(COMMAND ${TEST_STATUS} ${socket} OUTPUT_VARIABLE output RESULT_VARIABLE status)
+if (NOT status OR NOT output MATCHES "not answering")
+    message(FATAL_ERROR "GrateStatus answered for a finished run: '${status}'\n${output}")
+endif ()
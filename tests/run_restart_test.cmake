@@ -0,0 +1,108 @@
+#
+# CMake script to check that a run restarted from a checkpoint gives the same results as an uninterrupted run
+#
+message(STATUS "Running GrateCLI restart test")
+message(STATUS "  Test run directory: ${TEST_RUN_DIR}")
+message(STATUS "  Test input: ${TEST_INPUT}")
+message(STATUS "  Test binary: ${TEST_BINARY}")
+
+#
+# make the test directory
+#
+execute_process(COMMAND ${CMAKE_COMMAND} -E remove_directory ${TEST_RUN_DIR})
+execute_process(COMMAND ${CMAKE_COMMAND} -E make_directory ${TEST_RUN_DIR})
+
+#
+# copy input files
+#
+file(COPY ${TEST_INPUT} DESTINATION ${TEST_RUN_DIR})
+get_filename_component(INPUT_NAME ${TEST_INPUT} NAME)
+
+#
+# uninterrupted reference run
+#
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E chdir ${TEST_RUN_DIR} ${TEST_BINARY} 300
+            --input ${INPUT_NAME} --output Full_Results.txt
+    RESULT_VARIABLE status
+)
+if (status)
+    message(FATAL_ERROR "Reference run failed: '${status}'")
+endif (status)
+
+#
+# run that "stops" at step 230, having checkpointed at step 150 and written output past it
+#
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E chdir ${TEST_RUN_DIR} ${TEST_BINARY} 230
+            --input ${INPUT_NAME} --output Restart_Results.txt
+            --checkpoint restart.ckp --checkpoint-interval 150
+    RESULT_VARIABLE status
+)
+if (status)
+    message(FATAL_ERROR "Checkpointed run failed: '${status}'")
+endif (status)
+if (NOT EXISTS ${TEST_RUN_DIR}/restart.ckp)
+    message(FATAL_ERROR "No checkpoint file was written")
+endif ()
+
+#
+# continue from the checkpoint to the end of the run
+#
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E chdir ${TEST_RUN_DIR} ${TEST_BINARY} 300
+            --input ${INPUT_NAME} --output Restart_Results.txt --restart restart.ckp
+    RESULT_VARIABLE status
+)
+if (status)
+    message(FATAL_ERROR "Restarted run failed: '${status}'")
+endif (status)
+
+#
+# the restarted results must match the uninterrupted run exactly
+#
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E compare_files ${TEST_RUN_DIR}/Full_Results.txt ${TEST_RUN_DIR}/Restart_Results.txt
+    RESULT_VARIABLE status
+)
+if (status)
+    message(FATAL_ERROR "Restarted run gave different results to the uninterrupted run")
+endif (status)
+
+#
+# the same with binary results, where the index must be cut back as well
+#
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E chdir ${TEST_RUN_DIR} ${TEST_BINARY} 300
+            --input ${INPUT_NAME} --output Full_Results.grb
+    RESULT_VARIABLE status
+)
+if (status)
+    message(FATAL_ERROR "Binary reference run failed: '${status}'")
+endif (status)
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E chdir ${TEST_RUN_DIR} ${TEST_BINARY} 230
+            --input ${INPUT_NAME} --output Restart_Results.grb
+            --checkpoint restart_grb.ckp --checkpoint-interval 150
+    RESULT_VARIABLE status
+)
+if (status)
+    message(FATAL_ERROR "Binary checkpointed run failed: '${status}'")
+endif (status)
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E chdir ${TEST_RUN_DIR} ${TEST_BINARY} 300
+            --input ${INPUT_NAME} --output Restart_Results.grb --restart restart_grb.ckp
+    RESULT_VARIABLE status
+)
+if (status)
+    message(FATAL_ERROR "Binary restarted run failed: '${status}'")
+endif (status)
+foreach (SUFFIX grb grb.idx)
+    execute_process(
+        COMMAND ${CMAKE_COMMAND} -E compare_files ${TEST_RUN_DIR}/Full_Results.${SUFFIX} ${TEST_RUN_DIR}/Restart_Results.${SUFFIX}
+        RESULT_VARIABLE status
+    )
+    if (status)
+        message(FATAL_ERROR "Restarted run gave different binary results (${SUFFIX}) to the uninterrupted run")
+    endif (status)
+endforeach ()
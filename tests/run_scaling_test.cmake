@@ -0,0 +1,76 @@
+#
+# CMake script for a scaling run: a synthetic river of NODES nodes is generated and run on its
+# own, then as ensembles of one member per thread for each of THREADS. Each run appends a line
+# to RESULTS_CSV, to plot throughput against node count and thread count.
+#
+string(REPLACE "," ";" THREADS "${THREADS}")     # a list, comma separated on the command line
+message(STATUS "Running GrateCLI scaling test")
+message(STATUS "  Test run directory: ${TEST_RUN_DIR}")
+message(STATUS "  Nodes: ${NODES}, threads: ${THREADS}, steps: ${STEPS}")
+message(STATUS "  Results: ${RESULTS_CSV}")
+
+execute_process(COMMAND ${CMAKE_COMMAND} -E remove_directory ${TEST_RUN_DIR})
+execute_process(COMMAND ${CMAKE_COMMAND} -E make_directory ${TEST_RUN_DIR})
+
+include(${CMAKE_CURRENT_LIST_DIR}/decimal.cmake)
+
+function(add_result RUN THREADS MEMBERS US)
+    if (US EQUAL 0)
+        set(US 1)
+    endif ()
+    math(EXPR rate "${MEMBERS} * ${STEPS} * 1000000 / ${US}")
+    int_to_decimal(${US} 6 seconds)
+    if (NOT EXISTS ${RESULTS_CSV})
+        file(WRITE ${RESULTS_CSV} "run,nodes,threads,members,steps,seconds,steps_per_second\n")
+    endif ()
+    file(APPEND ${RESULTS_CSV} "${RUN},${NODES},${THREADS},${MEMBERS},${STEPS},${seconds},${rate}\n")
+    message(STATUS "  ${RUN}: ${NODES} nodes, ${THREADS} threads, ${MEMBERS} members: ${rate} steps/s")
+endfunction()
+
+execute_process(
+    COMMAND ${GENERATE_BINARY} --nodes ${NODES} --tributaries 3 --seed 1 --output ${TEST_RUN_DIR}/river.xml
+    RESULT_VARIABLE status
+)
+if (status)
+    message(FATAL_ERROR "GrateGenerate failed: '${status}'")
+endif (status)
+
+#
+# one model: the time of the model steps alone, from --timings
+#
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E chdir ${TEST_RUN_DIR} ${TEST_BINARY} ${STEPS} --input river.xml
+            --output results.txt --timings
+    OUTPUT_VARIABLE output
+    RESULT_VARIABLE status
+)
+if (status OR NOT output MATCHES "\nstep +([0-9.]+) +${STEPS} ")
+    message(FATAL_ERROR "GrateCLI failed on ${NODES} nodes: '${status}'\n${output}")
+endif ()
+decimal_to_int(${CMAKE_MATCH_1} 3 us)     # milliseconds in
+add_result(single 1 1 ${us})
+
+#
+# ensembles of one member per thread: every worker busy; the wall time from the CLI includes
+# building each member and writing its results
+#
+foreach (T ${THREADS})
+    set(members "")
+    foreach (M RANGE 1 ${T})
+        set(members "${members}\t<MEMBER name=\"m${M}\"/>\n")
+    endforeach ()
+    file(WRITE ${TEST_RUN_DIR}/manifest${T}.xml
+         "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<ENSEMBLE steps=\"${STEPS}\" output_dir=\"threads${T}\">\n${members}</ENSEMBLE>\n")
+    file(MAKE_DIRECTORY ${TEST_RUN_DIR}/threads${T})
+    execute_process(
+        COMMAND ${CMAKE_COMMAND} -E chdir ${TEST_RUN_DIR} ${TEST_BINARY} --input river.xml
+                --ensemble manifest${T}.xml --threads ${T}
+        OUTPUT_VARIABLE output
+        RESULT_VARIABLE status
+    )
+    if (status OR NOT output MATCHES "${T} of ${T} members completed in ([0-9.]+) s")
+        message(FATAL_ERROR "Ensemble of ${T} on ${NODES} nodes failed: '${status}'\n${output}")
+    endif ()
+    decimal_to_int(${CMAKE_MATCH_1} 6 us)
+    add_result(ensemble ${T} ${T} ${us})
+endforeach ()
@@ -0,0 +1,59 @@
+#
+# CMake script to check the setup cache: a run from the cache matches a run from the xml,
+# and a cache that no longer matches its xml is ignored
+#
+message(STATUS "Running GrateCLI setup cache test")
+message(STATUS "  Test run directory: ${TEST_RUN_DIR}")
+message(STATUS "  Test input: ${TEST_INPUT}")
+message(STATUS "  Test binary: ${TEST_BINARY}")
+
+#
+# make the test directory
+#
+execute_process(COMMAND ${CMAKE_COMMAND} -E remove_directory ${TEST_RUN_DIR})
+execute_process(COMMAND ${CMAKE_COMMAND} -E make_directory ${TEST_RUN_DIR})
+file(COPY ${TEST_INPUT} DESTINATION ${TEST_RUN_DIR})
+get_filename_component(INPUT_NAME ${TEST_INPUT} NAME)
+
+macro(run_grate OUTPUT_VAR)
+    execute_process(
+        COMMAND ${CMAKE_COMMAND} -E chdir ${TEST_RUN_DIR} ${TEST_BINARY} ${ARGN}
+        RESULT_VARIABLE status
+        OUTPUT_VARIABLE ${OUTPUT_VAR}
+    )
+    if (status)
+        message(FATAL_ERROR "GrateCLI ${ARGN} failed: '${status}'")
+    endif (status)
+endmacro(run_grate)
+
+#
+# compile the cache, then run with and without it
+#
+run_grate(log --input ${INPUT_NAME} --compile-setup)
+if (NOT EXISTS ${TEST_RUN_DIR}/${INPUT_NAME}.setup)
+    message(FATAL_ERROR "No setup cache was written")
+endif ()
+run_grate(log 300 --input ${INPUT_NAME} --output cached.txt)
+if (NOT log MATCHES "Using setup cache")
+    message(FATAL_ERROR "The setup cache was not used:\n${log}")
+endif ()
+run_grate(log 300 --input ${INPUT_NAME} --output xml.txt --no-setup-cache)
+if (log MATCHES "Using setup cache")
+    message(FATAL_ERROR "The setup cache was used with --no-setup-cache")
+endif ()
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E compare_files ${TEST_RUN_DIR}/cached.txt ${TEST_RUN_DIR}/xml.txt
+    RESULT_VARIABLE status
+)
+if (status)
+    message(FATAL_ERROR "A run from the setup cache differs from a run from the xml")
+endif (status)
+
+#
+# once the xml is edited the cache is stale, and the xml is read instead
+#
+file(APPEND ${TEST_RUN_DIR}/${INPUT_NAME} "\n")
+run_grate(log 10 --input ${INPUT_NAME} --output stale.txt)
+if (log MATCHES "Using setup cache" OR NOT log MATCHES "out of date")
+    message(FATAL_ERROR "A stale setup cache was not detected:\n${log}")
+endif ()
@@ -0,0 +1,44 @@
+#
+# CMake script to check the solver convergence report: JSON and CSV, for the run and each interval
+#
+message(STATUS "Running GrateCLI solver report test")
+message(STATUS "  Test run directory: ${TEST_RUN_DIR}")
+message(STATUS "  Test input: ${TEST_INPUT}")
+message(STATUS "  Test binary: ${TEST_BINARY}")
+
+#
+# make the test directory
+#
+execute_process(COMMAND ${CMAKE_COMMAND} -E remove_directory ${TEST_RUN_DIR})
+execute_process(COMMAND ${CMAKE_COMMAND} -E make_directory ${TEST_RUN_DIR})
+file(COPY ${TEST_INPUT} DESTINATION ${TEST_RUN_DIR})
+get_filename_component(INPUT_NAME ${TEST_INPUT} NAME)
+
+foreach (REPORT solvers.json solvers.csv)
+    execute_process(
+        COMMAND ${CMAKE_COMMAND} -E chdir ${TEST_RUN_DIR} ${TEST_BINARY} 50 --input ${INPUT_NAME}
+                --output results.txt --solver-report ${REPORT} --solver-report-interval 20
+        RESULT_VARIABLE status
+    )
+    if (status)
+        message(FATAL_ERROR "GrateCLI run with --solver-report ${REPORT} failed: '${status}'")
+    endif (status)
+    if (NOT EXISTS ${TEST_RUN_DIR}/${REPORT})
+        message(FATAL_ERROR "No solver report ${REPORT} was written")
+    endif ()
+endforeach ()
+
+#
+# every step solves the backwater, so energyConserve is called; the last interval is partial
+#
+file(READ ${TEST_RUN_DIR}/solvers.json json)
+if (NOT json MATCHES "\"first_step\": 0,\n  \"last_step\": 49,"
+        OR NOT json MATCHES "\"energyConserve\": {\"calls\": [1-9]"
+        OR NOT json MATCHES "\"first_step\": 40,\n      \"last_step\": 49,")
+    message(FATAL_ERROR "Unexpected JSON solver report:\n${json}")
+endif ()
+file(STRINGS ${TEST_RUN_DIR}/solvers.csv rows REGEX "^0,49,solver,quasiNormal,calls,[1-9]")
+file(STRINGS ${TEST_RUN_DIR}/solvers.csv intervals REGEX "^20,39,solver,quasiNormal,calls,")
+if (NOT rows OR NOT intervals)
+    message(FATAL_ERROR "Unexpected CSV solver report")
+endif ()
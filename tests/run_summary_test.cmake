@@ -0,0 +1,58 @@
+#
+# CMake script to check the run summary: a JSON object with the run's size and throughput, and
+# one line appended to the history for each run
+#
+message(STATUS "Running GrateCLI run summary test")
+message(STATUS "  Test run directory: ${TEST_RUN_DIR}")
+message(STATUS "  Test binary: ${TEST_BINARY}")
+message(STATUS "  Test input: ${TEST_INPUT}")
+
+execute_process(COMMAND ${CMAKE_COMMAND} -E remove_directory ${TEST_RUN_DIR})
+execute_process(COMMAND ${CMAKE_COMMAND} -E make_directory ${TEST_RUN_DIR})
+
+foreach (run 1 2)
+    execute_process(
+        COMMAND ${CMAKE_COMMAND} -E chdir ${TEST_RUN_DIR} ${TEST_BINARY} 20 --input ${TEST_INPUT}
+                --output results.txt --summary summary.json --summary-history history.jsonl
+        OUTPUT_VARIABLE output
+        RESULT_VARIABLE status
+    )
+    if (status OR NOT output MATCHES "Run summary written to 'summary.json'")
+        message(FATAL_ERROR "Run ${run} failed: '${status}'\n${output}")
+    endif ()
+endforeach ()
+
+file(READ ${TEST_RUN_DIR}/summary.json summary)
+foreach (pattern
+        "\"status\": \"finished\""
+        "\"nodes\": 85,"
+        "\"steps\": 20,"
+        "\"steps_per_second\": [0-9.e+]+,"
+        "\"node_steps_per_second\": [0-9.e+]+,"
+        "\"simulated_to_wall\": [0-9.e+]+,"
+        "\"bytes_written\": [1-9][0-9]*,"
+        "\"step\": {\n +\"seconds\": [0-9.e+-]+,\n +\"calls\": 20\n"
+        "\"quasiNormal\": {\n +\"calls\": [1-9][0-9]*,\n +\"iterations\": [1-9][0-9]*,")
+    if (NOT summary MATCHES "${pattern}")
+        message(FATAL_ERROR "No match for '${pattern}' in the summary\n${summary}")
+    endif ()
+endforeach ()
+
+# bytes_written is the size of the results file
+file(READ ${TEST_RUN_DIR}/results.txt results HEX)
+string(LENGTH "${results}" size)
+math(EXPR size "${size} / 2")
+if (NOT summary MATCHES "\"bytes_written\": ${size},")
+    message(FATAL_ERROR "bytes_written is not the size of results.txt (${size})\n${summary}")
+endif ()
+
+file(STRINGS ${TEST_RUN_DIR}/history.jsonl history)
+list(LENGTH history lines)
+if (NOT lines EQUAL 2)
+    message(FATAL_ERROR "Expected 2 runs in the history, found ${lines}")
+endif ()
+foreach (line IN LISTS history)
+    if (NOT line MATCHES "^{\"version\": .*\"steps\": 20, .*\"phases\": {.*}}$")
+        message(FATAL_ERROR "Not a summary on one line: '${line}'")
+    endif ()
+endforeach ()
@@ -5,6 +5,7 @@ message(STATUS "Running GrateRipCLI test")
 message(STATUS "  Test run directory: ${TEST_RUN_DIR}")
 message(STATUS "  Test src directory: ${TEST_SRC_DIR}")
 message(STATUS "  Test binary: ${TEST_BINARY}")
+message(STATUS "  Test input: ${TEST_INPUT}")
 message(STATUS "  Compare binary: ${COMPARE_BINARY}")
 message(STATUS "  Profiling: ${DOING_PROFILING}")
 message(STATUS "  Gprof program: ${GPROF_PROGRAM}")
@@ -25,13 +26,15 @@ execute_process(COMMAND ${CMAKE_COMMAND} -E make_directory ${TEST_RUN_DIR})
 #
 # copy input file
 #
-file(COPY ${TEST_SRC_DIR}/test_out.xml DESTINATION ${TEST_RUN_DIR})
+file(COPY ${TEST_INPUT} DESTINATION ${TEST_RUN_DIR})
+get_filename_component(INPUT_NAME ${TEST_INPUT} NAME)
 
 #
 # run the code
 #
 execute_process(
     COMMAND ${CMAKE_COMMAND} -E chdir ${TEST_RUN_DIR} ${TEST_BINARY} ${TEST_NUM_STEPS}
+            --input ${INPUT_NAME} --output Run_Results.txt
     RESULT_VARIABLE status
 )
 if (status)
@@ -0,0 +1,60 @@
+#
+# CMake script to check the Chrome trace of a single run: model phases on the main thread and
+# results written on the writer thread
+#
+message(STATUS "Running GrateCLI trace test")
+message(STATUS "  Test run directory: ${TEST_RUN_DIR}")
+message(STATUS "  Test input: ${TEST_INPUT}")
+message(STATUS "  Test binary: ${TEST_BINARY}")
+
+#
+# make the test directory
+#
+execute_process(COMMAND ${CMAKE_COMMAND} -E remove_directory ${TEST_RUN_DIR})
+execute_process(COMMAND ${CMAKE_COMMAND} -E make_directory ${TEST_RUN_DIR})
+file(COPY ${TEST_INPUT} DESTINATION ${TEST_RUN_DIR})
+get_filename_component(INPUT_NAME ${TEST_INPUT} NAME)
+
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E chdir ${TEST_RUN_DIR} ${TEST_BINARY} 200 --input ${INPUT_NAME}
+            --output results.txt --trace trace.json
+    RESULT_VARIABLE status
+)
+if (status)
+    message(FATAL_ERROR "GrateCLI run with --trace failed: '${status}'")
+endif (status)
+
+file(READ ${TEST_RUN_DIR}/trace.json trace)
+if (NOT trace MATCHES "^{\"displayTimeUnit\": \"ms\", \"traceEvents\": \\[\n.*\n\\]}\n$")
+    message(FATAL_ERROR "trace.json is not a Chrome trace")
+endif ()
+string(REGEX MATCHALL "\"name\": \"backWater\", \"cat\": \"model\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1," spans "${trace}")
+list(LENGTH spans nspans)
+if (NOT nspans EQUAL 200)
+    message(FATAL_ERROR "Expected 200 backWater spans on the main thread, got ${nspans}")
+endif ()
+if (NOT trace MATCHES "\"writer results.txt\"" OR NOT trace MATCHES "\"name\": \"write\", \"cat\": \"results\"")
+    message(FATAL_ERROR "The results writer thread is missing from the trace")
+endif ()
+
+#
+# a run that fails part way still writes its timeline: here a checkpoint it can't write
+#
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E chdir ${TEST_RUN_DIR} ${TEST_BINARY} 200 --input ${INPUT_NAME}
+            --output failed_results.txt --checkpoint missing/checkpoint.bin --checkpoint-interval 50
+            --trace failed_trace.json
+    RESULT_VARIABLE status
+)
+if (NOT status EQUAL 1)
+    message(FATAL_ERROR "Expected the run with an unwritable checkpoint to fail, got: '${status}'")
+endif ()
+if (NOT EXISTS ${TEST_RUN_DIR}/failed_trace.json)
+    message(FATAL_ERROR "The failed run wrote no trace")
+endif ()
+file(READ ${TEST_RUN_DIR}/failed_trace.json trace)
+string(REGEX MATCHALL "\"name\": \"backWater\", \"cat\": \"model\"" spans "${trace}")
+list(LENGTH spans nspans)
+if (NOT nspans EQUAL 50)
+    message(FATAL_ERROR "Expected the 50 steps before the failure in its trace, got ${nspans}")
+endif ()
@@ -0,0 +1,91 @@
+// file to test the run history: frames are found by step, the history stays within its depth
+// however long the run, keeps the recent steps at full detail and still reaches back to the start
+
+#include "runhistory.h"
+#include "grateerror.h"
+#include <iostream>
+
+
+static std::shared_ptr<const HistoryFrame> frameAt(unsigned int counter, unsigned int nnodes) {
+    std::shared_ptr<HistoryFrame> f(new HistoryFrame);
+    f->counter = counter;
+    f->hours = counter / 3600.;
+    f->eta.assign(nnodes, float(counter));
+    f->wsl.assign(nnodes, counter + 1.f);
+    f->width.assign(nnodes, 10.f);
+    f->Qs.assign(nnodes, 0.01f);
+    f->d50.assign(nnodes, 32.f);
+    return f;
+}
+
+int main() {
+    const size_t depth = 64;
+    const unsigned int stride = 10, nnodes = 500;
+    RunHistory history(depth, stride);
+
+    if (history.first() || history.at(100)) {
+        std::cerr << "An empty history has frames" << std::endl;
+        return 1;
+    }
+
+    size_t most = 0;
+    for (unsigned int step = 0; step <= 100000; step++) {
+        if (not history.wants(step))
+            continue;
+        history.record(frameAt(step, nnodes));
+        if (history.size() > depth) {
+            std::cerr << "History of " << history.size() << " frames at step " << step << std::endl;
+            return 1;
+        }
+        most = std::max(most, history.memory().bytes);
+    }
+
+    // memory stays what 'depth' frames take
+    size_t frame_bytes = frameAt(0, nnodes)->memory().bytes;
+    std::cout << history.size() << " frames, " << history.thinned() << " thinnings, at most "
+              << most << " bytes" << std::endl;
+    if (most > depth * frame_bytes) {
+        std::cerr << "History held " << most << " bytes, more than " << depth << " frames of " << frame_bytes << std::endl;
+        return 1;
+    }
+
+    // the start of the run is kept, and the newest half is every step recorded
+    if (history.first()->counter != 0 || history.last()->counter != 100000) {
+        std::cerr << "History runs from " << history.first()->counter << " to " << history.last()->counter << std::endl;
+        return 1;
+    }
+    for (unsigned int step = 100000 - stride * (depth / 4); step <= 100000; step += stride)
+        if (history.at(step)->counter != step) {
+            std::cerr << "Recent step " << step << " not kept" << std::endl;
+            return 1;
+        }
+
+    // any step finds the last frame at or before it, in step order
+    unsigned int previous = 0;
+    for (unsigned int step = 0; step <= 100000; step += 7) {
+        std::shared_ptr<const HistoryFrame> f = history.at(step);
+        if (f->counter > step || f->counter < previous || f->eta[0] != float(f->counter)) {
+            std::cerr << "Step " << step << " found frame " << f->counter << std::endl;
+            return 1;
+        }
+        previous = f->counter;
+    }
+    if (history.at(200000)->counter != 100000) {
+        std::cerr << "A step past the end didn't find the last frame" << std::endl;
+        return 1;
+    }
+
+    history.clear();
+    if (history.size() != 0 || history.thinned() != 0) {
+        std::cerr << "History not cleared" << std::endl;
+        return 1;
+    }
+
+    try {
+        RunHistory tiny(2, 1);
+        std::cerr << "A history of 2 frames was allowed" << std::endl;
+        return 1;
+    } catch (GrateError &) {
+    }
+    return 0;
+}
@@ -0,0 +1,97 @@
+// file to test the GUI's plot level of detail and the frame time budget
+
+#include "plotframe.h"
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+
+int main() {
+    // a long profile with one spike and one pit, decimated to a few hundred points
+    const size_t n = 10000;
+    std::vector<double> x(n), y(n);
+    for (size_t i = 0; i < n; i++) {
+        x[i] = i;
+        y[i] = 100. - 0.01 * i + 0.1 * std::sin(0.05 * i);
+    }
+    y[4321] = 500.;
+    y[8765] = -50.;
+
+    std::vector<double> dx, dy;
+    decimateMinMax(x.data(), y.data(), n, 400, dx, dy);
+    if (dx.size() != 400 || dy.size() != 400) {
+        std::cerr << "Decimated to " << dx.size() << " points, not 400" << std::endl;
+        return 1;
+    }
+    double top = -1e9, bottom = 1e9;
+    for (size_t i = 0; i < dy.size(); i++) {
+        top = std::max(top, dy[i]);
+        bottom = std::min(bottom, dy[i]);
+        if (i > 0 && dx[i] <= dx[i - 1]) {
+            std::cerr << "Decimated x not increasing at " << i << std::endl;
+            return 1;
+        }
+    }
+    if (top != 500. || bottom != -50. || dx.front() != 0 || dx.back() != n - 1) {
+        std::cerr << "Decimation lost the ends or the extremes: " << top << " " << bottom << std::endl;
+        return 1;
+    }
+
+    // new values, same x: the points stay where they were, so a plot can update in place
+    std::vector<double> ex, ey;
+    y[4321] = 0.;
+    decimateMinMax(x.data(), y.data(), n, 400, ex, ey);
+    if (ex != dx) {
+        std::cerr << "Decimated x changed with the values" << std::endl;
+        return 1;
+    }
+
+    // short series are copied
+    decimateMinMax(x.data(), y.data(), 85, 400, ex, ey);
+    if (ex.size() != 85 || ey[84] != y[84]) {
+        std::cerr << "A short series was changed" << std::endl;
+        return 1;
+    }
+
+    // six plots, one slow: every change is drawn, within the budget apart from the one plot a
+    // frame that always goes
+    const double costs[6] = {0.002, 0.002, 0.002, 0.001, 0.001, 0.012};
+    FrameBudget budget(6, 0.008);
+    std::vector<int> lastDrawn(6, -1);
+    for (int frame = 0; frame < 40; frame++) {
+        for (int p = 0; p < 6; p++)
+            budget.changed(p);
+        std::vector<int> due = budget.due();
+        double spent = 0;
+        for (unsigned int i = 0; i < due.size(); i++) {
+            spent += costs[due[i]];
+            budget.drawn(due[i], costs[due[i]]);
+            lastDrawn[due[i]] = frame;
+        }
+        if (due.empty() || (frame > 2 && due.size() > 1 && spent > 0.008 + 1e-12)) {
+            std::cerr << "Frame " << frame << " drew " << due.size() << " plots in " << spent << " s" << std::endl;
+            return 1;
+        }
+    }
+    for (int p = 0; p < 6; p++)
+        if (lastDrawn[p] < 40 - 4) {
+            std::cerr << "Plot " << p << " last drawn in frame " << lastDrawn[p] << std::endl;
+            return 1;
+        }
+    if (std::fabs(budget.cost(5) - 0.012) > 1e-9 || not budget.pending()) {
+        std::cerr << "Costs not tracked" << std::endl;
+        return 1;
+    }
+
+    // nothing changed, nothing due
+    for (int frame = 0; frame < 10 && budget.pending(); frame++) {
+        std::vector<int> due = budget.due();
+        for (unsigned int i = 0; i < due.size(); i++)
+            budget.drawn(due[i], costs[due[i]]);
+    }
+    if (budget.pending() || not budget.due().empty()) {
+        std::cerr << "Plots due without changes" << std::endl;
+        return 1;
+    }
+    return 0;
+}
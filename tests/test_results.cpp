@@ -0,0 +1,256 @@
+// file to test the binary results writer and reader, compressed results, the asynchronous writer
+// and text formatting
+
+#include "results.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+
+
+static ResultsSnapshot makeStep(unsigned int counter, size_t nvars, size_t nnodes) {
+    ResultsSnapshot s;
+    s.counter = counter;
+    s.seconds = 10. * counter;
+    s.columns.resize(nvars);
+    for (size_t v = 0; v < nvars; v++)
+        for (size_t i = 0; i < nnodes; i++)
+            s.columns[v].push_back(counter + v * 0.1 + i * 0.001);
+    return s;
+}
+
+// a slowly evolving field with some awkward values, for the codecs
+static ResultsSnapshot makeSlowStep(unsigned int counter, size_t nvars, size_t nnodes) {
+    ResultsSnapshot s;
+    s.counter = counter;
+    s.seconds = 10. * counter;
+    s.columns.resize(nvars);
+    for (size_t v = 0; v < nvars; v++)
+        for (size_t i = 0; i < nnodes; i++)
+            s.columns[v].push_back(100. - 0.01 * i + 1e-4 * std::sin(0.1 * counter + v + i));
+    s.columns[0][1] = std::numeric_limits<double>::infinity();
+    s.columns[0][2] = (counter % 3 == 0) ? std::nan("") : 1e300;
+    s.columns[0][3] = -0.;
+    return s;
+}
+
+static bool sameBits(const std::vector<double> &a, const std::vector<double> &b) {
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(double)) == 0;
+}
+
+int main() {
+    const char *fileName = "test_results.grb";
+
+    ResultsLayout layout;
+    layout.variables.push_back("ETA");
+    layout.variables.push_back("DEPTH");
+    layout.variables.push_back("QS");
+    for (unsigned int i = 0; i < 5; i++) {
+        layout.nodes.push_back(i * 2);
+        layout.x.push_back(i * 100.);
+    }
+    layout.attributes.push_back(std::make_pair(std::string("feedQw"), 1.2));
+    layout.startTime = GrateTime(2018, 8, 2, 11, 37, 21);
+
+    // write two steps, then resume the file and add a third
+    {
+        BinaryResultsWriter w(fileName);
+        w.open(layout, false);
+        w.write(makeStep(0, 3, 5));
+        w.write(makeStep(100, 3, 5));
+    }
+    {
+        BinaryResultsWriter w(fileName);
+        w.open(layout, true);
+        w.write(makeStep(200, 3, 5));
+    }
+
+    BinaryResultsFile f(fileName);
+    if (f.layout.variables != layout.variables || f.layout.nodes != layout.nodes || f.layout.x != layout.x ||
+            f.layout.attributes != layout.attributes) {
+        std::cerr << "Binary results header was not read back correctly" << std::endl;
+        return 1;
+    }
+    if (f.frameCount() != 3 || f.counter(2) != 200 || f.seconds(1) != 1000.) {
+        std::cerr << "Binary results index was not read back correctly" << std::endl;
+        return 1;
+    }
+
+    // read single variables out of order
+    std::vector<double> qs = f.read(2, f.variableIndex("QS"));
+    std::vector<double> eta = f.read(0, f.variableIndex("ETA"));
+    if (qs != makeStep(200, 3, 5).columns[2] || eta != makeStep(0, 3, 5).columns[0]) {
+        std::cerr << "Binary results values were not read back correctly" << std::endl;
+        return 1;
+    }
+    if (f.variableIndex("WIDTH") != -1) {
+        std::cerr << "Found a variable that was not written" << std::endl;
+        return 1;
+    }
+
+    // many steps through the writer thread, with only two buffers, must arrive complete and in order
+    {
+        AsyncResultsWriter w(new BinaryResultsWriter(fileName));
+        w.open(layout, false);
+        for (unsigned int c = 0; c < 500; c++) {
+            w.buffer() = makeStep(c, 3, 5);
+            w.commit();
+        }
+        w.flush();
+    }
+    BinaryResultsFile a(fileName);
+    if (a.frameCount() != 500) {
+        std::cerr << "Steps were lost by the asynchronous writer" << std::endl;
+        return 1;
+    }
+    for (size_t frame = 0; frame < a.frameCount(); frame++) {
+        if (a.counter(frame) != frame || a.read(frame, 1) != makeStep(frame, 3, 5).columns[1]) {
+            std::cerr << "Asynchronous writer wrote step " << frame << " incorrectly" << std::endl;
+            return 1;
+        }
+    }
+
+    // frames are on disk after a flush; an index that got further than the data is cut back to it
+    {
+        BinaryResultsWriter w(fileName);
+        w.open(layout, false);
+        w.write(makeStep(0, 3, 5));
+        w.write(makeStep(100, 3, 5));
+        w.flush();
+        if (BinaryResultsFile(fileName).frameCount() != 2) {
+            std::cerr << "Frames not on disk after a flush" << std::endl;
+            return 1;
+        }
+    }
+    std::filesystem::resize_file(fileName, std::filesystem::file_size(fileName) - 8);
+    if (BinaryResultsFile(fileName).frameCount() != 1) {
+        std::cerr << "An index entry past the end of the data was read" << std::endl;
+        return 1;
+    }
+
+    std::remove(fileName);
+    std::remove((std::string(fileName) + ".idx").c_str());
+
+    // the block compressor round trips runs, random bytes and tiny blocks; one kept from block
+    // to block compresses each exactly as a fresh one does
+    std::mt19937 rng(42);
+    BlockCompressor reused;
+    for (size_t n : {0, 1, 12, 13, 100, 70000, 200000, 100}) {
+        std::vector<uint8_t> src(n), packed, repacked, unpacked;
+        for (size_t i = 0; i < n; i++)
+            src[i] = (i % 1000 < 700) ? uint8_t(i / 1000) : uint8_t(rng());
+        blockCompress(src.data(), src.size(), packed);
+        blockDecompress(packed.data(), packed.size(), unpacked, src.size());
+        if (unpacked != src) {
+            std::cerr << "Block compressor did not round trip " << n << " bytes" << std::endl;
+            return 1;
+        }
+        reused.compress(src.data(), src.size(), repacked);
+        if (repacked != packed) {
+            std::cerr << "Reused block compressor differs on " << n << " bytes" << std::endl;
+            return 1;
+        }
+    }
+
+    // lossless compressed file: bit-identical values, read in any order, across a resume
+    const char *zName = "test_results.grz";
+    {
+        ResultsWriter *w = makeResultsWriter(zName);
+        w->open(layout, false);
+        for (unsigned int c = 0; c < 30; c++)
+            w->write(makeSlowStep(c, 3, 5));
+        delete w;
+    }
+    {
+        ResultsWriter *w = makeResultsWriter(zName);
+        w->open(layout, true);
+        for (unsigned int c = 30; c < 45; c++)
+            w->write(makeSlowStep(c, 3, 5));
+        delete w;
+    }
+    BinaryResultsFile z(zName);
+    if (z.encoding.codec != CODEC_XOR || z.frameCount() != 45 || z.layout.variables != layout.variables) {
+        std::cerr << "Compressed results header was not read back correctly" << std::endl;
+        return 1;
+    }
+    size_t order[] = {44, 0, 17, 18, 19, 33, 31, 30, 29, 5};
+    for (size_t k = 0; k < sizeof(order) / sizeof(order[0]); k++)
+        for (int v = 0; v < 3; v++)
+            if (not sameBits(z.read(order[k], v), makeSlowStep(order[k], 3, 5).columns[v])) {
+                std::cerr << "Compressed frame " << order[k] << " was not decoded exactly" << std::endl;
+                return 1;
+            }
+
+    // quantised: every value within the tolerance, non-finite values exact
+    ResultsEncoding lossy;
+    lossy.codec = CODEC_QUANTISED;
+    lossy.tolerance = 1e-6;
+    lossy.keyframeInterval = 7;
+    {
+        BinaryResultsWriter w(zName, lossy);
+        w.open(layout, false);
+        for (unsigned int c = 0; c < 30; c++)
+            w.write(makeSlowStep(c, 3, 5));
+    }
+    BinaryResultsFile q(zName);
+    for (size_t frame = 0; frame < q.frameCount(); frame++) {
+        ResultsSnapshot expect = makeSlowStep(frame, 3, 5);
+        for (int v = 0; v < 3; v++) {
+            std::vector<double> values = q.read(frame, v);
+            for (size_t i = 0; i < values.size(); i++) {
+                double e = expect.columns[v][i];
+                bool ok = std::isfinite(e) ? std::fabs(values[i] - e) <= lossy.tolerance
+                                           : sameBits(std::vector<double>(1, values[i]), std::vector<double>(1, e));
+                if (not ok) {
+                    std::cerr << "Quantised value " << values[i] << " is not within tolerance of " << e << std::endl;
+                    return 1;
+                }
+            }
+        }
+    }
+    std::remove(zName);
+    std::remove((std::string(zName) + ".idx").c_str());
+
+    // the text writer must format numbers exactly as ostream << does
+    double awkward[] = {0., -0., 1., 0.1, 1. / 3., -2.5e-7, 1e-5, 123456., 1234567., 999999.5, 0.0001234565,
+                        6.02214076e23, 1e300, 4.9e-324, 2.2250738585072014e-308,
+                        std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(),
+                        std::nan("")};
+    size_t nawkward = sizeof(awkward) / sizeof(awkward[0]);
+    ResultsLayout textLayout;
+    textLayout.variables.push_back("VALUE");
+    ResultsSnapshot textStep;
+    textStep.counter = 4294967295u;
+    textStep.columns.resize(1);
+    std::ostringstream expected;
+    expected << "Count:  " << textStep.counter << '\n';
+    for (size_t i = 0; i < nawkward; i++) {
+        textLayout.nodes.push_back(i);
+        textLayout.x.push_back(i);
+        textStep.columns[0].push_back(awkward[i]);
+        expected << awkward[i] << '\n';
+    }
+    expected << '\n';
+    {
+        TextResultsWriter w("test_results.txt");
+        w.open(textLayout, false);
+        w.write(textStep);
+    }
+    std::ifstream textFile("test_results.txt");
+    std::string text((std::istreambuf_iterator<char>(textFile)), std::istreambuf_iterator<char>());
+    textFile.close();
+    std::remove("test_results.txt");
+    if (text.size() < expected.str().size() ||
+            text.compare(text.size() - expected.str().size(), std::string::npos, expected.str()) != 0) {
+        std::cerr << "Text results differ from ostream formatting:" << std::endl << text << std::endl
+                  << "expected:" << std::endl << expected.str() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
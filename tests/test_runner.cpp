@@ -0,0 +1,140 @@
+// file to test running a model on its own thread: snapshots are published at the rate asked for,
+// are not changed once published, and the model steps as it would on the calling thread. Rates
+// are checked with intervals of zero and of an hour, so the counts don't depend on the machine
+
+#include "modelrunner.h"
+#include "model.h"
+#include "tinyxml2/tinyxml2.h"
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+using namespace tinyxml2;
+
+
+static bool sameBits(const std::vector<double> &a, const std::vector<double> &b) {
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(double)) == 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: test_runner INPUT" << std::endl;
+        return 1;
+    }
+    XMLDocument xml;
+    if (xml.LoadFile(argv[1]) != XML_SUCCESS) {
+        std::cerr << "Error reading " << argv[1] << std::endl;
+        return 1;
+    }
+
+    std::ostringstream log;
+    Model model(xml.FirstChildElement(), "test_runner_threaded.txt", &log);
+    RunControls controls;
+    controls.dt = model.rn->dt;
+    controls.writeInterval = 7;
+    controls.sedUpw = model.rn->sedUpw;
+    controls.hydroUpw = model.rn->hydroUpw;
+    controls.regime = model.rn->regimeFlag;
+    controls.cycle = true;
+
+    // a snapshot after every step
+    RunHistory history(16, 5);
+    ModelRunner runner(&model, std::chrono::steady_clock::duration::zero(), &history);
+    unsigned int first = model.rn->counter;
+    runner.start(controls);
+
+    // hold on to a snapshot taken part way, and what it said then; the steps seen only go forward
+    std::shared_ptr<const ModelSnapshot> early;
+    std::vector<double> early_eta;
+    unsigned int early_counter = 0, seen = first;
+    for (int wait = 0; runner.running() && wait < 6000; wait++) {
+        std::shared_ptr<const ModelSnapshot> s = runner.latest();
+        if (s->counter < seen) {
+            std::cerr << "Snapshot of step " << s->counter << " published after step " << seen << std::endl;
+            return 1;
+        }
+        seen = s->counter;
+        if (not early && s->counter > 20) {
+            early = s;
+            early_eta = s->eta;
+            early_counter = s->counter;
+        }
+        if (s->counter >= 300)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    runner.stop();
+
+    std::shared_ptr<const ModelSnapshot> last = runner.latest();
+    if (runner.running() || last->state != RUN_RUNNING || last->counter < 300) {
+        std::cerr << "The run didn't get to step 300: state " << last->state << ", step " << last->counter
+                  << " " << last->error << std::endl;
+        return 1;
+    }
+    if (not early || early->counter != early_counter || not sameBits(early->eta, early_eta)
+            || early_counter >= last->counter) {
+        std::cerr << "A published snapshot changed" << std::endl;
+        return 1;
+    }
+
+    // the last snapshot is the state the model stopped in
+    if (last->counter != model.rn->counter || not sameBits(last->eta, model.rn->eta)
+            || last->gsdCumul.size() != model.rn->ngsz || model.rn->writeInterval != 7) {
+        std::cerr << "The last snapshot isn't the model's final state" << std::endl;
+        return 1;
+    }
+
+    // the history was recorded every 5 steps, thinned as it filled, up to the step it stopped on
+    std::shared_ptr<const HistoryFrame> recent = history.last();
+    if (history.size() > 16 || history.thinned() == 0 || history.first()->counter % 5 != 0
+            || not recent || recent->counter != model.rn->counter / 5 * 5) {
+        std::cerr << "History of " << history.size() << " frames doesn't match the run" << std::endl;
+        return 1;
+    }
+    if (recent->counter == model.rn->counter && recent->eta.back() != float(model.rn->eta.back())) {
+        std::cerr << "The last history frame isn't the model's final state" << std::endl;
+        return 1;
+    }
+
+    // one at the start, one per step and one at the end
+    std::cout << last->counter - first << " steps, " << runner.published() << " snapshots" << std::endl;
+    if (runner.published() != last->counter - first + 2) {
+        std::cerr << "Published " << runner.published() << " snapshots in " << last->counter - first
+                  << " steps, expected one per step and two more" << std::endl;
+        return 1;
+    }
+
+    // an interval longer than the run: only the snapshots at the start and the end
+    RunHistory more(16, 5);
+    ModelRunner throttled(&model, std::chrono::hours(1), &more);
+    unsigned int resumed = model.rn->counter;
+    throttled.start(controls);
+    for (int wait = 0; throttled.running() && wait < 6000; wait++) {
+        std::shared_ptr<const HistoryFrame> f = more.last();
+        if (f && f->counter >= resumed + 50)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    throttled.stop();
+    last = throttled.latest();
+    if (throttled.published() != 2 || last->counter != model.rn->counter || last->counter < resumed + 50
+            || last->state != RUN_RUNNING) {
+        std::cerr << "Published " << throttled.published() << " snapshots with an hour's interval, the last at step "
+                  << last->counter << " of " << model.rn->counter << std::endl;
+        return 1;
+    }
+
+    // the same steps on this thread give the same river
+    Model direct(xml.FirstChildElement(), "test_runner_direct.txt", &log);
+    while (direct.rn->counter < model.rn->counter)
+        if (not direct.iteration()) {
+            std::cerr << "Direct run failed: " << direct.status().lastError() << std::endl;
+            return 1;
+        }
+    if (not sameBits(direct.rn->eta, model.rn->eta)) {
+        std::cerr << "The threaded run differs from the direct run" << std::endl;
+        return 1;
+    }
+    return 0;
+}
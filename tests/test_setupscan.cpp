@@ -0,0 +1,83 @@
+// file to test the scan of an input for its sizes, for --predict-memory: it must find what
+// readSetup does without building the document, and fail where readSetup would
+
+#include "setup.h"
+#include "grateerror.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+
+static bool sameSeries(const std::vector<SeriesStep> &a, const std::vector<SeriesStep> &b) {
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++)
+        if (a[i].loc != b[i].loc)
+            return false;
+    return true;
+}
+
+static bool scanFails(const std::string &xml) {
+    std::istringstream in(xml);
+    ModelSetup setup;
+    try {
+        scanSetupSizes(in, setup);
+    } catch (GrateError &) {
+        return true;
+    }
+    return false;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: test_setupscan INPUT.xml" << std::endl;
+        return 1;
+    }
+
+    XMLDocument doc;
+    if (doc.LoadFile(argv[1]) != XML_SUCCESS) {
+        std::cerr << "Can't read " << argv[1] << std::endl;
+        return 1;
+    }
+    ModelSetup read;
+    readSetup(doc.FirstChildElement(), read);
+
+    std::ifstream in(argv[1], std::ios::in | std::ios::binary);
+    ModelSetup scanned;
+    scanSetupSizes(in, scanned);
+    if (scanned.nnodes != read.nnodes || scanned.nlayer != read.nlayer || scanned.ngrp != read.ngrp ||
+            scanned.ngsz != read.ngsz || scanned.nlith != read.nlith) {
+        std::cerr << "Scanned PARAMS differ from those read" << std::endl;
+        return 1;
+    }
+    if (not sameSeries(scanned.hydroSeries, read.hydroSeries) || not sameSeries(scanned.sedSeries, read.sedSeries)) {
+        std::cerr << "Scanned series differ from those read: " << scanned.hydroSeries.size() << " and "
+                  << scanned.sedSeries.size() << " entries" << std::endl;
+        return 1;
+    }
+
+    // the first of each element counts, and comments, declarations and empty elements are passed over
+    std::istringstream odd(
+        "<?xml version=\"1.0\"?>\n<!-- <PARAMS><NNODES>1</NNODES></PARAMS> -->\n<GRATE>\n"
+        "<PARAMS><NNODES> 40 </NNODES><NNODES>50</NNODES><NLAYER>30</NLAYER><NGSZ>13</NGSZ>"
+        "<NLITH>3</NLITH><NGRP>12</NGRP><LA/></PARAMS>\n<PARAMS><NNODES>60</NNODES></PARAMS>\n"
+        "<hydro_series><STEP src=\"a>b\"><loc>0</loc></STEP><STEP><datetime/><loc>7</loc></STEP></hydro_series>\n"
+        "<sed_series><STEP><loc>3</loc><loc>4</loc></STEP></sed_series>\n</GRATE>\n");
+    ModelSetup setup;
+    scanSetupSizes(odd, setup);
+    if (setup.nnodes != 40 || setup.nlayer != 30 || setup.hydroSeries.size() != 2 || setup.hydroSeries[1].loc != 7 ||
+            setup.sedSeries.size() != 1 || setup.sedSeries[0].loc != 3) {
+        std::cerr << "Scanned " << setup.nnodes << " nodes and " << setup.hydroSeries.size() << " + "
+                  << setup.sedSeries.size() << " series entries from the hand written input" << std::endl;
+        return 1;
+    }
+
+    if (not scanFails("<GRATE><PARAMS><NNODES>4x</NNODES></PARAMS></GRATE>") ||
+            not scanFails("<GRATE><hydro_series><STEP><Qw>1</Qw></STEP></hydro_series></GRATE>") ||
+            not scanFails("<GRATE></GRATE>")) {
+        std::cerr << "A bad input was scanned" << std::endl;
+        return 1;
+    }
+    return 0;
+}
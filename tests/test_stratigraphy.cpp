@@ -0,0 +1,59 @@
+// file to test the copy on write stratigraphy: a copy and the model it was taken from never see
+// each other's writes, whichever writes first and whether or not it had written the layer before
+
+#include "riverprofile.h"
+#include <iostream>
+#include <thread>
+
+
+int main() {
+    NodeGSDObject init;
+    init.dsg = 1.;
+    Stratigraphy a;
+    a.assign(4, 3, init);
+
+    // layers start out shared with each other
+    a.edit(0, 0).dsg = 2.;
+    if (a.layer(0, 1).dsg != 1. || not a.owns(0, 0) || a.owns(0, 1)) {
+        std::cerr << "Writing one layer changed another" << std::endl;
+        return 1;
+    }
+
+    // a layer the original owned before the copy is shared after it, on both sides
+    Stratigraphy b(a);
+    if (a.owns(0, 0) || b.owns(0, 0)) {
+        std::cerr << "A layer is still owned after a copy" << std::endl;
+        return 1;
+    }
+    a.edit(0, 0).dsg = 3.;
+    b.edit(1, 2).dsg = 4.;
+    if (b.layer(0, 0).dsg != 2. || a.layer(1, 2).dsg != 1. || a.layer(0, 0).dsg != 3.) {
+        std::cerr << "A write reached the other copy" << std::endl;
+        return 1;
+    }
+
+    // copies taken on several threads at once, each then written
+    const int nthreads = 4;
+    Stratigraphy copies[nthreads];
+    std::thread workers[nthreads];
+    for (int t = 0; t < nthreads; t++)
+        workers[t] = std::thread([&a, &copies, t]() {
+            copies[t] = a;
+            for (unsigned int i = 0; i < 4; i++)
+                for (unsigned int z = 0; z < 3; z++)
+                    copies[t].edit(i, z).dsg = 10. + t;
+        });
+    for (int t = 0; t < nthreads; t++)
+        workers[t].join();
+    a.edit(0, 0).dsg = 5.;
+    for (int t = 0; t < nthreads; t++)
+        if (copies[t].layer(0, 0).dsg != 10. + t || copies[t].layer(3, 2).dsg != 10. + t) {
+            std::cerr << "Copy " << t << " sees another's writes" << std::endl;
+            return 1;
+        }
+    if (a.layer(0, 0).dsg != 5. || a.layer(3, 2).dsg != 1. || b.layer(0, 0).dsg != 2.) {
+        std::cerr << "The copies' writes reached the original" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,144 @@
+/*******************
+ *
+ *
+ *  GRATE 9
+ *
+ *  Work-stealing thread pool
+ *
+ *
+ *
+*********************/
+
+#include "threadpool.h"
+#include "trace.h"
+#include <iostream>
+#include <ciso646>
+
+
+WorkStealingPool::WorkStealingPool(unsigned int nthreads) :
+    nextQueue(0), queued(0), unfinished(0), stopping(false)
+{
+    if (nthreads == 0)
+        nthreads = std::thread::hardware_concurrency();
+    if (nthreads == 0)                         // hardware_concurrency may not be known
+        nthreads = 1;
+
+    for (unsigned int i = 0; i < nthreads; i++)
+        queues.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue));
+
+    for (unsigned int i = 0; i < nthreads; i++)
+        workers.push_back(std::thread(&WorkStealingPool::workerLoop, this, i));
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(stateLock);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+
+    for (unsigned int i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
+
+unsigned int WorkStealingPool::size() const
+{
+    return workers.size();
+}
+
+void WorkStealingPool::submit(std::function<void()> task)
+{
+    unsigned int id;
+    {
+        std::lock_guard<std::mutex> guard(stateLock);
+        id = nextQueue;
+        nextQueue = (nextQueue + 1) % queues.size();
+        unfinished++;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(queues[id]->lock);
+        queues[id]->tasks.push_back(task);
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(stateLock);
+        queued++;
+    }
+    workAvailable.notify_one();
+}
+
+void WorkStealingPool::wait()
+{
+    std::unique_lock<std::mutex> guard(stateLock);
+    allDone.wait(guard, [this] { return unfinished == 0; });
+}
+
+bool WorkStealingPool::popLocal(unsigned int id, std::function<void()> &task)
+{
+    std::lock_guard<std::mutex> guard(queues[id]->lock);
+    if (queues[id]->tasks.empty())
+        return false;
+
+    task = queues[id]->tasks.back();
+    queues[id]->tasks.pop_back();
+    return true;
+}
+
+bool WorkStealingPool::steal(unsigned int id, std::function<void()> &task)
+{
+    // visit the other queues, starting with our neighbour
+    for (unsigned int i = 1; i < queues.size(); i++)
+    {
+        WorkerQueue &victim = *queues[(id + i) % queues.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (not victim.tasks.empty())
+        {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void WorkStealingPool::workerLoop(unsigned int id)
+{
+    std::function<void()> task;
+    traceThreadName("pool worker " + std::to_string(id));
+
+    while (true)
+    {
+        {
+            // claim one of the queued tasks (or leave if we are shutting down)
+            std::unique_lock<std::mutex> guard(stateLock);
+            workAvailable.wait(guard, [this] { return queued > 0 || stopping; });
+            if (queued == 0)
+                return;
+            queued--;
+        }
+
+        // a task was pushed before it was counted, so there is one in some queue for us,
+        // although another worker may get to a given queue first
+        bool stolen = false;
+        while (not popLocal(id, task) && not (stolen = steal(id, task)))
+            std::this_thread::yield();
+
+        try {
+            TraceScope span("pool", stolen ? "stolen task" : "task");
+            task();
+        }
+        catch (...) {
+            std::cerr << "WorkStealingPool: uncaught exception in task" << std::endl;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(stateLock);
+            unfinished--;
+            if (unfinished == 0)
+                allDone.notify_all();
+        }
+    }
+}
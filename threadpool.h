@@ -0,0 +1,48 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+
+// Fixed size thread pool with one task queue per worker. Workers take tasks from the
+// back of their own queue and, when that is empty, steal from the front of the others.
+class WorkStealingPool
+{
+public:
+    explicit WorkStealingPool(unsigned int nthreads = 0);  // 0 means one worker per hardware thread
+    ~WorkStealingPool();
+
+    void submit(std::function<void()> task);   // queue a task (queues are filled round-robin)
+    void wait();                               // block until every submitted task has finished
+    unsigned int size() const;                 // number of worker threads
+
+private:
+    struct WorkerQueue
+    {
+        std::mutex lock;
+        std::deque< std::function<void()> > tasks;
+    };
+
+    void workerLoop(unsigned int id);
+    bool popLocal(unsigned int id, std::function<void()> &task);
+    bool steal(unsigned int id, std::function<void()> &task);
+
+    std::vector< std::unique_ptr<WorkerQueue> > queues;
+    std::vector<std::thread> workers;
+
+    std::mutex stateLock;
+    std::condition_variable workAvailable;
+    std::condition_variable allDone;
+    unsigned int nextQueue;                    // round-robin position for submit()
+    size_t queued;                             // tasks waiting in the queues, not yet claimed by a worker
+    size_t unfinished;                         // tasks submitted but not yet completed
+    bool stopping;
+};
+
+#endif // THREADPOOL_H
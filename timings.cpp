@@ -0,0 +1,146 @@
+/*******************
+ *
+ *
+ *  GRATE 9
+ *
+ *  Per-phase timing of the model step
+ *
+ *
+ *
+*********************/
+
+#include "timings.h"
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+struct PhaseInfo
+{
+    const char *name;
+    int depth;                                 // Nesting under PHASE_STEP
+};
+
+const PhaseInfo phases[N_PHASES] = {
+    {"step", 0},
+    {"backWater", 1},
+    {"setQuasiSteadyNodalFlows", 2},
+    {"computeTransport", 1},
+    {"setNodalSedInputs", 2},
+    {"exner", 2},
+    {"setRegimeWidth", 1},
+    {"writeResults", 1},
+    {"checkpoint", 1},
+};
+
+}  // namespace
+
+
+const char *phaseName(Phase phase)
+{
+    return phases[phase].name;
+}
+
+PhaseTimes::PhaseTimes()
+{
+    for (int p = 0; p < N_PHASES; p++)
+    {
+        elapsed[p] = std::chrono::steady_clock::duration::zero();
+        calls[p] = 0;
+    }
+}
+
+double PhaseTimes::seconds(Phase phase) const
+{
+    return std::chrono::duration<double>(elapsed[phase]).count();
+}
+
+unsigned long PhaseTimes::count(Phase phase) const
+{
+    return calls[phase];
+}
+
+bool PhaseTimes::hasCounts() const
+{
+    for (int c = 0; c < N_COUNTERS; c++)
+        if (counted[PHASE_STEP].available[c])
+            return true;
+    return false;
+}
+
+PhaseTimes PhaseTimes::since(const PhaseTimes &earlier) const
+{
+    PhaseTimes d;
+    for (int p = 0; p < N_PHASES; p++)
+    {
+        d.elapsed[p] = elapsed[p] - earlier.elapsed[p];
+        d.calls[p] = calls[p] - earlier.calls[p];
+        d.counted[p] = counted[p] - earlier.counted[p];
+    }
+    return d;
+}
+
+void PhaseTimes::print(std::ostream &out) const
+{
+    // formatted on the side, so the stream's own settings are left alone
+    std::ostringstream table;
+    table << std::fixed;
+    table << std::left << std::setw(30) << "phase" << std::right << std::setw(12) << "total (ms)"
+          << std::setw(10) << "calls" << std::setw(14) << "per call (ms)" << std::setw(10) << "% step" << "\n";
+
+    double step = seconds(PHASE_STEP);
+    double top = 0;
+    for (int p = 0; p < N_PHASES; p++)
+    {
+        double s = seconds(Phase(p));
+        if (phases[p].depth == 1)
+            top += s;
+        table << std::left << std::setw(30) << std::string(2 * phases[p].depth, ' ') + phases[p].name << std::right
+              << std::setprecision(1) << std::setw(12) << s * 1000 << std::setw(10) << calls[p]
+              << std::setprecision(3) << std::setw(14) << (calls[p] > 0 ? s * 1000 / calls[p] : 0.)
+              << std::setprecision(1) << std::setw(10) << (step > 0 ? s / step * 100 : 0.) << "\n";
+    }
+
+    double other = step - top;
+    table << std::left << std::setw(30) << "  other" << std::right << std::setprecision(1) << std::setw(12) << other * 1000
+          << std::setw(10) << "" << std::setw(14) << "" << std::setw(10) << (step > 0 ? other / step * 100 : 0.) << "\n";
+    out << table.str();
+}
+
+void PhaseTimes::printCounts(std::ostream &out, unsigned int nodes) const
+{
+    std::ostringstream table;
+    table << std::fixed;
+    table << std::left << std::setw(30) << "phase" << std::right << std::setw(14) << "Mcycles" << std::setw(14) << "Minstr"
+          << std::setw(8) << "IPC" << std::setw(18) << "LLC miss/node" << std::setw(18) << "branch miss/node" << "\n";
+
+    for (int p = 0; p < N_PHASES; p++)
+    {
+        const CounterValues &c = counted[p];
+        double nodeSteps = double(calls[p]) * nodes;
+        table << std::left << std::setw(30) << std::string(2 * phases[p].depth, ' ') + phases[p].name << std::right;
+        table << std::setprecision(1);
+        for (int k = COUNTER_CYCLES; k <= COUNTER_INSTRUCTIONS; k++)
+        {
+            if (c.available[k])
+                table << std::setw(14) << c.value[k] / 1e6;
+            else
+                table << std::setw(14) << "-";
+        }
+        table << std::setprecision(2);
+        if (c.available[COUNTER_CYCLES] && c.available[COUNTER_INSTRUCTIONS] && c.value[COUNTER_CYCLES] > 0)
+            table << std::setw(8) << double(c.value[COUNTER_INSTRUCTIONS]) / c.value[COUNTER_CYCLES];
+        else
+            table << std::setw(8) << "-";
+        table << std::setprecision(3);
+        for (int k = COUNTER_LLC_MISSES; k <= COUNTER_BRANCH_MISSES; k++)
+        {
+            if (c.available[k] && nodeSteps > 0)
+                table << std::setw(18) << c.value[k] / nodeSteps;
+            else
+                table << std::setw(18) << "-";
+        }
+        table << "\n";
+    }
+    out << table.str();
+}
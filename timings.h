@@ -0,0 +1,94 @@
+#ifndef TIMINGS_H
+#define TIMINGS_H
+
+#include "counters.h"
+#include "trace.h"
+#include <chrono>
+#include <ostream>
+
+
+// Phases of Model::iteration that are timed. Nested phases follow the phase they are called from.
+enum Phase {
+    PHASE_STEP,                                // The whole of Model::iteration
+    PHASE_BACKWATER,                           // hydro::backWater
+    PHASE_NODAL_FLOWS,                         //   hydro::setQuasiSteadyNodalFlows
+    PHASE_TRANSPORT,                           // sed::computeTransport
+    PHASE_SED_INPUTS,                          //   sed::setNodalSedInputs
+    PHASE_EXNER,                               //   sed::exner
+    PHASE_REGIME_WIDTH,                        // hydro::setRegimeWidth
+    PHASE_RESULTS,                             // Model::writeResults
+    PHASE_CHECKPOINT,                          // writeCheckpoint
+    N_PHASES
+};
+
+const char *phaseName(Phase phase);            // e.g. "backWater"
+
+// Time spent in each phase, for one model. A model is only advanced by one thread at a time, so
+// its timings are only touched by that thread and need no locking.
+class PhaseTimes
+{
+public:
+
+    PhaseTimes();
+
+    void add(Phase phase, std::chrono::steady_clock::duration d)
+    {
+        elapsed[phase] += d;
+        calls[phase]++;
+    }
+
+    void addCounts(Phase phase, const CounterValues &c)
+    {
+        counted[phase] += c;
+    }
+
+    double seconds(Phase phase) const;
+    unsigned long count(Phase phase) const;
+    const CounterValues &counts(Phase phase) const { return counted[phase]; }
+    bool hasCounts() const;                                   // Any hardware counts recorded
+
+    PhaseTimes since(const PhaseTimes &earlier) const;        // The time spent after 'earlier' was taken
+    void print(std::ostream &out) const;                      // Table of phases, per call and share of a step
+    void printCounts(std::ostream &out, unsigned int nodes) const;   // IPC and misses per node-step
+
+private:
+    std::chrono::steady_clock::duration elapsed[N_PHASES];
+    unsigned long calls[N_PHASES];
+    CounterValues counted[N_PHASES];
+};
+
+// Adds the time from construction to destruction to a phase, and to the trace if one is being
+// recorded. Two reads of the steady clock, cheap enough to leave in production builds; with
+// hardware counters on, also two reads of the thread's counters.
+class ScopedTimer
+{
+public:
+
+    ScopedTimer(PhaseTimes &times, Phase phase) : times(times), phase(phase), counting(countersEnabled())
+    {
+        if (counting)
+            startCounts = readCounters();
+        start = std::chrono::steady_clock::now();
+    }
+    ~ScopedTimer()
+    {
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        if (counting)
+            times.addCounts(phase, readCounters() - startCounts);
+        times.add(phase, end - start);
+        if (traceEnabled())
+            traceEvent("model", phaseName(phase), start, end);
+    }
+
+private:
+    PhaseTimes &times;
+    Phase phase;
+    bool counting;
+    CounterValues startCounts;
+    std::chrono::steady_clock::time_point start;
+
+    ScopedTimer(const ScopedTimer &);
+    ScopedTimer &operator=(const ScopedTimer &);
+};
+
+#endif // TIMINGS_H
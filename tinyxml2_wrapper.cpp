@@ -1,18 +1,20 @@
 
 #include "tinyxml2_wrapper.h"
+#include "grateerror.h"
 #include <sstream>
 #include <iostream>
 
 using namespace tinyxml2;
 
 double getDoubleValue(XMLElement *e, const char *name) {
-    // get the child element
-    XMLElement *child = e->FirstChildElement(name);
+    return getDoubleText(e->FirstChildElement(name), name);
+}
+
+double getDoubleText(XMLElement *child, const char *name) {
     if (child == NULL) {
         std::stringstream error_stream;
         error_stream << "Error getting child element: " << name;
-        std::string msg = error_stream.str();
-        throw msg;
+        throw GrateError(error_stream.str());
     }
 
     // get the value
@@ -20,8 +22,7 @@ double getDoubleValue(XMLElement *e, const char *name) {
     if (child->QueryDoubleText(&value) != XML_SUCCESS) {
         std::stringstream error_stream;
         error_stream << "Error getting double value for child element: " << name;
-        std::string msg = error_stream.str();
-        throw msg;
+        throw GrateError(error_stream.str());
     }
 
     return value;
@@ -33,8 +34,7 @@ float getFloatValue(XMLElement *e, const char *name) {
     if (child == NULL) {
         std::stringstream error_stream;
         error_stream << "Error getting child element: " << name;
-        std::string msg = error_stream.str();
-        throw msg;
+        throw GrateError(error_stream.str());
     }
 
     // get the value
@@ -42,21 +42,21 @@ float getFloatValue(XMLElement *e, const char *name) {
     if (child->QueryFloatText(&value) != XML_SUCCESS) {
         std::stringstream error_stream;
         error_stream << "Error getting double value for child element: " << name;
-        std::string msg = error_stream.str();
-        throw msg;
+        throw GrateError(error_stream.str());
     }
 
     return value;
 }
 
 int getIntValue(XMLElement *e, const char *name) {
-    // get the child element
-    XMLElement *child = e->FirstChildElement(name);
+    return getIntText(e->FirstChildElement(name), name);
+}
+
+int getIntText(XMLElement *child, const char *name) {
     if (child == NULL) {
         std::stringstream error_stream;
         error_stream << "Error getting child element: " << name;
-        std::string msg = error_stream.str();
-        throw msg;
+        throw GrateError(error_stream.str());
     }
 
     // get the value
@@ -64,9 +64,17 @@ int getIntValue(XMLElement *e, const char *name) {
     if (child->QueryIntText(&value) != XML_SUCCESS) {
         std::stringstream error_stream;
         error_stream << "Error getting int value for child element: " << name;
-        std::string msg = error_stream.str();
-        throw msg;
+        throw GrateError(error_stream.str());
     }
 
     return value;
 }
+
+double getDoubleValue(XMLElement *e, const char *name, double defaultValue) {
+    // optional child element: fall back to the default if it is missing
+    if (e->FirstChildElement(name) == NULL) {
+        return defaultValue;
+    }
+
+    return getDoubleValue(e, name);
+}
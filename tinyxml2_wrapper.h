@@ -8,5 +8,11 @@ using namespace tinyxml2;
 double getDoubleValue(XMLElement *e, const char *name);
 float getFloatValue(XMLElement *e, const char *name);
 int getIntValue(XMLElement *e, const char *name);
+double getDoubleValue(XMLElement *e, const char *name, double defaultValue);  // optional element
+
+// Value of a child element that has already been found (NULL if it is missing), with the same
+// errors as getDoubleValue and getIntValue
+double getDoubleText(XMLElement *child, const char *name);
+int getIntText(XMLElement *child, const char *name);
 
 #endif
@@ -0,0 +1,157 @@
+/*******************
+ *
+ *
+ *  GRATE 9
+ *
+ *  Event tracer, written as a Chrome trace
+ *
+ *
+ *
+*********************/
+
+#include "trace.h"
+#include "grateerror.h"
+#include "jsontext.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <ciso646>
+
+std::atomic<bool> traceOn(false);
+
+namespace {
+
+const size_t TRACE_BUFFER_EVENTS = 1 << 16;    // Per thread; about 5 MB
+const size_t TRACE_NAME = 48;                  // Longer names are cut short
+const size_t TRACE_CATEGORY = 16;
+
+struct TraceRecord
+{
+    int64_t start;                             // ns since traceStart()
+    int64_t duration;
+    char category[TRACE_CATEGORY];
+    char name[TRACE_NAME];
+};
+
+// One thread's ring buffer. Only the owning thread writes; 'written' is published with release
+// ordering so a reader that has seen it also sees the records.
+struct TraceBuffer
+{
+    explicit TraceBuffer(int tid) : records(TRACE_BUFFER_EVENTS), written(0), tid(tid) {}
+
+    std::vector<TraceRecord> records;
+    std::atomic<uint64_t> written;
+    int tid;
+    std::string threadName;
+};
+
+std::mutex registryLock;                       // Only taken when a thread records for the first time
+std::vector< std::unique_ptr<TraceBuffer> > registry;
+std::chrono::steady_clock::time_point origin;
+thread_local TraceBuffer *localBuffer = NULL;
+
+TraceBuffer &threadBuffer()
+{
+    if (localBuffer == NULL)
+    {
+        std::lock_guard<std::mutex> guard(registryLock);
+        registry.push_back(std::unique_ptr<TraceBuffer>(new TraceBuffer(registry.size() + 1)));
+        localBuffer = registry.back().get();
+    }
+    return *localBuffer;
+}
+
+void copyName(char *to, const char *from, size_t n)
+{
+    std::strncpy(to, from, n - 1);
+    to[n - 1] = '\0';
+}
+
+void writeMicroseconds(std::ostream &out, int64_t ns)
+{
+    char text[32];
+    std::snprintf(text, sizeof(text), "%lld.%03lld", (long long)(ns / 1000), (long long)(ns % 1000));
+    out << text;
+}
+
+}  // namespace
+
+
+void traceStart()
+{
+    origin = std::chrono::steady_clock::now();
+    traceOn.store(true);
+}
+
+void traceThreadName(const std::string &name)
+{
+    if (traceEnabled())
+        threadBuffer().threadName = name;
+}
+
+void traceEvent(const char *category, const char *name,
+                std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+    if (not traceEnabled())
+        return;
+    TraceBuffer &b = threadBuffer();
+    uint64_t n = b.written.load(std::memory_order_relaxed);
+    TraceRecord &r = b.records[n % TRACE_BUFFER_EVENTS];
+    r.start = std::chrono::duration_cast<std::chrono::nanoseconds>(start - origin).count();
+    r.duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    copyName(r.category, category, TRACE_CATEGORY);
+    copyName(r.name, name, TRACE_NAME);
+    b.written.store(n + 1, std::memory_order_release);
+}
+
+void writeTrace(const std::string &fileName)
+{
+    traceOn.store(false);
+
+    std::ofstream out(fileName);
+    if (not out)
+        throw GrateError("Error writing trace: " + fileName);
+
+    // complete ("X") events carry both ends of a span, so a span survives on its own when the
+    // ring buffer has overwritten the events around it
+    std::lock_guard<std::mutex> guard(registryLock);
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first = true;
+    for (size_t t = 0; t < registry.size(); t++)
+    {
+        const TraceBuffer &b = *registry[t];
+        uint64_t n = b.written.load(std::memory_order_acquire);
+        uint64_t begin = n > TRACE_BUFFER_EVENTS ? n - TRACE_BUFFER_EVENTS : 0;
+
+        std::string threadName = b.threadName.empty() ? "thread " + std::to_string(b.tid) : b.threadName;
+        if (begin > 0)
+            threadName += " (first " + std::to_string(begin) + " events dropped)";
+        out << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << b.tid
+            << ", \"args\": {\"name\": ";
+        writeJsonString(out, threadName);
+        out << "}}";
+        first = false;
+
+        for (uint64_t i = begin; i < n; i++)
+        {
+            const TraceRecord &r = b.records[i % TRACE_BUFFER_EVENTS];
+            out << ",\n{\"name\": ";
+            writeJsonString(out, r.name);
+            out << ", \"cat\": ";
+            writeJsonString(out, r.category);
+            out << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << b.tid << ", \"ts\": ";
+            writeMicroseconds(out, r.start);
+            out << ", \"dur\": ";
+            writeMicroseconds(out, r.duration);
+            out << "}";
+        }
+    }
+    out << "\n]}\n";
+
+    if (not out)
+        throw GrateError("Error writing trace: " + fileName);
+}
@@ -0,0 +1,60 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+
+// Event tracer: a timeline of what each thread was doing (model phases, results writing, ensemble
+// members), written as a Chrome trace file for chrome://tracing or ui.perfetto.dev. Each thread
+// records into its own ring buffer, which only it writes to, so recording takes no locks; when a
+// buffer is full the oldest events are overwritten. Off unless traceStart() is called, and then a
+// trace point costs one relaxed atomic load.
+
+extern std::atomic<bool> traceOn;
+
+inline bool traceEnabled()
+{
+    return traceOn.load(std::memory_order_relaxed);
+}
+
+void traceStart();                             // Start recording, with times relative to now
+void traceThreadName(const std::string &name); // Label for the calling thread in the timeline
+
+// One span on the calling thread's timeline. The category and name are copied.
+void traceEvent(const char *category, const char *name,
+                std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+
+// Stops recording and writes every thread's events; the threads must have finished with them.
+// Throws GrateError if the file can't be written.
+void writeTrace(const std::string &fileName);
+
+// Records the time from construction to destruction as a span, if tracing is on
+class TraceScope
+{
+public:
+
+    TraceScope(const char *category, const char *name) : category(category), name(name), on(traceEnabled())
+    {
+        if (on)
+            start = std::chrono::steady_clock::now();
+    }
+
+    ~TraceScope()
+    {
+        if (on)
+            traceEvent(category, name, start, std::chrono::steady_clock::now());
+    }
+
+private:
+    const char *category;
+    const char *name;                          // Must outlive the scope
+    bool on;
+    std::chrono::steady_clock::time_point start;
+
+    TraceScope(const TraceScope &);
+    TraceScope &operator=(const TraceScope &);
+};
+
+#endif // TRACE_H
@@ -95,6 +95,7 @@ public:
     QLabel *label_19;
     QSlider *sedUpw_slider;
     QPushButton *pausePlot;
+    QSlider *historySlider;
     QMenuBar *menuBar;
     QMenu *menuFile;
     QToolBar *mainToolBar;
@@ -354,6 +355,12 @@ public:
         pausePlot->setGeometry(QRect(20, 110, 90, 22));
         pausePlot->setAutoFillBackground(true);
         pausePlot->setCheckable(true);
+        historySlider = new QSlider(centralWidget);
+        historySlider->setObjectName(QString::fromUtf8("historySlider"));
+        historySlider->setEnabled(false);
+        historySlider->setGeometry(QRect(20, 136, 121, 22));
+        historySlider->setMaximum(0);
+        historySlider->setOrientation(Qt::Horizontal);
         MainWindow->setCentralWidget(centralWidget);
         menuBar = new QMenuBar(MainWindow);
         menuBar->setObjectName(QString::fromUtf8("menuBar"));
@@ -424,6 +431,9 @@ public:
         sedUpw_slider->setToolTip(QString());
 #endif // QT_CONFIG(tooltip)
         pausePlot->setText(QCoreApplication::translate("MainWindow", "Pause Plotting", nullptr));
+#if QT_CONFIG(tooltip)
+        historySlider->setToolTip(QCoreApplication::translate("MainWindow", "Look back through the run; all the way right follows it", nullptr));
+#endif // QT_CONFIG(tooltip)
         menuFile->setTitle(QCoreApplication::translate("MainWindow", "File", nullptr));
     } // retranslateUi
 
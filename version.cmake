@@ -0,0 +1,19 @@
+#
+# Writes OUTPUT (grate_version.h) with the git description of the source tree, e.g.
+# "a1b2c3d-dirty", at every build. The file is only replaced when the description changes, so an
+# unchanged tree rebuilds nothing.
+#
+execute_process(
+    COMMAND git describe --always --dirty
+    WORKING_DIRECTORY ${SOURCE_DIR}
+    OUTPUT_VARIABLE version
+    OUTPUT_STRIP_TRAILING_WHITESPACE
+    RESULT_VARIABLE status
+    ERROR_QUIET
+)
+if (status OR version STREQUAL "")
+    set(version "unknown")
+endif ()
+file(WRITE ${OUTPUT}.new "#define GRATE_VERSION \"${version}\"\n")
+configure_file(${OUTPUT}.new ${OUTPUT} COPYONLY)
+file(REMOVE ${OUTPUT}.new)